@@ -0,0 +1,147 @@
+#include "bench.hpp"
+#include <SDL.h>
+#include <SuperSDL/audio.hpp>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+namespace bench {
+
+namespace {
+
+uint64_t hashSamples(uint64_t Hash, const float *pSamples, size_t Count) {
+	const uint8_t *pBytes = reinterpret_cast<const uint8_t *>(pSamples);
+	for (size_t i = 0; i < Count * sizeof(float); i++)
+		Hash = (Hash ^ pBytes[i]) * 1099511628211ull;
+	return Hash;
+}
+
+// Fades out every voice and frees them.
+void stopAll(sps::CAudioMixer &Mixer, std::vector<sps::VoiceHandle> &Voices, std::vector<float> &Out) {
+	for (sps::VoiceHandle Voice : Voices)
+		Mixer.stop(Voice);
+	Voices.clear();
+	Mixer.mix(Out.data(), Mixer.getSamples());
+	Mixer.update();
+}
+
+// Mixes offline with the device of SDL's dummy audio driver paused, the way
+// its callback would. Half the voices are mono at 44.1 kHz and resampled,
+// the others stereo at the device rate, some of them pitched. Reports how
+// many voices fit in a millisecond of callback time with each kernel set.
+void audioMix() {
+	constexpr uint32_t Callbacks = 200;
+	const uint32_t aVoiceCounts[] = {64, 256, 1000};
+
+	SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+	sps::CAudioMixer Mixer;
+	Mixer.init(48000, 512);
+	if (!Mixer.isOpen()) {
+		std::printf("    no audio device\n");
+		return;
+	}
+	uint32_t Rate = Mixer.getFrequency();
+	uint32_t Samples = Mixer.getSamples();
+	std::vector<float> Out(size_t(Samples) * 2);
+
+	std::mt19937 Random(1);
+	std::uniform_real_distribution<float> Noise(-1.0f, 1.0f);
+	std::vector<float> Mono(44100);
+	for (float &Sample : Mono)
+		Sample = Noise(Random);
+	std::vector<float> Stereo(size_t(Rate) * 2);
+	for (float &Sample : Stereo)
+		Sample = Noise(Random);
+	sps::SoundHandle MonoSound = Mixer.createSound("mono", Mono.data(), 44100, 1, 44100);
+	sps::SoundHandle StereoSound = Mixer.createSound("stereo", Stereo.data(), Rate, 2, Rate);
+
+	// The real callback, driven by the dummy driver's thread.
+	std::vector<sps::VoiceHandle> Voices;
+	sps::VoiceParams Looped;
+	Looped.m_Loop = true;
+	Looped.m_Volume = 0.1f;
+	Voices.push_back(Mixer.play(MonoSound, Looped));
+	Voices.push_back(Mixer.play(StereoSound, Looped));
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	Mixer.setPaused(true);
+	uint64_t LiveCallbacks = Mixer.getStats().m_Callbacks;
+	stopAll(Mixer, Voices, Out);
+	std::printf("    dummy %u Hz device, %u frames per callback (%.2f ms), %llu callbacks in 100 ms\n", Rate, Samples, Samples * 1e3 / Rate,
+				(unsigned long long)LiveCallbacks);
+
+	sps::EAudioKernels Best = sps::setAudioKernels(sps::AUDIO_KERNELS_SSE2);
+	uint32_t Errors = 0;
+	for (uint32_t VoiceCount : aVoiceCounts) {
+		uint64_t Reference = 0;
+		for (int Kernels = sps::AUDIO_KERNELS_SCALAR; Kernels <= Best; Kernels++) {
+			sps::setAudioKernels(static_cast<sps::EAudioKernels>(Kernels));
+			std::mt19937 Params(VoiceCount);
+			for (uint32_t i = 0; i < VoiceCount; i++) {
+				sps::VoiceParams Voice;
+				Voice.m_Loop = true;
+				Voice.m_Volume = 1.0f / 64.0f;
+				Voice.m_Pan = Noise(Params);
+				Voice.m_Pitch = i % 4 == 3 ? 1.0f + 0.5f * Noise(Params) : 1.0f;
+				Voices.push_back(Mixer.play(i % 2 ? StereoSound : MonoSound, Voice));
+			}
+
+			uint64_t Hash = 14695981039346656037ull;
+			double Start = now();
+			for (uint32_t i = 0; i < Callbacks; i++) {
+				Mixer.mix(Out.data(), Samples);
+				Hash = hashSamples(Hash, Out.data(), Out.size());
+			}
+			double Time = (now() - Start) / Callbacks;
+			stopAll(Mixer, Voices, Out);
+
+			// Every kernel set must mix the same samples.
+			if (Kernels == sps::AUDIO_KERNELS_SCALAR)
+				Reference = Hash;
+			Errors += Hash != Reference;
+			std::printf("    %-6s %4u voices: %7.1f us per callback (%4.1f%% of real time), %6.0f voices per ms\n",
+						sps::getAudioKernelsName(static_cast<sps::EAudioKernels>(Kernels)), VoiceCount, Time * 1e6, Time * Rate / Samples * 100.0,
+						VoiceCount / (Time * 1e3));
+		}
+	}
+	sps::setAudioKernels(Best);
+
+	// A stream of a known length, mixed at about 4 times real time so the
+	// stream thread has to keep up.
+	constexpr uint32_t StreamFrames = 48000;
+	uint32_t Streamed = 0;
+	sps::VoiceHandle Stream = Mixer.playStream("constant", 1, Rate, [&Streamed](float *const *ppPlanes, uint32_t Frames) {
+		uint32_t Count = std::min(Frames, StreamFrames - Streamed);
+		for (uint32_t i = 0; i < Count; i++)
+			ppPlanes[0][i] = 0.5f;
+		Streamed += Count;
+		return Count;
+	});
+	double Sum = 0.0;
+	for (uint32_t i = 0; i < 4 * StreamFrames / Samples && Mixer.isPlaying(Stream); i++) {
+		std::this_thread::sleep_for(std::chrono::microseconds(uint64_t(Samples) * 250000 / Rate));
+		Mixer.mix(Out.data(), Samples);
+		Mixer.update();
+		for (uint32_t j = 0; j < Samples; j++)
+			Sum += Out[2 * j];
+	}
+	// Centered at constant power.
+	double Expected = StreamFrames * 0.5 * std::sqrt(0.5);
+	Errors += Mixer.isPlaying(Stream) || std::fabs(Sum - Expected) > 1.0;
+
+	sps::AudioStats Stats = Mixer.getStats();
+	std::printf("    streamed %u frames with %llu underruns, worst callback %.1f us, %s\n", Streamed, (unsigned long long)Stats.m_Underruns,
+				Stats.m_MaxMixTime * 1e6, Errors == 0 ? "mixes match" : "MIXES DON'T MATCH");
+	if (Errors != 0)
+		fail("mixes don't match the expected output");
+
+	Mixer.releaseSound(MonoSound);
+	Mixer.releaseSound(StereoSound);
+	Mixer.quit();
+}
+
+RegisterMicroBench s_Audio("audio", audioMix);
+
+} // namespace
+
+} // namespace bench
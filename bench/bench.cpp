@@ -0,0 +1,238 @@
+#include "bench.hpp"
+#include <SuperSDL/supersdl.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+
+namespace bench {
+
+std::vector<std::unique_ptr<CBenchScene>> &scenes() {
+	static std::vector<std::unique_ptr<CBenchScene>> s_Scenes;
+	return s_Scenes;
+}
+
+std::vector<MicroBench> &microBenchmarks() {
+	static std::vector<MicroBench> s_MicroBenchmarks;
+	return s_MicroBenchmarks;
+}
+
+static uint32_t s_Failures = 0;
+
+void fail(const char *pWhat) {
+	std::printf("    FAILED: %s\n", pWhat);
+	s_Failures++;
+}
+
+bool hasFailed() { return s_Failures != 0; }
+
+} // namespace bench
+
+// Renders every selected scene for a number of frames with the headless
+// renderer and reports CPU and GPU frame times plus a checksum of the last
+// frame of each scene.
+class CBenchGame : public sps::CGame {
+  private:
+	struct Result {
+		double m_CpuTime = 0.0;
+		double m_CpuMax = 0.0;
+		double m_GpuTime = 0.0;
+		uint32_t m_Samples = 0;
+		// Heap allocations of the measured frames, and frames that made any.
+		uint64_t m_HeapAllocations = 0;
+		uint32_t m_AllocatingFrames = 0;
+		uint64_t m_Checksum = 0;
+	};
+
+	static constexpr uint32_t WarmupFrames = 10;
+
+	std::vector<bench::CBenchScene *> m_Scenes;
+	std::vector<Result> m_Results;
+	// Renderer frame number of each readback to the scene it belongs to.
+	std::map<uint64_t, size_t> m_PendingReadbacks;
+	uint32_t m_FramesPerScene;
+	size_t m_Scene;
+	uint32_t m_Frame;
+
+  protected:
+	virtual void onLoad() {
+		renderer().setReadbackCallback([this](const sps::FrameReadback &Readback) {
+			// FNV-1a
+			uint64_t Hash = 14695981039346656037ull;
+			for (size_t i = 0; i < Readback.m_Size; i++)
+				Hash = (Hash ^ Readback.m_pPixels[i]) * 1099511628211ull;
+
+			auto It = m_PendingReadbacks.find(Readback.m_Frame);
+			if (It != m_PendingReadbacks.end()) {
+				m_Results[It->second].m_Checksum = Hash;
+				m_PendingReadbacks.erase(It);
+			}
+		});
+
+		for (auto *pScene : m_Scenes)
+			pScene->load(renderer());
+	}
+
+	virtual void onUpdate(double delta) { (void)delta; }
+
+	virtual void onRender(double alpha) {
+		(void)alpha;
+		if (m_Scene >= m_Scenes.size()) {
+			stop();
+			return;
+		}
+
+		Result &Current = m_Results[m_Scene];
+		if (m_Frame > WarmupFrames) {
+			Current.m_CpuTime += renderer().getCpuFrameTime();
+			Current.m_CpuMax = std::max(Current.m_CpuMax, renderer().getCpuFrameTime());
+			Current.m_GpuTime += renderer().getGpuFrameTime();
+			// Of the frame before, which belongs to this scene too.
+			uint64_t Allocations = getMemoryStats().m_FrameAllocations;
+			Current.m_HeapAllocations += Allocations;
+			Current.m_AllocatingFrames += Allocations > 0;
+			Current.m_Samples++;
+		}
+
+		m_Scenes[m_Scene]->render(renderer(), m_Frame);
+
+		if (++m_Frame == m_FramesPerScene) {
+			m_PendingReadbacks[renderer().getFrameNumber()] = m_Scene;
+			renderer().requestReadback();
+			m_Scenes[m_Scene]->unload(renderer());
+			m_Frame = 0;
+			m_Scene++;
+		}
+	}
+
+  public:
+	CBenchGame(std::vector<bench::CBenchScene *> Scenes, uint32_t FramesPerScene, uint32_t Width, uint32_t Height, bool Bindless, bool ParallelStartup)
+		: sps::CGame("Ryozuki", "SuperSDLBench") {
+		m_Scenes = std::move(Scenes);
+		m_Results.resize(m_Scenes.size());
+		m_FramesPerScene = std::max(FramesPerScene, WarmupFrames + 1);
+		m_Scene = 0;
+		m_Frame = 0;
+		setHeadless(true, Width, Height);
+		setTargetFrameRate(0.0);
+		renderer().setBindless(Bindless);
+		setParallelStartup(ParallelStartup);
+	}
+
+	void report() {
+		// Run with -S to compare against a sequential startup.
+		sps::StartupStats Startup = getStartupStats();
+		std::sort(Startup.m_Steps.begin(), Startup.m_Steps.end(), [](const sps::StartupStep &A, const sps::StartupStep &B) { return A.m_Start < B.m_Start; });
+		std::printf("startup: first frame after %.2f ms, %.2f ms of it in the background\n", Startup.m_TimeToFirstFrame * 1000.0,
+					Startup.m_BackgroundTime * 1000.0);
+		for (const sps::StartupStep &Step : Startup.m_Steps)
+			std::printf("  %-24s %8.2f ms at %8.2f ms%s\n", Step.m_pName, Step.m_Duration * 1000.0, Step.m_Start * 1000.0, Step.m_Background ? " (background)" : "");
+
+		std::printf("%-20s %12s %12s %12s %12s %18s\n", "scene", "cpu avg ms", "cpu max ms", "gpu avg ms", "allocs/frame", "checksum");
+		for (size_t i = 0; i < m_Scenes.size(); i++) {
+			const Result &R = m_Results[i];
+			uint32_t Samples = std::max(R.m_Samples, 1u);
+			std::printf("%-20s %12.3f %12.3f %12.3f %12.2f   %016llx\n", m_Scenes[i]->name(),
+						R.m_CpuTime * 1000.0 / Samples, R.m_CpuMax * 1000.0,
+						R.m_GpuTime * 1000.0 / Samples, double(R.m_HeapAllocations) / Samples, (unsigned long long)R.m_Checksum);
+			m_Scenes[i]->report(renderer());
+		}
+
+		// The engine's own work shouldn't allocate once warmed up, scenes
+		// that allocate on their own are expected to show up here.
+		if (!sps::isTrackingHeap()) {
+			std::printf("heap allocations aren't counted, build with SUPERSDL_TRACK_ALLOCATIONS\n");
+			return;
+		}
+		for (size_t i = 0; i < m_Scenes.size(); i++) {
+			const Result &R = m_Results[i];
+			if (R.m_AllocatingFrames > 0)
+				std::printf("%s allocated in %u of %u frames after warming up\n", m_Scenes[i]->name(), R.m_AllocatingFrames, R.m_Samples);
+		}
+	}
+};
+
+static void usage(const char *pArgv0) {
+	std::printf("usage: %s [-f frames] [-w width] [-h height] [-n] [-S] [-l] [-p [-i images]] [name...]\n", pArgv0);
+	std::printf("  -l  list the available scenes and micro benchmarks\n");
+	std::printf("  -n  bind textures one by one even if the GPU supports bindless ones\n");
+	std::printf("  -S  start up sequentially, to compare the time to the first frame\n");
+	std::printf("  -p  measure present intervals of every present mode in a window, frames per mode\n");
+	std::printf("  -i  swap chain images to ask for with -p\n");
+	std::printf("  names select scenes and micro benchmarks, all of them run by default\n");
+	std::printf("\n");
+	std::printf("Comparing startups without a GPU, e.g. on lavapipe:\n");
+	std::printf("  SDL_VIDEODRIVER=dummy SDL_AUDIODRIVER=dummy VK_ICD_FILENAMES=<path to lvp_icd.json> %s -f 20 clear\n", pArgv0);
+	std::printf("  the same with -S, alternating the two a few times. The pipeline cache in the\n");
+	std::printf("  pref path makes runs after the first warm, delete pipeline_cache.bin for cold ones.\n");
+}
+
+int main(int argc, char **argv) {
+	uint32_t Frames = 300;
+	uint32_t Width = 1280;
+	uint32_t Height = 720;
+	uint32_t Images = 0;
+	bool Present = false;
+	bool Bindless = true;
+	bool ParallelStartup = true;
+	std::vector<std::string> Filter;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			Frames = std::strtoul(argv[++i], nullptr, 10);
+		} else if (std::strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+			Width = std::strtoul(argv[++i], nullptr, 10);
+		} else if (std::strcmp(argv[i], "-h") == 0 && i + 1 < argc) {
+			Height = std::strtoul(argv[++i], nullptr, 10);
+		} else if (std::strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+			Images = std::strtoul(argv[++i], nullptr, 10);
+		} else if (std::strcmp(argv[i], "-n") == 0) {
+			Bindless = false;
+		} else if (std::strcmp(argv[i], "-S") == 0) {
+			ParallelStartup = false;
+		} else if (std::strcmp(argv[i], "-p") == 0) {
+			Present = true;
+		} else if (std::strcmp(argv[i], "-l") == 0) {
+			for (const auto &pScene : bench::scenes())
+				std::printf("scene %s\n", pScene->name());
+			for (const auto &Micro : bench::microBenchmarks())
+				std::printf("micro %s\n", Micro.m_pName);
+			return 0;
+		} else if (argv[i][0] == '-') {
+			usage(argv[0]);
+			return 1;
+		} else {
+			Filter.push_back(argv[i]);
+		}
+	}
+
+	if (Present)
+		return bench::runPresentBench(Frames, Images);
+
+	auto Selected = [&](const char *pName) {
+		return Filter.empty() || std::find(Filter.begin(), Filter.end(), pName) != Filter.end();
+	};
+
+	for (const auto &Micro : bench::microBenchmarks()) {
+		if (Selected(Micro.m_pName)) {
+			std::printf("== %s\n", Micro.m_pName);
+			Micro.m_pRun();
+		}
+	}
+
+	std::vector<bench::CBenchScene *> Scenes;
+	for (const auto &pScene : bench::scenes()) {
+		if (Selected(pScene->name()))
+			Scenes.push_back(pScene.get());
+	}
+
+	if (Scenes.empty())
+		return bench::hasFailed() ? 1 : 0;
+
+	CBenchGame Game(Scenes, Frames, Width, Height, Bindless, ParallelStartup);
+	Game.start();
+	Game.report();
+	return bench::hasFailed() ? 1 : 0;
+}
@@ -0,0 +1,65 @@
+#ifndef SUPERSDL_BENCH_BENCH_HPP
+#define SUPERSDL_BENCH_BENCH_HPP
+
+#include <SuperSDL/renderer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace bench {
+
+inline double now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Keeps the optimizer from throwing away a computed value.
+template <typename T>
+inline void doNotOptimize(const T &Value) {
+	asm volatile("" : : "r,m"(Value) : "memory");
+}
+
+// A scene rendered for a number of frames by the headless renderer. It must
+// only depend on the frame index so its checksum is reproducible.
+class CBenchScene {
+  public:
+	virtual ~CBenchScene() {}
+	virtual const char *name() const = 0;
+	virtual void load(sps::CRenderer &Renderer) { (void)Renderer; }
+	// Called after the scene's last frame was recorded.
+	virtual void unload(sps::CRenderer &Renderer) { (void)Renderer; }
+	virtual void render(sps::CRenderer &Renderer, uint32_t Frame) = 0;
+	// Extra metric appended to the report line, if any.
+	virtual void report(const sps::CRenderer &Renderer) const { (void)Renderer; }
+};
+
+// A benchmark that doesn't need the renderer.
+struct MicroBench {
+	const char *m_pName;
+	void (*m_pRun)();
+};
+
+std::vector<std::unique_ptr<CBenchScene>> &scenes();
+std::vector<MicroBench> &microBenchmarks();
+
+// A result a benchmark checks along the way is wrong. It's printed and the
+// bench exits with 1 once it's done, so scripts and CI notice.
+void fail(const char *pWhat);
+bool hasFailed();
+
+// Needs a display: cycles through the supported present modes in a window
+// and prints the present-to-present intervals of each. ImageCount 0 keeps
+// the renderer's default.
+int runPresentBench(uint32_t FramesPerMode, uint32_t ImageCount);
+
+struct RegisterScene {
+	RegisterScene(std::unique_ptr<CBenchScene> pScene) { scenes().push_back(std::move(pScene)); }
+};
+
+struct RegisterMicroBench {
+	RegisterMicroBench(const char *pName, void (*pRun)()) { microBenchmarks().push_back({pName, pRun}); }
+};
+
+} // namespace bench
+
+#endif
@@ -0,0 +1,116 @@
+#include "bench.hpp"
+#include <SuperSDL/color.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+struct Planes {
+	std::vector<float> m_R, m_G, m_B, m_A;
+
+	explicit Planes(size_t Count) : m_R(Count), m_G(Count), m_B(Count), m_A(Count) {}
+
+	sps::ColorPlanes get() { return {m_R.data(), m_G.data(), m_B.data(), m_A.data()}; }
+
+	bool operator==(const Planes &Other) const {
+		return m_R == Other.m_R && m_G == Other.m_G && m_B == Other.m_B && m_A == Other.m_A;
+	}
+};
+
+double linearToSrgb(double v) {
+	return v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+}
+
+// Every kernel on a 4K image worth of colors with each implementation the
+// CPU supports. The results are compared against the scalar ones, which
+// are compared against the exact conversion.
+void colorKernels() {
+	constexpr size_t Count = 3840 * 2160;
+	constexpr uint32_t Runs = 10;
+
+	std::vector<uint32_t> Source(Count);
+	for (size_t i = 0; i < Count; i++)
+		Source[i] = uint32_t(i * 2654435761u);
+	Planes Background(Count);
+	sps::unpackSrgb(Source.data(), Background.get(), Count);
+
+	sps::EColorKernels Best = sps::getColorKernels();
+	Planes Reference(Count);
+	std::vector<uint32_t> ReferencePacked(Count);
+	double aScalar[4] = {};
+
+	std::printf("    %-8s %14s %14s %14s %14s %8s\n", "kernels", "unpack Mc/s", "premul Mc/s", "blend Mc/s", "pack Mc/s", "match");
+	for (int k = sps::COLOR_KERNELS_SCALAR; k <= Best; k++) {
+		sps::EColorKernels Kernels = sps::setColorKernels(sps::EColorKernels(k));
+		Planes Colors(Count);
+		Planes Target(Count);
+		std::vector<uint32_t> Packed(Count);
+		double aTime[4] = {};
+
+		for (uint32_t Run = 0; Run < Runs; Run++) {
+			Target = Background;
+
+			double Start = now();
+			sps::unpackSrgb(Source.data(), Colors.get(), Count);
+			double Unpacked = now();
+			sps::premultiply(Colors.get(), Count);
+			double Premultiplied = now();
+			sps::blendOver(Target.get(), Colors.get(), Count);
+			double Blended = now();
+			sps::packSrgb(Target.get(), Packed.data(), Count);
+			double End = now();
+
+			aTime[0] += Unpacked - Start;
+			aTime[1] += Premultiplied - Unpacked;
+			aTime[2] += Blended - Premultiplied;
+			aTime[3] += End - Blended;
+		}
+		doNotOptimize(Packed[Count / 2]);
+
+		bool Match = true;
+		if (Kernels == sps::COLOR_KERNELS_SCALAR) {
+			Reference = Target;
+			ReferencePacked = Packed;
+			std::memcpy(aScalar, aTime, sizeof(aTime));
+		} else {
+			Match = Target == Reference && Packed == ReferencePacked;
+		}
+
+		std::printf("    %-8s", sps::getColorKernelsName(Kernels));
+		for (int i = 0; i < 4; i++)
+			std::printf(" %7.0f (%4.1fx)", Count * Runs / aTime[i] / 1e6, aScalar[i] / aTime[i]);
+		std::printf(" %8s\n", Match ? "yes" : "NO");
+		if (!Match)
+			fail("kernel results differ from the scalar ones");
+	}
+	sps::setColorKernels(Best);
+
+	// Accuracy of the table based sRGB encoding.
+	uint32_t MaxError = 0;
+	size_t Off = 0;
+	for (size_t i = 0; i < Count; i++) {
+		auto Check = [&](float Linear, uint32_t Encoded) {
+			double Clamped = std::min(1.0, std::max(0.0, double(Linear)));
+			uint32_t Exact = uint32_t(std::lround(linearToSrgb(Clamped) * 255.0));
+			uint32_t Error = Exact > Encoded ? Exact - Encoded : Encoded - Exact;
+			MaxError = std::max(MaxError, Error);
+			Off += Error != 0;
+		};
+		Check(Reference.m_R[i], ReferencePacked[i] & 0xFF);
+		Check(Reference.m_G[i], (ReferencePacked[i] >> 8) & 0xFF);
+		Check(Reference.m_B[i], (ReferencePacked[i] >> 16) & 0xFF);
+	}
+	std::printf("    sRGB encoding: max error %u levels, %.3f%% of channels off\n", MaxError, Off * 100.0 / (Count * 3));
+	if (MaxError > 1)
+		fail("sRGB encoding is off by more than one level");
+}
+
+RegisterMicroBench s_ColorKernels("color_kernels", colorKernels);
+
+} // namespace
+
+} // namespace bench
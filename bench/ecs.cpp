@@ -0,0 +1,179 @@
+#include "bench.hpp"
+#include <SuperSDL/ecs.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+constexpr uint32_t Entities = 1 << 20;
+
+struct Position {
+	float m_X, m_Y;
+};
+
+struct Velocity {
+	float m_X, m_Y;
+};
+
+struct Health {
+	float m_Value;
+};
+
+struct Frozen {
+	uint32_t m_Frames;
+};
+
+// What games write without a data model: heap objects behind pointers,
+// updated through a virtual call.
+class CObject {
+  public:
+	Position m_Position;
+	Velocity m_Velocity;
+	Health m_Health;
+	char m_aOther[40];
+
+	virtual ~CObject() {}
+	virtual void update(float Dt) {
+		m_Position.m_X += m_Velocity.m_X * Dt;
+		m_Position.m_Y += m_Velocity.m_Y * Dt;
+	}
+};
+
+void populate(sps::CWorld &World) {
+	for (uint32_t i = 0; i < Entities; i++) {
+		Position P = {float(i % 1024), float(i / 1024)};
+		Velocity V = {1.0f, 0.5f};
+		// A few archetypes, as in a real game.
+		if (i % 4 == 0)
+			World.create(P, V, Health{100.0f});
+		else if (i % 4 == 1)
+			World.create(P, V, Health{100.0f}, Frozen{0});
+		else
+			World.create(P, V);
+	}
+}
+
+void ecsIterate() {
+	constexpr uint32_t Runs = 20;
+	constexpr float Dt = 1.0f / 60.0f;
+
+	std::vector<std::unique_ptr<CObject>> Objects;
+	Objects.reserve(Entities);
+	for (uint32_t i = 0; i < Entities; i++) {
+		Objects.push_back(std::make_unique<CObject>());
+		Objects.back()->m_Velocity = {1.0f, 0.5f};
+	}
+	// Objects created over a game's lifetime end up all over the heap.
+	std::shuffle(Objects.begin(), Objects.end(), std::mt19937(42));
+
+	sps::CJobSystem Jobs;
+	Jobs.init();
+	sps::CWorld World;
+	World.init(&Jobs);
+	populate(World);
+
+	auto Measure = [&](const char *pName, auto &&Run) {
+		Run();
+		double Start = now();
+		for (uint32_t i = 0; i < Runs; i++)
+			Run();
+		double Time = (now() - Start) / Runs;
+		std::printf("    %-28s %8.3f ms %8.2f ns/entity\n", pName, Time * 1000.0, Time * 1e9 / Entities);
+	};
+
+	Measure("objects, virtual update", [&]() {
+		for (auto &pObject : Objects)
+			pObject->update(Dt);
+	});
+	Measure("each", [&]() {
+		World.each<Position, const Velocity>([](Position &P, const Velocity &V) {
+			P.m_X += V.m_X * Dt;
+			P.m_Y += V.m_Y * Dt;
+		});
+	});
+	Measure("eachChunk", [&]() {
+		World.eachChunk<Position, const Velocity>([](uint32_t Count, const sps::Entity *, Position *pP, const Velocity *pV) {
+			for (uint32_t i = 0; i < Count; i++) {
+				pP[i].m_X += pV[i].m_X * Dt;
+				pP[i].m_Y += pV[i].m_Y * Dt;
+			}
+		});
+	});
+	Measure("parallelEach", [&]() {
+		World.parallelEach<Position, const Velocity>([](Position &P, const Velocity &V) {
+			P.m_X += V.m_X * Dt;
+			P.m_Y += V.m_Y * Dt;
+		});
+	});
+	Measure("each, 3 components", [&]() {
+		World.each<Position, Health>([](Position &P, Health &H) { H.m_Value -= P.m_X * 0.0001f; });
+	});
+
+	float Sum = 0.0f;
+	World.each<Position>([&](Position &P) { Sum += P.m_X; });
+	doNotOptimize(Sum);
+	doNotOptimize(Objects[Entities / 2]->m_Position.m_X);
+
+	World.quit();
+	Jobs.quit();
+}
+
+// Structural changes through commands, recorded from parallel iteration the
+// way systems do it.
+void ecsMutate() {
+	sps::CJobSystem Jobs;
+	Jobs.init();
+	sps::CWorld World;
+	World.init(&Jobs);
+
+	auto Report = [](const char *pName, double Time) {
+		std::printf("    %-28s %8.3f ms %8.2f ns/entity\n", pName, Time * 1000.0, Time * 1e9 / Entities);
+	};
+
+	double Start = now();
+	populate(World);
+	Report("create", now() - Start);
+
+	Start = now();
+	World.parallelEach<Position>([&](sps::Entity E, Position &) { World.commands().add(E, Frozen{1}); });
+	double Recorded = now();
+	World.flush();
+	Report("add, record", Recorded - Start);
+	Report("add, flush", now() - Recorded);
+
+	Start = now();
+	World.parallelEach<Frozen>([&](sps::Entity E, Frozen &) { World.commands().remove<Frozen>(E); });
+	Recorded = now();
+	World.flush();
+	Report("remove, record", Recorded - Start);
+	Report("remove, flush", now() - Recorded);
+
+	Start = now();
+	World.parallelEach<Position>([&](sps::Entity E, Position &) { World.commands().destroy(E); });
+	World.flush();
+	Report("destroy, record and flush", now() - Start);
+
+	// Churn after warmup: chunks and command pages are reused.
+	populate(World);
+	Start = now();
+	World.parallelEach<Position>([&](sps::Entity E, Position &) { World.commands().destroy(E); });
+	World.flush();
+	populate(World);
+	Report("destroy and recreate", now() - Start);
+
+	std::printf("    %u entities in %u archetypes\n", World.getEntityCount(), World.getArchetypeCount());
+	World.quit();
+	Jobs.quit();
+}
+
+RegisterMicroBench s_EcsIterate("ecs_iterate", ecsIterate);
+RegisterMicroBench s_EcsMutate("ecs_mutate", ecsMutate);
+
+} // namespace
+
+} // namespace bench
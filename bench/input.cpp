@@ -0,0 +1,121 @@
+#include "bench.hpp"
+#include <SDL.h>
+#include <SuperSDL/input.hpp>
+#include <cstdio>
+#include <thread>
+
+namespace bench {
+
+namespace {
+
+// Synthetic events pushed under SDL's dummy video driver, pumped and folded
+// into snapshots the way CGame does every frame. Checks that the snapshots
+// add up to what was pushed.
+void inputPipeline() {
+	constexpr uint32_t Frames = 2000;
+	constexpr uint32_t MotionsPerFrame = 32;
+
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+	if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
+		std::printf("    SDL failed to start: %s\n", SDL_GetError());
+		return;
+	}
+
+	sps::CInput Input;
+	uint32_t Errors = 0;
+	double PushTime = 0.0;
+	double PumpTime = 0.0;
+	double UpdateTime = 0.0;
+	for (uint32_t Frame = 0; Frame < Frames; Frame++) {
+		double Start = now();
+		for (uint32_t i = 0; i < MotionsPerFrame; i++) {
+			SDL_Event Motion = {};
+			Motion.type = SDL_MOUSEMOTION;
+			Motion.motion.x = static_cast<Sint32>(Frame + i);
+			Motion.motion.y = static_cast<Sint32>(i);
+			Motion.motion.xrel = 1;
+			Motion.motion.yrel = -2;
+			SDL_PushEvent(&Motion);
+		}
+		// Tapped within the frame on odd frames, held across frames on even ones.
+		SDL_Event Key = {};
+		Key.type = SDL_KEYDOWN;
+		Key.key.keysym.scancode = SDL_SCANCODE_SPACE;
+		SDL_PushEvent(&Key);
+		if (Frame % 2) {
+			Key.type = SDL_KEYUP;
+			SDL_PushEvent(&Key);
+		}
+		double Pushed = now();
+		Input.pump();
+		double Pumped = now();
+		Input.update();
+		double Updated = now();
+
+		PushTime += Pushed - Start;
+		PumpTime += Pumped - Pushed;
+		UpdateTime += Updated - Pumped;
+
+		const sps::InputSnapshot &Snapshot = Input.snapshot();
+		bool Tapped = Frame % 2;
+		Errors += Snapshot.m_MouseDelta != glm::vec2(MotionsPerFrame, -2.0f * MotionsPerFrame);
+		Errors += Snapshot.m_MousePosition != glm::vec2(Frame + MotionsPerFrame - 1, MotionsPerFrame - 1);
+		Errors += !Snapshot.wasPressed(SDL_SCANCODE_SPACE);
+		Errors += Snapshot.isDown(SDL_SCANCODE_SPACE) == Tapped;
+		Errors += Snapshot.wasReleased(SDL_SCANCODE_SPACE) != Tapped;
+
+		// A frame without a fixed update, its release waits with the press
+		// for the next one.
+		if (!Tapped) {
+			Key.type = SDL_KEYUP;
+			SDL_PushEvent(&Key);
+			Input.pump();
+			Input.update();
+			const sps::InputSnapshot &Held = Input.snapshot();
+			Errors += !Held.wasPressed(SDL_SCANCODE_SPACE) || !Held.wasReleased(SDL_SCANCODE_SPACE) || Held.isDown(SDL_SCANCODE_SPACE);
+		}
+		// As CGame does after each fixed update.
+		Input.consume();
+		Errors += Input.snapshot().wasPressed(SDL_SCANCODE_SPACE) || Input.snapshot().m_MouseDelta != glm::vec2(0.0f);
+	}
+
+	// The queue between two threads, as when the snapshots are built by
+	// another thread than the window's.
+	constexpr uint32_t Concurrent = 200000;
+	sps::CSpscQueue<uint32_t> Queue(1024);
+	uint64_t Sum = 0;
+	double Start = now();
+	std::thread Consumer([&] {
+		uint32_t Value;
+		for (uint32_t Received = 0; Received < Concurrent;) {
+			if (Queue.pop(Value)) {
+				Sum += Value;
+				Received++;
+			}
+		}
+	});
+	for (uint32_t i = 0; i < Concurrent; i++) {
+		while (!Queue.push(i)) {
+		}
+	}
+	Consumer.join();
+	double QueueTime = now() - Start;
+	Errors += Sum != uint64_t(Concurrent) * (Concurrent - 1) / 2;
+
+	const sps::InputStats &Stats = Input.getStats();
+	std::printf("    %u frames of %u motions and a key: push %.2f us, pump %.2f us, snapshot %.2f us per frame\n", Frames, MotionsPerFrame,
+				PushTime * 1e6 / Frames, PumpTime * 1e6 / Frames, UpdateTime * 1e6 / Frames);
+	std::printf("    %llu events, %llu motions merged, %llu pumps deferred, spsc queue %.1f ns per element across threads, %s\n",
+				(unsigned long long)Stats.m_Events, (unsigned long long)Stats.m_MergedMotions, (unsigned long long)Stats.m_Deferred,
+				QueueTime * 1e9 / Concurrent, Errors == 0 ? "snapshots match" : "SNAPSHOTS DON'T MATCH");
+	if (Errors != 0)
+		fail("input snapshots don't match the pushed events");
+
+	SDL_QuitSubSystem(SDL_INIT_VIDEO);
+}
+
+RegisterMicroBench s_Input("input", inputPipeline);
+
+} // namespace
+
+} // namespace bench
@@ -0,0 +1,72 @@
+#include "bench.hpp"
+#include <SuperSDL/job_system.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+// A synthetic update: integrates a million particles orbiting the origin,
+// heavy enough on math that it should scale with the core count.
+struct Particles {
+	std::vector<float> m_X, m_Y, m_VX, m_VY;
+
+	explicit Particles(uint32_t Count) : m_X(Count), m_Y(Count), m_VX(Count), m_VY(Count) {
+		for (uint32_t i = 0; i < Count; i++) {
+			m_X[i] = std::cos(i * 0.001f) * (1.0f + i % 97);
+			m_Y[i] = std::sin(i * 0.001f) * (1.0f + i % 97);
+			m_VX[i] = -m_Y[i] * 0.1f;
+			m_VY[i] = m_X[i] * 0.1f;
+		}
+	}
+
+	void update(uint32_t Begin, uint32_t End, float Dt) {
+		for (uint32_t i = Begin; i < End; i++) {
+			float Angle = std::atan2(m_Y[i], m_X[i]);
+			float Dist = std::sqrt(m_X[i] * m_X[i] + m_Y[i] * m_Y[i]) + 1.0f;
+			m_VX[i] -= std::cos(Angle) / Dist * Dt;
+			m_VY[i] -= std::sin(Angle) / Dist * Dt;
+			m_X[i] += m_VX[i] * Dt;
+			m_Y[i] += m_VY[i] * Dt;
+		}
+	}
+};
+
+void jobsScaling() {
+	constexpr uint32_t Count = 1 << 20;
+	constexpr uint32_t Steps = 20;
+
+	uint32_t MaxThreads = std::max(1u, std::thread::hardware_concurrency());
+	double SingleThread = 0.0;
+
+	std::printf("    %8s %12s %10s %12s\n", "threads", "ms/update", "speedup", "efficiency");
+	for (uint32_t Threads = 1; Threads <= MaxThreads; Threads++) {
+		Particles State(Count);
+		sps::CJobSystem Jobs;
+		Jobs.init(Threads - 1);
+
+		double Start = now();
+		for (uint32_t Step = 0; Step < Steps; Step++) {
+			Jobs.parallelFor(0, Count, [&](uint32_t Begin, uint32_t End) { State.update(Begin, End, 1.0f / 60.0f); });
+		}
+		double Time = (now() - Start) / Steps;
+		doNotOptimize(State.m_X[Count / 2]);
+
+		Jobs.quit();
+
+		if (Threads == 1)
+			SingleThread = Time;
+		std::printf("    %8u %12.3f %10.2f %11.0f%%\n", Threads, Time * 1000.0, SingleThread / Time,
+					SingleThread / Time / Threads * 100.0);
+	}
+}
+
+RegisterMicroBench s_JobsScaling("jobs_scaling", jobsScaling);
+
+} // namespace
+
+} // namespace bench
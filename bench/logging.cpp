@@ -0,0 +1,95 @@
+#include "bench.hpp"
+#include <SuperSDL/loggable.hpp>
+#include <cstdio>
+#include <mutex>
+#include <spdlog/sinks/base_sink.h>
+
+namespace bench {
+
+namespace {
+
+constexpr uint32_t Messages = 100000;
+// Below the ring capacity so the async path is measured without drops.
+constexpr uint32_t Burst = 2048;
+
+// Formats messages like the console sink does and throws the text away,
+// the console would dominate the measurements.
+class CDiscardSink : public spdlog::sinks::base_sink<std::mutex> {
+  protected:
+	void sink_it_(const spdlog::details::log_msg &Msg) override {
+		spdlog::memory_buf_t Formatted;
+		formatter_->format(Msg, Formatted);
+		doNotOptimize(Formatted.size());
+	}
+	void flush_() override {}
+};
+
+// What CLoggable used to be: its own synchronous sink and Log() returning
+// the shared_ptr by value.
+class CLegacyLogger {
+  private:
+	std::shared_ptr<spdlog::logger> m_Logger;
+
+  public:
+	explicit CLegacyLogger(spdlog::sink_ptr pSink) { m_Logger = std::make_shared<spdlog::logger>("legacy", std::move(pSink)); }
+	auto Log() const { return m_Logger; }
+
+	void run(uint32_t i) { Log()->info("frame {} took {:.3f}ms", i, i * 0.001); }
+};
+
+class CLogger : sps::CLoggable {
+  public:
+	CLogger() : CLoggable("bench") {}
+
+	void run(uint32_t i) { Log()->info("frame {} took {:.3f}ms", i, i * 0.001); }
+	void runLimited(uint32_t i) { SPS_LOG_RATE_LIMITED(info, 1.0, "frame {} took {:.3f}ms", i, i * 0.001); }
+	void runStripped(uint32_t i) {
+		(void)i;
+		SPS_LOG_TRACE("frame {} took {:.3f}ms", i, i * 0.001);
+	}
+};
+
+// Runs Fn in bursts and returns the ns per message spent in the caller.
+template <typename F>
+double measure(F &&Fn) {
+	double Total = 0.0;
+	for (uint32_t Done = 0; Done < Messages; Done += Burst) {
+		double Start = now();
+		for (uint32_t i = Done; i < Done + Burst; i++)
+			Fn(i);
+		Total += now() - Start;
+		sps::CLoggable::flushLogs();
+	}
+	return Total * 1e9 / (Messages / Burst * Burst);
+}
+
+void logging() {
+	auto pDiscard = std::make_shared<CDiscardSink>();
+	CLegacyLogger Legacy(pDiscard);
+	CLogger Logger;
+	sps::CLoggable::setLogTarget(pDiscard);
+
+	double LegacyNs = measure([&](uint32_t i) { Legacy.run(i); });
+	double SyncNs = measure([&](uint32_t i) { Logger.run(i); });
+
+	sps::CLoggable::setAsyncLogging(true);
+	uint64_t Dropped = sps::CLoggable::getDroppedLogs();
+	double AsyncNs = measure([&](uint32_t i) { Logger.run(i); });
+	Dropped = sps::CLoggable::getDroppedLogs() - Dropped;
+	double LimitedNs = measure([&](uint32_t i) { Logger.runLimited(i); });
+	double StrippedNs = measure([&](uint32_t i) { Logger.runStripped(i); });
+	sps::CLoggable::setAsyncLogging(false);
+	sps::CLoggable::setLogTarget(nullptr);
+
+	std::printf("    %-24s %8.1f ns/message\n", "legacy shared_ptr, sync", LegacyNs);
+	std::printf("    %-24s %8.1f ns/message\n", "sync", SyncNs);
+	std::printf("    %-24s %8.1f ns/message (%llu dropped)\n", "async", AsyncNs, (unsigned long long)Dropped);
+	std::printf("    %-24s %8.1f ns/message\n", "async, rate limited", LimitedNs);
+	std::printf("    %-24s %8.1f ns/message\n", "SPS_LOG_TRACE", StrippedNs);
+}
+
+RegisterMicroBench s_Logging("logging", logging);
+
+} // namespace
+
+} // namespace bench
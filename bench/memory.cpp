@@ -0,0 +1,148 @@
+#include "bench.hpp"
+#include <SuperSDL/job_system.hpp>
+#include <SuperSDL/memory.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+// What a frame of engine code typically builds: short lists of handles and
+// a few strings, thrown away at the end of the frame.
+template <typename Vector, typename String>
+uint64_t buildFrame(uint32_t Frame, uint32_t Lists, const typename Vector::allocator_type &Allocator) {
+	uint64_t Sum = 0;
+	for (uint32_t i = 0; i < Lists; i++) {
+		Vector List(Allocator);
+		for (uint32_t j = 0; j < 8 + (i + Frame) % 24; j++)
+			List.push_back(i * j + Frame);
+		String Name("a pass name that doesn't fit in place", Allocator);
+		Name += static_cast<char>('a' + i % 26);
+		Sum += List.back() + Name.size();
+	}
+	return Sum;
+}
+
+struct Particle {
+	float m_aPosition[2];
+	float m_aVelocity[2];
+	uint32_t m_Age;
+	uint32_t m_Lifetime;
+};
+
+// Frame scratch containers on the heap and in a frame arena, objects from
+// the heap and from a pool, then the per-thread arenas of CFrameMemory used
+// by jobs. Checks that the arena and pool paths don't touch the heap once
+// warmed up.
+void memoryAllocators() {
+	constexpr uint32_t Frames = 1000;
+	constexpr uint32_t WarmupFrames = 10;
+	constexpr uint32_t Lists = 256;
+	uint32_t Errors = 0;
+
+	double Start = now();
+	uint64_t Sum = 0;
+	for (uint32_t Frame = 0; Frame < Frames; Frame++)
+		Sum += buildFrame<std::vector<uint32_t>, std::string>(Frame, Lists, std::allocator<uint32_t>());
+	double HeapTime = (now() - Start) / Frames;
+	doNotOptimize(Sum);
+
+	// Starts empty so it has to grow.
+	sps::CLinearArena Arena;
+	uint64_t SteadyAllocations = 0;
+	double ArenaTime = 0.0;
+	uint64_t ArenaSum = 0;
+	for (uint32_t Frame = 0; Frame < Frames; Frame++) {
+		sps::HeapCounters Before = sps::getHeapCounters();
+		Start = now();
+		ArenaSum += buildFrame<std::pmr::vector<uint32_t>, std::pmr::string>(Frame, Lists, &Arena);
+		Arena.reset();
+		if (Frame >= WarmupFrames) {
+			ArenaTime += now() - Start;
+			SteadyAllocations += sps::getHeapCounters().m_Allocations - Before.m_Allocations;
+		}
+	}
+	ArenaTime /= Frames - WarmupFrames;
+	Errors += ArenaSum != Sum || SteadyAllocations != 0;
+	std::printf("    %u lists per frame: heap %.1f us, frame arena %.1f us per frame, arena grew to %zu KiB in %llu overflows\n", Lists,
+				HeapTime * 1e6, ArenaTime * 1e6, Arena.getCapacity() >> 10, (unsigned long long)Arena.getOverflows());
+
+	// Particles spawning and dying in a shuffled order.
+	constexpr uint32_t Alive = 4096;
+	constexpr uint32_t Rounds = 200;
+	std::mt19937 Random(1);
+	std::vector<uint32_t> Order(Alive);
+	for (uint32_t i = 0; i < Alive; i++)
+		Order[i] = i;
+
+	std::vector<std::unique_ptr<Particle>> Owned(Alive);
+	Start = now();
+	for (uint32_t Round = 0; Round < Rounds; Round++) {
+		std::shuffle(Order.begin(), Order.end(), Random);
+		for (uint32_t i : Order)
+			Owned[i] = std::make_unique<Particle>(Particle{{0.0f, 0.0f}, {1.0f, 1.0f}, 0, Round});
+	}
+	double NewTime = (now() - Start) / (double(Rounds) * Alive);
+	Owned.clear();
+
+	sps::CObjectPool<Particle> Pool(256);
+	std::vector<Particle *> Pooled(Alive, nullptr);
+	SteadyAllocations = 0;
+	Start = now();
+	for (uint32_t Round = 0; Round < Rounds; Round++) {
+		std::shuffle(Order.begin(), Order.end(), Random);
+		sps::HeapCounters Before = sps::getHeapCounters();
+		for (uint32_t i : Order) {
+			Pool.destroy(Pooled[i]);
+			Pooled[i] = Pool.create(Particle{{0.0f, 0.0f}, {1.0f, 1.0f}, 0, Round});
+		}
+		if (Round > 0)
+			SteadyAllocations += sps::getHeapCounters().m_Allocations - Before.m_Allocations;
+	}
+	double PoolTime = (now() - Start) / (double(Rounds) * Alive);
+	for (Particle *pParticle : Pooled)
+		Pool.destroy(pParticle);
+	Errors += SteadyAllocations != 0 || Pool.getAlive() != 0;
+	std::printf("    %u objects replaced in random order: make_unique %.1f ns, pool %.1f ns per object, pool holds %zu\n", Alive,
+				NewTime * 1e9, PoolTime * 1e9, Pool.getCapacity());
+
+	// Jobs building their scratch lists in their thread's arena.
+	sps::CJobSystem Jobs;
+	Jobs.init();
+	sps::CFrameMemory Memory;
+	Memory.init(&Jobs);
+	uint64_t SteadyFrames = 0;
+	Start = now();
+	for (uint32_t Frame = 0; Frame < Frames; Frame++) {
+		Jobs.parallelFor(0, Lists, [&Memory, Frame](uint32_t Begin, uint32_t End) {
+			uint64_t Sum = buildFrame<std::pmr::vector<uint32_t>, std::pmr::string>(Frame, End - Begin, &Memory.arena());
+			doNotOptimize(Sum);
+		});
+		Memory.endFrame();
+		if (Frame >= WarmupFrames)
+			SteadyFrames += Memory.getStats().m_FrameAllocations == 0;
+	}
+	double JobsTime = (now() - Start) / Frames;
+	const sps::MemoryStats &Stats = Memory.getStats();
+	Errors += sps::isTrackingHeap() && SteadyFrames != Frames - WarmupFrames;
+	std::printf("    %u threads: %.1f us per frame, %llu of %u frames after warming up without heap allocations, arenas %zu KiB at peak\n",
+				Jobs.getThreadCount(), JobsTime * 1e6, (unsigned long long)SteadyFrames, Frames - WarmupFrames, Stats.m_ArenaPeak >> 10);
+	Memory.quit();
+	Jobs.quit();
+
+	std::printf("    %s\n", Errors != 0 ? "SUMS DIFFER OR THE STEADY STATE ALLOCATES" : sps::isTrackingHeap() ? "sums match, no steady state allocations" : "sums match, heap allocations aren't counted");
+	if (Errors != 0)
+		fail("sums differ or the steady state allocates");
+}
+
+RegisterMicroBench s_Memory("memory", memoryAllocators);
+
+} // namespace
+
+} // namespace bench
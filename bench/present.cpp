@@ -0,0 +1,111 @@
+#include "bench.hpp"
+#include <SuperSDL/supersdl.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+namespace bench {
+
+namespace {
+
+// Opens a window and renders a light sprite load uncapped in every present
+// mode the surface supports, recording the intervals between presents. The
+// swap chain is recreated in place between the modes.
+class CPresentGame : public sps::CGame {
+  private:
+	static constexpr uint32_t WarmupFrames = 30;
+
+	struct Result {
+		vk::PresentModeKHR m_Mode;
+		uint32_t m_ImageCount = 0;
+		std::vector<double> m_Intervals;
+	};
+
+	std::vector<Result> m_Results;
+	uint32_t m_FramesPerMode;
+	uint32_t m_ImageCount;
+	size_t m_Mode;
+	uint32_t m_Frame;
+
+  protected:
+	virtual void onLoad() {
+		for (auto Mode : renderer().getSupportedPresentModes()) {
+			Result R;
+			R.m_Mode = Mode;
+			m_Results.push_back(R);
+		}
+		renderer().setSwapChainImages(m_ImageCount);
+		if (!m_Results.empty())
+			renderer().setPresentMode(m_Results[0].m_Mode);
+	}
+
+	virtual void onUpdate(double delta) { (void)delta; }
+
+	virtual void onRender(double alpha) {
+		(void)alpha;
+		if (m_Mode >= m_Results.size()) {
+			stop();
+			return;
+		}
+
+		Result &Current = m_Results[m_Mode];
+		const sps::PresentStats &Stats = renderer().getPresentStats();
+		// Stats of the previous mode until the swap chain was recreated.
+		if (Stats.m_Mode == Current.m_Mode && m_Frame++ > WarmupFrames && Stats.m_Presents > 1) {
+			Current.m_ImageCount = Stats.m_ImageCount;
+			Current.m_Intervals.push_back(Stats.m_LastInterval);
+		}
+
+		sps::Sprite Sprite;
+		Sprite.m_Size = glm::vec2(16.0f);
+		for (uint32_t i = 0; i < 256; i++) {
+			Sprite.m_Position = glm::vec2((i % 32) * 20.0f, (i / 32) * 20.0f + (m_Frame % 64));
+			Sprite.m_Color = 0xFF000000 | (i * 2654435761u >> 8);
+			renderer().drawSprite(Sprite);
+		}
+
+		if (Current.m_Intervals.size() == m_FramesPerMode) {
+			m_Frame = 0;
+			if (++m_Mode < m_Results.size())
+				renderer().setPresentMode(m_Results[m_Mode].m_Mode);
+		}
+	}
+
+  public:
+	CPresentGame(uint32_t FramesPerMode, uint32_t ImageCount) : sps::CGame("Ryozuki", "SuperSDLBench") {
+		m_FramesPerMode = std::max(FramesPerMode, 1u);
+		m_ImageCount = ImageCount;
+		m_Mode = 0;
+		m_Frame = 0;
+		setTargetFrameRate(0.0);
+	}
+
+	void report() {
+		std::printf("%-24s %7s %14s %14s %14s %10s\n", "present mode", "images", "avg ms", "p99 ms", "max ms", "fps");
+		for (auto &R : m_Results) {
+			if (R.m_Intervals.empty()) {
+				std::printf("%-24s %7s\n", vk::to_string(R.m_Mode).c_str(), "skipped");
+				continue;
+			}
+			std::sort(R.m_Intervals.begin(), R.m_Intervals.end());
+			double Sum = 0.0;
+			for (double Interval : R.m_Intervals)
+				Sum += Interval;
+			double Average = Sum / R.m_Intervals.size();
+			double P99 = R.m_Intervals[R.m_Intervals.size() * 99 / 100];
+			std::printf("%-24s %7u %14.3f %14.3f %14.3f %10.0f\n", vk::to_string(R.m_Mode).c_str(), R.m_ImageCount,
+						Average * 1000.0, P99 * 1000.0, R.m_Intervals.back() * 1000.0, 1.0 / Average);
+		}
+	}
+};
+
+} // namespace
+
+int runPresentBench(uint32_t FramesPerMode, uint32_t ImageCount) {
+	CPresentGame Game(FramesPerMode, ImageCount);
+	Game.start();
+	Game.report();
+	return 0;
+}
+
+} // namespace bench
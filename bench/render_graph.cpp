@@ -0,0 +1,194 @@
+#include "bench.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+
+namespace bench {
+
+namespace {
+
+// Frames declaring a sample render graph that ends in an image the sprites
+// then draw. The passes only clear and copy, what's measured is what the
+// graph makes of them: passes culled and merged, barriers left, and memory
+// saved by aliasing the transient images.
+class CRenderGraphScene : public CBenchScene {
+  private:
+	using BuildFunction = void (*)(sps::CRenderGraph &Graph, vk::Extent2D Extent, sps::RenderGraphImage Output);
+
+	const char *m_pName;
+	BuildFunction m_pBuild;
+	sps::ImageHandle m_Output;
+	uint32_t m_Texture;
+	// Compiles by earlier scenes.
+	uint32_t m_Compiles;
+	double m_DeclareTime;
+	uint64_t m_Frames;
+
+  public:
+	CRenderGraphScene(const char *pName, BuildFunction pBuild) : m_pName(pName), m_pBuild(pBuild) {
+		m_Texture = sps::CTextureTable::WhiteTexture;
+		m_Compiles = 0;
+		m_DeclareTime = 0.0;
+		m_Frames = 0;
+	}
+
+	const char *name() const override { return m_pName; }
+
+	void load(sps::CRenderer &Renderer) override {
+		m_Compiles = Renderer.renderGraph().getStats().m_Compiles;
+		vk::Extent2D Extent = Renderer.getExtent();
+		vk::ImageCreateInfo Info;
+		Info.imageType = vk::ImageType::e2D;
+		Info.format = vk::Format::eR8G8B8A8Unorm;
+		Info.extent = vk::Extent3D(Extent.width, Extent.height, 1);
+		Info.mipLevels = 1;
+		Info.arrayLayers = 1;
+		Info.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+		m_Output = Renderer.resources().createImage("graph_output", Info);
+		m_Texture = Renderer.textures().add(Renderer.resources().get(m_Output)->m_View);
+	}
+
+	void render(sps::CRenderer &Renderer, uint32_t Frame) override {
+		(void)Frame;
+		vk::Extent2D Extent = Renderer.getExtent();
+		const sps::GpuImage *pOutput = Renderer.resources().get(m_Output);
+
+		double Start = now();
+		sps::CRenderGraph &Graph = Renderer.renderGraph();
+		// Written from scratch every frame, what was in it doesn't matter.
+		sps::RenderGraphImage Output = Graph.importImage("output", {vk::Format::eR8G8B8A8Unorm, Extent}, pOutput->m_Image, pOutput->m_View,
+														 vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal);
+		m_pBuild(Graph, Extent, Output);
+		m_DeclareTime += now() - Start;
+		m_Frames++;
+
+		sps::Sprite Sprite;
+		Sprite.m_Position = glm::vec2(Extent.width, Extent.height) * 0.5f;
+		Sprite.m_Size = glm::vec2(Extent.width, Extent.height) * 0.5f;
+		Sprite.m_Texture = m_Texture;
+		Renderer.drawSprite(Sprite);
+	}
+
+	void unload(sps::CRenderer &Renderer) override {
+		Renderer.textures().remove(m_Texture);
+		Renderer.resources().destroy(m_Output);
+	}
+
+	void report(const sps::CRenderer &Renderer) const override {
+		const sps::RenderGraphStats &Stats = Renderer.renderGraph().getStats();
+		if (m_Frames == 0 || Stats.m_Compiles == m_Compiles)
+			return;
+		std::printf("    %u passes, %u culled, %u render passes with %u merged passes and %u subpass dependencies\n",
+					Stats.m_Passes, Stats.m_CulledPasses, Stats.m_RenderPasses, Stats.m_MergedPasses, Stats.m_SubpassDependencies);
+		std::printf("    %u image barriers in %u batches instead of %u, %u transient images in %.1f MiB instead of %.1f MiB (%.0f%% saved)\n",
+					Stats.m_ImageBarriers, Stats.m_BarrierBatches, Stats.m_NaiveBarriers, Stats.m_TransientImages,
+					Stats.m_AliasedBytes / 1048576.0, Stats.m_TransientBytes / 1048576.0,
+					Stats.m_TransientBytes > 0 ? 100.0 * (Stats.m_TransientBytes - Stats.m_AliasedBytes) / Stats.m_TransientBytes : 0.0);
+		std::printf("    declared in %.1f us per frame, compiled %u times in %.1f us\n", m_DeclareTime * 1e6 / m_Frames, Stats.m_Compiles - m_Compiles,
+					Stats.m_CompileTime * 1e6);
+	}
+};
+
+vk::ClearValue clearColor(float Red, float Green, float Blue) {
+	return vk::ClearColorValue(std::array<float, 4>{Red, Green, Blue, 1.0f});
+}
+
+// A G-buffer lit through input attachments, a bloom chain, tone mapping with
+// a UI on top copied to the output, and a debug view nothing uses.
+void buildDeferred(sps::CRenderGraph &Graph, vk::Extent2D Extent, sps::RenderGraphImage Output) {
+	using namespace sps;
+	const vk::Format Hdr = vk::Format::eR16G16B16A16Sfloat;
+
+	RenderGraphImage Albedo = Graph.createImage("albedo", {vk::Format::eR8G8B8A8Unorm, Extent});
+	RenderGraphImage Normal = Graph.createImage("normal", {Hdr, Extent});
+	RenderGraphImage Depth = Graph.createImage("depth", {vk::Format::eD32Sfloat, Extent});
+	RenderGraphImage Lit = Graph.createImage("lit", {Hdr, Extent});
+	RenderGraphImage Ldr = Graph.createImage("ldr", {vk::Format::eR8G8B8A8Unorm, Extent});
+	RenderGraphImage Debug = Graph.createImage("debug", {vk::Format::eR8G8B8A8Unorm, Extent});
+
+	uint32_t Pass = Graph.addPass("gbuffer", RENDER_GRAPH_GRAPHICS, nullptr);
+	Graph.use(Pass, Albedo, RENDER_GRAPH_COLOR, clearColor(0.5f, 0.4f, 0.3f));
+	Graph.use(Pass, Normal, RENDER_GRAPH_COLOR, clearColor(0.0f, 0.0f, 1.0f));
+	Graph.use(Pass, Depth, RENDER_GRAPH_DEPTH, vk::ClearDepthStencilValue(1.0f, 0));
+
+	Pass = Graph.addPass("lighting", RENDER_GRAPH_GRAPHICS, nullptr);
+	Graph.use(Pass, Albedo, RENDER_GRAPH_INPUT);
+	Graph.use(Pass, Normal, RENDER_GRAPH_INPUT);
+	Graph.use(Pass, Depth, RENDER_GRAPH_DEPTH_READ);
+	Graph.use(Pass, Lit, RENDER_GRAPH_COLOR, clearColor(0.1f, 0.1f, 0.2f));
+
+	RenderGraphImage Bloom = Lit;
+	vk::Extent2D BloomExtent = Extent;
+	for (uint32_t i = 0; i < 4; i++) {
+		BloomExtent = vk::Extent2D(std::max(BloomExtent.width / 2, 1u), std::max(BloomExtent.height / 2, 1u));
+		RenderGraphImage Next = Graph.createImage("bloom", {Hdr, BloomExtent});
+		Pass = Graph.addPass("bloom_down", RENDER_GRAPH_GRAPHICS, nullptr);
+		Graph.use(Pass, Bloom, RENDER_GRAPH_SAMPLED);
+		Graph.use(Pass, Next, RENDER_GRAPH_COLOR, clearColor(0.0f, 0.0f, 0.0f));
+		Bloom = Next;
+	}
+
+	Pass = Graph.addPass("tonemap", RENDER_GRAPH_GRAPHICS, nullptr);
+	Graph.use(Pass, Lit, RENDER_GRAPH_SAMPLED);
+	Graph.use(Pass, Bloom, RENDER_GRAPH_SAMPLED);
+	Graph.use(Pass, Ldr, RENDER_GRAPH_COLOR, clearColor(0.2f, 0.3f, 0.4f));
+
+	Pass = Graph.addPass("ui", RENDER_GRAPH_GRAPHICS, nullptr);
+	Graph.use(Pass, Ldr, RENDER_GRAPH_COLOR);
+
+	Pass = Graph.addPass("debug_depth", RENDER_GRAPH_GRAPHICS, nullptr);
+	Graph.use(Pass, Depth, RENDER_GRAPH_SAMPLED);
+	Graph.use(Pass, Debug, RENDER_GRAPH_COLOR, clearColor(0.0f, 0.0f, 0.0f));
+
+	Pass = Graph.addPass("present_copy", RENDER_GRAPH_TRANSFER, [&Graph, Ldr, Output, Extent](vk::CommandBuffer Cmd, const RenderGraphPassInfo &) {
+		vk::ImageSubresourceLayers Layers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+		vk::ImageCopy Region(Layers, vk::Offset3D(0, 0, 0), Layers, vk::Offset3D(0, 0, 0), vk::Extent3D(Extent.width, Extent.height, 1));
+		Cmd.copyImage(Graph.getImage(Ldr), vk::ImageLayout::eTransferSrcOptimal, Graph.getImage(Output), vk::ImageLayout::eTransferDstOptimal, Region);
+	});
+	Graph.use(Pass, Ldr, RENDER_GRAPH_TRANSFER_SRC);
+	Graph.use(Pass, Output, RENDER_GRAPH_TRANSFER_DST);
+}
+
+// A long chain of full screen effects, each only alive until the next one
+// read it, with a compute pass measuring the luminance along the way.
+void buildPostChain(sps::CRenderGraph &Graph, vk::Extent2D Extent, sps::RenderGraphImage Output) {
+	using namespace sps;
+	const vk::Format Hdr = vk::Format::eR16G16B16A16Sfloat;
+
+	RenderGraphImage Scene = Graph.createImage("scene", {Hdr, Extent});
+	RenderGraphImage Luminance = Graph.createImage("luminance", {vk::Format::eR32Sfloat, vk::Extent2D(64, 64)});
+
+	uint32_t Pass = Graph.addPass("scene", RENDER_GRAPH_GRAPHICS, nullptr);
+	Graph.use(Pass, Scene, RENDER_GRAPH_COLOR, clearColor(0.3f, 0.2f, 0.1f));
+
+	Pass = Graph.addPass("luminance", RENDER_GRAPH_COMPUTE, nullptr);
+	Graph.use(Pass, Scene, RENDER_GRAPH_SAMPLED);
+	Graph.use(Pass, Luminance, RENDER_GRAPH_STORAGE);
+
+	RenderGraphImage Previous = Scene;
+	for (uint32_t i = 0; i < 8; i++) {
+		RenderGraphImage Next = Graph.createImage("effect", {Hdr, Extent});
+		Pass = Graph.addPass("effect", RENDER_GRAPH_GRAPHICS, nullptr);
+		Graph.use(Pass, Previous, RENDER_GRAPH_SAMPLED);
+		if (i == 4)
+			Graph.use(Pass, Luminance, RENDER_GRAPH_SAMPLED);
+		Graph.use(Pass, Next, RENDER_GRAPH_COLOR, clearColor(0.1f * i, 0.2f, 0.3f));
+		Previous = Next;
+	}
+
+	RenderGraphImage Histogram = Graph.createImage("histogram", {vk::Format::eR8G8B8A8Unorm, vk::Extent2D(256, 64)});
+	Pass = Graph.addPass("debug_histogram", RENDER_GRAPH_GRAPHICS, nullptr);
+	Graph.use(Pass, Luminance, RENDER_GRAPH_SAMPLED);
+	Graph.use(Pass, Histogram, RENDER_GRAPH_COLOR, clearColor(0.0f, 0.0f, 0.0f));
+
+	Pass = Graph.addPass("composite", RENDER_GRAPH_GRAPHICS, nullptr);
+	Graph.use(Pass, Previous, RENDER_GRAPH_SAMPLED);
+	Graph.use(Pass, Output, RENDER_GRAPH_COLOR, clearColor(0.4f, 0.5f, 0.6f));
+}
+
+RegisterScene s_GraphDeferred(std::make_unique<CRenderGraphScene>("render_graph_deferred", buildDeferred));
+RegisterScene s_GraphPost(std::make_unique<CRenderGraphScene>("render_graph_post", buildPostChain));
+
+} // namespace
+
+} // namespace bench
@@ -0,0 +1,91 @@
+#include "bench.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+
+namespace bench {
+
+namespace {
+
+// Creates buffers and images every frame and destroys ones made a few
+// frames earlier, while those may still be in use by frames in flight.
+// Nothing waits for the device, the frame fences decide when the objects
+// really go.
+class CResourceChurnScene : public CBenchScene {
+  private:
+	static constexpr uint32_t PerFrame = 32;
+	static constexpr uint32_t Lifetime = 4;
+
+	std::deque<sps::BufferHandle> m_Buffers;
+	std::deque<sps::ImageHandle> m_Images;
+	double m_CreateTime;
+	double m_DestroyTime;
+	uint32_t m_MaxPending;
+	uint64_t m_Frames;
+
+  public:
+	CResourceChurnScene() {
+		m_CreateTime = 0.0;
+		m_DestroyTime = 0.0;
+		m_MaxPending = 0;
+		m_Frames = 0;
+	}
+
+	const char *name() const override { return "resource_churn"; }
+
+	void render(sps::CRenderer &Renderer, uint32_t Frame) override {
+		sps::CGpuResources &Resources = Renderer.resources();
+
+		double Start = now();
+		for (uint32_t i = 0; i < PerFrame; i++) {
+			m_Buffers.push_back(Resources.createBuffer("churn", 64 << 10, vk::BufferUsageFlagBits::eVertexBuffer,
+													   vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
+
+			vk::ImageCreateInfo Info;
+			Info.imageType = vk::ImageType::e2D;
+			Info.format = vk::Format::eR8G8B8A8Unorm;
+			Info.extent = vk::Extent3D(64 + (Frame + i) % 4 * 64, 256, 1);
+			Info.mipLevels = 1;
+			Info.arrayLayers = 1;
+			Info.usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+			m_Images.push_back(Resources.createImage("churn", Info));
+		}
+		double Created = now();
+
+		while (m_Buffers.size() > PerFrame * Lifetime) {
+			Resources.destroy(m_Buffers.front());
+			m_Buffers.pop_front();
+			Resources.destroy(m_Images.front());
+			m_Images.pop_front();
+		}
+		double End = now();
+
+		m_CreateTime += Created - Start;
+		m_DestroyTime += End - Created;
+		m_MaxPending = std::max(m_MaxPending, Resources.getStats().m_PendingDestroys);
+		m_Frames++;
+	}
+
+	void unload(sps::CRenderer &Renderer) override {
+		for (sps::BufferHandle Buffer : m_Buffers)
+			Renderer.resources().destroy(Buffer);
+		for (sps::ImageHandle Image : m_Images)
+			Renderer.resources().destroy(Image);
+		m_Buffers.clear();
+		m_Images.clear();
+	}
+
+	void report(const sps::CRenderer &Renderer) const override {
+		(void)Renderer;
+		if (m_Frames == 0)
+			return;
+		std::printf("    %u buffers and images per frame, %.1f us to create, %.1f us to destroy, at most %u objects pending\n",
+					PerFrame, m_CreateTime * 1e6 / m_Frames, m_DestroyTime * 1e6 / m_Frames, m_MaxPending);
+	}
+};
+
+RegisterScene s_ResourceChurn(std::make_unique<CResourceChurnScene>());
+
+} // namespace
+
+} // namespace bench
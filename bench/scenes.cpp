@@ -0,0 +1,160 @@
+#include "bench.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+namespace bench {
+
+namespace {
+
+class CClearScene : public CBenchScene {
+  public:
+	const char *name() const override { return "clear"; }
+	void render(sps::CRenderer &Renderer, uint32_t Frame) override {
+		(void)Renderer;
+		(void)Frame;
+	}
+};
+
+// A grid of spinning sprites. With Mixed set neighbours alternate between
+// pipelines and texture ids, the worst case for the sort.
+class CSpriteScene : public CBenchScene {
+  private:
+	const char *m_pName;
+	uint32_t m_Count;
+	bool m_Mixed;
+	double m_SubmitTime;
+	uint64_t m_Sprites;
+	uint64_t m_Draws;
+	uint64_t m_Frames;
+
+  public:
+	CSpriteScene(const char *pName, uint32_t Count, bool Mixed) {
+		m_pName = pName;
+		m_Count = Count;
+		m_Mixed = Mixed;
+		m_SubmitTime = 0.0;
+		m_Sprites = 0;
+		m_Draws = 0;
+		m_Frames = 0;
+	}
+
+	const char *name() const override { return m_pName; }
+
+	void render(sps::CRenderer &Renderer, uint32_t Frame) override {
+		// Stats of the previous frame.
+		const sps::SpriteBatchStats &Stats = Renderer.getSpriteStats();
+		if (Frame > 0) {
+			m_SubmitTime += Stats.m_SubmitTime;
+			m_Sprites += Stats.m_SpriteCount;
+			m_Draws += Stats.m_DrawCount;
+			m_Frames++;
+		}
+
+		vk::Extent2D Extent = Renderer.getExtent();
+		uint32_t Columns = std::ceil(std::sqrt(m_Count * float(Extent.width) / Extent.height));
+		float Step = float(Extent.width) / Columns;
+
+		sps::Sprite Sprite;
+		Sprite.m_Size = glm::vec2(Step * 0.8f);
+		for (uint32_t i = 0; i < m_Count; i++) {
+			Sprite.m_Position = glm::vec2((i % Columns + 0.5f) * Step, (i / Columns + 0.5f) * Step);
+			Sprite.m_Rotation = (Frame + i) * 0.01f;
+			Sprite.m_Color = 0xFF000000 | (i * 2654435761u >> 8);
+			if (m_Mixed) {
+				Sprite.m_Pipeline = i % sps::NUM_SPRITE_PIPELINES;
+				Sprite.m_Texture = i % 4;
+			}
+			Renderer.drawSprite(Sprite);
+		}
+	}
+
+	void report(const sps::CRenderer &Renderer) const override {
+		(void)Renderer;
+		if (m_Frames == 0 || m_SubmitTime <= 0.0)
+			return;
+		std::printf("    %llu sprites/frame in %.1f draws, %.1f sprites/ms of submit time\n",
+					(unsigned long long)(m_Sprites / m_Frames), double(m_Draws) / m_Frames,
+					m_Sprites / (m_SubmitTime * 1000.0));
+	}
+};
+
+// One draw per sprite, recorded by a fixed number of threads. Run for each
+// thread count to get the recording scaling curve.
+class CDrawScene : public CBenchScene {
+  private:
+	std::string m_Name;
+	uint32_t m_Count;
+	uint32_t m_Threads;
+	double m_RecordTime;
+	uint64_t m_Draws;
+	uint64_t m_Frames;
+
+  public:
+	CDrawScene(uint32_t Count, uint32_t Threads) {
+		m_Name = "draws_t" + std::to_string(Threads);
+		m_Count = Count;
+		m_Threads = Threads;
+		m_RecordTime = 0.0;
+		m_Draws = 0;
+		m_Frames = 0;
+	}
+
+	const char *name() const override { return m_Name.c_str(); }
+
+	void render(sps::CRenderer &Renderer, uint32_t Frame) override {
+		const sps::SpriteBatchStats &Stats = Renderer.getSpriteStats();
+		if (Frame > 0) {
+			m_RecordTime += Stats.m_RecordTime;
+			m_Draws += Stats.m_DrawCount;
+			m_Frames++;
+		}
+
+		Renderer.setRecordThreads(m_Threads);
+
+		vk::Extent2D Extent = Renderer.getExtent();
+		uint32_t Columns = std::ceil(std::sqrt(m_Count * float(Extent.width) / Extent.height));
+		float Step = float(Extent.width) / Columns;
+
+		sps::Sprite Sprite;
+		Sprite.m_Size = glm::vec2(Step * 0.8f);
+		for (uint32_t i = 0; i < m_Count; i++) {
+			Sprite.m_Position = glm::vec2((i % Columns + 0.5f) * Step, (i / Columns + 0.5f) * Step);
+			Sprite.m_Color = 0xFF000000 | (i * 2654435761u >> 8);
+			// A layer each and alternating pipelines, so nothing can be
+			// merged, whether textures split draws or not.
+			Sprite.m_Layer = i;
+			Sprite.m_Pipeline = i % 2 ? sps::SPRITE_PIPELINE_ADDITIVE : sps::SPRITE_PIPELINE_ALPHA;
+			Renderer.drawSprite(Sprite);
+		}
+	}
+
+	void report(const sps::CRenderer &Renderer) const override {
+		(void)Renderer;
+		if (m_Frames == 0)
+			return;
+		std::printf("    %.0f draws/frame recorded in %.3fms by up to %u threads\n",
+					double(m_Draws) / m_Frames, m_RecordTime * 1000.0 / m_Frames, m_Threads);
+	}
+};
+
+struct RegisterDrawScenes {
+	RegisterDrawScenes() {
+		uint32_t MaxThreads = std::max(1u, std::thread::hardware_concurrency());
+		for (uint32_t Threads = 1; Threads <= MaxThreads; Threads *= 2)
+			scenes().push_back(std::make_unique<CDrawScene>(20000, Threads));
+		if ((MaxThreads & (MaxThreads - 1)) != 0)
+			scenes().push_back(std::make_unique<CDrawScene>(20000, MaxThreads));
+	}
+};
+
+RegisterScene s_Clear(std::make_unique<CClearScene>());
+RegisterScene s_Sprites(std::make_unique<CSpriteScene>("sprites", 50000, false));
+RegisterScene s_SpritesMixed(std::make_unique<CSpriteScene>("sprites_mixed", 50000, true));
+RegisterDrawScenes s_Draws;
+
+} // namespace
+
+} // namespace bench
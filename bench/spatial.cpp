@@ -0,0 +1,200 @@
+#include "bench.hpp"
+#include <SuperSDL/spatial.hpp>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+struct Object {
+	glm::vec2 m_Position;
+	glm::vec2 m_Velocity;
+	glm::vec2 m_HalfSize;
+	uint32_t m_GridProxy;
+	uint32_t m_TreeProxy;
+
+	sps::Aabb bounds() const { return sps::Aabb::fromCenter(m_Position, m_HalfSize); }
+};
+
+// Objects of 4 to 16 pixels at the same density for every count, so the
+// cost per object shows how the structures scale.
+std::vector<Object> makeObjects(uint32_t Count, float &WorldSize) {
+	WorldSize = std::sqrt(float(Count)) * 32.0f;
+	std::mt19937 Rng(Count);
+	std::uniform_real_distribution<float> Position(0.0f, WorldSize);
+	std::uniform_real_distribution<float> Velocity(-3.0f, 3.0f);
+	std::uniform_real_distribution<float> HalfSize(2.0f, 8.0f);
+
+	std::vector<Object> Objects(Count);
+	for (Object &O : Objects) {
+		O.m_Position = glm::vec2(Position(Rng), Position(Rng));
+		O.m_Velocity = glm::vec2(Velocity(Rng), Velocity(Rng));
+		O.m_HalfSize = glm::vec2(HalfSize(Rng), HalfSize(Rng));
+	}
+	return Objects;
+}
+
+void spatialIndex(uint32_t Count) {
+	constexpr uint32_t Steps = 5;
+	constexpr uint32_t Queries = 200;
+
+	float WorldSize;
+	std::vector<Object> Objects = makeObjects(Count, WorldSize);
+	sps::CSpatialGrid Grid(32.0f);
+	sps::CAabbTree Tree(4.0f);
+
+	std::printf("    %u objects\n", Count);
+	auto Report = [Count](const char *pName, double GridTime, double TreeTime) {
+		std::printf("      %-10s grid %8.2f ms %7.1f ns/object   tree %8.2f ms %7.1f ns/object\n", pName,
+					GridTime * 1000.0, GridTime * 1e9 / Count, TreeTime * 1000.0, TreeTime * 1e9 / Count);
+	};
+
+	double Start = now();
+	for (uint32_t i = 0; i < Count; i++)
+		Objects[i].m_GridProxy = Grid.insert(Objects[i].bounds(), i);
+	double GridTime = now() - Start;
+	Start = now();
+	for (uint32_t i = 0; i < Count; i++)
+		Objects[i].m_TreeProxy = Tree.insert(Objects[i].bounds(), i);
+	Report("insert", GridTime, now() - Start);
+
+	// Everything moves every step, the worst case for both.
+	GridTime = 0.0;
+	double TreeTime = 0.0;
+	uint64_t Reinserted = 0;
+	for (uint32_t Step = 0; Step < Steps; Step++) {
+		for (Object &O : Objects)
+			O.m_Position += O.m_Velocity;
+		Start = now();
+		for (const Object &O : Objects)
+			Grid.update(O.m_GridProxy, O.bounds());
+		GridTime += now() - Start;
+		Start = now();
+		for (const Object &O : Objects)
+			Reinserted += Tree.update(O.m_TreeProxy, O.bounds());
+		TreeTime += now() - Start;
+	}
+	Report("update", GridTime / Steps, TreeTime / Steps);
+	std::printf("      %.1f%% of the tree updates reinserted, height %u, %u grid cells\n",
+				Reinserted * 100.0 / (uint64_t(Count) * Steps), Tree.getHeight(), Grid.getCellCount());
+
+	// A 1080p view over the world, as a renderer would cull with it.
+	std::mt19937 Rng(7);
+	std::uniform_real_distribution<float> Corner(-960.0f, WorldSize - 960.0f);
+	std::vector<sps::Aabb> Views(Queries);
+	for (sps::Aabb &View : Views) {
+		glm::vec2 Min(Corner(Rng), Corner(Rng));
+		View = {Min, Min + glm::vec2(1920.0f, 1080.0f)};
+	}
+
+	uint64_t aHits[3] = {};
+	double aTime[3] = {};
+	Start = now();
+	for (const sps::Aabb &View : Views)
+		Grid.query(View, [&](uint32_t) { aHits[0]++; });
+	aTime[0] = now() - Start;
+	Start = now();
+	for (const sps::Aabb &View : Views)
+		Tree.query(View, [&](uint32_t) { aHits[1]++; });
+	aTime[1] = now() - Start;
+	// Testing every object is what culling costs without an index.
+	Start = now();
+	for (const sps::Aabb &View : Views) {
+		for (const Object &O : Objects)
+			aHits[2] += O.bounds().overlaps(View);
+	}
+	aTime[2] = now() - Start;
+	std::printf("      %-10s grid %8.1f us   tree %8.1f us   linear %8.1f us   %llu visible%s\n", "view",
+				aTime[0] * 1e6 / Queries, aTime[1] * 1e6 / Queries, aTime[2] * 1e6 / Queries,
+				(unsigned long long)(aHits[0] / Queries), aHits[0] == aHits[1] && aHits[1] == aHits[2] ? "" : ", MISMATCH");
+
+	uint64_t aPairs[2] = {};
+	Start = now();
+	Grid.queryPairs([&](uint32_t, uint32_t) { aPairs[0]++; });
+	GridTime = now() - Start;
+	Start = now();
+	Tree.queryPairs([&](uint32_t, uint32_t) { aPairs[1]++; });
+	Report("pairs", GridTime, now() - Start);
+	std::printf("      %llu overlapping pairs%s\n", (unsigned long long)aPairs[0], aPairs[0] == aPairs[1] ? "" : ", MISMATCH");
+
+	Start = now();
+	for (const Object &O : Objects)
+		Grid.remove(O.m_GridProxy);
+	GridTime = now() - Start;
+	Start = now();
+	for (const Object &O : Objects)
+		Tree.remove(O.m_TreeProxy);
+	Report("remove", GridTime, now() - Start);
+}
+
+void spatial() {
+	for (uint32_t Count : {10000u, 100000u, 1000000u})
+		spatialIndex(Count);
+}
+
+// Scrolls over a world far larger than the screen. Only what the tree finds
+// in the view is handed to the renderer.
+class CCulledScene : public CBenchScene {
+  private:
+	std::vector<Object> m_Objects;
+	sps::CAabbTree m_Tree;
+	float m_WorldSize;
+	double m_QueryTime;
+	uint64_t m_Visible;
+	uint64_t m_Frames;
+
+  public:
+	CCulledScene() {
+		m_WorldSize = 0.0f;
+		m_QueryTime = 0.0;
+		m_Visible = 0;
+		m_Frames = 0;
+	}
+
+	const char *name() const override { return "sprites_culled"; }
+
+	void load(sps::CRenderer &Renderer) override {
+		(void)Renderer;
+		m_Objects = makeObjects(200000, m_WorldSize);
+		for (uint32_t i = 0; i < m_Objects.size(); i++)
+			m_Objects[i].m_TreeProxy = m_Tree.insert(m_Objects[i].bounds(), i);
+	}
+
+	void render(sps::CRenderer &Renderer, uint32_t Frame) override {
+		sps::Aabb View = Renderer.getViewRect();
+		glm::vec2 Size = View.m_Max - View.m_Min;
+		glm::vec2 Camera = (glm::vec2(m_WorldSize) - Size) * (0.5f + 0.4f * std::sin(Frame * 0.01f));
+		View = {View.m_Min + Camera, View.m_Max + Camera};
+
+		double Start = now();
+		sps::Sprite Sprite;
+		m_Tree.query(View, [&](uint32_t Index) {
+			const Object &O = m_Objects[Index];
+			Sprite.m_Position = O.m_Position - Camera;
+			Sprite.m_Size = O.m_HalfSize * 2.0f;
+			Sprite.m_Color = 0xFF000000 | (Index * 2654435761u >> 8);
+			Renderer.drawSprite(Sprite);
+			m_Visible++;
+		});
+		m_QueryTime += now() - Start;
+		m_Frames++;
+	}
+
+	void report(const sps::CRenderer &Renderer) const override {
+		(void)Renderer;
+		if (m_Frames == 0)
+			return;
+		std::printf("    %zu sprites in the world, %llu visible per frame, culled and queued in %.3f ms\n", m_Objects.size(),
+					(unsigned long long)(m_Visible / m_Frames), m_QueryTime * 1000.0 / m_Frames);
+	}
+};
+
+RegisterMicroBench s_Spatial("spatial", spatial);
+RegisterScene s_SpritesCulled(std::make_unique<CCulledScene>());
+
+} // namespace
+
+} // namespace bench
@@ -0,0 +1,85 @@
+#include "bench.hpp"
+#include <cstdio>
+#include <cstring>
+
+namespace bench {
+
+namespace {
+
+// Requests a burst of textures generated on the workers and keeps drawing
+// sprites while they stream in. The frame times show whether uploads stall
+// rendering, the report how long the textures took to become ready.
+class CStreamingScene : public CBenchScene {
+  private:
+	static constexpr uint32_t Textures = 64;
+	static constexpr uint32_t Size = 512;
+
+	std::vector<sps::AssetHandle> m_Handles;
+	double m_RequestTime;
+	double m_ReadyTime;
+	uint32_t m_ReadyFrames;
+
+  public:
+	CStreamingScene() {
+		m_RequestTime = 0.0;
+		m_ReadyTime = 0.0;
+		m_ReadyFrames = 0;
+	}
+
+	const char *name() const override { return "streaming"; }
+
+	void render(sps::CRenderer &Renderer, uint32_t Frame) override {
+		sps::CAssetStreamer &Assets = Renderer.assets();
+
+		if (Frame == 0) {
+			m_RequestTime = now();
+			for (uint32_t i = 0; i < Textures; i++) {
+				m_Handles.push_back(Assets.loadTexture("generated", [i](sps::TextureData &Texture) {
+					Texture.m_Width = Size;
+					Texture.m_Height = Size;
+					Texture.m_Pixels.resize(Size * Size * 4);
+					for (uint32_t p = 0; p < Size * Size; p++) {
+						uint32_t Value = (p ^ (p >> 9) ^ i) * 2654435761u;
+						std::memcpy(&Texture.m_Pixels[p * 4], &Value, 4);
+					}
+					return true;
+				}));
+			}
+		}
+
+		uint32_t Ready = 0;
+		for (auto Handle : m_Handles)
+			Ready += Assets.isReady(Handle);
+		if (Ready == Textures && m_ReadyTime == 0.0) {
+			m_ReadyTime = now();
+			m_ReadyFrames = Frame;
+		}
+
+		// Something to render meanwhile, one sprite per texture that arrived.
+		sps::Sprite Sprite;
+		Sprite.m_Size = glm::vec2(32.0f);
+		for (uint32_t i = 0; i < Ready; i++) {
+			Sprite.m_Position = glm::vec2(24.0f + (i % 16) * 36.0f, 24.0f + (i / 16) * 36.0f);
+			Sprite.m_Texture = Assets.getTextureIndex(m_Handles[i]);
+			Renderer.drawSprite(Sprite);
+		}
+	}
+
+	void report(const sps::CRenderer &Renderer) const override {
+		(void)Renderer;
+		double Megabytes = double(Textures) * Size * Size * 4 / (1 << 20);
+		if (m_ReadyTime == 0.0) {
+			std::printf("    %.0fMB of textures didn't finish streaming\n", Megabytes);
+			return;
+		}
+		double Seconds = m_ReadyTime - m_RequestTime;
+		std::printf("    %.0fMB in %u textures ready after %.1fms (%u frames), %.0fMB/s\n",
+					Megabytes, Textures, Seconds * 1000.0, m_ReadyFrames, Megabytes / Seconds);
+	}
+};
+
+RegisterScene s_Streaming(std::make_unique<CStreamingScene>());
+
+} // namespace
+
+} // namespace bench
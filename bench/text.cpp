@@ -0,0 +1,153 @@
+#include "bench.hpp"
+#include <SuperSDL/font_atlas.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace bench {
+
+namespace {
+
+// SUPERSDL_BENCH_FONT overrides the font, empty if none was found.
+std::string findFont() {
+	if (const char *pPath = std::getenv("SUPERSDL_BENCH_FONT"))
+		return pPath;
+
+	const char *apCandidates[] = {
+		"/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+		"/usr/share/fonts/TTF/DejaVuSans.ttf",
+		"/usr/share/fonts/dejavu/DejaVuSans.ttf",
+		"/Library/Fonts/Arial.ttf",
+		"C:/Windows/Fonts/arial.ttf",
+	};
+	for (const char *pPath : apCandidates) {
+		if (std::ifstream(pPath).good())
+			return pPath;
+	}
+	return "";
+}
+
+// A debug overlay: rows of labels that never change next to counters that
+// change every frame, so both the cached and the uncached layout path run.
+class CTextScene : public CBenchScene {
+  private:
+	static constexpr uint32_t Rows = 60;
+
+	uint32_t m_Font;
+	bool m_Loaded;
+	double m_LayoutTime;
+	double m_SubmitTime;
+	uint64_t m_Glyphs;
+	uint64_t m_Draws;
+	uint64_t m_Frames;
+
+  public:
+	CTextScene() {
+		m_Font = 0;
+		m_Loaded = false;
+		m_LayoutTime = 0.0;
+		m_SubmitTime = 0.0;
+		m_Glyphs = 0;
+		m_Draws = 0;
+		m_Frames = 0;
+	}
+
+	const char *name() const override { return "text"; }
+
+	void load(sps::CRenderer &Renderer) override {
+		std::string Path = findFont();
+		if (Path.empty())
+			return;
+		try {
+			m_Font = Renderer.loadFont(Path);
+			m_Loaded = true;
+		} catch (std::exception &) {
+		}
+	}
+
+	void render(sps::CRenderer &Renderer, uint32_t Frame) override {
+		if (!m_Loaded)
+			return;
+
+		// Sprite stats are of the previous frame, which only drew text.
+		if (Frame > 0) {
+			m_SubmitTime += Renderer.getSpriteStats().m_SubmitTime;
+			m_Draws += Renderer.getSpriteStats().m_DrawCount;
+		}
+
+		char aCounter[64];
+		float LineHeight = float(Renderer.getExtent().height) / (Rows / 2);
+		for (uint32_t i = 0; i < Rows; i++) {
+			glm::vec2 Position((i % 2) * Renderer.getExtent().width * 0.5f, (i / 2) * LineHeight);
+			uint32_t Color = 0xFF000000 | (i * 2654435761u >> 8);
+			std::snprintf(aCounter, sizeof(aCounter), "entity %u: %u frames, %.2f ms", i, Frame, (Frame + i) * 0.01);
+			Renderer.drawText(m_Font, (i % 4) == 0 ? aCounter : "Static overlay label", Position, LineHeight, Color);
+		}
+
+		if (Frame > 0) {
+			const sps::TextStats &Stats = Renderer.getTextStats();
+			m_LayoutTime += Stats.m_LayoutTime;
+			m_Glyphs += Stats.m_GlyphsDrawn;
+			m_Frames++;
+		}
+	}
+
+	void report(const sps::CRenderer &Renderer) const override {
+		if (!m_Loaded) {
+			std::printf("    no font found, set SUPERSDL_BENCH_FONT\n");
+			return;
+		}
+		if (m_Frames == 0 || m_LayoutTime <= 0.0)
+			return;
+		std::printf("    %llu glyphs/frame in %.1f draws, %.0f glyphs/ms laid out, %.0f glyphs/ms laid out and submitted\n",
+					(unsigned long long)(m_Glyphs / m_Frames), double(m_Draws) / m_Frames,
+					m_Glyphs / (m_LayoutTime * 1000.0), m_Glyphs / ((m_LayoutTime + m_SubmitTime) * 1000.0));
+		std::printf("    atlas %.1f%% used, %u glyphs rasterized\n",
+					Renderer.getFontAtlas().getOccupancy() * 100.0, Renderer.getFontAtlas().getStats().m_GlyphsRasterized);
+	}
+};
+
+// Layout alone, without a GPU: strings seen for the first time against ones
+// that hit the cache.
+void textLayout() {
+	std::string Path = findFont();
+	if (Path.empty()) {
+		std::printf("    no font found, set SUPERSDL_BENCH_FONT\n");
+		return;
+	}
+
+	sps::CFontAtlas Atlas;
+	Atlas.init(1024, 1024);
+	uint32_t Font = Atlas.loadFont(Path);
+
+	constexpr uint32_t Strings = 20000;
+	char aText[64];
+	uint64_t Glyphs = 0;
+
+	double Start = now();
+	for (uint32_t i = 0; i < Strings; i++) {
+		std::snprintf(aText, sizeof(aText), "score %u, frame %u", i * 7, i);
+		Glyphs += Atlas.layout(Font, aText).m_Glyphs.size();
+	}
+	double Uncached = now() - Start;
+	uint64_t UncachedGlyphs = Glyphs;
+
+	Glyphs = 0;
+	Start = now();
+	for (uint32_t i = 0; i < Strings * 10; i++)
+		Glyphs += Atlas.layout(Font, "Static overlay label").m_Glyphs.size();
+	double Cached = now() - Start;
+
+	std::printf("    %-24s %10.0f glyphs/ms\n", "uncached layout", UncachedGlyphs / (Uncached * 1000.0));
+	std::printf("    %-24s %10.0f glyphs/ms\n", "cached layout", Glyphs / (Cached * 1000.0));
+	std::printf("    %u glyphs rasterized, atlas %.1f%% used\n", Atlas.getStats().m_GlyphsRasterized, Atlas.getOccupancy() * 100.0);
+}
+
+RegisterScene s_Text(std::make_unique<CTextScene>());
+RegisterMicroBench s_TextLayout("text_layout", textLayout);
+
+} // namespace
+
+} // namespace bench
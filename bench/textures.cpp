@@ -0,0 +1,93 @@
+#include "bench.hpp"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+// Sprites spread over many small textures in random order, which is what a
+// scene full of different objects looks like to the sprite batch. Bindless,
+// they take a single draw. Run with -n to compare with a descriptor set per
+// texture, which splits the draws on every texture.
+class CTexturedScene : public CBenchScene {
+  private:
+	static constexpr uint32_t Textures = 1024;
+	static constexpr uint32_t Size = 16;
+	static constexpr uint32_t Sprites = 50000;
+
+	std::vector<sps::AssetHandle> m_Handles;
+	double m_SubmitTime;
+	uint64_t m_Draws;
+	uint64_t m_DescriptorBinds;
+	uint64_t m_Frames;
+
+  public:
+	CTexturedScene() {
+		m_SubmitTime = 0.0;
+		m_Draws = 0;
+		m_DescriptorBinds = 0;
+		m_Frames = 0;
+	}
+
+	const char *name() const override { return "sprites_textured"; }
+
+	void load(sps::CRenderer &Renderer) override {
+		for (uint32_t i = 0; i < Textures; i++) {
+			m_Handles.push_back(Renderer.assets().loadTexture("tile", [i](sps::TextureData &Texture) {
+				Texture.m_Width = Size;
+				Texture.m_Height = Size;
+				Texture.m_Pixels.resize(Size * Size * 4);
+				for (uint32_t p = 0; p < Size * Size; p++) {
+					uint32_t Value = 0xFF000000 | ((p + i) * 2654435761u >> 8);
+					std::memcpy(&Texture.m_Pixels[p * 4], &Value, 4);
+				}
+				return true;
+			}));
+		}
+	}
+
+	void render(sps::CRenderer &Renderer, uint32_t Frame) override {
+		// Sprite stats are of the previous frame, which only drew this scene.
+		if (Frame > 0) {
+			const sps::SpriteBatchStats &Stats = Renderer.getSpriteStats();
+			m_SubmitTime += Stats.m_SubmitTime;
+			m_Draws += Stats.m_DrawCount;
+			m_DescriptorBinds += Stats.m_DescriptorBinds;
+			m_Frames++;
+		}
+
+		sps::CAssetStreamer &Assets = Renderer.assets();
+		vk::Extent2D Extent = Renderer.getExtent();
+		sps::Sprite Sprite;
+		Sprite.m_Size = glm::vec2(12.0f);
+		for (uint32_t i = 0; i < Sprites; i++) {
+			uint32_t Hash = (i + Frame * 7919) * 2654435761u;
+			Sprite.m_Position = glm::vec2(Hash % Extent.width, (Hash >> 12) % Extent.height);
+			Sprite.m_Texture = Assets.getTextureIndex(m_Handles[(i * 2654435761u >> 8) % Textures]);
+			Renderer.drawSprite(Sprite);
+		}
+	}
+
+	void unload(sps::CRenderer &Renderer) override {
+		for (sps::AssetHandle Handle : m_Handles)
+			Renderer.assets().release(Handle);
+		m_Handles.clear();
+	}
+
+	void report(const sps::CRenderer &Renderer) const override {
+		if (m_Frames == 0)
+			return;
+		std::printf("    %s, %u sprites over %u textures in %.1f draws and %.1f descriptor binds, submitted in %.3f ms (%.0f sprites/ms)\n",
+					Renderer.isBindless() ? "bindless" : "bound one by one", Sprites, Textures,
+					double(m_Draws) / m_Frames, double(m_DescriptorBinds) / m_Frames, m_SubmitTime * 1000.0 / m_Frames,
+					Sprites * m_Frames / (m_SubmitTime * 1000.0));
+	}
+};
+
+RegisterScene s_SpritesTextured(std::make_unique<CTexturedScene>());
+
+} // namespace
+
+} // namespace bench
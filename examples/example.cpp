@@ -3,8 +3,17 @@
 class CMyGame : public sps::CGame {
   protected:
 	virtual void onLoad() {}
-	virtual void onRender(double delta) {}
-	virtual void onUpdate(double delta) {}
+	virtual void onRender(double alpha) {
+		sps::Sprite Sprite;
+		Sprite.m_Position = {320.0f, 240.0f};
+		Sprite.m_Size = {100.0f, 100.0f};
+		Sprite.m_Color = sps::packColor(sps::COLOR_RED);
+		renderer().drawSprite(Sprite);
+	}
+	virtual void onUpdate(double delta) {
+		if (input().wasPressed(SDL_SCANCODE_ESCAPE))
+			stop();
+	}
   public:
 	CMyGame() : sps::CGame("Ryozuki", "SuperSDLGame"){}
 };
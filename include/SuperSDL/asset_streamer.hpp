@@ -0,0 +1,202 @@
+#ifndef SUPERSDL_ASSET_STREAMER_HPP
+#define SUPERSDL_ASSET_STREAMER_HPP
+
+#include "SuperSDL/gpu_allocator.hpp"
+#include "SuperSDL/job_system.hpp"
+#include "SuperSDL/loggable.hpp"
+#include "SuperSDL/memory.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+
+namespace sps {
+
+class CRenderer;
+
+enum EAssetState : uint32_t {
+	ASSET_PENDING = 0,
+	ASSET_READY,
+	ASSET_FAILED,
+};
+
+// Refers to an asset of a CAssetStreamer, 0 is never a valid asset. The
+// generation keeps handles of a released asset invalid once its id is reused.
+struct AssetHandle {
+	uint32_t m_Id = 0;
+	uint32_t m_Generation = 0;
+
+	explicit operator bool() const { return m_Id != 0; }
+};
+
+// RGBA8 pixels, filled in by a decoder on a worker thread.
+struct TextureData {
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	std::vector<uint8_t> m_Pixels;
+};
+
+struct AssetStreamerStats {
+	uint32_t m_Pending = 0;
+	uint32_t m_BatchesInFlight = 0;
+	uint64_t m_BytesUploaded = 0;
+	vk::DeviceSize m_StagingUsed = 0;
+	vk::DeviceSize m_StagingCapacity = 0;
+};
+
+/*
+ * Loads textures and buffers in the background. Files are read and decoded
+ * by the job system, the results are copied through a fixed-size staging ring
+ * on the transfer queue, which is a dedicated one when the device has it.
+ * Completion is tracked with a fence per upload batch, frames never wait for
+ * an upload.
+ *
+ * When the transfer queue is in another family, uploaded resources are
+ * released by it and acquired by the graphics queue in the frame that
+ * notices the batch finished, before the asset is reported ready. Ready
+ * textures are added to the renderer's texture table.
+ *
+ * All methods must be called by the thread that runs the renderer.
+ */
+class CAssetStreamer : CLoggable {
+  private:
+	static constexpr uint32_t MaxBatches = 4;
+
+	enum EAssetType {
+		ASSET_TEXTURE,
+		ASSET_BUFFER,
+	};
+
+	struct Asset {
+		EAssetType m_Type;
+		std::atomic<EAssetState> m_State;
+		std::string m_Name;
+		// Run on a worker, fill m_Data or m_Texture.
+		std::function<bool(TextureData &)> m_DecodeTexture;
+		std::function<bool(std::vector<uint8_t> &)> m_ReadBuffer;
+		TextureData m_Texture;
+		std::vector<uint8_t> m_Data;
+		bool m_Decoded = false;
+		std::chrono::steady_clock::time_point m_RequestTime;
+
+		vk::Image m_Image;
+		vk::ImageView m_ImageView;
+		vk::Extent2D m_Extent;
+		// In the renderer's texture table once ready.
+		uint32_t m_TextureIndex = 0;
+		vk::Buffer m_Buffer;
+		vk::BufferUsageFlags m_BufferUsage;
+		GpuAllocation m_Memory;
+		bool m_Released = false;
+	};
+
+	// Copies submitted together, finished once m_Fence signaled.
+	struct Batch {
+		vk::CommandBuffer m_CommandBuffer;
+		vk::Fence m_Fence;
+		std::vector<uint32_t> m_Assets;
+		// Staging ring position right after the batch's data.
+		uint64_t m_StagingEnd = 0;
+	};
+
+	CRenderer *m_pRenderer;
+	CJobSystem *m_pJobs;
+	vk::Device m_Device;
+	vk::Queue m_TransferQueue;
+	uint32_t m_TransferFamily;
+	uint32_t m_GraphicsFamily;
+
+	vk::CommandPool m_CommandPool;
+	std::vector<Batch> m_Batches;
+	// Batches are submitted and finish in order, this is the oldest one.
+	uint32_t m_FirstBatch;
+	uint32_t m_BatchCount;
+
+	vk::Buffer m_StagingBuffer;
+	GpuAllocation m_StagingMemory;
+	vk::DeviceSize m_StagingSize;
+	// Monotonic positions, the ring offset is the position modulo its size.
+	uint64_t m_StagingHead;
+	uint64_t m_StagingTail;
+
+	// Index 0 is unused so the handle 0 stays invalid. Assets come from a
+	// pool, streaming in a level doesn't go to the heap for each of them.
+	CObjectPool<Asset> m_AssetPool;
+	std::vector<Asset *> m_Assets;
+	std::vector<uint32_t> m_Generations;
+	std::vector<uint32_t> m_FreeIds;
+	// Decoded by a worker, waiting for staging space.
+	std::mutex m_DecodedMutex;
+	std::vector<uint32_t> m_Decoded;
+	std::vector<uint32_t> m_Uploadable;
+	// Released while still loading, retired once the upload is done.
+	std::vector<uint32_t> m_Released;
+	CJobCounter m_Decoding;
+
+	AssetStreamerStats m_Stats;
+
+	AssetHandle create(EAssetType Type, const std::string &Name);
+	void decode(Asset *pAsset, uint32_t Id);
+	bool allocateStaging(vk::DeviceSize Size, vk::DeviceSize &Offset);
+	bool recordUpload(vk::CommandBuffer Cmd, Asset &Asset);
+	void recordAcquire(vk::CommandBuffer Cmd, Asset &Asset);
+	void finishBatches(vk::CommandBuffer FrameCmd);
+	void submitBatch();
+	void destroy(Asset &Asset);
+	// Hands the asset's objects to the renderer's deferred destruction and
+	// frees its id.
+	void retire(uint32_t Id);
+	Asset *get(AssetHandle Handle) const;
+
+  public:
+	CAssetStreamer();
+
+	// Lets assets be requested before init(), for preloading while the
+	// renderer starts. They are decoded right away and uploaded once it
+	// runs. init() calls it if it wasn't.
+	void start(CJobSystem *pJobs);
+	void init(CRenderer *pRenderer, CJobSystem *pJobs, vk::Queue TransferQueue, uint32_t TransferFamily, uint32_t GraphicsFamily, vk::DeviceSize StagingSize);
+	// The device must be idle.
+	void quit();
+
+	// Called by the renderer once per frame with the frame's command buffer,
+	// which must be outside of a render pass.
+	void update(vk::CommandBuffer FrameCmd);
+
+	// Decodes a BMP file into a sampled RGBA8 texture.
+	AssetHandle loadTexture(const std::string &Path);
+	// Decode runs on a worker thread and returns false on failure.
+	AssetHandle loadTexture(const std::string &Name, std::function<bool(TextureData &)> Decode);
+	// Reads a file into a device local buffer.
+	AssetHandle loadBuffer(const std::string &Path, vk::BufferUsageFlags Usage);
+	// Read runs on a worker thread and returns false on failure.
+	AssetHandle loadBuffer(const std::string &Name, vk::BufferUsageFlags Usage, std::function<bool(std::vector<uint8_t> &)> Read);
+
+	// Invalidates the handle, the asset is destroyed once no frame in flight
+	// can use it anymore.
+	void release(AssetHandle Handle);
+
+	EAssetState getState(AssetHandle Handle) const;
+	bool isReady(AssetHandle Handle) const { return getState(Handle) == ASSET_READY; }
+	// Null until the asset is ready.
+	vk::ImageView getImageView(AssetHandle Handle) const;
+	// What Sprite::m_Texture takes, CTextureTable::WhiteTexture until the
+	// texture is ready.
+	uint32_t getTextureIndex(AssetHandle Handle) const;
+	vk::Image getImage(AssetHandle Handle) const;
+	vk::Extent2D getExtent(AssetHandle Handle) const;
+	vk::Buffer getBuffer(AssetHandle Handle) const;
+
+	bool hasDedicatedQueue() const { return m_TransferFamily != m_GraphicsFamily; }
+	const AssetStreamerStats &getStats() const { return m_Stats; }
+};
+
+} // namespace sps
+
+#endif
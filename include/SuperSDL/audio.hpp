@@ -0,0 +1,314 @@
+#ifndef SUPERSDL_AUDIO_HPP
+#define SUPERSDL_AUDIO_HPP
+
+#include "SuperSDL/loggable.hpp"
+#include "SuperSDL/spsc_queue.hpp"
+#include <SDL_audio.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sps {
+
+// Refers to a sound of a CAudioMixer, 0 is never a valid sound.
+struct SoundHandle {
+	uint32_t m_Id = 0;
+	uint32_t m_Generation = 0;
+
+	explicit operator bool() const { return m_Id != 0; }
+};
+
+// Refers to a playing voice. Becomes invalid once the voice finished, which
+// update() notices.
+struct VoiceHandle {
+	uint32_t m_Id = 0;
+	uint32_t m_Generation = 0;
+
+	explicit operator bool() const { return m_Id != 0; }
+};
+
+struct VoiceParams {
+	float m_Volume = 1.0f;
+	// -1 is left, 1 is right. Mono sounds are panned at constant power,
+	// stereo ones attenuate the other side.
+	float m_Pan = 0.0f;
+	// Playback speed, 2 is an octave up.
+	float m_Pitch = 1.0f;
+	bool m_Loop = false;
+};
+
+struct AudioStats {
+	uint32_t m_Voices = 0;
+	uint32_t m_PeakVoices = 0;
+	uint64_t m_Callbacks = 0;
+	uint64_t m_Frames = 0;
+	// Time spent in mix(), in seconds.
+	double m_MixTime = 0.0;
+	double m_MaxMixTime = 0.0;
+	// Blocks a streamed voice had no data for.
+	uint64_t m_Underruns = 0;
+	// Commands lost to a full queue and plays without a free voice.
+	uint64_t m_DroppedCommands = 0;
+	uint64_t m_DroppedVoices = 0;
+};
+
+/*
+ * The mix, resample and volume kernels, SIMD where the CPU has it. The best
+ * implementation is picked on first use.
+ */
+enum EAudioKernels {
+	AUDIO_KERNELS_SCALAR = 0,
+	AUDIO_KERNELS_SSE2,
+};
+
+// The implementation in use.
+EAudioKernels getAudioKernels();
+// Uses Kernels or the best supported one below it, returns the one in use.
+// Meant for benchmarks, call it while no mixer is running.
+EAudioKernels setAudioKernels(EAudioKernels Kernels);
+const char *getAudioKernelsName(EAudioKernels Kernels);
+
+/*
+ * Mixes voices into the audio device from SDL's audio callback.
+ *
+ * The callback takes no lock and allocates nothing. Every change is a command
+ * in a lock-free queue it drains at the start of each callback, finished
+ * voices go back the same way and are freed by update(). Sounds are decoded
+ * to float planes when loaded. Streams are filled a chunk ahead by a
+ * background thread, chunks travel between it and the callback through a
+ * pair of queues per stream.
+ *
+ * Voices are resampled to the device rate by linear interpolation over a
+ * 32.32 fixed point position, voices at the device rate and unit pitch are
+ * mixed straight from their samples. Volume changes ramp over one block so
+ * they don't click.
+ *
+ * All methods but mix() must be called by the thread that owns the mixer.
+ */
+class CAudioMixer : CLoggable {
+  public:
+	static constexpr uint32_t MaxVoices = 1024;
+	// Frames written by the stream function at a time.
+	static constexpr uint32_t StreamChunkFrames = 2048;
+
+	// Writes up to Frames frames to one plane per channel and returns how
+	// many it wrote, fewer ends the stream. Runs on the stream thread.
+	using StreamFunction = std::function<uint32_t(float *const *ppPlanes, uint32_t Frames)>;
+
+  private:
+	static constexpr size_t CommandQueueSize = 4096;
+	// Frames mixed at a time, callbacks asking for more are split.
+	static constexpr uint32_t BlockFrames = 256;
+	static constexpr uint32_t StreamChunks = 4;
+	static constexpr std::chrono::milliseconds StreamPoll{5};
+
+	enum ECommand {
+		COMMAND_PLAY,
+		COMMAND_STOP,
+		COMMAND_GAIN,
+		COMMAND_PITCH,
+	};
+
+	// Planar, one guard frame after each plane so interpolating the last
+	// frame reads the first one again.
+	struct Sound {
+		std::string m_Name;
+		// One plane per channel of m_Frames + 1 frames, the last repeats the
+		// first so looping voices interpolate across the end.
+		std::vector<float> m_Samples;
+		// Per channel the last frame and a silent one, what voices that
+		// don't loop play the last frame from.
+		float m_aaTail[2][2] = {};
+		uint32_t m_Channels = 0;
+		uint32_t m_Rate = 0;
+		uint32_t m_Frames = 0;
+		// Voices playing it, it's destroyed once released and unused.
+		uint32_t m_Voices = 0;
+		bool m_Released = false;
+	};
+
+	// Each chunk has one plane per channel of StreamChunkFrames + 1 frames,
+	// the first being the last frame of the chunk before, so interpolating
+	// across chunks only reads one chunk. The last chunk ends in a silent
+	// frame to fade its last frame into.
+	struct Stream {
+		std::string m_Name;
+		StreamFunction m_Read;
+		uint32_t m_Channels = 0;
+		std::vector<float> m_Samples;
+		std::array<uint32_t, StreamChunks> m_aFrames = {};
+		// Filled by the stream thread, handed back once played.
+		CSpscQueue<uint32_t> m_Ready;
+		CSpscQueue<uint32_t> m_Free;
+		std::array<float, 2> m_aLast = {};
+		// Chunks filled for the first time so far.
+		uint32_t m_Primed = 0;
+		bool m_Ended = false;
+
+		Stream() : m_Ready(StreamChunks), m_Free(StreamChunks) {}
+		float *plane(uint32_t Chunk, uint32_t Channel) { return &m_Samples[(Chunk * m_Channels + Channel) * (StreamChunkFrames + 1)]; }
+	};
+
+	struct Command {
+		ECommand m_Type;
+		uint32_t m_Voice;
+		const Sound *m_pSound;
+		Stream *m_pStream;
+		uint64_t m_Step;
+		float m_GainLeft;
+		float m_GainRight;
+		bool m_Loop;
+	};
+
+	// Owned by the audio thread.
+	struct Voice {
+		const Sound *m_pSound;
+		Stream *m_pStream;
+		// The samples being read, m_Frames + 1 of them per plane.
+		const float *m_apPlanes[2];
+		uint32_t m_Channels;
+		uint32_t m_Frames;
+		// Chunk of m_pStream being read, -1 if none.
+		int32_t m_Chunk;
+		uint64_t m_Position;
+		uint64_t m_Step;
+		float m_GainLeft;
+		float m_GainRight;
+		float m_TargetLeft;
+		float m_TargetRight;
+		bool m_Loop;
+		// Playing the sound's tail, m_Frames is 1 then.
+		bool m_Tail;
+		bool m_Stopping;
+		// Got its first chunk, running dry after counts as an underrun.
+		bool m_Started;
+		bool m_LastChunk;
+	};
+
+	// Owned by the owner thread.
+	struct VoiceSlot {
+		uint32_t m_Generation = 0;
+		bool m_Playing = false;
+		uint32_t m_Sound = 0;
+		Stream *m_pStream = nullptr;
+		uint32_t m_Channels = 0;
+		// Source rate over device rate.
+		double m_BaseStep = 0.0;
+		float m_Volume = 1.0f;
+		float m_Pan = 0.0f;
+	};
+
+	SDL_AudioDeviceID m_Device;
+	uint32_t m_Frequency;
+	uint32_t m_Samples;
+
+	// Owner thread to audio thread and back.
+	CSpscQueue<Command> m_Commands;
+	CSpscQueue<uint32_t> m_Finished;
+
+	// Audio thread state, allocated up front.
+	std::unique_ptr<Voice[]> m_pVoices;
+	std::unique_ptr<uint32_t[]> m_pActive;
+	uint32_t m_ActiveCount;
+	alignas(16) float m_aBus[2][BlockFrames];
+	alignas(16) float m_aScratch[2][BlockFrames];
+	std::atomic<float> m_MasterVolume;
+	std::atomic<uint64_t> m_Callbacks;
+	std::atomic<uint64_t> m_Frames;
+	std::atomic<uint64_t> m_MixTicks;
+	std::atomic<uint64_t> m_MaxMixTicks;
+	std::atomic<uint64_t> m_Underruns;
+
+	std::vector<VoiceSlot> m_VoiceSlots;
+	std::vector<uint32_t> m_FreeVoices;
+	// Index 0 is unused so the handle 0 stays invalid.
+	std::vector<std::unique_ptr<Sound>> m_Sounds;
+	std::vector<uint32_t> m_SoundGenerations;
+	std::vector<uint32_t> m_FreeSounds;
+	AudioStats m_Stats;
+
+	// The stream thread owns m_Streams, the others hand streams over through
+	// the opened and closed lists.
+	std::thread m_StreamThread;
+	std::mutex m_StreamMutex;
+	std::condition_variable m_StreamWake;
+	bool m_StreamRunning;
+	std::vector<std::unique_ptr<Stream>> m_OpenedStreams;
+	std::vector<Stream *> m_ClosedStreams;
+	std::vector<std::unique_ptr<Stream>> m_Streams;
+
+	static void audioCallback(void *pUserData, Uint8 *pStream, int Length);
+	void streamLoop();
+	void fillChunk(Stream &Stream, uint32_t Chunk);
+
+	void applyCommands();
+	bool fetchChunk(Voice &Voice);
+	// False once the voice finished.
+	bool renderVoice(Voice &Voice, uint32_t Count);
+
+	Sound *getSound(SoundHandle Handle) const;
+	VoiceSlot *getVoice(VoiceHandle Handle);
+	VoiceHandle startVoice(Command &Play, const VoiceParams &Params, uint32_t Channels, uint32_t Rate);
+	void computeGains(const VoiceSlot &Slot, float &Left, float &Right) const;
+	bool sendCommand(const Command &Command);
+	void destroySound(uint32_t Id);
+
+  public:
+	CAudioMixer();
+	~CAudioMixer();
+
+	// Opens the default output device, the frequency and buffer size in
+	// frames are requests. Failing to open one is logged and leaves the
+	// mixer without voices.
+	void init(uint32_t Frequency = 48000, uint32_t Samples = 512);
+	void quit();
+	// Once per frame, frees finished voices and the sounds and streams only
+	// they still used.
+	void update();
+
+	// Decodes a WAV file, more than two channels are mixed down to stereo.
+	SoundHandle loadSound(const std::string &Path);
+	// From interleaved samples of one or two channels.
+	SoundHandle createSound(const std::string &Name, const float *pSamples, uint32_t Frames, uint32_t Channels, uint32_t Rate);
+	// Playing voices finish first.
+	void releaseSound(SoundHandle Handle);
+
+	// An invalid handle when there is no free voice or no device.
+	VoiceHandle play(SoundHandle Sound, const VoiceParams &Params = VoiceParams());
+	// Read is called by the stream thread until it returns fewer frames than
+	// asked. Looping is up to it, m_Loop is ignored.
+	VoiceHandle playStream(const std::string &Name, uint32_t Channels, uint32_t Rate, StreamFunction Read,
+						   const VoiceParams &Params = VoiceParams());
+	// Fades the voice out over one block.
+	void stop(VoiceHandle Handle);
+	void setVolume(VoiceHandle Handle, float Volume);
+	void setPan(VoiceHandle Handle, float Pan);
+	void setPitch(VoiceHandle Handle, float Pitch);
+	bool isPlaying(VoiceHandle Handle) const;
+
+	void setMasterVolume(float Volume) { m_MasterVolume.store(Volume, std::memory_order_relaxed); }
+	void setPaused(bool Paused);
+
+	// Renders Frames of interleaved stereo. The device's callback calls it,
+	// call it directly only while the device is paused, e.g. to render a mix
+	// offline.
+	void mix(float *pOut, uint32_t Frames);
+
+	bool isOpen() const { return m_Device != 0; }
+	uint32_t getFrequency() const { return m_Frequency; }
+	// Frames per callback.
+	uint32_t getSamples() const { return m_Samples; }
+	AudioStats getStats() const;
+};
+
+} // namespace sps
+
+#endif
@@ -1,38 +1,115 @@
 #ifndef SUPERSDL_COLOR_HPP
 #define SUPERSDL_COLOR_HPP
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
 namespace sps {
 
+// Channels in [0, 1], nothing is gamma converted.
 class CColor {
   public:
 	float r, g, b, a;
 
-	CColor();
-	CColor(int r, int g, int b);
-	CColor(int r, int g, int b, int a);
-	CColor(int all);
+	constexpr CColor() : CColor(0) {}
+	constexpr CColor(int r, int g, int b, int a = 255) : r(r / 255.f), g(g / 255.f), b(b / 255.f), a(a / 255.f) {}
+	constexpr CColor(int all) : CColor(all, all, all, all) {}
+
+	static constexpr CColor from_float(float r, float g, float b, float a = 1.f) {
+		CColor Color;
+		Color.r = r;
+		Color.g = g;
+		Color.b = b;
+		Color.a = a;
+		return Color;
+	}
 
 	// hex should be RGB
-	static CColor from_hex(int hex);
+	static constexpr CColor from_hex(int hex) {
+		return CColor((hex & 0xFF0000) >> 16, (hex & 0xFF00) >> 8, (hex & 0xFF));
+	}
+
+	constexpr CColor operator+(const CColor &other) const {
+		return from_float(r + other.r, g + other.g, b + other.b, a + other.a);
+	}
+
+	constexpr CColor operator-(const CColor &other) const {
+		return from_float(r - other.r, g - other.g, b - other.b, a - other.a);
+	}
 
-	CColor operator+(const CColor &other);
-	CColor operator-(const CColor &other);
-	CColor operator*(const CColor &other);
+	constexpr CColor operator*(const CColor &other) const {
+		return from_float(r * other.r, g * other.g, b * other.b, a * other.a);
+	}
 };
 
-const CColor COLOR_WHITE = CColor(255);
-const CColor COLOR_BLACK = CColor(0);
-const CColor COLOR_GRAY = CColor(128);
-const CColor COLOR_RED = CColor(255, 0, 0);
-const CColor COLOR_LIME = CColor(0, 255, 0);
-const CColor COLOR_BLUE = CColor(0, 0, 255);
-const CColor COLOR_YELLOW = CColor(255, 255, 0);
-const CColor COLOR_CYAN = CColor(0, 255, 255);
-const CColor COLOR_MAGENTA = CColor(255, 0, 255);
-const CColor COLOR_SILVER = CColor(192);
-const CColor COLOR_MAROON = CColor(128, 0, 0);
-const CColor COLOR_GREEN = CColor(0, 128, 0);
-const CColor COLOR_PURPLE = CColor(128, 0, 128);
+// RGBA8 as sprites and images store it, red in the lowest byte.
+constexpr uint32_t packRGBA(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
+	return uint32_t(r) | (uint32_t(g) << 8) | (uint32_t(b) << 16) | (uint32_t(a) << 24);
+}
+
+constexpr uint32_t packColor(const CColor &Color) {
+	auto Channel = [](float v) {
+		return static_cast<uint8_t>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+	};
+	return packRGBA(Channel(Color.r), Channel(Color.g), Channel(Color.b), Channel(Color.a));
+}
+
+constexpr CColor unpackColor(uint32_t Packed) {
+	return CColor(Packed & 0xFF, (Packed >> 8) & 0xFF, (Packed >> 16) & 0xFF, Packed >> 24);
+}
+
+constexpr CColor COLOR_WHITE = CColor(255);
+constexpr CColor COLOR_BLACK = CColor(0);
+constexpr CColor COLOR_GRAY = CColor(128);
+constexpr CColor COLOR_RED = CColor(255, 0, 0);
+constexpr CColor COLOR_LIME = CColor(0, 255, 0);
+constexpr CColor COLOR_BLUE = CColor(0, 0, 255);
+constexpr CColor COLOR_YELLOW = CColor(255, 255, 0);
+constexpr CColor COLOR_CYAN = CColor(0, 255, 255);
+constexpr CColor COLOR_MAGENTA = CColor(255, 0, 255);
+constexpr CColor COLOR_SILVER = CColor(192);
+constexpr CColor COLOR_MAROON = CColor(128, 0, 0);
+constexpr CColor COLOR_GREEN = CColor(0, 128, 0);
+constexpr CColor COLOR_PURPLE = CColor(128, 0, 128);
+
+/*
+ * Kernels over many colors, e.g. a whole image or particle system, stored as
+ * one array per channel so every SIMD lane works on another color. The best
+ * implementation the CPU supports is picked on first use.
+ *
+ * Packed colors are sRGB encoded, planes are linear. Converting to sRGB
+ * interpolates a table over the float's exponent and top mantissa bits
+ * instead of calling pow, which is within one level of the exact result.
+ */
+struct ColorPlanes {
+	float *m_pR;
+	float *m_pG;
+	float *m_pB;
+	float *m_pA;
+};
+
+enum EColorKernels {
+	COLOR_KERNELS_SCALAR = 0,
+	COLOR_KERNELS_SSE2,
+	COLOR_KERNELS_AVX2,
+};
+
+// The implementation in use.
+EColorKernels getColorKernels();
+// Uses Kernels or the best supported one below it, returns the one in use.
+// Meant for benchmarks and tests, call it while no kernel runs.
+EColorKernels setColorKernels(EColorKernels Kernels);
+const char *getColorKernelsName(EColorKernels Kernels);
+
+// sRGB RGBA8 to linear planes, alpha is only normalized.
+void unpackSrgb(const uint32_t *pSrc, const ColorPlanes &Dst, size_t Count);
+// Linear planes to sRGB RGBA8, channels are clamped to [0, 1].
+void packSrgb(const ColorPlanes &Src, uint32_t *pDst, size_t Count);
+// Multiplies the color channels by alpha.
+void premultiply(const ColorPlanes &Colors, size_t Count);
+// Src over Dst, both premultiplied. The result is written to Dst.
+void blendOver(const ColorPlanes &Dst, const ColorPlanes &Src, size_t Count);
 
 } // namespace sps
 
@@ -0,0 +1,71 @@
+#ifndef SUPERSDL_CONFIG_HPP
+#define SUPERSDL_CONFIG_HPP
+
+#include "SuperSDL/loggable.hpp"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+
+namespace sps {
+
+// Settings read from the config file, unset ones keep what the game chose.
+struct ConfigValues {
+	// [engine]
+	std::optional<uint32_t> m_WorkerThreads;
+
+	// [renderer]
+	std::optional<uint32_t> m_Width;
+	std::optional<uint32_t> m_Height;
+	std::optional<vk::PresentModeKHR> m_PresentMode;
+	std::optional<uint32_t> m_SwapChainImages;
+	std::optional<uint32_t> m_FramesInFlight;
+	std::optional<bool> m_Validation;
+	std::optional<bool> m_Bindless;
+
+	// [game]
+	std::optional<double> m_TargetFrameRate;
+	std::optional<bool> m_Profiler;
+};
+
+/*
+ * The TOML config file in the config path. A template with every key
+ * commented out is written when there is none, so a fresh install behaves
+ * as the game was built.
+ *
+ * The file is watched by polling its modification time, which is a single
+ * stat call every PollInterval. A file that fails to parse is reported and
+ * the previous values stay in effect.
+ */
+class CConfig : CLoggable {
+  private:
+	static constexpr double PollInterval = 0.5;
+
+	std::string m_Path;
+	// Converted once, a string would be converted on every poll.
+	std::filesystem::path m_File;
+	std::filesystem::file_time_type m_LastWrite;
+	std::chrono::steady_clock::time_point m_NextPoll;
+	ConfigValues m_Values;
+
+	bool parse(ConfigValues &Values);
+	void writeTemplate();
+
+  public:
+	CConfig();
+
+	void load(const std::string &Path);
+	// Reloads the file if it was modified since it was last read. Returns
+	// true if it was, Previous is set to the values before the reload.
+	bool poll(ConfigValues &Previous);
+
+	const ConfigValues &get() const { return m_Values; }
+	const std::string &getPath() const { return m_Path; }
+};
+
+} // namespace sps
+
+#endif
@@ -0,0 +1,472 @@
+#ifndef SUPERSDL_ECS_HPP
+#define SUPERSDL_ECS_HPP
+
+#include "SuperSDL/job_system.hpp"
+#include "SuperSDL/loggable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sps {
+
+// Refers to an entity of a CWorld. A destroyed entity's index is reused with
+// another generation, so stale handles are detected. Generation 0 is never
+// valid.
+struct Entity {
+	uint32_t m_Index = 0;
+	uint32_t m_Generation = 0;
+
+	explicit operator bool() const { return m_Generation != 0; }
+	bool operator==(const Entity &Other) const { return m_Index == Other.m_Index && m_Generation == Other.m_Generation; }
+	bool operator!=(const Entity &Other) const { return !(*this == Other); }
+};
+
+// One bit per component type.
+using ComponentMask = uint64_t;
+constexpr uint32_t MaxComponentTypes = 64;
+
+// How a component type is moved and destroyed inside the untyped columns.
+struct ComponentInfo {
+	uint32_t m_Size;
+	uint32_t m_Align;
+	// Move constructs into uninitialized pDst and destroys pSrc.
+	void (*m_pRelocate)(void *pDst, void *pSrc);
+	void (*m_pDestroy)(void *pComponent);
+};
+
+// Throws once there are more than MaxComponentTypes types.
+uint32_t registerComponent(const ComponentInfo &Info);
+const ComponentInfo &getComponentInfo(uint32_t Id);
+
+// The id of a component type, registered on first use. Any movable type
+// can be a component.
+template <typename T>
+uint32_t componentId() {
+	using Component = std::remove_cv_t<T>;
+	static_assert(std::is_move_constructible_v<Component>, "components must be movable");
+	// Const components share the id of the mutable type.
+	if constexpr (!std::is_same_v<T, Component>) {
+		return componentId<Component>();
+	} else {
+		static const uint32_t s_Id = registerComponent({
+			uint32_t(sizeof(Component)),
+			uint32_t(alignof(Component)),
+			[](void *pDst, void *pSrc) {
+				Component *pSource = static_cast<Component *>(pSrc);
+				new (pDst) Component(std::move(*pSource));
+				pSource->~Component();
+			},
+			[](void *pComponent) { static_cast<Component *>(pComponent)->~Component(); },
+		});
+		return s_Id;
+	}
+}
+
+template <typename... Ts>
+ComponentMask componentMask() {
+	return (ComponentMask(0) | ... | (ComponentMask(1) << componentId<Ts>()));
+}
+
+class CWorld;
+
+/*
+ * Structural changes recorded while iterating, applied by CWorld::flush().
+ * Commands are closures stored back to back in pages that are kept between
+ * flushes, so recording doesn't allocate once the pages are warm.
+ *
+ * Commands on entities that were destroyed by the time they are applied
+ * are ignored. Entities created by commands only exist after the flush.
+ */
+class CEntityCommands {
+  private:
+	static constexpr size_t PageSize = 64 << 10;
+
+	struct Header {
+		// Runs and destroys the closure, also when it throws.
+		void (*m_pApply)(void *pClosure, CWorld &World);
+		void (*m_pDiscard)(void *pClosure);
+		size_t m_Size;
+	};
+
+	struct Page {
+		std::unique_ptr<unsigned char[]> m_pData;
+		size_t m_Capacity = 0;
+		size_t m_Used = 0;
+	};
+
+	std::vector<Page> m_Pages;
+	size_t m_Page;
+	uint32_t m_Count;
+
+	void *allocate(size_t Size);
+	// Destroys the commands from Offset on without running them.
+	static void discard(Page &Current, size_t Offset);
+
+	template <typename F>
+	void push(F &&Fn);
+
+	static size_t align(size_t Size) { return (Size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1); }
+
+  public:
+	CEntityCommands();
+	~CEntityCommands();
+	CEntityCommands(const CEntityCommands &) = delete;
+	CEntityCommands &operator=(const CEntityCommands &) = delete;
+	CEntityCommands(CEntityCommands &&) = default;
+
+	template <typename... Ts>
+	void create(Ts &&...Components);
+	void destroy(Entity E);
+	template <typename T>
+	void add(Entity E, T &&Component);
+	template <typename T>
+	void remove(Entity E);
+
+	// Runs the commands in the order they were recorded and clears them.
+	void apply(CWorld &World);
+	// Drops the commands without running them.
+	void clear();
+	uint32_t size() const { return m_Count; }
+};
+
+/*
+ * Entities and their components, grouped by archetype: all entities with
+ * the same set of component types are stored together. An archetype keeps
+ * its entities in fixed-size chunks, and every chunk holds one contiguous
+ * column per component type. Iterating a query walks the matching chunks
+ * and reads each column linearly, and a whole chunk is the unit of work
+ * when iterating in parallel.
+ *
+ * Adding or removing a component moves the entity to another archetype.
+ * Removal fills the hole with the archetype's last entity, so columns stay
+ * dense. Such structural changes are not allowed while iterating, record
+ * them in commands() instead and they are applied by flush().
+ *
+ * Systems are called in the order they were added by update(), which
+ * flushes the commands after each one. CGame runs it every fixed update.
+ *
+ * Everything except commands() and the component access in iteration
+ * callbacks must be called on the thread that owns the world.
+ */
+class CWorld : CLoggable {
+  private:
+	static constexpr size_t ChunkSize = 16 << 10;
+
+	struct Chunk {
+		unsigned char *m_pData;
+	};
+
+	struct Archetype {
+		ComponentMask m_Mask = 0;
+		std::vector<uint32_t> m_Components;
+		// Column index of each component type, -1 if it has none.
+		int8_t m_aColumn[MaxComponentTypes];
+		// Parallel to m_Components, the entity column is at offset 0.
+		std::vector<uint32_t> m_Offsets;
+		uint32_t m_ChunkCapacity = 0;
+		size_t m_ChunkBytes = 0;
+		// Emptied chunks are kept for later, only the first are in use.
+		std::vector<Chunk> m_Chunks;
+		uint32_t m_Count = 0;
+		// The archetype with one component type more or less, filled lazily.
+		Archetype *m_apAdd[MaxComponentTypes] = {};
+		Archetype *m_apRemove[MaxComponentTypes] = {};
+
+		uint32_t usedChunks() const { return (m_Count + m_ChunkCapacity - 1) / m_ChunkCapacity; }
+		uint32_t chunkCount(uint32_t Chunk) const { return std::min(m_ChunkCapacity, m_Count - Chunk * m_ChunkCapacity); }
+		Entity *entities(uint32_t Chunk) const { return reinterpret_cast<Entity *>(m_Chunks[Chunk].m_pData); }
+		void *column(uint32_t Chunk, uint32_t Column) const { return m_Chunks[Chunk].m_pData + m_Offsets[Column]; }
+		void *component(uint32_t Row, uint32_t Column) const;
+	};
+
+	struct EntityRecord {
+		Archetype *m_pArchetype = nullptr;
+		uint32_t m_Row = 0;
+		uint32_t m_Generation = 1;
+	};
+
+	// Matching archetypes of a query, extended when archetypes are added.
+	struct Query {
+		std::vector<Archetype *> m_Archetypes;
+		size_t m_Checked = 0;
+	};
+
+	struct ChunkRef {
+		Archetype *m_pArchetype;
+		uint32_t m_Chunk;
+	};
+
+	struct System {
+		const char *m_pName;
+		std::function<void(CWorld &, double)> m_Run;
+	};
+
+	CJobSystem *m_pJobs;
+	std::vector<std::unique_ptr<Archetype>> m_Archetypes;
+	std::unordered_map<ComponentMask, Archetype *> m_ArchetypeMap;
+	std::unordered_map<ComponentMask, Query> m_Queries;
+	std::vector<EntityRecord> m_Entities;
+	std::vector<uint32_t> m_FreeEntities;
+	uint32_t m_EntityCount;
+	// One per job system thread, so recording needs no lock.
+	std::vector<CEntityCommands> m_Commands;
+	std::vector<ChunkRef> m_ParallelChunks;
+	std::vector<System> m_Systems;
+	std::atomic<uint32_t> m_Iterating;
+
+	Archetype *getArchetype(ComponentMask Mask);
+	Archetype *addEdge(Archetype *pFrom, uint32_t Component);
+	Archetype *removeEdge(Archetype *pFrom, uint32_t Component);
+	const std::vector<Archetype *> &query(ComponentMask Mask);
+
+	Entity allocateEntity();
+	uint32_t allocateRow(Archetype &Archetype, Entity E);
+	// Moves the last row into Row. Components must have been moved out or
+	// destroyed already.
+	void removeRow(Archetype &Archetype, uint32_t Row);
+	void moveEntity(Entity E, Archetype &To);
+	const EntityRecord *record(Entity E) const;
+	void checkStructural() const;
+
+	class CIterationGuard {
+	  private:
+		std::atomic<uint32_t> &m_Iterating;
+
+	  public:
+		explicit CIterationGuard(std::atomic<uint32_t> &Iterating) : m_Iterating(Iterating) { m_Iterating.fetch_add(1, std::memory_order_relaxed); }
+		~CIterationGuard() { m_Iterating.fetch_sub(1, std::memory_order_relaxed); }
+	};
+
+	template <typename... Ts, typename F, size_t... Is>
+	static void runChunk(const Archetype &Archetype, uint32_t Chunk, F &Fn, std::index_sequence<Is...>);
+
+  public:
+	CWorld();
+	~CWorld();
+	CWorld(const CWorld &) = delete;
+	CWorld &operator=(const CWorld &) = delete;
+
+	// pJobs runs parallelEach, may be null to run everything inline.
+	void init(CJobSystem *pJobs);
+	// Destroys all entities and systems.
+	void quit();
+
+	template <typename... Ts>
+	Entity create(Ts &&...Components);
+	// Does nothing if the entity is already gone.
+	void destroy(Entity E);
+	bool isAlive(Entity E) const { return record(E) != nullptr; }
+	uint32_t getEntityCount() const { return m_EntityCount; }
+	uint32_t getArchetypeCount() const { return static_cast<uint32_t>(m_Archetypes.size()); }
+
+	// Replaces the component if the entity already has one.
+	template <typename T>
+	void add(Entity E, T &&Component);
+	template <typename T>
+	void remove(Entity E);
+	template <typename T>
+	bool has(Entity E) const;
+	// Null if the entity doesn't have the component. Only valid until the
+	// next structural change.
+	template <typename T>
+	T *get(Entity E);
+
+	// Calls Fn(Ts &...) or Fn(Entity, Ts &...) for every entity that has all
+	// of Ts.
+	template <typename... Ts, typename F>
+	void each(F &&Fn);
+	// Calls Fn(uint32_t Count, const Entity *pEntities, Ts *...pColumns) once
+	// per chunk, for kernels that work on whole columns.
+	template <typename... Ts, typename F>
+	void eachChunk(F &&Fn);
+	// Like each(), with the chunks spread over the job system. Fn runs
+	// concurrently and must only touch the components it was given. Must
+	// not be nested in another parallelEach().
+	template <typename... Ts, typename F>
+	void parallelEach(F &&Fn);
+
+	// The calling thread's command buffer, any job system thread may record.
+	CEntityCommands &commands();
+	// Applies the commands of all threads, thread by thread.
+	void flush();
+
+	void addSystem(const char *pName, std::function<void(CWorld &, double)> Run);
+	// Runs the systems in order and flushes the commands after each.
+	void update(double Delta);
+};
+
+template <typename F>
+void CEntityCommands::push(F &&Fn) {
+	using Func = std::decay_t<F>;
+	static_assert(alignof(Func) <= alignof(std::max_align_t), "command capture is over-aligned");
+
+	size_t HeaderSize = align(sizeof(Header));
+	unsigned char *pData = static_cast<unsigned char *>(allocate(HeaderSize + align(sizeof(Func))));
+	Header *pHeader = new (pData) Header;
+	pHeader->m_pApply = [](void *pClosure, CWorld &World) {
+		struct Destroy {
+			Func *m_pFn;
+			~Destroy() { m_pFn->~Func(); }
+		} Closure{static_cast<Func *>(pClosure)};
+		(*Closure.m_pFn)(World);
+	};
+	pHeader->m_pDiscard = [](void *pClosure) { static_cast<Func *>(pClosure)->~Func(); };
+	pHeader->m_Size = HeaderSize + align(sizeof(Func));
+	new (pData + HeaderSize) Func(std::forward<F>(Fn));
+	m_Count++;
+}
+
+template <typename... Ts>
+void CEntityCommands::create(Ts &&...Components) {
+	push([Tuple = std::make_tuple(std::forward<Ts>(Components)...)](CWorld &World) mutable {
+		std::apply([&World](auto &&...Args) { World.create(std::move(Args)...); }, std::move(Tuple));
+	});
+}
+
+template <typename T>
+void CEntityCommands::add(Entity E, T &&Component) {
+	push([E, Value = std::forward<T>(Component)](CWorld &World) mutable {
+		if (World.isAlive(E))
+			World.add(E, std::move(Value));
+	});
+}
+
+template <typename T>
+void CEntityCommands::remove(Entity E) {
+	push([E](CWorld &World) {
+		if (World.isAlive(E))
+			World.remove<T>(E);
+	});
+}
+
+template <typename... Ts>
+Entity CWorld::create(Ts &&...Components) {
+	checkStructural();
+	Archetype *pArchetype = getArchetype(componentMask<std::decay_t<Ts>...>());
+
+	Entity E = allocateEntity();
+	uint32_t Row = allocateRow(*pArchetype, E);
+	(new (pArchetype->component(Row, pArchetype->m_aColumn[componentId<std::decay_t<Ts>>()])) std::decay_t<Ts>(std::forward<Ts>(Components)), ...);
+	return E;
+}
+
+template <typename T>
+void CWorld::add(Entity E, T &&Component) {
+	using Type = std::decay_t<T>;
+	checkStructural();
+	const EntityRecord *pRecord = record(E);
+	if (!pRecord)
+		return;
+
+	uint32_t Id = componentId<Type>();
+	Archetype *pFrom = pRecord->m_pArchetype;
+	if (pFrom->m_aColumn[Id] >= 0) {
+		*static_cast<Type *>(pFrom->component(pRecord->m_Row, pFrom->m_aColumn[Id])) = std::forward<T>(Component);
+		return;
+	}
+
+	Archetype *pTo = addEdge(pFrom, Id);
+	moveEntity(E, *pTo);
+	pRecord = record(E);
+	new (pTo->component(pRecord->m_Row, pTo->m_aColumn[Id])) Type(std::forward<T>(Component));
+}
+
+template <typename T>
+void CWorld::remove(Entity E) {
+	checkStructural();
+	const EntityRecord *pRecord = record(E);
+	uint32_t Id = componentId<T>();
+	if (!pRecord || pRecord->m_pArchetype->m_aColumn[Id] < 0)
+		return;
+	moveEntity(E, *removeEdge(pRecord->m_pArchetype, Id));
+}
+
+template <typename T>
+bool CWorld::has(Entity E) const {
+	const EntityRecord *pRecord = record(E);
+	return pRecord && pRecord->m_pArchetype->m_aColumn[componentId<T>()] >= 0;
+}
+
+template <typename T>
+T *CWorld::get(Entity E) {
+	const EntityRecord *pRecord = record(E);
+	if (!pRecord)
+		return nullptr;
+	int Column = pRecord->m_pArchetype->m_aColumn[componentId<T>()];
+	if (Column < 0)
+		return nullptr;
+	return static_cast<T *>(pRecord->m_pArchetype->component(pRecord->m_Row, Column));
+}
+
+template <typename... Ts, typename F, size_t... Is>
+void CWorld::runChunk(const Archetype &Archetype, uint32_t Chunk, F &Fn, std::index_sequence<Is...>) {
+	uint32_t Count = Archetype.chunkCount(Chunk);
+	const Entity *pEntities = Archetype.entities(Chunk);
+	std::tuple<Ts *...> Columns(static_cast<Ts *>(Archetype.column(Chunk, Archetype.m_aColumn[componentId<Ts>()]))...);
+
+	for (uint32_t i = 0; i < Count; i++) {
+		if constexpr (std::is_invocable_v<F &, Entity, Ts &...>)
+			Fn(pEntities[i], std::get<Is>(Columns)[i]...);
+		else
+			Fn(std::get<Is>(Columns)[i]...);
+	}
+}
+
+template <typename... Ts, typename F>
+void CWorld::each(F &&Fn) {
+	const std::vector<Archetype *> &Archetypes = query(componentMask<Ts...>());
+	CIterationGuard Guard(m_Iterating);
+	for (Archetype *pArchetype : Archetypes) {
+		uint32_t Chunks = pArchetype->usedChunks();
+		for (uint32_t Chunk = 0; Chunk < Chunks; Chunk++)
+			runChunk<Ts...>(*pArchetype, Chunk, Fn, std::index_sequence_for<Ts...>());
+	}
+}
+
+template <typename... Ts, typename F>
+void CWorld::eachChunk(F &&Fn) {
+	const std::vector<Archetype *> &Archetypes = query(componentMask<Ts...>());
+	CIterationGuard Guard(m_Iterating);
+	for (Archetype *pArchetype : Archetypes) {
+		uint32_t Chunks = pArchetype->usedChunks();
+		for (uint32_t Chunk = 0; Chunk < Chunks; Chunk++) {
+			Fn(pArchetype->chunkCount(Chunk), const_cast<const Entity *>(pArchetype->entities(Chunk)),
+			   static_cast<Ts *>(pArchetype->column(Chunk, pArchetype->m_aColumn[componentId<Ts>()]))...);
+		}
+	}
+}
+
+template <typename... Ts, typename F>
+void CWorld::parallelEach(F &&Fn) {
+	const std::vector<Archetype *> &Archetypes = query(componentMask<Ts...>());
+	CIterationGuard Guard(m_Iterating);
+
+	m_ParallelChunks.clear();
+	for (Archetype *pArchetype : Archetypes) {
+		uint32_t Chunks = pArchetype->usedChunks();
+		for (uint32_t Chunk = 0; Chunk < Chunks; Chunk++)
+			m_ParallelChunks.push_back({pArchetype, Chunk});
+	}
+
+	auto Run = [this, &Fn](uint32_t Begin, uint32_t End) {
+		for (uint32_t i = Begin; i < End; i++)
+			runChunk<Ts...>(*m_ParallelChunks[i].m_pArchetype, m_ParallelChunks[i].m_Chunk, Fn, std::index_sequence_for<Ts...>());
+	};
+	if (m_pJobs)
+		m_pJobs->parallelFor(0, static_cast<uint32_t>(m_ParallelChunks.size()), Run);
+	else
+		Run(0, static_cast<uint32_t>(m_ParallelChunks.size()));
+}
+
+} // namespace sps
+
+#endif
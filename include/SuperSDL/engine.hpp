@@ -1,7 +1,12 @@
 #ifndef SUPERSDL_ENGINE_HPP
 #define SUPERSDL_ENGINE_HPP
 
+#include "audio.hpp"
+#include "config.hpp"
+#include "job_system.hpp"
 #include "loggable.hpp"
+#include "memory.hpp"
+#include "startup.hpp"
 #include <spdlog/logger.h>
 #include <SDL.h>
 #include <string>
@@ -14,14 +19,43 @@ class CEngine : CLoggable {
 		std::string m_AppConfigPath;
 		const char *m_pOrgName;
 		const char *m_pGameName;
+		uint32_t m_WorkerThreads;
+		CStartup m_Startup;
+		// Steps init() left running in the background.
+		CJobCounter m_Starting;
+		CJobSystem m_Jobs;
+		CFrameMemory m_Memory;
+		CConfig m_Config;
+		CAudioMixer m_Audio;
 
   public:
 	CEngine();
 	void init(const char *pOrgName, const char *pGameName);
+	// Waits for what init() started in the background, the audio mixer is
+	// only open after it.
+	void waitForStartup();
 	void quit();
 
 	const char *getOrgName() { return m_pOrgName; }
 	const char *getGameName() { return m_pGameName; }
+	// Per user writable directory, ends with a path separator.
+	const std::string &getConfigPath() const { return m_AppConfigPath; }
+
+	// Must be called before init(), 0 runs every job on the main thread.
+	// CJobSystem::AutoWorkers, the default, uses one worker per core besides it.
+	void setWorkerThreads(uint32_t Count) { m_WorkerThreads = Count; }
+	CJobSystem &jobs() { return m_Jobs; }
+	// Per-thread scratch memory of the current frame, CGame ends its frames.
+	CFrameMemory &memory() { return m_Memory; }
+	const CFrameMemory &memory() const { return m_Memory; }
+	// config.toml in the config path, loaded by init().
+	CConfig &config() { return m_Config; }
+	// Times the startup, see CStartup.
+	CStartup &startup() { return m_Startup; }
+	const CStartup &startup() const { return m_Startup; }
+	// Opened in the background by init(), see waitForStartup(). Silent if
+	// there is no audio device.
+	CAudioMixer &audio() { return m_Audio; }
 };
 
 } // namespace sps
@@ -0,0 +1,136 @@
+#ifndef SUPERSDL_FONT_ATLAS_HPP
+#define SUPERSDL_FONT_ATLAS_HPP
+
+#include "SuperSDL/loggable.hpp"
+#include "SuperSDL/skyline_packer.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct FT_LibraryRec_;
+struct FT_FaceRec_;
+
+namespace sps {
+
+// Decodes the code point at i and advances i past it. Malformed sequences,
+// overlong forms, surrogates and code points past U+10FFFF give U+FFFD.
+uint32_t decodeUtf8(std::string_view Text, size_t &i);
+
+// A glyph rasterized into the atlas. Sizes are in pixels at the base size.
+struct GlyphInfo {
+	// Rectangle in the atlas, empty for glyphs without an outline.
+	uint32_t m_X = 0;
+	uint32_t m_Y = 0;
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	// From the pen position to the top left of the rectangle, y down.
+	glm::vec2 m_Offset = glm::vec2(0.0f);
+	float m_Advance = 0.0f;
+	// False when FreeType couldn't load or render it.
+	bool m_Valid = false;
+};
+
+// Glyph positions of a string, in pixels at the base size with the origin at
+// the top left of the first line.
+struct TextLayout {
+	struct Glyph {
+		glm::vec2 m_Position;
+		const GlyphInfo *m_pInfo;
+	};
+
+	std::vector<Glyph> m_Glyphs;
+	glm::vec2 m_Size = glm::vec2(0.0f);
+};
+
+struct FontAtlasStats {
+	uint64_t m_LayoutHits = 0;
+	uint64_t m_LayoutMisses = 0;
+	uint32_t m_GlyphsRasterized = 0;
+	uint32_t m_GlyphsDropped = 0;
+};
+
+/*
+ * Rasterizes glyphs once, as signed distance fields at a single base size,
+ * and packs them into one 8-bit atlas shared by all fonts. Text of any size
+ * is drawn from the same glyphs, the shader reconstructs sharp edges from the
+ * distance. Layouts are cached per font and string, so unchanged text costs
+ * a hash lookup per frame.
+ *
+ * Glyphs that don't fit once the atlas is full are left out, and neither
+ * they nor the layouts missing them are cached, so they are tried again.
+ *
+ * This is the CPU side, CTextRenderer uploads the atlas and draws.
+ */
+class CFontAtlas : CLoggable {
+  public:
+	// Glyphs are rasterized at this size in pixels.
+	static constexpr uint32_t BaseSize = 40;
+	// Distance in pixels covered by the field outside and inside the outline.
+	static constexpr uint32_t Spread = 6;
+
+  private:
+	// Cached layouts per font before the cache is flushed.
+	static constexpr size_t MaxCachedLayouts = 4096;
+
+	struct Font {
+		FT_FaceRec_ *m_pFace = nullptr;
+		bool m_HasKerning = false;
+		float m_LineHeight = 0.0f;
+		float m_Ascender = 0.0f;
+		// By glyph index, the map keeps the addresses stable.
+		std::unordered_map<uint32_t, GlyphInfo> m_Glyphs;
+		std::unordered_map<std::string, TextLayout> m_Layouts;
+	};
+
+	FT_LibraryRec_ *m_pLibrary;
+	std::vector<std::unique_ptr<Font>> m_Fonts;
+
+	uint32_t m_Width;
+	uint32_t m_Height;
+	std::vector<uint8_t> m_Pixels;
+	CSkylinePacker m_Packer;
+	// Area changed since the last upload, empty when m_DirtyMax <= m_DirtyMin.
+	glm::uvec2 m_DirtyMin;
+	glm::uvec2 m_DirtyMax;
+
+	FontAtlasStats m_Stats;
+	// What getGlyph() returns for glyphs that didn't fit, only its advance
+	// is read.
+	GlyphInfo m_Dropped;
+	// A layout missing dropped glyphs, returned without being cached.
+	TextLayout m_Uncached;
+
+	const GlyphInfo &getGlyph(Font &Font, uint32_t GlyphIndex);
+
+  public:
+	CFontAtlas();
+	~CFontAtlas();
+
+	void init(uint32_t Width, uint32_t Height);
+	void quit();
+
+	// Returns the id of the font, throws if it can't be loaded.
+	uint32_t loadFont(const std::string &Path);
+
+	// The cached layout of Text, valid until the next call.
+	const TextLayout &layout(uint32_t Font, std::string_view Text);
+
+	uint32_t getWidth() const { return m_Width; }
+	uint32_t getHeight() const { return m_Height; }
+	const uint8_t *getPixels() const { return m_Pixels.data(); }
+
+	// Area of the atlas changed since clearDirty(), false if none.
+	bool getDirty(glm::uvec2 &Min, glm::uvec2 &Max) const;
+	void clearDirty();
+
+	const FontAtlasStats &getStats() const { return m_Stats; }
+	double getOccupancy() const { return m_Packer.getOccupancy(); }
+};
+
+} // namespace sps
+
+#endif
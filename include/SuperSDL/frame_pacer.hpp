@@ -0,0 +1,70 @@
+#ifndef SUPERSDL_FRAME_PACER_HPP
+#define SUPERSDL_FRAME_PACER_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace sps {
+
+struct FrameStats {
+	// All times are in seconds.
+	double m_TargetFrameTime = 0.0;
+	double m_LastFrameTime = 0.0;
+	double m_AverageFrameTime = 0.0;
+	double m_MinFrameTime = 0.0;
+	double m_MaxFrameTime = 0.0;
+	// Mean absolute difference between the frame time and the target.
+	double m_PacingError = 0.0;
+	uint64_t m_FrameCount = 0;
+	uint64_t m_UpdateCount = 0;
+	uint64_t m_MissedDeadlines = 0;
+};
+
+/*
+ * Paces frames to a target rate using a hybrid wait: it sleeps while the
+ * deadline is further away than the measured sleep overshoot and spins for
+ * the remainder. The overshoot is estimated online so that the amount of
+ * spinning adapts to the scheduler granularity of the machine.
+ */
+class CFramePacer {
+  public:
+	using clock_t = std::chrono::steady_clock;
+
+  private:
+	static constexpr size_t HistorySize = 128;
+
+	double m_TargetFrameTime;
+	clock_t::time_point m_LastFrame;
+	clock_t::time_point m_NextDeadline;
+
+	// Running estimate of how long a 1ms sleep really takes (Welford).
+	double m_SleepEstimate;
+	double m_SleepMean;
+	double m_SleepM2;
+	uint64_t m_SleepCount;
+
+	std::array<double, HistorySize> m_History;
+	FrameStats m_Stats;
+
+	void sleepUntil(clock_t::time_point Deadline);
+	void recordFrame(double FrameTime);
+
+  public:
+	CFramePacer();
+
+	// 0 disables pacing and lets the loop run as fast as possible.
+	void setTargetFrameRate(double Fps);
+	double getTargetFrameRate() const;
+
+	void reset();
+	// Blocks until the next frame deadline and records the frame time.
+	void waitForNextFrame();
+	void countUpdate() { m_Stats.m_UpdateCount++; }
+
+	const FrameStats &getStats() const { return m_Stats; }
+};
+
+} // namespace sps
+
+#endif
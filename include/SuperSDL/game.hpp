@@ -1,6 +1,9 @@
 #ifndef SUPERSDL_GAME_HPP
 #define SUPERSDL_GAME_HPP
 
+#include "SuperSDL/ecs.hpp"
+#include "SuperSDL/frame_pacer.hpp"
+#include "SuperSDL/input.hpp"
 #include "SuperSDL/renderer.hpp"
 #include "engine.hpp"
 #include "loggable.hpp"
@@ -11,20 +14,82 @@ class CGame : CLoggable {
   private:
 	CEngine m_Engine;
 	CRenderer m_Renderer;
+	CFramePacer m_Pacer;
+	CInput m_Input;
+	CWorld m_World;
 	bool m_Stop;
+	bool m_Headless;
+	bool m_Profiling;
+	double m_UpdateStep;
+	double m_MaxFrameTime;
 	const char *m_pOrgName;
 	const char *m_pGameName;
 
+	void run();
+	// Applies the values that differ from Previous, the ones that need a
+	// restart only before the renderer started.
+	void applyConfig(const ConfigValues &Previous, const ConfigValues &Values, bool Running);
+
   protected:
 	void stop();
+	// Called before the renderer starts, with the job system running. Only
+	// renderer().assets() may be used, textures and buffers requested here
+	// are decoded while the renderer starts and uploaded once it runs.
+	virtual void onPreload() {}
 	virtual void onLoad() = 0;
+	// Called at a fixed rate after the world's systems, delta is always the
+	// update step. Commands recorded here are flushed right after.
 	virtual void onUpdate(double delta) = 0;
-	virtual void onRender(double delta) = 0;
+	// alpha is how far we are between the last update and the next one, in [0, 1).
+	virtual void onRender(double alpha) = 0;
+
+	// Updates per second used for the fixed timestep. Anything but a
+	// positive finite rate is logged and ignored.
+	void setUpdateRate(double Hz);
+	// Frames per second, 0 to run uncapped.
+	void setTargetFrameRate(double Fps);
+	// Uses SDL's dummy video and audio drivers and renders offscreen, must be set
+	// before start().
+	void setHeadless(bool Headless, uint32_t Width = 640, uint32_t Height = 480);
+
+	// Records CPU and GPU scopes and writes a Chrome trace to the config
+	// path on exit, must be set before start(). Also enabled by the
+	// SUPERSDL_PROFILE environment variable.
+	void setProfiling(bool Profiling) { m_Profiling = Profiling; }
+
+	// Worker threads besides the main one, must be set before start(). One
+	// per core by default, 0 runs every job on the main thread.
+	void setWorkerThreads(uint32_t Count) { m_Engine.setWorkerThreads(Count); }
+	// Lets onUpdate and onRender fan work out, see CJobSystem::parallelFor.
+	CJobSystem &jobs() { return m_Engine.jobs(); }
+
+	CRenderer &renderer() { return m_Renderer; }
+	// Input sampled right before the fixed updates, update jobs may read it
+	// concurrently. Presses and releases wait for the next update, frames
+	// without one don't lose them, and only the first update of a frame
+	// sees them. Call it again in every update instead of keeping the
+	// reference, the snapshot changes after each one.
+	const InputSnapshot &input() const { return m_Input.snapshot(); }
+	const InputStats &getInputStats() const { return m_Input.getStats(); }
+	// Finished voices are freed once per frame, before the fixed updates.
+	CAudioMixer &audio() { return m_Engine.audio(); }
+	// Its systems run every fixed update, add them in onLoad().
+	CWorld &world() { return m_World; }
 
   public:
 	CGame(const char *pOrgName, const char *pGameName);
 	virtual ~CGame() {}
 	void start();
+
+	const FrameStats &getFrameStats() const { return m_Pacer.getStats(); }
+	// Heap allocations of the last frame and the frame arenas' use.
+	const MemoryStats &getMemoryStats() const { return m_Engine.memory().getStats(); }
+	// How long each step of the startup took, complete once the first frame
+	// was submitted.
+	StartupStats getStartupStats() const { return m_Engine.startup().getStats(); }
+	// Runs independent startup steps beside the main thread, must be set
+	// before start(). On by default, turning it off shows what it saves.
+	void setParallelStartup(bool Parallel) { m_Engine.startup().setParallel(Parallel); }
 };
 
 } // namespace sps
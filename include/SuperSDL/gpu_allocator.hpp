@@ -0,0 +1,144 @@
+#ifndef SUPERSDL_GPU_ALLOCATOR_HPP
+#define SUPERSDL_GPU_ALLOCATOR_HPP
+
+#include "SuperSDL/loggable.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+
+namespace sps {
+
+struct GpuMemoryBlock;
+
+// A range of device memory owned by the allocator.
+struct GpuAllocation {
+	vk::DeviceMemory m_Memory;
+	vk::DeviceSize m_Offset = 0;
+	vk::DeviceSize m_Size = 0;
+	// Points at m_Offset when the memory is host visible.
+	void *m_pMapped = nullptr;
+
+	// Bookkeeping for the allocator.
+	GpuMemoryBlock *m_pBlock = nullptr;
+	vk::DeviceSize m_RequestedSize = 0;
+	uint32_t m_MemoryType = 0;
+	uint32_t m_Order = 0;
+
+	explicit operator bool() const { return static_cast<bool>(m_Memory); }
+};
+
+// Per-frame scratch memory, valid until the frame slot is reused.
+struct TransientAllocation {
+	vk::Buffer m_Buffer;
+	vk::DeviceSize m_Offset = 0;
+	void *m_pMapped = nullptr;
+
+	explicit operator bool() const { return m_pMapped != nullptr; }
+};
+
+struct GpuAllocatorStats {
+	// Live vkAllocateMemory calls, bounded by maxMemoryAllocationCount.
+	uint32_t m_DeviceAllocations = 0;
+	uint32_t m_MaxDeviceAllocations = 0;
+	uint32_t m_BlockCount = 0;
+	uint32_t m_DedicatedCount = 0;
+	uint32_t m_AllocationCount = 0;
+
+	// Device memory we hold, what is handed out (rounded) and what was asked for.
+	vk::DeviceSize m_ReservedBytes = 0;
+	vk::DeviceSize m_UsedBytes = 0;
+	vk::DeviceSize m_RequestedBytes = 0;
+	vk::DeviceSize m_FreeBytes = 0;
+	vk::DeviceSize m_LargestFreeRange = 0;
+
+	vk::DeviceSize m_TransientCapacity = 0;
+	vk::DeviceSize m_TransientUsed = 0;
+
+	// Space lost to rounding up to the buddy sizes.
+	double internalFragmentation() const { return m_UsedBytes ? 1.0 - double(m_RequestedBytes) / m_UsedBytes : 0.0; }
+	// How much of the free space can't be used by a single allocation.
+	double externalFragmentation() const { return m_FreeBytes ? 1.0 - double(m_LargestFreeRange) / m_FreeBytes : 0.0; }
+};
+
+/*
+ * Sub-allocates device memory so resources don't each need their own
+ * vkAllocateMemory.
+ *
+ * Long-lived resources come from buddy allocated blocks, one pool per memory
+ * type and tiling so linear and optimal resources never share a block and
+ * bufferImageGranularity can't be violated. Buddy ranges are aligned to their
+ * size, which covers any power of two alignment requirement. Requests too big
+ * for a block get a dedicated allocation.
+ *
+ * Per-frame data goes to a linear allocator: a persistently mapped buffer with
+ * one region per frame in flight that is reset when the frame slot is reused.
+ */
+class CGpuAllocator : CLoggable {
+  private:
+	static constexpr vk::DeviceSize MinAllocationSize = 256;
+	static constexpr vk::DeviceSize DefaultBlockSize = 64ull << 20;
+
+	struct Pool {
+		uint32_t m_MemoryType;
+		bool m_Linear;
+		vk::DeviceSize m_BlockSize;
+		std::vector<std::unique_ptr<GpuMemoryBlock>> m_Blocks;
+	};
+
+	vk::PhysicalDevice m_PhysicalDevice;
+	vk::Device m_Device;
+	vk::PhysicalDeviceMemoryProperties m_MemoryProperties;
+
+	mutable std::mutex m_Mutex;
+	std::vector<Pool> m_Pools;
+	GpuAllocatorStats m_Stats;
+
+	// Linear per-frame allocator.
+	vk::Buffer m_TransientBuffer;
+	GpuAllocation m_TransientMemory;
+	vk::DeviceSize m_TransientFrameSize;
+	uint32_t m_TransientFrame;
+	std::atomic<vk::DeviceSize> m_TransientHead;
+	std::atomic<bool> m_TransientWarned;
+
+	Pool &getPool(uint32_t MemoryType, bool Linear);
+	GpuMemoryBlock *createBlock(Pool &Pool);
+	void destroyBlock(GpuMemoryBlock *pBlock);
+	vk::DeviceMemory allocateDeviceMemory(vk::DeviceSize Size, uint32_t MemoryType, void **ppMapped);
+	void freeDeviceMemory(vk::DeviceMemory Memory, bool Mapped);
+
+  public:
+	CGpuAllocator();
+	~CGpuAllocator();
+
+	void init(vk::PhysicalDevice PhysicalDevice, vk::Device Device, uint32_t FramesInFlight, vk::DeviceSize TransientFrameSize);
+	void quit();
+
+	// Returns a memory type with all the Required flags, favoring ones that also have the Preferred ones.
+	uint32_t findMemoryType(uint32_t TypeFilter, vk::MemoryPropertyFlags Required, vk::MemoryPropertyFlags Preferred = {}) const;
+
+	// Linear is true for buffers and linearly tiled images.
+	GpuAllocation allocate(const vk::MemoryRequirements &Requirements, vk::MemoryPropertyFlags Required, vk::MemoryPropertyFlags Preferred, bool Linear);
+	void free(GpuAllocation &Allocation);
+
+	GpuAllocation allocateBuffer(vk::Buffer Buffer, vk::MemoryPropertyFlags Required, vk::MemoryPropertyFlags Preferred = {});
+	GpuAllocation allocateImage(vk::Image Image, vk::MemoryPropertyFlags Required, vk::MemoryPropertyFlags Preferred = {});
+
+	// Makes the region of the given frame current and empties it. The caller
+	// must make sure the GPU is done with that frame.
+	void beginFrame(uint32_t Frame);
+	// Thread safe, returns an empty allocation when the frame region is full.
+	TransientAllocation allocateTransient(vk::DeviceSize Size, vk::DeviceSize Alignment = 16);
+
+	GpuAllocatorStats getStats() const;
+	void logStats() const;
+};
+
+} // namespace sps
+
+#endif
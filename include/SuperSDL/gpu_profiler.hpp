@@ -0,0 +1,96 @@
+#ifndef SUPERSDL_GPU_PROFILER_HPP
+#define SUPERSDL_GPU_PROFILER_HPP
+
+#include "SuperSDL/profiler.hpp"
+#include <cstdint>
+#include <vector>
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+
+namespace sps {
+
+/*
+ * Timestamp queries per frame in flight. Each frame slot has its own range of
+ * queries which is only read back once the slot's fence has signaled, so
+ * resolving never stalls. The whole frame is always timed; nested scopes are
+ * only recorded while the CPU profiler is enabled and are forwarded to it on
+ * a "GPU" track.
+ */
+class CGpuProfiler {
+  private:
+	struct Scope {
+		const char *m_pName;
+		uint32_t m_Begin;
+		uint32_t m_End;
+	};
+
+	struct FrameQueries {
+		std::vector<Scope> m_Scopes;
+		std::vector<uint32_t> m_Stack;
+		uint32_t m_Used = 0;
+		// CPU time the frame was submitted, used to place it on the trace.
+		uint64_t m_SubmitTime = 0;
+	};
+
+	vk::Device m_Device;
+	vk::QueryPool m_Pool;
+	uint32_t m_QueriesPerFrame;
+	uint64_t m_TimestampMask;
+	double m_Period;
+	uint32_t m_Frame;
+	std::vector<FrameQueries> m_Frames;
+	std::vector<uint64_t> m_Results;
+	double m_FrameTime;
+	CProfiler::Track *m_pTrack;
+
+	uint32_t writeTimestamp(vk::CommandBuffer Cmd, vk::PipelineStageFlagBits Stage);
+
+  public:
+	CGpuProfiler();
+
+	// Returns false if the queue family can't write timestamps.
+	bool init(vk::PhysicalDevice PhysicalDevice, vk::Device Device, uint32_t QueueFamily, uint32_t FramesInFlight, uint32_t MaxScopes);
+	void quit();
+	bool isSupported() const { return static_cast<bool>(m_Pool); }
+
+	void beginFrame(vk::CommandBuffer Cmd, uint32_t Frame);
+	void endFrame(vk::CommandBuffer Cmd);
+	void markSubmitted(uint64_t CpuTime) {
+		if (m_Pool)
+			m_Frames[m_Frame].m_SubmitTime = CpuTime;
+	}
+
+	void beginScope(vk::CommandBuffer Cmd, const char *pName);
+	void endScope(vk::CommandBuffer Cmd);
+
+	// Reads the queries of a frame slot whose fence signaled.
+	void resolve(uint32_t Frame);
+
+	// Seconds the GPU spent on the most recently resolved frame.
+	double getFrameTime() const { return m_FrameTime; }
+};
+
+class CGpuProfileScope {
+  private:
+	CGpuProfiler *m_pProfiler;
+	vk::CommandBuffer m_Cmd;
+
+  public:
+	CGpuProfileScope(CGpuProfiler &Profiler, vk::CommandBuffer Cmd, const char *pName) : m_pProfiler(&Profiler), m_Cmd(Cmd) {
+		m_pProfiler->beginScope(m_Cmd, pName);
+	}
+	~CGpuProfileScope() { m_pProfiler->endScope(m_Cmd); }
+
+	CGpuProfileScope(const CGpuProfileScope &) = delete;
+	CGpuProfileScope &operator=(const CGpuProfileScope &) = delete;
+};
+
+} // namespace sps
+
+#ifdef SUPERSDL_PROFILER
+#define SPS_PROFILE_GPU_SCOPE(Profiler, Cmd, Name) ::sps::CGpuProfileScope SPS_PROFILE_CONCAT(SpsGpuProfileScope, __LINE__)(Profiler, Cmd, Name)
+#else
+#define SPS_PROFILE_GPU_SCOPE(Profiler, Cmd, Name) (void)0
+#endif
+
+#endif
@@ -0,0 +1,244 @@
+#ifndef SUPERSDL_GPU_RESOURCES_HPP
+#define SUPERSDL_GPU_RESOURCES_HPP
+
+#include "SuperSDL/gpu_allocator.hpp"
+#include "SuperSDL/loggable.hpp"
+#include "SuperSDL/shader.hpp"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+
+namespace sps {
+
+// Refers to a resource of a CResourcePool. Generations start at 1, so a
+// default constructed handle is never valid, and the handles of a destroyed
+// resource stay invalid when its slot is reused.
+template <typename Tag>
+struct ResourceHandle {
+	uint32_t m_Index = 0;
+	uint32_t m_Generation = 0;
+
+	explicit operator bool() const { return m_Generation != 0; }
+	bool operator==(const ResourceHandle &Other) const { return m_Index == Other.m_Index && m_Generation == Other.m_Generation; }
+	bool operator!=(const ResourceHandle &Other) const { return !(*this == Other); }
+};
+
+using BufferHandle = ResourceHandle<struct BufferTag>;
+using ImageHandle = ResourceHandle<struct ImageTag>;
+using PipelineHandle = ResourceHandle<struct PipelineTag>;
+using ShaderHandle = ResourceHandle<struct ShaderTag>;
+
+struct GpuBuffer {
+	std::string m_Name;
+	vk::Buffer m_Buffer;
+	GpuAllocation m_Memory;
+	vk::DeviceSize m_Size = 0;
+};
+
+struct GpuImage {
+	std::string m_Name;
+	vk::Image m_Image;
+	vk::ImageView m_View;
+	GpuAllocation m_Memory;
+	vk::Extent3D m_Extent;
+	vk::Format m_Format = vk::Format::eUndefined;
+};
+
+struct GpuPipeline {
+	std::string m_Name;
+	vk::Pipeline m_Pipeline;
+};
+
+struct GpuShader {
+	std::string m_Name;
+	vk::ShaderModule m_Module;
+};
+
+// Slots of T addressed by generational handles.
+template <typename T, typename Tag>
+class CResourcePool {
+  private:
+	struct Slot {
+		T m_Resource;
+		uint32_t m_Generation = 0;
+		bool m_Alive = false;
+	};
+
+	std::vector<Slot> m_Slots;
+	std::vector<uint32_t> m_FreeSlots;
+	uint32_t m_Count = 0;
+
+  public:
+	using Handle = ResourceHandle<Tag>;
+
+	Handle add(T Resource) {
+		uint32_t Index;
+		if (!m_FreeSlots.empty()) {
+			Index = m_FreeSlots.back();
+			m_FreeSlots.pop_back();
+		} else {
+			Index = static_cast<uint32_t>(m_Slots.size());
+			m_Slots.emplace_back();
+		}
+
+		Slot &S = m_Slots[Index];
+		// Skips 0 when it wraps around.
+		if (++S.m_Generation == 0)
+			S.m_Generation = 1;
+		S.m_Resource = std::move(Resource);
+		S.m_Alive = true;
+		m_Count++;
+		return Handle{Index, S.m_Generation};
+	}
+
+	// Null for stale handles.
+	T *get(Handle H) {
+		if (H.m_Index >= m_Slots.size())
+			return nullptr;
+		Slot &S = m_Slots[H.m_Index];
+		return S.m_Alive && S.m_Generation == H.m_Generation ? &S.m_Resource : nullptr;
+	}
+	const T *get(Handle H) const { return const_cast<CResourcePool *>(this)->get(H); }
+
+	// Moves the resource out, returns false for stale handles.
+	bool remove(Handle H, T &Resource) {
+		T *pResource = get(H);
+		if (!pResource)
+			return false;
+		Resource = std::move(*pResource);
+		*pResource = T();
+		m_Slots[H.m_Index].m_Alive = false;
+		m_FreeSlots.push_back(H.m_Index);
+		m_Count--;
+		return true;
+	}
+
+	// Calls Fn(T &) for every live resource.
+	template <typename F>
+	void forEach(F &&Fn) {
+		for (Slot &S : m_Slots) {
+			if (S.m_Alive)
+				Fn(S.m_Resource);
+		}
+	}
+
+	void clear() {
+		m_Slots.clear();
+		m_FreeSlots.clear();
+		m_Count = 0;
+	}
+
+	uint32_t getCount() const { return m_Count; }
+};
+
+struct GpuResourceStats {
+	uint32_t m_Buffers = 0;
+	uint32_t m_Images = 0;
+	uint32_t m_Pipelines = 0;
+	uint32_t m_Shaders = 0;
+	// Objects waiting for the frames that may use them.
+	uint32_t m_PendingDestroys = 0;
+	uint64_t m_Destroyed = 0;
+	// Lookups and destroys with handles that were no longer valid.
+	uint64_t m_StaleHandles = 0;
+};
+
+/*
+ * Owns buffers, images, pipelines and shaders behind generational handles
+ * and destroys Vulkan objects without waiting for the device. Destroying
+ * invalidates the handle right away, the objects themselves are queued
+ * with the frame being recorded and freed once the fences of that frame and
+ * every earlier one have signaled.
+ *
+ * Resources still alive at quit() are reported as leaks. All methods must
+ * be called by the thread that runs the renderer.
+ */
+class CGpuResources : CLoggable {
+  private:
+	struct Garbage {
+		// The last frame that may use the object.
+		uint64_t m_Frame;
+		vk::ObjectType m_Type;
+		uint64_t m_Object;
+		GpuAllocation m_Memory;
+	};
+
+	vk::Device m_Device;
+	CGpuAllocator *m_pAllocator;
+	uint64_t m_Frame;
+
+	CResourcePool<GpuBuffer, BufferTag> m_Buffers;
+	CResourcePool<GpuImage, ImageTag> m_Images;
+	CResourcePool<GpuPipeline, PipelineTag> m_Pipelines;
+	CResourcePool<GpuShader, ShaderTag> m_Shaders;
+	// In frame order.
+	std::deque<Garbage> m_Garbage;
+	std::function<void(vk::ImageView)> m_ViewRetired;
+	mutable GpuResourceStats m_Stats;
+
+	void queue(vk::ObjectType Type, uint64_t Object, GpuAllocation Memory);
+	void destroyNow(Garbage &Garbage);
+
+	template <typename T, typename Tag>
+	const T *lookup(const CResourcePool<T, Tag> &Pool, ResourceHandle<Tag> Handle) const {
+		const T *pResource = Pool.get(Handle);
+		if (!pResource && Handle)
+			m_Stats.m_StaleHandles++;
+		return pResource;
+	}
+
+  public:
+	CGpuResources();
+
+	void init(vk::Device Device, CGpuAllocator *pAllocator);
+	// The device must be idle. Reports and destroys whatever is left.
+	void quit();
+
+	// Called by the renderer once the frame slot is free. Frame is the one
+	// being recorded, everything before FirstUnfinished is done on the GPU.
+	void beginFrame(uint64_t Frame, uint64_t FirstUnfinished);
+
+	// Throw if the objects can't be created.
+	BufferHandle createBuffer(const std::string &Name, vk::DeviceSize Size, vk::BufferUsageFlags Usage, vk::MemoryPropertyFlags Required, vk::MemoryPropertyFlags Preferred = {});
+	// Device local, with a view of the whole image.
+	ImageHandle createImage(const std::string &Name, const vk::ImageCreateInfo &Info, vk::ImageAspectFlags Aspect = vk::ImageAspectFlagBits::eColor);
+	ShaderHandle createShader(const EmbeddedShader &Shader);
+	PipelineHandle createPipeline(const std::string &Name, const vk::GraphicsPipelineCreateInfo &Info, vk::PipelineCache Cache = {});
+
+	// Invalidate the handle, the objects are destroyed once no frame in
+	// flight can use them. Stale handles are ignored.
+	void destroy(BufferHandle Handle);
+	void destroy(ImageHandle Handle);
+	void destroy(PipelineHandle Handle);
+	void destroy(ShaderHandle Handle);
+
+	// Null for stale handles.
+	const GpuBuffer *get(BufferHandle Handle) const { return lookup(m_Buffers, Handle); }
+	const GpuImage *get(ImageHandle Handle) const { return lookup(m_Images, Handle); }
+	const GpuPipeline *get(PipelineHandle Handle) const { return lookup(m_Pipelines, Handle); }
+	const GpuShader *get(ShaderHandle Handle) const { return lookup(m_Shaders, Handle); }
+
+	// Defers destroying an object that isn't owned by a pool, and freeing
+	// its memory if it has any.
+	template <typename T>
+	void destroyLater(T Object, GpuAllocation Memory = GpuAllocation()) {
+		if (Object)
+			queue(T::objectType, uint64_t(static_cast<typename T::CType>(Object)), Memory);
+	}
+
+	// Called with every image view queued for destruction, pooled or not.
+	// Its handle may belong to another view once it's gone, so caches keyed
+	// by view handles drop their entries here.
+	void setViewRetiredCallback(std::function<void(vk::ImageView)> Callback) { m_ViewRetired = std::move(Callback); }
+
+	const GpuResourceStats &getStats() const;
+};
+
+} // namespace sps
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef SUPERSDL_INPUT_HPP
+#define SUPERSDL_INPUT_HPP
+
+#include "SuperSDL/loggable.hpp"
+#include "SuperSDL/spsc_queue.hpp"
+#include <SDL_events.h>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+
+namespace sps {
+
+// The input since the last fixed update. Built once per frame and never
+// changed after, any thread may read it while the update runs. Presses,
+// releases, motion and text add up over frames until an update consumed
+// them, so each one is seen by exactly one update.
+struct InputSnapshot {
+	// Counts the snapshots, starting at 1.
+	uint64_t m_Sequence = 0;
+	// Sampled at, and how old the oldest event in it was then, in seconds.
+	std::chrono::steady_clock::time_point m_Time;
+	double m_OldestEvent = 0.0;
+
+	// By scancode. A key pressed and released before an update is in both
+	// pressed and released, but not down. Repeats don't count as presses.
+	std::bitset<SDL_NUM_SCANCODES> m_KeysDown;
+	std::bitset<SDL_NUM_SCANCODES> m_KeysPressed;
+	std::bitset<SDL_NUM_SCANCODES> m_KeysReleased;
+
+	// In window pixels, the delta is the sum of every motion since the last
+	// update.
+	glm::vec2 m_MousePosition = glm::vec2(0.0f);
+	glm::vec2 m_MouseDelta = glm::vec2(0.0f);
+	glm::vec2 m_Wheel = glm::vec2(0.0f);
+	// SDL_BUTTON() masks.
+	uint32_t m_ButtonsDown = 0;
+	uint32_t m_ButtonsPressed = 0;
+	uint32_t m_ButtonsReleased = 0;
+
+	// UTF-8 text typed since the last update.
+	std::string m_Text;
+	bool m_Focused = true;
+	bool m_QuitRequested = false;
+
+	bool isDown(SDL_Scancode Key) const { return m_KeysDown[Key]; }
+	bool wasPressed(SDL_Scancode Key) const { return m_KeysPressed[Key]; }
+	bool wasReleased(SDL_Scancode Key) const { return m_KeysReleased[Key]; }
+	bool isButtonDown(uint8_t Button) const { return m_ButtonsDown & SDL_BUTTON(Button); }
+	bool wasButtonPressed(uint8_t Button) const { return m_ButtonsPressed & SDL_BUTTON(Button); }
+	bool wasButtonReleased(uint8_t Button) const { return m_ButtonsReleased & SDL_BUTTON(Button); }
+};
+
+struct InputStats {
+	uint64_t m_Events = 0;
+	// Motion events folded into the one before them.
+	uint64_t m_MergedMotions = 0;
+	// Pumps that left events in SDL's queue for later because ours was full.
+	uint64_t m_Deferred = 0;
+	// Worst m_OldestEvent so far.
+	double m_MaxEventAge = 0.0;
+};
+
+/*
+ * Moves SDL events into input snapshots.
+ *
+ * pump() drains SDL's queue into a lock-free queue, it must run on the thread
+ * that owns the window, which SDL requires of event pumping. update() folds
+ * whatever is queued into the next snapshot and publishes it, on one other
+ * thread at most, or the same one. CGame calls both right before the fixed
+ * updates, after waiting for the GPU, so the snapshot is as fresh as it can
+ * be when the simulation reads it, and consume() after each fixed update.
+ *
+ * Snapshots are double buffered. update() and consume() both publish into
+ * the other buffer, so the published snapshot stays valid and unchanged
+ * through one more call of either and is overwritten by the second. CGame
+ * consumes after every fixed update, keep a reference for one fixed update
+ * at most and copy what must last longer.
+ */
+class CInput : CLoggable {
+  private:
+	static constexpr size_t QueueSize = 1024;
+	// Events taken out of SDL's queue at a time.
+	static constexpr int PumpBatch = 64;
+
+	CSpscQueue<SDL_Event> m_Events;
+	std::array<InputSnapshot, 2> m_aSnapshots;
+	uint32_t m_Current;
+	std::atomic<uint64_t> m_Deferred;
+	InputStats m_Stats;
+
+	void apply(InputSnapshot &Snapshot, const SDL_Event &Event, bool &Moved);
+	// Next starts out as the published snapshot, with or without its edges.
+	InputSnapshot &beginSnapshot(bool KeepEdges);
+
+  public:
+	CInput();
+
+	// Owner of the window only.
+	void pump();
+	// Builds and publishes the next snapshot, the presses, releases, motion
+	// and text of the current one carry over.
+	void update();
+	// Publishes a snapshot without presses, releases, motion or text, once an
+	// update has seen them. Same thread as update().
+	void consume();
+
+	// Overwritten by the second update() or consume() after this call.
+	const InputSnapshot &snapshot() const { return m_aSnapshots[m_Current]; }
+	const InputStats &getStats() const { return m_Stats; }
+};
+
+} // namespace sps
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef SUPERSDL_JOB_SYSTEM_HPP
+#define SUPERSDL_JOB_SYSTEM_HPP
+
+#include "SuperSDL/loggable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sps {
+
+class CJobSystem;
+struct Job;
+
+// Counts unfinished jobs. Jobs can be scheduled to run once a counter reached
+// zero, and threads can wait on it while helping with other jobs.
+class CJobCounter {
+  private:
+	friend class CJobSystem;
+
+	std::atomic<uint32_t> m_Pending;
+	mutable std::mutex m_Mutex;
+	// Jobs waiting for this counter, linked through Job::m_pNext.
+	mutable Job *m_pDependents;
+
+  public:
+	CJobCounter() : m_Pending(0), m_pDependents(nullptr) {}
+	CJobCounter(const CJobCounter &) = delete;
+	CJobCounter &operator=(const CJobCounter &) = delete;
+
+	// Use CJobSystem::wait() before destroying the counter, the thread that
+	// released it may still be touching it.
+	bool isDone() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job {
+	static constexpr size_t StorageSize = 96;
+
+	void (*m_pRun)(void *pStorage);
+	CJobCounter *m_pCounter;
+	Job *m_pNext;
+	// Set while the slot holds a job that hasn't finished.
+	std::atomic<bool> m_Busy;
+	alignas(std::max_align_t) unsigned char m_aStorage[StorageSize];
+};
+
+/*
+ * Work-stealing scheduler with one worker per core.
+ *
+ * Every worker, and the thread that called init(), owns a Chase-Lev deque:
+ * the owner pushes and pops at the bottom without locking and idle threads
+ * steal from the top of a random victim. Job objects come from a ring per
+ * thread, so scheduling doesn't allocate. Idle workers sleep until new jobs
+ * are pushed.
+ *
+ * Only the init() thread and the workers can schedule jobs, other threads
+ * run them inline.
+ */
+class CJobSystem : CLoggable {
+  private:
+	static constexpr uint32_t QueueCapacity = 4096;
+	static constexpr uint32_t JobsPerThread = 4096;
+
+	class CDeque {
+	  private:
+		std::atomic<int64_t> m_Top;
+		std::atomic<int64_t> m_Bottom;
+		std::unique_ptr<std::atomic<Job *>[]> m_pJobs;
+
+	  public:
+		CDeque();
+		// Owner only.
+		bool push(Job *pJob);
+		Job *pop();
+		// Any thread.
+		Job *steal();
+	};
+
+	struct Worker {
+		CDeque m_Queue;
+		std::unique_ptr<Job[]> m_pJobs;
+		uint32_t m_NextJob = 0;
+		uint32_t m_Index = 0;
+		uint64_t m_Random = 0;
+		std::thread m_Thread;
+	};
+
+	// Index 0 is the thread that called init().
+	std::vector<std::unique_ptr<Worker>> m_Workers;
+	std::atomic<bool> m_Stop;
+
+	// Jobs pushed and not taken yet, lets workers go to sleep.
+	std::atomic<int64_t> m_Queued;
+	std::atomic<uint32_t> m_Sleeping;
+	std::mutex m_WakeMutex;
+	std::condition_variable m_WakeCondition;
+
+	Worker *currentWorker() const;
+	Job *allocateJob(Worker &Worker);
+	void submit(Job *pJob, const CJobCounter *pDependency);
+	void push(Worker &Worker, Job *pJob);
+	Job *findJob(Worker &Worker);
+	void execute(Job *pJob);
+	void workerLoop(Worker *pWorker);
+
+	template <typename F>
+	static void runStored(void *pStorage) {
+		F *pFn = static_cast<F *>(pStorage);
+		(*pFn)();
+		pFn->~F();
+	}
+
+  public:
+	// Starts one worker per core besides the calling thread.
+	static constexpr uint32_t AutoWorkers = UINT32_MAX;
+
+	CJobSystem();
+	~CJobSystem();
+
+	// WorkerThreads excludes the calling thread, with 0 every job runs on it.
+	void init(uint32_t WorkerThreads = AutoWorkers);
+	void quit();
+
+	// Threads running jobs, including the one that called init().
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+	// Index of the calling thread in [0, getThreadCount()), 0 for the init()
+	// thread and UINT32_MAX for threads that aren't ours.
+	uint32_t getThreadIndex() const;
+
+	// Runs Fn on some thread. pCounter, if given, is incremented now and
+	// decremented once Fn returned. With pDependency the job only starts
+	// after that counter reached zero.
+	template <typename F>
+	void schedule(F &&Fn, CJobCounter *pCounter = nullptr, const CJobCounter *pDependency = nullptr);
+
+	// Helps running jobs until the counter reaches zero.
+	void wait(const CJobCounter &Counter);
+
+	// Calls Fn(Begin, End) on chunks of [Begin, End) and waits for all of them.
+	// Grain is the smallest chunk, 0 picks a few chunks per thread.
+	template <typename F>
+	void parallelFor(uint32_t Begin, uint32_t End, F &&Fn, uint32_t Grain = 0);
+};
+
+template <typename F>
+void CJobSystem::schedule(F &&Fn, CJobCounter *pCounter, const CJobCounter *pDependency) {
+	using Func = std::decay_t<F>;
+	static_assert(sizeof(Func) <= Job::StorageSize, "job captures too much, capture a pointer instead");
+	static_assert(alignof(Func) <= alignof(std::max_align_t), "job capture is over-aligned");
+
+	Worker *pWorker = currentWorker();
+	if (!pWorker) {
+		// Not one of ours, we have no queue to push to.
+		if (pDependency)
+			wait(*pDependency);
+		Fn();
+		return;
+	}
+
+	if (pCounter)
+		pCounter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+
+	Job *pJob = allocateJob(*pWorker);
+	new (pJob->m_aStorage) Func(std::forward<F>(Fn));
+	pJob->m_pRun = &runStored<Func>;
+	pJob->m_pCounter = pCounter;
+	pJob->m_pNext = nullptr;
+	submit(pJob, pDependency);
+}
+
+template <typename F>
+void CJobSystem::parallelFor(uint32_t Begin, uint32_t End, F &&Fn, uint32_t Grain) {
+	if (Begin >= End)
+		return;
+
+	uint32_t Count = End - Begin;
+	uint32_t Threads = getThreadCount();
+	if (Grain == 0)
+		Grain = std::max(1u, Count / std::max(1u, Threads * 4));
+	if (Count <= Grain || Threads <= 1 || !currentWorker()) {
+		Fn(Begin, End);
+		return;
+	}
+
+	CJobCounter Counter;
+	for (uint32_t First = Begin, Last; First < End; First = Last) {
+		Last = First + std::min(Grain, End - First);
+		schedule([&Fn, First, Last]() { Fn(First, Last); }, &Counter);
+	}
+	wait(Counter);
+}
+
+} // namespace sps
+
+#endif
@@ -1,22 +1,103 @@
 #ifndef SUPERSDL_LOGGABLE_HPP
 #define SUPERSDL_LOGGABLE_HPP
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <spdlog/logger.h>
 
+// Levels below this are compiled out of the SPS_LOG_* macros, uses the
+// SPDLOG_LEVEL_* values.
+#ifndef SUPERSDL_LOG_LEVEL
+#ifdef NDEBUG
+#define SUPERSDL_LOG_LEVEL SPDLOG_LEVEL_INFO
+#else
+#define SUPERSDL_LOG_LEVEL SPDLOG_LEVEL_DEBUG
+#endif
+#endif
+
 namespace sps {
 
+/*
+ * Every loggable class gets its own named logger, all of them write to one
+ * shared sink.
+ *
+ * By default the sink writes synchronously. In async mode a call only copies
+ * the formatted message into a lock-free ring buffer and a background thread
+ * writes it out, so logging from the frame loop never waits on the console.
+ * When the ring is full messages are dropped and counted instead of blocking.
+ */
 class CLoggable {
   private:
 	std::shared_ptr<spdlog::logger> m_Logger;
 
   protected:
-	auto Log() const { return m_Logger; }
+	// A plain pointer, returning the shared_ptr would touch its refcount on every call.
+	spdlog::logger *Log() const { return m_Logger.get(); }
 
   public:
 	CLoggable(const char *pName);
+
+	// Starts or stops the background writer. Stopping writes whatever is
+	// still queued, call it while no other thread is logging.
+	static void setAsyncLogging(bool Async);
+	static bool isAsyncLogging();
+	// Blocks until everything logged so far was written.
+	static void flushLogs();
+	// Messages lost because the ring buffer was full.
+	static uint64_t getDroppedLogs();
+	// Where the shared sink writes, the console unless set. Null goes back
+	// to the console. Call it while async logging is off.
+	static void setLogTarget(spdlog::sink_ptr pTarget);
+};
+
+// Lets one message through per interval and counts the ones it held back.
+class CLogRateLimit {
+  private:
+	int64_t m_Interval;
+	std::atomic<int64_t> m_Next;
+	std::atomic<uint32_t> m_Suppressed;
+
+  public:
+	explicit CLogRateLimit(double Seconds);
+	// Suppressed is set to the number of messages held back since the last one.
+	bool allow(uint32_t &Suppressed);
 };
 
 } // namespace sps
 
+// Stripped calls are still compiled but never run, so the arguments are
+// checked and values only computed for the message don't warn as unused.
+#if SUPERSDL_LOG_LEVEL <= SPDLOG_LEVEL_TRACE
+#define SPS_LOG_TRACE(...) Log()->trace(__VA_ARGS__)
+#else
+#define SPS_LOG_TRACE(...)              \
+	do {                                \
+		if (false)                      \
+			Log()->trace(__VA_ARGS__);  \
+	} while (0)
+#endif
+
+#if SUPERSDL_LOG_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define SPS_LOG_DEBUG(...) Log()->debug(__VA_ARGS__)
+#else
+#define SPS_LOG_DEBUG(...)              \
+	do {                                \
+		if (false)                      \
+			Log()->debug(__VA_ARGS__);  \
+	} while (0)
+#endif
+
+// For messages that can fire every frame, Level is a logger method such as warn.
+#define SPS_LOG_RATE_LIMITED(Level, Seconds, ...)                                         \
+	do {                                                                                  \
+		static ::sps::CLogRateLimit SpsLogRateLimit(Seconds);                             \
+		uint32_t SpsLogSuppressed;                                                        \
+		if (SpsLogRateLimit.allow(SpsLogSuppressed)) {                                    \
+			Log()->Level(__VA_ARGS__);                                                    \
+			if (SpsLogSuppressed)                                                         \
+				Log()->Level("({} similar messages suppressed)", SpsLogSuppressed);       \
+		}                                                                                 \
+	} while (0)
+
 #endif
@@ -0,0 +1,211 @@
+#ifndef SUPERSDL_MEMORY_HPP
+#define SUPERSDL_MEMORY_HPP
+
+#include "SuperSDL/loggable.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace sps {
+
+class CJobSystem;
+
+// Heap allocations made through operator new, by any thread. malloc() isn't
+// counted.
+struct HeapCounters {
+	uint64_t m_Allocations = 0;
+	uint64_t m_Bytes = 0;
+};
+
+// False when built without SUPERSDL_TRACK_ALLOCATIONS, the counters then
+// stay at 0.
+bool isTrackingHeap();
+// Totals since the process started.
+HeapCounters getHeapCounters();
+
+/*
+ * Bump allocator as a memory resource, for std::pmr containers. Allocating
+ * moves a pointer, deallocating does nothing and reset() frees everything at
+ * once.
+ *
+ * Allocations that don't fit the block go to overflow blocks from the heap,
+ * which reset() frees after growing the block to what was used in total, so
+ * a steady workload stops touching the heap after its first round.
+ *
+ * Not thread safe, see CFrameMemory for one per thread.
+ */
+class CLinearArena : public std::pmr::memory_resource {
+  private:
+	static constexpr size_t MinOverflowBlock = 64 << 10;
+
+	struct OverflowBlock {
+		OverflowBlock *m_pNext;
+		size_t m_Size;
+	};
+
+	unsigned char *m_pBlock;
+	size_t m_Capacity;
+	size_t m_Used;
+	OverflowBlock *m_pOverflow;
+	unsigned char *m_pOverflowHead;
+	size_t m_OverflowLeft;
+	size_t m_OverflowUsed;
+	size_t m_Peak;
+	uint64_t m_Overflows;
+
+	void *allocateOverflow(size_t Bytes, size_t Alignment);
+
+  protected:
+	void *do_allocate(size_t Bytes, size_t Alignment) override;
+	void do_deallocate(void *pData, size_t Bytes, size_t Alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource &Other) const noexcept override { return this == &Other; }
+
+  public:
+	explicit CLinearArena(size_t Capacity = 0);
+	~CLinearArena();
+	CLinearArena(const CLinearArena &) = delete;
+	CLinearArena &operator=(const CLinearArena &) = delete;
+
+	// Invalidates everything allocated since the last reset.
+	void reset();
+
+	// Bytes handed out since the last reset, padding included.
+	size_t getUsed() const { return m_Used + m_OverflowUsed; }
+	size_t getCapacity() const { return m_Capacity; }
+	// Most used between two resets.
+	size_t getPeak() const { return m_Peak; }
+	// Overflow blocks taken from the heap so far.
+	uint64_t getOverflows() const { return m_Overflows; }
+};
+
+/*
+ * Fixed-size objects recycled through a free list. Memory comes in chunks of
+ * ChunkSize objects that are kept until the pool is destroyed, so once the
+ * pool grew to the most objects alive at a time, creating one doesn't touch
+ * the heap. Objects keep their address for their whole life.
+ *
+ * Not thread safe. Every object must be destroyed before the pool is.
+ */
+template <typename T>
+class CObjectPool {
+  private:
+	union Slot {
+		Slot *m_pNext;
+		alignas(T) unsigned char m_aStorage[sizeof(T)];
+	};
+
+	std::vector<std::unique_ptr<Slot[]>> m_Chunks;
+	Slot *m_pFree;
+	uint32_t m_ChunkSize;
+	size_t m_Alive;
+
+	void grow() {
+		m_Chunks.push_back(std::make_unique<Slot[]>(m_ChunkSize));
+		Slot *pChunk = m_Chunks.back().get();
+		for (uint32_t i = m_ChunkSize; i-- > 0;) {
+			pChunk[i].m_pNext = m_pFree;
+			m_pFree = &pChunk[i];
+		}
+	}
+
+  public:
+	explicit CObjectPool(uint32_t ChunkSize = 64) : m_pFree(nullptr), m_ChunkSize(ChunkSize > 0 ? ChunkSize : 1), m_Alive(0) {}
+	CObjectPool(const CObjectPool &) = delete;
+	CObjectPool &operator=(const CObjectPool &) = delete;
+
+	template <typename... Args>
+	T *create(Args &&...Arguments) {
+		if (!m_pFree)
+			grow();
+		Slot *pSlot = m_pFree;
+		// The object overwrites the link.
+		Slot *pNext = pSlot->m_pNext;
+		T *pObject = new (pSlot->m_aStorage) T(std::forward<Args>(Arguments)...);
+		m_pFree = pNext;
+		m_Alive++;
+		return pObject;
+	}
+
+	void destroy(T *pObject) {
+		if (!pObject)
+			return;
+		pObject->~T();
+		Slot *pSlot = reinterpret_cast<Slot *>(pObject);
+		pSlot->m_pNext = m_pFree;
+		m_pFree = pSlot;
+		m_Alive--;
+	}
+
+	// Makes room for Count objects alive at a time.
+	void reserve(size_t Count) {
+		while (getCapacity() < Count)
+			grow();
+	}
+
+	size_t getAlive() const { return m_Alive; }
+	size_t getCapacity() const { return m_Chunks.size() * m_ChunkSize; }
+};
+
+struct MemoryStats {
+	uint64_t m_Frames = 0;
+	// Heap allocations through operator new during the last frame, by every
+	// thread. Zero once the game reached a steady state, unless its own code
+	// allocates.
+	uint64_t m_FrameAllocations = 0;
+	uint64_t m_FrameBytes = 0;
+	uint64_t m_MaxFrameAllocations = 0;
+	// Frames in a row up to the last one without a heap allocation.
+	uint64_t m_QuietFrames = 0;
+	// Summed over the frame arenas of all threads.
+	size_t m_ArenaUsed = 0;
+	size_t m_ArenaPeak = 0;
+	size_t m_ArenaCapacity = 0;
+	uint64_t m_ArenaOverflows = 0;
+};
+
+/*
+ * Scratch memory that lives until the end of the frame, one CLinearArena
+ * per job system thread so recording jobs allocate without locking. Engine
+ * code builds its per-frame containers in it instead of on the heap.
+ *
+ * endFrame() resets every arena, so it must run while no job uses them, and
+ * nothing allocated from them may be kept past it. Jobs that span frames,
+ * like asset decoding, must use the heap.
+ *
+ * Also counts the heap allocations of each frame, see MemoryStats.
+ */
+class CFrameMemory : CLoggable {
+  public:
+	// Initial size of each arena, they grow to what a frame needs.
+	static constexpr size_t ArenaSize = 256 << 10;
+
+  private:
+	// Indexed by CJobSystem::getThreadIndex().
+	std::vector<std::unique_ptr<CLinearArena>> m_Arenas;
+	CJobSystem *m_pJobs;
+	HeapCounters m_FrameStart;
+	MemoryStats m_Stats;
+
+  public:
+	CFrameMemory();
+
+	// After the job system started.
+	void init(CJobSystem *pJobs);
+	void quit();
+
+	// The calling thread's arena, throws for threads that aren't the job
+	// system's.
+	CLinearArena &arena();
+	// Resets the arenas and records the frame's heap allocations.
+	void endFrame();
+
+	const MemoryStats &getStats() const { return m_Stats; }
+};
+
+} // namespace sps
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef SUPERSDL_PROFILER_HPP
+#define SUPERSDL_PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sps {
+
+/*
+ * Collects timed scopes from any thread and exports them as a Chrome
+ * trace_event file (chrome://tracing, Perfetto).
+ *
+ * Every thread writes into its own ring buffer, so recording a scope is a
+ * couple of clock reads and stores without any lock or atomic RMW. The
+ * registry lock is only taken the first time a thread records something.
+ * When the ring of a thread is full the oldest events are overwritten.
+ *
+ * Scopes are recorded through the SPS_PROFILE_* macros, which compile to
+ * nothing unless SUPERSDL_PROFILER is defined.
+ */
+class CProfiler {
+  public:
+	struct Event {
+		// Must outlive the profiler, usually a string literal.
+		const char *m_pName;
+		uint64_t m_Start;
+		uint64_t m_Duration;
+	};
+
+	// Events of one thread, or of a virtual track such as the GPU.
+	struct Track {
+		static constexpr uint32_t Capacity = 1 << 16;
+
+		std::string m_Name;
+		uint32_t m_Id;
+		std::unique_ptr<Event[]> m_pEvents;
+		std::atomic<uint64_t> m_Head;
+
+		void push(const char *pName, uint64_t Start, uint64_t Duration) {
+			uint64_t Head = m_Head.load(std::memory_order_relaxed);
+			m_pEvents[Head % Capacity] = {pName, Start, Duration};
+			m_Head.store(Head + 1, std::memory_order_release);
+		}
+	};
+
+  private:
+	std::atomic<bool> m_Enabled;
+	std::chrono::steady_clock::time_point m_Epoch;
+
+	std::mutex m_TracksMutex;
+	std::vector<std::unique_ptr<Track>> m_Tracks;
+
+	CProfiler();
+	Track *createTrack(std::string Name);
+
+  public:
+	static CProfiler &get();
+
+	void setEnabled(bool Enabled) { m_Enabled.store(Enabled, std::memory_order_relaxed); }
+	bool isEnabled() const { return m_Enabled.load(std::memory_order_relaxed); }
+
+	// Nanoseconds since the profiler was created.
+	uint64_t now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Epoch).count();
+	}
+
+	// The track of the calling thread, created on first use.
+	Track &threadTrack();
+	// Names the calling thread in the exported trace.
+	void setThreadName(const char *pName);
+	// A track that isn't bound to a thread, only one thread may write to it.
+	Track *addTrack(const char *pName);
+
+	// Writes everything recorded so far. Returns false if the file couldn't be written.
+	bool exportChromeTrace(const std::string &Path);
+};
+
+class CProfileScope {
+  private:
+	const char *m_pName;
+	uint64_t m_Start;
+
+  public:
+	explicit CProfileScope(const char *pName) {
+		CProfiler &Profiler = CProfiler::get();
+		m_pName = Profiler.isEnabled() ? pName : nullptr;
+		if (m_pName)
+			m_Start = Profiler.now();
+	}
+
+	~CProfileScope() {
+		if (m_pName) {
+			CProfiler &Profiler = CProfiler::get();
+			uint64_t End = Profiler.now();
+			Profiler.threadTrack().push(m_pName, m_Start, End - m_Start);
+		}
+	}
+
+	CProfileScope(const CProfileScope &) = delete;
+	CProfileScope &operator=(const CProfileScope &) = delete;
+};
+
+} // namespace sps
+
+#define SPS_PROFILE_CONCAT_IMPL(a, b) a##b
+#define SPS_PROFILE_CONCAT(a, b) SPS_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef SUPERSDL_PROFILER
+#define SPS_PROFILE_SCOPE(Name) ::sps::CProfileScope SPS_PROFILE_CONCAT(SpsProfileScope, __LINE__)(Name)
+#define SPS_PROFILE_THREAD(Name) ::sps::CProfiler::get().setThreadName(Name)
+#else
+#define SPS_PROFILE_SCOPE(Name) (void)0
+#define SPS_PROFILE_THREAD(Name) (void)0
+#endif
+
+#endif
@@ -0,0 +1,296 @@
+#ifndef SUPERSDL_RENDER_GRAPH_HPP
+#define SUPERSDL_RENDER_GRAPH_HPP
+
+#include "SuperSDL/gpu_allocator.hpp"
+#include "SuperSDL/loggable.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+
+namespace sps {
+
+class CRenderer;
+
+enum ERenderGraphPass {
+	// Draws to attachments, consecutive ones may share a render pass.
+	RENDER_GRAPH_GRAPHICS = 0,
+	RENDER_GRAPH_COMPUTE,
+	RENDER_GRAPH_TRANSFER,
+};
+
+// How a pass uses an image, which decides its layout and the stages and
+// accesses barriers wait for.
+enum ERenderGraphUsage {
+	// Attachments, graphics passes only. Written attachments keep what was
+	// in them unless the pass clears them.
+	RENDER_GRAPH_COLOR = 0,
+	RENDER_GRAPH_DEPTH,
+	// Depth tested against but not written.
+	RENDER_GRAPH_DEPTH_READ,
+	// Read at the fragment's own pixel, lets the writer share a render pass.
+	RENDER_GRAPH_INPUT,
+	// Sampled by graphics or compute shaders.
+	RENDER_GRAPH_SAMPLED,
+	// Read and written by compute shaders.
+	RENDER_GRAPH_STORAGE,
+	// Transfer passes only.
+	RENDER_GRAPH_TRANSFER_SRC,
+	RENDER_GRAPH_TRANSFER_DST,
+	NUM_RENDER_GRAPH_USAGES
+};
+
+// Refers to an image declared this frame.
+struct RenderGraphImage {
+	uint32_t m_Index = UINT32_MAX;
+
+	explicit operator bool() const { return m_Index != UINT32_MAX; }
+};
+
+struct RenderGraphImageDesc {
+	vk::Format m_Format = vk::Format::eR8G8B8A8Unorm;
+	vk::Extent2D m_Extent;
+	vk::SampleCountFlagBits m_Samples = vk::SampleCountFlagBits::e1;
+};
+
+// What a pass records with.
+struct RenderGraphPassInfo {
+	// Pipelines the pass draws with must be compatible with this subpass of
+	// this render pass. The render pass stays the same for as long as the
+	// graph does. All of it is empty outside graphics passes.
+	vk::RenderPass m_RenderPass;
+	uint32_t m_Subpass = 0;
+	vk::Extent2D m_Extent;
+};
+
+struct RenderGraphStats {
+	uint32_t m_Passes = 0;
+	uint32_t m_CulledPasses = 0;
+	// Render passes begun, and the graphics passes that became a later
+	// subpass of one of them instead of a render pass of their own.
+	uint32_t m_RenderPasses = 0;
+	uint32_t m_MergedPasses = 0;
+	// A barrier before every use of every declared pass, what writing them
+	// by hand without looking at the rest of the frame costs.
+	uint32_t m_NaiveBarriers = 0;
+	// Image barriers recorded, in m_BarrierBatches pipelineBarrier() calls.
+	uint32_t m_ImageBarriers = 0;
+	uint32_t m_BarrierBatches = 0;
+	// Dependencies between the subpasses of merged passes.
+	uint32_t m_SubpassDependencies = 0;
+	uint32_t m_TransientImages = 0;
+	// Memory of the transient images, each with its own and aliased.
+	vk::DeviceSize m_TransientBytes = 0;
+	vk::DeviceSize m_AliasedBytes = 0;
+	// Graphs compiled from scratch, and the time the last one took in seconds.
+	uint32_t m_Compiles = 0;
+	double m_CompileTime = 0.0;
+};
+
+/*
+ * Schedules the frame's offscreen passes. Passes are declared every frame,
+ * in order, with the images they read and write, and the graph works out
+ * the rest when the renderer executes it:
+ *
+ * - Passes whose results nothing uses are culled. What a pass must produce
+ *   is an imported image or a side effect.
+ * - Consecutive graphics passes with the same extent become subpasses of a
+ *   single render pass when the later ones only read the earlier ones'
+ *   attachments as input attachments.
+ * - Barriers and layout transitions are derived from the usages, batched
+ *   per pass and left out where nothing changed, e.g. a second read in the
+ *   same layout.
+ * - Transient images, the ones the graph creates, live from their first to
+ *   their last use and share memory with transient images whose lifetimes
+ *   don't overlap.
+ *
+ * The plan, and the render passes, images and memory it needs, are kept
+ * for as long as the frames declare the same graph. Imported images may
+ * change between frames, only their usages count.
+ *
+ * All methods must be called by the thread that runs the renderer, between
+ * its beginFrame() and endFrame().
+ */
+class CRenderGraph : CLoggable {
+  public:
+	using RecordFunction = std::function<void(vk::CommandBuffer Cmd, const RenderGraphPassInfo &Info)>;
+
+  private:
+	struct Use {
+		uint32_t m_Image;
+		ERenderGraphUsage m_Usage;
+		std::optional<vk::ClearValue> m_Clear;
+	};
+
+	struct PassDecl {
+		std::string m_Name;
+		ERenderGraphPass m_Type;
+		RecordFunction m_Record;
+		// In the frame memory, like every per-frame list of the graph.
+		std::pmr::vector<Use> m_Uses;
+		bool m_SideEffect;
+	};
+
+	struct ImageDecl {
+		std::string m_Name;
+		RenderGraphImageDesc m_Desc;
+		bool m_Imported;
+		vk::Image m_Image;
+		vk::ImageView m_View;
+		vk::ImageLayout m_InitialLayout;
+		vk::ImageLayout m_FinalLayout;
+	};
+
+	struct Barrier {
+		uint32_t m_Image;
+		vk::ImageLayout m_OldLayout;
+		vk::ImageLayout m_NewLayout;
+		vk::AccessFlags m_SrcAccess;
+		vk::AccessFlags m_DstAccess;
+	};
+
+	struct BarrierBatch {
+		vk::PipelineStageFlags m_SrcStages;
+		vk::PipelineStageFlags m_DstStages;
+		std::vector<Barrier> m_Barriers;
+	};
+
+	// A render pass, a compute or transfer pass, or the final transitions.
+	struct Step {
+		BarrierBatch m_Barriers;
+		std::vector<uint32_t> m_Passes;
+		// Graphics steps only.
+		uint32_t m_RenderPass = UINT32_MAX;
+	};
+
+	struct RenderPass {
+		vk::RenderPass m_RenderPass;
+		vk::Extent2D m_Extent;
+		// Images in attachment order, and the pass and use each is first used
+		// by, which has the clear value.
+		std::vector<uint32_t> m_Attachments;
+		std::vector<std::pair<uint32_t, uint32_t>> m_FirstUses;
+	};
+
+	struct TransientImage {
+		vk::ImageCreateInfo m_Info;
+		vk::ImageAspectFlags m_Aspect;
+		vk::MemoryRequirements m_Requirements;
+		// First and last step using it.
+		uint32_t m_First;
+		uint32_t m_Last;
+		// Of all its uses, what the next user of the memory waits for.
+		vk::PipelineStageFlags m_Stages;
+		vk::AccessFlags m_WriteAccess;
+		uint32_t m_Block;
+		vk::DeviceSize m_Offset;
+		vk::Image m_Image;
+		vk::ImageView m_View;
+	};
+
+	// Memory shared by transient images that are never alive together.
+	struct MemoryBlock {
+		vk::DeviceSize m_Size;
+		vk::DeviceSize m_Alignment;
+		uint32_t m_MemoryTypeBits;
+		std::vector<uint32_t> m_Images;
+		GpuAllocation m_Memory;
+	};
+
+	CRenderer *m_pRenderer;
+	vk::Device m_Device;
+
+	// Declared this frame.
+	std::vector<PassDecl> m_Passes;
+	std::vector<ImageDecl> m_Images;
+
+	// The compiled plan, valid while m_Signature matches the declarations.
+	std::vector<uint64_t> m_Signature;
+	std::vector<Step> m_Steps;
+	std::vector<RenderPass> m_RenderPasses;
+	// Per declared image, its transient image or UINT32_MAX.
+	std::vector<uint32_t> m_ImageTransients;
+	std::vector<TransientImage> m_Transients;
+	std::vector<MemoryBlock> m_Blocks;
+	std::vector<uint32_t> m_PassSubpass;
+	// Keyed by render pass and attachment views, imported images change.
+	// Looked up with keys in the frame memory. Entries go with their views,
+	// see forgetView().
+	struct KeyLess {
+		using is_transparent = void;
+		template <typename A, typename B>
+		bool operator()(const A &Left, const B &Right) const {
+			return std::lexicographical_compare(Left.begin(), Left.end(), Right.begin(), Right.end());
+		}
+	};
+	std::map<std::vector<uint64_t>, vk::Framebuffer, KeyLess> m_Framebuffers;
+	RenderGraphStats m_Stats;
+
+	uint32_t addImage(ImageDecl &&Image);
+	std::pmr::memory_resource *frameMemory() const;
+	void computeSignature(std::pmr::vector<uint64_t> &Signature) const;
+	void release();
+	void compile();
+	void cull(std::vector<bool> &Alive);
+	void buildSteps(const std::vector<bool> &Alive);
+	bool canMerge(const Step &Group, uint32_t Pass) const;
+	void createRenderPasses();
+	void planBarriers();
+	void createTransients();
+	void aliasTransients();
+	vk::Framebuffer getFramebuffer(const RenderPass &Pass);
+	void recordBarriers(vk::CommandBuffer Cmd, const BarrierBatch &Batch) const;
+
+  public:
+	CRenderGraph();
+
+	void init(CRenderer *pRenderer);
+	// The device must be idle.
+	void quit();
+
+	// Drops the declarations, which live in frame memory. Called by the
+	// renderer when a frame begins and when it ends, started or not.
+	void reset();
+
+	// Created and owned by the graph, only valid during the frame.
+	RenderGraphImage createImage(const std::string &Name, const RenderGraphImageDesc &Desc);
+	// Owned by the caller. The image is in Initial when the graph starts and
+	// left in Final once the graph is done, which makes it something the
+	// frame produces: passes writing it aren't culled.
+	RenderGraphImage importImage(const std::string &Name, const RenderGraphImageDesc &Desc, vk::Image Image, vk::ImageView View,
+								 vk::ImageLayout Initial, vk::ImageLayout Final);
+
+	// Passes run in the order they are added. Record may be empty.
+	uint32_t addPass(const std::string &Name, ERenderGraphPass Type, RecordFunction Record);
+	// Clear is only used by attachments, which are otherwise loaded.
+	void use(uint32_t Pass, RenderGraphImage Image, ERenderGraphUsage Usage, std::optional<vk::ClearValue> Clear = std::nullopt);
+	// Keeps the pass even if it writes nothing the frame needs, e.g. when it
+	// writes buffers the graph doesn't know of.
+	void setSideEffect(uint32_t Pass) { m_Passes[Pass].m_SideEffect = true; }
+
+	// Only valid while passes record, e.g. to copy from a transient image.
+	vk::Image getImage(RenderGraphImage Image) const;
+	vk::ImageView getView(RenderGraphImage Image) const;
+
+	// Compiles the declarations unless they match the last frame's, and
+	// records them outside of a render pass.
+	void execute(vk::CommandBuffer Cmd);
+
+	// Destroys the framebuffers that use View. The renderer calls it for
+	// every view it retires, a new view may get the same handle.
+	void forgetView(vk::ImageView View);
+
+	bool empty() const { return m_Passes.empty(); }
+	const RenderGraphStats &getStats() const { return m_Stats; }
+};
+
+} // namespace sps
+
+#endif
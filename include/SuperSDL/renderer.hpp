@@ -1,10 +1,27 @@
 #ifndef SUPERSDL_RENDERER_HPP
 #define SUPERSDL_RENDERER_HPP
 
+#include "SuperSDL/asset_streamer.hpp"
 #include "SuperSDL/engine.hpp"
+#include "SuperSDL/gpu_allocator.hpp"
+#include "SuperSDL/gpu_profiler.hpp"
+#include "SuperSDL/gpu_resources.hpp"
 #include "SuperSDL/loggable.hpp"
+#include "SuperSDL/render_graph.hpp"
+#include "SuperSDL/shader.hpp"
+#include "SuperSDL/sprite_batch.hpp"
+#include "SuperSDL/text_renderer.hpp"
+#include "SuperSDL/texture_table.hpp"
 #include "util.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <memory_resource>
 #include <optional>
+#include <string>
+#include <string_view>
 #define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
 #include <vulkan/vulkan.hpp>
 #include <vector>
@@ -12,6 +29,29 @@
 
 namespace sps {
 
+// Intervals between consecutive presents of the current swap chain, in
+// seconds. Measured on the CPU when vkQueuePresentKHR returns, which is when
+// the presentation engine throttles us in FIFO, so it tracks the display
+// rate there and the frame rate in the other modes.
+struct PresentStats {
+	vk::PresentModeKHR m_Mode = vk::PresentModeKHR::eFifo;
+	uint32_t m_ImageCount = 0;
+	uint64_t m_Presents = 0;
+	double m_LastInterval = 0.0;
+	double m_AverageInterval = 0.0;
+	double m_MaxInterval = 0.0;
+};
+
+// Pixels of a headless frame, only valid during the readback callback.
+struct FrameReadback {
+	uint64_t m_Frame;
+	uint32_t m_Width;
+	uint32_t m_Height;
+	vk::Format m_Format;
+	const uint8_t *m_pPixels;
+	size_t m_Size;
+};
+
 class CRenderer : CLoggable {
 	private:
 		CEngine *m_pEngine;
@@ -24,32 +64,162 @@ class CRenderer : CLoggable {
 		vk::Device m_Device;
 		vk::Queue m_GraphicsQueue;
 		vk::Queue m_PresentQueue;
+		vk::Queue m_TransferQueue;
 		vk::SurfaceKHR m_Surface;
 		vk::SwapchainKHR m_SwapChain;
+		vk::SurfaceFormatKHR m_SurfaceFormat;
 		vk::Format m_SwapChainImageFormat;
 		vk::Extent2D m_SwapChainExtent;
+		vk::RenderPass m_RenderPass;
 		vk::PipelineLayout m_PipelineLayout;
-		vk::Format m_SwapChainImageFormat;
+		std::vector<vk::Pipeline> m_Pipelines;
+		vk::PipelineCache m_PipelineCache;
+		bool m_PipelineCacheWarm;
+		// The cache file as read in the background while the device is
+		// created, header included.
+		std::vector<char> m_PipelineCacheFile;
+		CJobCounter m_PipelineCacheRead;
+		vk::DebugUtilsMessengerEXT m_DebugMessenger;
 
 		std::vector<vk::Image> m_SwapChainImages;
 		std::vector<vk::ImageView> m_SwapChainImageViews;
+		std::vector<vk::Framebuffer> m_SwapChainFramebuffers;
+
+		vk::PresentModeKHR m_PresentMode;
+		// 0 picks one more than the minimum.
+		uint32_t m_RequestedImageCount;
+		// Recreated at the start of the next frame.
+		bool m_SwapChainDirty;
+		// Window size in pixels the swap chain was created for.
+		int m_DrawableWidth;
+		int m_DrawableHeight;
+		PresentStats m_PresentStats;
+		std::chrono::steady_clock::time_point m_LastPresent;
+
+		// A replaced swap chain, destroyed once the frames that were in
+		// flight when it was replaced finished.
+		struct RetiredSwapChain {
+			vk::SwapchainKHR m_SwapChain;
+			std::vector<vk::ImageView> m_ImageViews;
+			std::vector<vk::Framebuffer> m_Framebuffers;
+			uint64_t m_Frame = 0;
+		};
+
+		std::vector<RetiredSwapChain> m_RetiredSwapChains;
+
+		// Secondary command buffers one thread recorded during a frame.
+		struct ThreadCommands {
+			vk::CommandPool m_CommandPool;
+			std::vector<vk::CommandBuffer> m_Buffers;
+			uint32_t m_Used = 0;
+		};
+
+		// Everything the CPU needs to record and submit one frame while
+		// the GPU may still be working on the previous ones.
+		struct FrameData {
+			vk::CommandPool m_CommandPool;
+			vk::CommandBuffer m_CommandBuffer;
+			// One per job system thread, command pools can't be shared.
+			std::vector<ThreadCommands> m_Threads;
+			// Executed by the render pass in this order.
+			std::vector<vk::CommandBuffer> m_Secondaries;
+			vk::Semaphore m_ImageAvailable;
+			vk::Semaphore m_RenderFinished;
+			vk::Fence m_InFlight;
+			uint64_t m_FrameNumber = 0;
+		};
+
+		uint32_t m_FramesInFlight;
+		uint32_t m_CurrentFrame;
+		uint32_t m_ImageIndex;
+		bool m_FrameStarted;
+		std::vector<FrameData> m_Frames;
+		// The fence of the frame currently using each swap chain image.
+		std::vector<vk::Fence> m_ImagesInFlight;
+		uint32_t m_RecordThreads;
+
+		vk::DeviceSize m_TransientMemorySize;
+		CGpuAllocator m_Allocator;
+		CGpuResources m_Resources;
+
+		// Headless mode renders into offscreen images that stand in for the
+		// swap chain images, one per frame in flight.
+		bool m_Headless;
+		vk::Extent2D m_HeadlessExtent;
+		std::vector<GpuAllocation> m_OffscreenMemory;
+
+		struct Readback {
+			vk::Buffer m_Buffer;
+			GpuAllocation m_Memory;
+			bool m_Pending = false;
+			uint64_t m_Frame = 0;
+		};
+
+		std::vector<Readback> m_Readbacks;
+		bool m_ReadbackRequested;
+		std::function<void(const FrameReadback &)> m_ReadbackCallback;
+
+		CGpuProfiler m_GpuProfiler;
+		double m_CpuFrameTime;
+		std::chrono::steady_clock::time_point m_FrameStart;
+		uint64_t m_FrameNumber;
+
+		std::vector<const char *> m_DeviceExtensions;
+
+		uint32_t m_MaxSprites;
+		CSpriteBatch m_SpriteBatch;
+		uint32_t m_FontAtlasSize;
+		CTextRenderer m_TextRenderer;
+		vk::DeviceSize m_StagingSize;
+		CAssetStreamer m_Assets;
+
+		// Requested, the texture table is only bindless if the device
+		// supports it too.
+		bool m_Bindless;
+		bool m_DescriptorIndexing;
+		uint32_t m_MaxTextures;
+		CTextureTable m_Textures;
+		CRenderGraph m_Graph;
 
 		std::vector<const char*> m_ValidationLayers;
+		bool m_Validation;
+		uint32_t m_WindowWidth;
+		uint32_t m_WindowHeight;
 
 		void createInstance();
-		bool isDeviceSuitable(const vk::PhysicalDevice &Device) const;
-		int ratePhysicalDevice(const vk::PhysicalDevice &Device) const;
 		void pickPhysicalDevice();
-		bool checkDeviceExtSupport(const vk::PhysicalDevice &Device) const;
+		// Temporaries go to pMemory, as in every method taking one.
+		bool checkDeviceExtSupport(const vk::PhysicalDevice &Device, std::pmr::memory_resource *pMemory) const;
+		// Whether the device has what the bindless texture table needs.
+		bool checkDescriptorIndexing(const vk::PhysicalDevice &Device, const vk::PhysicalDeviceProperties &Properties) const;
 		void createLogicalDevice();
 		void create_surface();
 		void createImageViews();
 		void createRenderPass();
+		// Compiles the sprite pipelines on the job system, waitForPipelines()
+		// must be called before they are used.
 		void createGraphicsPipeline();
+		void waitForPipelines();
+		void createFramebuffers();
+		void createFrameResources();
+		void createOffscreenTargets();
+		void recordReadback(vk::CommandBuffer Cmd);
+		// Collects the results of a frame slot whose fence signaled.
+		void resolveFrame(uint32_t Slot);
+
+		std::string getPipelineCachePath();
+		// Only reads the file, doesn't need the device.
+		void readPipelineCache();
+		void loadPipelineCache();
+		void savePipelineCache();
+		void flushSprites();
+		vk::CommandBuffer beginSecondary(FrameData &Frame);
 
 		struct QueueFamilyIndices {
 			std::optional<uint32_t> m_GraphicsFamily;
 			std::optional<uint32_t> m_PresentFamily;
+			// A transfer only family if there is one, the graphics family otherwise.
+			std::optional<uint32_t> m_TransferFamily;
 
 			bool isComplete() const {
 				return m_GraphicsFamily.has_value()
@@ -57,22 +227,68 @@ class CRenderer : CLoggable {
 			}
 		};
 
-		QueueFamilyIndices findQueueFamilies(const vk::PhysicalDevice &device) const;
+		QueueFamilyIndices findQueueFamilies(const vk::PhysicalDevice &Device, std::pmr::memory_resource *pMemory) const;
+
+		// Everything picking a device asks about it, queried once per device.
+		struct PhysicalDeviceInfo {
+			vk::PhysicalDevice m_Device;
+			vk::PhysicalDeviceProperties m_Properties;
+			QueueFamilyIndices m_Families;
+			bool m_DescriptorIndexing = false;
+			bool m_ExtensionsSupported = false;
+			bool m_SwapChainGood = false;
+		};
+
+		// Of the picked device, its queue families are the ones to use.
+		PhysicalDeviceInfo m_DeviceInfo;
+
+		PhysicalDeviceInfo queryPhysicalDevice(const vk::PhysicalDevice &Device, std::pmr::memory_resource *pMemory) const;
+		bool isDeviceSuitable(const PhysicalDeviceInfo &Info) const;
+		int ratePhysicalDevice(const PhysicalDeviceInfo &Info) const;
 
 		struct SwapChainSupportDetails {
 			vk::SurfaceCapabilitiesKHR m_Capabilities;
-			std::vector<vk::SurfaceFormatKHR> m_Formats;
-			std::vector<vk::PresentModeKHR> m_PresentModes;
+			std::pmr::vector<vk::SurfaceFormatKHR> m_Formats;
+			std::pmr::vector<vk::PresentModeKHR> m_PresentModes;
+
+			explicit SwapChainSupportDetails(std::pmr::memory_resource *pMemory) : m_Formats(pMemory), m_PresentModes(pMemory) {}
 		};
 
-		SwapChainSupportDetails querySwapChainSupport(const vk::PhysicalDevice &Device) const;
+		SwapChainSupportDetails querySwapChainSupport(const vk::PhysicalDevice &Device, std::pmr::memory_resource *pMemory) const;
 
-		vk::SurfaceFormatKHR chooseSurfaceFormat(const std::vector<vk::SurfaceFormatKHR> &Formats) const;
-		vk::PresentModeKHR choosePresentMode(const std::vector<vk::PresentModeKHR> &Modes) const;
+		vk::SurfaceFormatKHR chooseSurfaceFormat(const std::pmr::vector<vk::SurfaceFormatKHR> &Formats) const;
+		vk::PresentModeKHR choosePresentMode(const std::pmr::vector<vk::PresentModeKHR> &Modes) const;
 		vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR &Capabilities) const;
-		void createSwapChain();
+		// Returns false if the window has no area to present to.
+		bool createSwapChain();
+		bool recreateSwapChain();
+		void destroyRetiredSwapChains(bool All);
+		void updatePresentStats();
+
+		// What the sprite pipelines are made of, kept until the jobs
+		// compiling them are done.
+		struct PipelineBuild {
+			ShaderHandle m_aShaders[3];
+			std::array<vk::VertexInputBindingDescription, 2> m_Bindings;
+			std::array<vk::VertexInputAttributeDescription, 7> m_Attributes;
+			vk::PipelineVertexInputStateCreateInfo m_VertexInput;
+			vk::PipelineInputAssemblyStateCreateInfo m_InputAssembly;
+			vk::PipelineViewportStateCreateInfo m_Viewport;
+			vk::DynamicState m_aDynamicStates[2];
+			vk::PipelineDynamicStateCreateInfo m_DynamicState;
+			vk::PipelineRasterizationStateCreateInfo m_Rasterizer;
+			vk::PipelineMultisampleStateCreateInfo m_Multisampling;
+			// Each pipeline has its own blending and fragment shader.
+			vk::PipelineShaderStageCreateInfo m_aaStages[NUM_SPRITE_PIPELINES][2];
+			vk::PipelineColorBlendAttachmentState m_aBlendAttachments[NUM_SPRITE_PIPELINES];
+			vk::PipelineColorBlendStateCreateInfo m_aColorBlending[NUM_SPRITE_PIPELINES];
+			vk::GraphicsPipelineCreateInfo m_aInfos[NUM_SPRITE_PIPELINES];
+			std::atomic<uint32_t> m_Failed{0};
+			std::chrono::steady_clock::time_point m_Start;
+		};
 
-		vk::ShaderModule createShaderModule(const std::vector<char> &code);
+		std::unique_ptr<PipelineBuild> m_pPipelineBuild;
+		CJobCounter m_PipelineJobs;
 
 		void setupDebugCallback();
 		bool checkValidationLayerSupport();
@@ -82,6 +298,130 @@ class CRenderer : CLoggable {
 		CRenderer(CEngine *pEngine);
 		void init();
 		void quit();
+
+		// Must be called before init(). Renders to offscreen images instead
+		// of a window, needs neither a display nor a presentation engine.
+		void setHeadless(bool Headless, uint32_t Width = 640, uint32_t Height = 480);
+		bool isHeadless() const { return m_Headless; }
+
+		// Must be called before init(). Enabled in debug builds by default.
+		void setValidation(bool Validation) { m_Validation = Validation; }
+
+		// Must be called before init().
+		void setFramesInFlight(uint32_t Count);
+		uint32_t getFramesInFlight() const { return m_FramesInFlight; }
+		uint32_t getCurrentFrame() const { return m_CurrentFrame; }
+
+		// Waits until the frame slot is free, acquires a swap chain image and
+		// starts recording. Returns false if no frame could be started.
+		bool beginFrame();
+		// Only the wait of beginFrame(), for work that should happen after
+		// it, such as sampling input.
+		void waitForFrame();
+		// Finishes recording, submits and presents the frame. Must be
+		// called even if beginFrame() failed, it then drops what was
+		// declared for the frame.
+		void endFrame();
+		uint64_t getFrameNumber() const { return m_FrameNumber; }
+		// The calling thread's scratch memory, freed when the frame ends. For
+		// the frame's temporary containers, on the job system's threads only.
+		std::pmr::memory_resource *frameMemory() const { return &m_pEngine->memory().arena(); }
+
+		// Records Count secondary command buffers inside the frame's render
+		// pass on the job system, calling Record(Cmd, Index) for each. They
+		// are executed in index order, after the ones of earlier calls, no
+		// matter which thread recorded them. Sprites are recorded last. Pass
+		// a lambda capturing more than two pointers with std::cref(), a
+		// std::function would allocate a copy.
+		void recordParallel(uint32_t Count, const std::function<void(vk::CommandBuffer, uint32_t)> &Record);
+		// Caps the threads recording sprites, 0 uses all of them.
+		void setRecordThreads(uint32_t Count) { m_RecordThreads = Count; }
+
+		// Copies the current frame to host memory. The callback runs once the
+		// GPU finished the frame, without waiting for it. Headless only.
+		void requestReadback();
+		void setReadbackCallback(std::function<void(const FrameReadback &)> Callback) { m_ReadbackCallback = std::move(Callback); }
+
+		// Seconds spent recording and submitting the last frame.
+		double getCpuFrameTime() const { return m_CpuFrameTime; }
+		// Seconds the GPU spent on the most recently finished frame, 0 if unknown.
+		double getGpuFrameTime() const { return m_GpuProfiler.getFrameTime(); }
+		// Times nested GPU scopes of the current frame, see SPS_PROFILE_GPU_SCOPE.
+		CGpuProfiler &getGpuProfiler() { return m_GpuProfiler; }
+
+		// Must be called before init().
+		void setMaxSprites(uint32_t Count) { m_MaxSprites = Count; }
+		// Queues a sprite for the current frame, ignored if no frame was started.
+		void drawSprite(const Sprite &Sprite) {
+			if (m_FrameStarted)
+				m_SpriteBatch.draw(Sprite);
+		}
+		const SpriteBatchStats &getSpriteStats() const { return m_SpriteBatch.getStats(); }
+		// What the current frame shows, in the pixel coordinates sprites use.
+		// Sprites outside are culled by drawSprite(), games with many objects
+		// should query a CSpatialGrid or CAabbTree with it instead.
+		Aabb getViewRect() const { return {glm::vec2(0.0f), glm::vec2(m_SwapChainExtent.width, m_SwapChainExtent.height)}; }
+
+		// Must be called before init(), width and height of the glyph atlas.
+		void setFontAtlasSize(uint32_t Size) { m_FontAtlasSize = Size; }
+		// Returns the id of the font, throws if it can't be loaded.
+		uint32_t loadFont(const std::string &Path) { return m_TextRenderer.loadFont(Path); }
+		// Queues text for the current frame with its top left corner at
+		// Position. Glyphs are drawn as sprites on the given layer.
+		void drawText(uint32_t Font, std::string_view Text, glm::vec2 Position, float PixelSize, uint32_t Color = 0xFFFFFFFF, uint16_t Layer = 0) {
+			m_TextRenderer.draw(Font, Text, Position, PixelSize, Color, Layer);
+		}
+		glm::vec2 measureText(uint32_t Font, std::string_view Text, float PixelSize) { return m_TextRenderer.measure(Font, Text, PixelSize); }
+		const TextStats &getTextStats() const { return m_TextRenderer.getStats(); }
+		const CFontAtlas &getFontAtlas() const { return m_TextRenderer.getAtlas(); }
+
+		vk::Device getDevice() const { return m_Device; }
+		vk::PhysicalDevice getPhysicalDevice() const { return m_PhysicalDevice; }
+		vk::Extent2D getExtent() const { return m_SwapChainExtent; }
+
+		// Resizes the window, or sets its initial size before init().
+		void setWindowSize(uint32_t Width, uint32_t Height);
+		// The size last set, the window may have been resized since.
+		vk::Extent2D getWindowSize() const { return vk::Extent2D(m_WindowWidth, m_WindowHeight); }
+
+		// Takes effect on the next frame, falls back to FIFO if the surface
+		// doesn't support the mode. Mailbox by default.
+		void setPresentMode(vk::PresentModeKHR Mode);
+		// The mode the swap chain uses, which may differ from the requested one.
+		vk::PresentModeKHR getPresentMode() const { return m_PresentStats.m_Mode; }
+		std::vector<vk::PresentModeKHR> getSupportedPresentModes() const;
+		// Swap chain images to ask for, clamped to what the surface allows.
+		// Takes effect on the next frame, 0 uses one more than the minimum.
+		void setSwapChainImages(uint32_t Count);
+		const PresentStats &getPresentStats() const { return m_PresentStats; }
+
+		// Must be called before init(), per frame in flight.
+		void setTransientMemorySize(vk::DeviceSize Size) { m_TransientMemorySize = Size; }
+		CGpuAllocator &getAllocator() { return m_Allocator; }
+		// Buffers, images, pipelines and shaders behind handles, destroyed
+		// without waiting for the device.
+		CGpuResources &resources() { return m_Resources; }
+
+		// Must be called before init(), size of the ring assets are uploaded through.
+		void setStagingSize(vk::DeviceSize Size) { m_StagingSize = Size; }
+		CAssetStreamer &assets() { return m_Assets; }
+
+		// Must be called before init(). Textures are bindless when the device
+		// supports descriptor indexing, unless this is turned off.
+		void setBindless(bool Bindless) { m_Bindless = Bindless; }
+		bool isBindless() const { return m_Textures.isBindless(); }
+		// Must be called before init(), textures the table holds at most.
+		void setMaxTextures(uint32_t Count) { m_MaxTextures = Count; }
+		// The indices sprites refer to textures by.
+		CTextureTable &textures() { return m_Textures; }
+		const CTextureTable &textures() const { return m_Textures; }
+		// Offscreen passes declared during the frame, executed by endFrame()
+		// before the sprites are drawn.
+		CRenderGraph &renderGraph() { return m_Graph; }
+		const CRenderGraph &renderGraph() const { return m_Graph; }
+
+		void createBuffer(vk::DeviceSize Size, vk::BufferUsageFlags Usage, vk::MemoryPropertyFlags Properties, vk::Buffer &Buffer, GpuAllocation &Allocation);
+		void destroyBuffer(vk::Buffer &Buffer, GpuAllocation &Allocation);
 };
 
 } // namespace sps
@@ -0,0 +1,31 @@
+#ifndef SUPERSDL_SHADER_HPP
+#define SUPERSDL_SHADER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sps {
+
+// SPIR-V compiled into the library at build time.
+struct EmbeddedShader {
+	const char *m_pName;
+	const uint32_t *m_pCode;
+	// In bytes, as vk::ShaderModuleCreateInfo wants it.
+	size_t m_CodeSize;
+};
+
+class CShaderRegistry {
+  public:
+	// Looks a shader up by its source file name, e.g. "sprite.vert".
+	// Returns nullptr if there is no such shader.
+	static const EmbeddedShader *find(const char *pName);
+	// Same as find() but throws if the shader doesn't exist.
+	static const EmbeddedShader &get(const char *pName);
+
+	static const EmbeddedShader *begin();
+	static const EmbeddedShader *end();
+};
+
+} // namespace sps
+
+#endif
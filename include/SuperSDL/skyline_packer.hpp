@@ -0,0 +1,46 @@
+#ifndef SUPERSDL_SKYLINE_PACKER_HPP
+#define SUPERSDL_SKYLINE_PACKER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sps {
+
+/*
+ * Packs rectangles into a fixed area with the skyline bottom-left heuristic.
+ * Only the top edge of the packed area is tracked, as a list of horizontal
+ * segments, so rectangles can't be freed one by one, only all at once.
+ */
+class CSkylinePacker {
+  private:
+	struct Segment {
+		uint32_t m_X;
+		uint32_t m_Y;
+		uint32_t m_Width;
+	};
+
+	uint32_t m_Width;
+	uint32_t m_Height;
+	uint64_t m_UsedArea;
+	std::vector<Segment> m_Skyline;
+
+	// Lowest y a Width wide rectangle fits at when placed at segment Index.
+	bool fits(size_t Index, uint32_t Width, uint32_t Height, uint32_t &Y) const;
+
+  public:
+	CSkylinePacker();
+
+	void init(uint32_t Width, uint32_t Height);
+	void reset();
+
+	// Returns false when the rectangle doesn't fit anymore.
+	bool pack(uint32_t Width, uint32_t Height, uint32_t &X, uint32_t &Y);
+
+	// Fraction of the area covered by packed rectangles.
+	double getOccupancy() const { return m_Width && m_Height ? double(m_UsedArea) / (double(m_Width) * m_Height) : 0.0; }
+};
+
+} // namespace sps
+
+#endif
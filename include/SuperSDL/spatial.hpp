@@ -0,0 +1,288 @@
+#ifndef SUPERSDL_SPATIAL_HPP
+#define SUPERSDL_SPATIAL_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <utility>
+#include <vector>
+
+namespace sps {
+
+// An axis aligned box, touching boxes overlap.
+struct Aabb {
+	glm::vec2 m_Min = glm::vec2(0.0f);
+	glm::vec2 m_Max = glm::vec2(0.0f);
+
+	static Aabb fromCenter(glm::vec2 Center, glm::vec2 HalfSize) { return {Center - HalfSize, Center + HalfSize}; }
+
+	bool overlaps(const Aabb &Other) const {
+		return m_Min.x <= Other.m_Max.x && Other.m_Min.x <= m_Max.x && m_Min.y <= Other.m_Max.y && Other.m_Min.y <= m_Max.y;
+	}
+	bool contains(const Aabb &Other) const {
+		return m_Min.x <= Other.m_Min.x && m_Min.y <= Other.m_Min.y && Other.m_Max.x <= m_Max.x && Other.m_Max.y <= m_Max.y;
+	}
+	Aabb merged(const Aabb &Other) const { return {glm::min(m_Min, Other.m_Min), glm::max(m_Max, Other.m_Max)}; }
+	Aabb expanded(float Margin) const { return {m_Min - Margin, m_Max + Margin}; }
+	float perimeter() const { return 2.0f * ((m_Max.x - m_Min.x) + (m_Max.y - m_Min.y)); }
+	glm::vec2 center() const { return (m_Min + m_Max) * 0.5f; }
+};
+
+constexpr uint32_t NullProxy = UINT32_MAX;
+
+/*
+ * Buckets boxes into square cells of a fixed size, only the cells that hold
+ * something are stored so the world is unbounded. Inserting, moving and
+ * removing is cheap as long as boxes span few cells, which makes the grid
+ * the better choice for many similarly sized, fast moving objects. Boxes
+ * much larger than a cell should go into a CAabbTree instead.
+ *
+ * Queries are const and may run on several threads at once, as long as
+ * nothing is inserted, moved or removed meanwhile.
+ */
+class CSpatialGrid {
+  private:
+	struct Proxy {
+		Aabb m_Bounds;
+		glm::ivec2 m_CellMin;
+		glm::ivec2 m_CellMax;
+		uint32_t m_UserData;
+		// Next free proxy while this one is unused.
+		uint32_t m_NextFree;
+	};
+
+	struct Cell {
+		glm::ivec2 m_Coord;
+		std::vector<uint32_t> m_Proxies;
+	};
+
+	// Open addressing with linear probing, cells are never removed so an
+	// empty slot ends every probe sequence.
+	struct Slot {
+		uint64_t m_Key;
+		uint32_t m_Cell;
+	};
+
+	float m_CellSize;
+	float m_InvCellSize;
+	std::vector<Proxy> m_Proxies;
+	uint32_t m_FreeList;
+	uint32_t m_ProxyCount;
+	std::vector<Cell> m_Cells;
+	std::vector<Slot> m_Slots;
+	uint32_t m_SlotMask;
+
+	static uint64_t cellKey(int32_t X, int32_t Y) { return (uint64_t(uint32_t(X)) << 32) | uint32_t(Y); }
+	static uint32_t hashKey(uint64_t Key) { return uint32_t((Key * 0x9E3779B97F4A7C15ull) >> 32); }
+
+	glm::ivec2 cellOf(glm::vec2 Point) const;
+	const Cell *findCell(int32_t X, int32_t Y) const;
+	Cell &getCell(int32_t X, int32_t Y);
+	void grow();
+	void link(uint32_t Index, glm::ivec2 Min, glm::ivec2 Max, glm::ivec2 SkipMin, glm::ivec2 SkipMax);
+	void unlink(uint32_t Index, glm::ivec2 Min, glm::ivec2 Max, glm::ivec2 SkipMin, glm::ivec2 SkipMax);
+
+	// A pair found in several cells is only reported from the one holding
+	// the top left corner of their intersection.
+	bool isReportingCell(const Cell &Cell, glm::ivec2 CellMinA, glm::ivec2 CellMinB) const {
+		return Cell.m_Coord == glm::max(CellMinA, CellMinB);
+	}
+
+  public:
+	explicit CSpatialGrid(float CellSize = 64.0f);
+
+	// Changes the cell size, existing boxes are rebucketed.
+	void setCellSize(float CellSize);
+	float getCellSize() const { return m_CellSize; }
+
+	// Returns the proxy the box is referred to by from now on.
+	uint32_t insert(const Aabb &Bounds, uint32_t UserData);
+	void remove(uint32_t Proxy);
+	// Only touches the cells the box entered or left.
+	void update(uint32_t Proxy, const Aabb &Bounds);
+	void clear();
+
+	const Aabb &getBounds(uint32_t Proxy) const { return m_Proxies[Proxy].m_Bounds; }
+	uint32_t getUserData(uint32_t Proxy) const { return m_Proxies[Proxy].m_UserData; }
+	uint32_t getCount() const { return m_ProxyCount; }
+	uint32_t getCellCount() const { return static_cast<uint32_t>(m_Cells.size()); }
+
+	// Calls Fn(uint32_t UserData) once for every box overlapping Area.
+	template <typename F>
+	void query(const Aabb &Area, F &&Fn) const;
+	// Calls Fn(uint32_t UserDataA, uint32_t UserDataB) once for every pair of
+	// overlapping boxes.
+	template <typename F>
+	void queryPairs(F &&Fn) const;
+};
+
+/*
+ * A bounding volume hierarchy that is updated incrementally, as in Box2D.
+ * Leaves store the box enlarged by a margin, moving a box only touches the
+ * tree once it leaves that fat box. Inserting picks the sibling with the
+ * least perimeter growth and rotations keep the tree balanced. Handles any
+ * mix of box sizes and suits static or slowly moving objects.
+ *
+ * Queries are const and may run on several threads at once, as long as
+ * nothing is inserted, moved or removed meanwhile.
+ */
+class CAabbTree {
+  private:
+	struct Node {
+		// The fat box for leaves.
+		Aabb m_Bounds;
+		// What was inserted, only set for leaves.
+		Aabb m_Tight;
+		// Next free node while this one is unused.
+		uint32_t m_Parent;
+		uint32_t m_aChild[2];
+		// 0 for leaves, -1 for unused nodes.
+		int32_t m_Height;
+		uint32_t m_UserData;
+
+		bool isLeaf() const { return m_aChild[0] == NullProxy; }
+	};
+
+	// Deep enough for any balanced tree that fits into memory.
+	static constexpr uint32_t MaxStackDepth = 128;
+
+	std::vector<Node> m_Nodes;
+	uint32_t m_Root;
+	uint32_t m_FreeList;
+	uint32_t m_LeafCount;
+	float m_Margin;
+
+	uint32_t allocateNode();
+	void freeNode(uint32_t Index);
+	void insertLeaf(uint32_t Leaf);
+	void removeLeaf(uint32_t Leaf);
+	uint32_t balance(uint32_t Index);
+	void refit(uint32_t Index);
+
+  public:
+	explicit CAabbTree(float Margin = 8.0f);
+
+	void setMargin(float Margin) { m_Margin = Margin; }
+	float getMargin() const { return m_Margin; }
+
+	// Returns the proxy the box is referred to by from now on.
+	uint32_t insert(const Aabb &Bounds, uint32_t UserData);
+	void remove(uint32_t Proxy);
+	// Returns true if the leaf had to be moved in the tree.
+	bool update(uint32_t Proxy, const Aabb &Bounds);
+	void clear();
+
+	const Aabb &getBounds(uint32_t Proxy) const { return m_Nodes[Proxy].m_Tight; }
+	uint32_t getUserData(uint32_t Proxy) const { return m_Nodes[Proxy].m_UserData; }
+	uint32_t getCount() const { return m_LeafCount; }
+	uint32_t getHeight() const { return m_Root == NullProxy ? 0 : m_Nodes[m_Root].m_Height; }
+
+	// Calls Fn(uint32_t UserData) once for every box overlapping Area.
+	template <typename F>
+	void query(const Aabb &Area, F &&Fn) const;
+	// Calls Fn(uint32_t UserDataA, uint32_t UserDataB) once for every pair of
+	// overlapping boxes.
+	template <typename F>
+	void queryPairs(F &&Fn) const;
+};
+
+template <typename F>
+void CSpatialGrid::query(const Aabb &Area, F &&Fn) const {
+	if (m_ProxyCount == 0)
+		return;
+
+	glm::ivec2 Min = cellOf(Area.m_Min);
+	glm::ivec2 Max = cellOf(Area.m_Max);
+	for (int32_t y = Min.y; y <= Max.y; y++) {
+		for (int32_t x = Min.x; x <= Max.x; x++) {
+			const Cell *pCell = findCell(x, y);
+			if (!pCell)
+				continue;
+			for (uint32_t Index : pCell->m_Proxies) {
+				const Proxy &P = m_Proxies[Index];
+				if (P.m_Bounds.overlaps(Area) && isReportingCell(*pCell, P.m_CellMin, Min))
+					Fn(P.m_UserData);
+			}
+		}
+	}
+}
+
+template <typename F>
+void CSpatialGrid::queryPairs(F &&Fn) const {
+	for (const Cell &C : m_Cells) {
+		for (size_t i = 0; i < C.m_Proxies.size(); i++) {
+			const Proxy &A = m_Proxies[C.m_Proxies[i]];
+			for (size_t j = i + 1; j < C.m_Proxies.size(); j++) {
+				const Proxy &B = m_Proxies[C.m_Proxies[j]];
+				if (A.m_Bounds.overlaps(B.m_Bounds) && isReportingCell(C, A.m_CellMin, B.m_CellMin))
+					Fn(A.m_UserData, B.m_UserData);
+			}
+		}
+	}
+}
+
+template <typename F>
+void CAabbTree::query(const Aabb &Area, F &&Fn) const {
+	if (m_Root == NullProxy)
+		return;
+
+	uint32_t aStack[MaxStackDepth];
+	uint32_t Top = 0;
+	aStack[Top++] = m_Root;
+	while (Top > 0) {
+		const Node &N = m_Nodes[aStack[--Top]];
+		if (!N.m_Bounds.overlaps(Area))
+			continue;
+		if (N.isLeaf()) {
+			if (N.m_Tight.overlaps(Area))
+				Fn(N.m_UserData);
+		} else {
+			aStack[Top++] = N.m_aChild[0];
+			aStack[Top++] = N.m_aChild[1];
+		}
+	}
+}
+
+template <typename F>
+void CAabbTree::queryPairs(F &&Fn) const {
+	if (m_Root == NullProxy)
+		return;
+
+	// Descends the tree against itself, a subtree paired with itself splits
+	// into its children's pairs. Only overlapping subtrees are visited.
+	std::vector<std::pair<uint32_t, uint32_t>> Stack;
+	Stack.reserve(MaxStackDepth);
+	Stack.emplace_back(m_Root, m_Root);
+	while (!Stack.empty()) {
+		auto [IndexA, IndexB] = Stack.back();
+		Stack.pop_back();
+		const Node &A = m_Nodes[IndexA];
+		const Node &B = m_Nodes[IndexB];
+
+		if (IndexA == IndexB) {
+			if (!A.isLeaf()) {
+				Stack.emplace_back(A.m_aChild[0], A.m_aChild[0]);
+				Stack.emplace_back(A.m_aChild[1], A.m_aChild[1]);
+				Stack.emplace_back(A.m_aChild[0], A.m_aChild[1]);
+			}
+			continue;
+		}
+		if (!A.m_Bounds.overlaps(B.m_Bounds))
+			continue;
+
+		if (A.isLeaf() && B.isLeaf()) {
+			if (A.m_Tight.overlaps(B.m_Tight))
+				Fn(A.m_UserData, B.m_UserData);
+		} else if (B.isLeaf() || (!A.isLeaf() && A.m_Height >= B.m_Height)) {
+			Stack.emplace_back(A.m_aChild[0], IndexB);
+			Stack.emplace_back(A.m_aChild[1], IndexB);
+		} else {
+			Stack.emplace_back(IndexA, B.m_aChild[0]);
+			Stack.emplace_back(IndexA, B.m_aChild[1]);
+		}
+	}
+}
+
+} // namespace sps
+
+#endif
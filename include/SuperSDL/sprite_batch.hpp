@@ -0,0 +1,160 @@
+#ifndef SUPERSDL_SPRITE_BATCH_HPP
+#define SUPERSDL_SPRITE_BATCH_HPP
+
+#include "SuperSDL/color.hpp"
+#include "SuperSDL/gpu_allocator.hpp"
+#include "SuperSDL/loggable.hpp"
+#include "SuperSDL/spatial.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+
+namespace sps {
+
+class CRenderer;
+
+enum ESpritePipeline : uint16_t {
+	SPRITE_PIPELINE_ALPHA = 0,
+	SPRITE_PIPELINE_ADDITIVE,
+	// Samples the font atlas as a distance field, see CTextRenderer.
+	SPRITE_PIPELINE_TEXT,
+	NUM_SPRITE_PIPELINES
+};
+
+struct Sprite {
+	// Center of the sprite, in pixels.
+	glm::vec2 m_Position = glm::vec2(0.0f);
+	glm::vec2 m_Size = glm::vec2(1.0f);
+	// Top left and bottom right texture coordinates.
+	glm::vec4 m_UV = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	// In radians, around the center.
+	float m_Rotation = 0.0f;
+	uint32_t m_Color = 0xFFFFFFFF;
+	// Index into the renderer's texture table, see CRenderer::textures().
+	// Sprites with an index that isn't in the table are drawn white.
+	uint32_t m_Texture = 0;
+	uint16_t m_Pipeline = SPRITE_PIPELINE_ALPHA;
+	// Lower layers are drawn first, sprites on the same layer are reordered
+	// to minimize state changes.
+	uint16_t m_Layer = 0;
+};
+
+// Covers the sprite at any rotation.
+inline Aabb getSpriteBounds(const Sprite &Sprite) {
+	glm::vec2 Half = glm::abs(Sprite.m_Size) * 0.5f;
+	if (Sprite.m_Rotation != 0.0f)
+		Half = glm::vec2(glm::length(Half));
+	return Aabb::fromCenter(Sprite.m_Position, Half);
+}
+
+// A run of instances that can be drawn with a single instanced draw.
+struct SpriteDrawBatch {
+	uint32_t m_Pipeline;
+	// The texture of every instance, unless the texture table is bindless.
+	uint32_t m_Texture;
+	uint32_t m_FirstInstance;
+	uint32_t m_InstanceCount;
+};
+
+struct SpriteBatchStats {
+	uint32_t m_SpriteCount = 0;
+	uint32_t m_DroppedSprites = 0;
+	// Sprites entirely outside the view, they never reach the GPU.
+	uint32_t m_CulledSprites = 0;
+	uint32_t m_DrawCount = 0;
+	uint32_t m_PipelineBinds = 0;
+	// Texture table binds, one per command buffer when bindless.
+	uint32_t m_DescriptorBinds = 0;
+	// Time spent sorting, writing instances and recording draws, in seconds.
+	double m_SubmitTime = 0.0;
+	// The recording part of m_SubmitTime, spread over the recording threads.
+	double m_RecordTime = 0.0;
+
+	double spritesPerMs() const { return m_SubmitTime > 0.0 ? m_SpriteCount / (m_SubmitTime * 1000.0) : 0.0; }
+};
+
+/*
+ * Collects sprites during a frame and submits them as a handful of instanced
+ * draws. Instance data is written straight into the renderer's transient
+ * per-frame memory, which is persistently mapped and never shared with a
+ * frame the GPU may still be reading.
+ */
+class CSpriteBatch : CLoggable {
+  private:
+	// What the GPU sees per sprite, must match sprite.vert.
+	struct Instance {
+		glm::vec2 m_Position;
+		glm::vec2 m_Size;
+		glm::vec4 m_UV;
+		float m_Rotation;
+		uint32_t m_Color;
+		uint32_t m_Texture;
+	};
+
+	struct SortEntry {
+		uint64_t m_Key;
+		uint32_t m_Index;
+
+		bool operator<(const SortEntry &Other) const {
+			return m_Key < Other.m_Key || (m_Key == Other.m_Key && m_Index < Other.m_Index);
+		}
+	};
+
+	CRenderer *m_pRenderer;
+	uint32_t m_MaxSprites;
+	uint32_t m_Dropped;
+	uint32_t m_Culled;
+	Aabb m_View;
+
+	vk::Buffer m_QuadBuffer;
+	GpuAllocation m_QuadMemory;
+	TransientAllocation m_Instances;
+
+	std::vector<Sprite> m_Sprites;
+	std::vector<SortEntry> m_SortEntries;
+	std::vector<SpriteDrawBatch> m_Batches;
+	SpriteBatchStats m_Stats;
+	std::atomic<uint32_t> m_PipelineBinds;
+	std::atomic<uint32_t> m_DescriptorBinds;
+	std::chrono::steady_clock::time_point m_PrepareStart;
+	std::chrono::steady_clock::time_point m_RecordStart;
+
+  public:
+	CSpriteBatch();
+
+	static std::array<vk::VertexInputBindingDescription, 2> getBindingDescriptions();
+	static std::array<vk::VertexInputAttributeDescription, 7> getAttributeDescriptions();
+
+	void init(CRenderer *pRenderer, uint32_t MaxSprites);
+	void quit();
+
+	// Sprites outside of it are dropped by draw(), in pixels.
+	void setView(const Aabb &View) { m_View = View; }
+	const Aabb &getView() const { return m_View; }
+
+	void draw(const Sprite &Sprite);
+
+	// Submitting happens in three steps so the draws can be recorded by
+	// several threads:
+	// Sorts the queued sprites and uploads them into the current frame's
+	// transient memory. Returns the number of draws.
+	uint32_t prepare();
+	// Records draws [First, Last) into Cmd, which must have the sprite push
+	// constants and the font atlas set. Binds the texture table itself.
+	// Thread safe for disjoint ranges.
+	void record(vk::CommandBuffer Cmd, const std::vector<vk::Pipeline> &Pipelines, vk::PipelineLayout Layout, uint32_t First, uint32_t Last);
+	// Empties the queue once every draw was recorded.
+	void finish();
+
+	const SpriteBatchStats &getStats() const { return m_Stats; }
+	uint32_t getMaxSprites() const { return m_MaxSprites; }
+};
+
+} // namespace sps
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef SUPERSDL_SPSC_QUEUE_HPP
+#define SUPERSDL_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace sps {
+
+/*
+ * Bounded single-producer single-consumer ring. One thread pushes, one
+ * thread pops, neither ever blocks or allocates after construction. Each
+ * side keeps a cached copy of the other side's index and only reloads it
+ * when the ring looks full or empty, so the two cache lines are touched
+ * once per wrap instead of once per element.
+ */
+template <typename T>
+class CSpscQueue {
+  private:
+	std::unique_ptr<T[]> m_pSlots;
+	size_t m_Mask;
+
+	// Written by the consumer.
+	alignas(64) std::atomic<size_t> m_Head;
+	size_t m_CachedTail;
+	// Written by the producer.
+	alignas(64) std::atomic<size_t> m_Tail;
+	size_t m_CachedHead;
+
+  public:
+	// Rounded up to a power of two.
+	explicit CSpscQueue(size_t Capacity) {
+		size_t Size = 2;
+		while (Size < Capacity)
+			Size <<= 1;
+		m_pSlots = std::make_unique<T[]>(Size);
+		m_Mask = Size - 1;
+		m_Head.store(0, std::memory_order_relaxed);
+		m_Tail.store(0, std::memory_order_relaxed);
+		m_CachedTail = 0;
+		m_CachedHead = 0;
+	}
+
+	CSpscQueue(const CSpscQueue &) = delete;
+	CSpscQueue &operator=(const CSpscQueue &) = delete;
+
+	// Producer only, false if the ring is full.
+	template <typename U>
+	bool push(U &&Value) {
+		size_t Tail = m_Tail.load(std::memory_order_relaxed);
+		if (Tail - m_CachedHead > m_Mask) {
+			m_CachedHead = m_Head.load(std::memory_order_acquire);
+			if (Tail - m_CachedHead > m_Mask)
+				return false;
+		}
+		m_pSlots[Tail & m_Mask] = std::forward<U>(Value);
+		m_Tail.store(Tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Producer only, how many pushes will succeed at least.
+	size_t freeSpace() {
+		m_CachedHead = m_Head.load(std::memory_order_acquire);
+		return m_Mask + 1 - (m_Tail.load(std::memory_order_relaxed) - m_CachedHead);
+	}
+
+	// Consumer only, false if the ring is empty.
+	bool pop(T &Value) {
+		size_t Head = m_Head.load(std::memory_order_relaxed);
+		if (Head == m_CachedTail) {
+			m_CachedTail = m_Tail.load(std::memory_order_acquire);
+			if (Head == m_CachedTail)
+				return false;
+		}
+		Value = std::move(m_pSlots[Head & m_Mask]);
+		m_Head.store(Head + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t capacity() const { return m_Mask + 1; }
+	// Only exact when neither side is running.
+	size_t size() const { return m_Tail.load(std::memory_order_acquire) - m_Head.load(std::memory_order_acquire); }
+};
+
+} // namespace sps
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SUPERSDL_STARTUP_HPP
+#define SUPERSDL_STARTUP_HPP
+
+#include "SuperSDL/loggable.hpp"
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sps {
+
+struct StartupStep {
+	// A string literal.
+	const char *m_pName;
+	// Seconds since the startup began.
+	double m_Start;
+	double m_Duration;
+	// Ran beside the main thread, so its time overlapped other steps.
+	bool m_Background;
+};
+
+struct StartupStats {
+	// In the order they finished.
+	std::vector<StartupStep> m_Steps;
+	// From the beginning until the first frame was submitted, 0 before that.
+	double m_TimeToFirstFrame = 0.0;
+	// Summed over the background steps, the most running them beside the
+	// main thread can have saved.
+	double m_BackgroundTime = 0.0;
+};
+
+/*
+ * Times the steps of starting the engine, the renderer and the game, from
+ * any thread, and logs a breakdown once the first frame is out.
+ *
+ * Steps that don't depend on each other, like reading files and compiling
+ * pipelines, run beside the main thread's Vulkan bring-up. Parallel startup
+ * can be turned off to measure what that saves.
+ */
+class CStartup : CLoggable {
+  private:
+	using clock_t = std::chrono::steady_clock;
+
+	clock_t::time_point m_Begin;
+	std::thread::id m_MainThread;
+	bool m_Parallel;
+	bool m_Finished;
+	mutable std::mutex m_Mutex;
+	StartupStats m_Stats;
+
+  public:
+	CStartup();
+
+	// By the main thread, before anything else starts.
+	void begin();
+	// Once the first frame was submitted, logs the breakdown.
+	void finish();
+	bool isFinished() const { return m_Finished; }
+
+	// Runs Fn as a step.
+	template <typename F>
+	void time(const char *pName, F &&Fn) {
+		clock_t::time_point Start = clock_t::now();
+		Fn();
+		record(pName, Start);
+	}
+	// A step that started at Start and just ended.
+	void record(const char *pName, clock_t::time_point Start);
+
+	// Must be set before the engine starts, on by default.
+	void setParallel(bool Parallel) { m_Parallel = Parallel; }
+	bool isParallel() const { return m_Parallel; }
+
+	// A copy, background steps may still be adding to it.
+	StartupStats getStats() const;
+};
+
+} // namespace sps
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef SUPERSDL_TEXT_RENDERER_HPP
+#define SUPERSDL_TEXT_RENDERER_HPP
+
+#include "SuperSDL/font_atlas.hpp"
+#include "SuperSDL/gpu_allocator.hpp"
+#include "SuperSDL/loggable.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <string_view>
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+
+namespace sps {
+
+class CRenderer;
+
+struct TextStats {
+	uint32_t m_GlyphsDrawn = 0;
+	// Seconds spent laying out and queueing glyphs this frame.
+	double m_LayoutTime = 0.0;
+
+	double glyphsPerMs() const { return m_LayoutTime > 0.0 ? m_GlyphsDrawn / (m_LayoutTime * 1000.0) : 0.0; }
+};
+
+/*
+ * Draws text from a CFontAtlas. Every glyph becomes a sprite using the text
+ * pipeline and the atlas texture, so the sprite batch sorts all glyphs of a
+ * layer into a single instanced draw. Glyphs rasterized during the frame are
+ * copied to the atlas image before the render pass starts.
+ */
+class CTextRenderer : CLoggable {
+  private:
+	CRenderer *m_pRenderer;
+	CFontAtlas m_Atlas;
+
+	vk::Image m_Image;
+	GpuAllocation m_ImageMemory;
+	vk::ImageView m_ImageView;
+	vk::Sampler m_Sampler;
+	// The image is undefined until the first upload.
+	bool m_ImageReady;
+
+	vk::DescriptorSetLayout m_SetLayout;
+	vk::DescriptorPool m_DescriptorPool;
+	vk::DescriptorSet m_DescriptorSet;
+
+	TextStats m_Stats;
+
+  public:
+	// The texture id of glyph sprites, sprites of other textures never
+	// share a draw with them.
+	static constexpr uint32_t AtlasTexture = UINT32_MAX;
+
+	CTextRenderer();
+
+	// Must be called before the pipeline layout is created.
+	void init(CRenderer *pRenderer, uint32_t AtlasWidth, uint32_t AtlasHeight);
+	void quit();
+
+	// Returns the id of the font, throws if it can't be loaded.
+	uint32_t loadFont(const std::string &Path) { return m_Atlas.loadFont(Path); }
+
+	// Queues Text with its top left corner at Position. Lines are separated
+	// by '\n', PixelSize is the height of a line's em square.
+	void draw(uint32_t Font, std::string_view Text, glm::vec2 Position, float PixelSize, uint32_t Color, uint16_t Layer);
+	// Size of the text's bounding box in pixels.
+	glm::vec2 measure(uint32_t Font, std::string_view Text, float PixelSize);
+
+	// Copies glyphs rasterized since the last call to the atlas image.
+	// Must be recorded outside of a render pass.
+	void upload(vk::CommandBuffer Cmd);
+	// Binds the atlas for the text pipeline.
+	void bind(vk::CommandBuffer Cmd, vk::PipelineLayout Layout) const;
+	// Starts counting the next frame's glyphs.
+	void resetStats() { m_Stats = TextStats(); }
+
+	vk::DescriptorSetLayout getSetLayout() const { return m_SetLayout; }
+	const CFontAtlas &getAtlas() const { return m_Atlas; }
+	const TextStats &getStats() const { return m_Stats; }
+};
+
+} // namespace sps
+
+#endif
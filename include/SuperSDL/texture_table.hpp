@@ -0,0 +1,102 @@
+#ifndef SUPERSDL_TEXTURE_TABLE_HPP
+#define SUPERSDL_TEXTURE_TABLE_HPP
+
+#include "SuperSDL/gpu_resources.hpp"
+#include "SuperSDL/loggable.hpp"
+#include <cstdint>
+#include <deque>
+#include <vector>
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+
+namespace sps {
+
+class CRenderer;
+
+/*
+ * Gives sampled images the index sprites refer to them by, see
+ * Sprite::m_Texture. The sprite pipelines read the table from set 1.
+ *
+ * Bindless, when the device supports descriptor indexing, every texture is
+ * an element of one large array of combined image samplers. The set is bound
+ * once per command buffer, the shader indexes it with the instance's texture
+ * and textures never split a draw. Elements are written while the set may be
+ * bound by frames in flight, which update-after-bind allows as long as those
+ * frames don't use them, and unused elements may stay unwritten.
+ *
+ * Otherwise every texture gets a descriptor set of its own, which is bound
+ * whenever the texture changes between draws.
+ *
+ * A removed index is reused once no frame in flight can draw with it. All
+ * methods must be called by the thread that runs the renderer.
+ */
+class CTextureTable : CLoggable {
+  private:
+	struct Removed {
+		// The last frame that may draw with the texture.
+		uint64_t m_Frame;
+		uint32_t m_Index;
+	};
+
+	CRenderer *m_pRenderer;
+	vk::Device m_Device;
+	bool m_Bindless;
+	uint32_t m_Capacity;
+	uint64_t m_Frame;
+
+	vk::Sampler m_Sampler;
+	vk::DescriptorSetLayout m_SetLayout;
+	vk::DescriptorPool m_DescriptorPool;
+	// The whole table when bindless, one set per index otherwise, allocated
+	// when the index is first used.
+	std::vector<vk::DescriptorSet> m_Sets;
+	std::vector<bool> m_Used;
+	std::vector<uint32_t> m_FreeIndices;
+	uint32_t m_Count;
+	// In frame order.
+	std::deque<Removed> m_Removed;
+
+	ImageHandle m_White;
+	// The white image is undefined until the first frame clears it.
+	bool m_WhiteReady;
+
+	void write(uint32_t Index, vk::ImageView View);
+
+  public:
+	// A 1x1 white texture, what untextured sprites use. Also returned for
+	// anything that isn't in the table.
+	static constexpr uint32_t WhiteTexture = 0;
+
+	CTextureTable();
+
+	// Must be called before the pipeline layout is created. Bindless asks
+	// for descriptor indexing, which the device must have enabled.
+	void init(CRenderer *pRenderer, bool Bindless, uint32_t Capacity);
+	// The device must be idle.
+	void quit();
+
+	// Called by the renderer once the frame slot is free, with the frame's
+	// command buffer outside of a render pass. Frame is the one being
+	// recorded, everything before FirstUnfinished is done on the GPU.
+	void update(vk::CommandBuffer FrameCmd, uint64_t Frame, uint64_t FirstUnfinished);
+
+	// The view must be in the shader read only layout whenever a frame
+	// draws with it. Returns WhiteTexture if the table is full.
+	uint32_t add(vk::ImageView View);
+	// The view must outlive the frames in flight, which CGpuResources takes
+	// care of when both go in the same frame.
+	void remove(uint32_t Index);
+	bool contains(uint32_t Index) const { return Index < m_Used.size() && m_Used[Index]; }
+
+	// Binds set 1: the whole table when bindless, Texture's set otherwise.
+	void bind(vk::CommandBuffer Cmd, vk::PipelineLayout Layout, uint32_t Texture) const;
+
+	bool isBindless() const { return m_Bindless; }
+	vk::DescriptorSetLayout getSetLayout() const { return m_SetLayout; }
+	uint32_t getCapacity() const { return m_Capacity; }
+	uint32_t getCount() const { return m_Count; }
+};
+
+} // namespace sps
+
+#endif
@@ -1,2 +1,7 @@
-glslc shader.vert -o vert.spv
-glslc shader.frag -o frag.spv
\ No newline at end of file
+#!/bin/sh
+# Compiles the shaders to the SPIR-V word lists embedded by src/graphics/shader.cpp.
+# The build runs the same commands, this is handy to check a shader compiles.
+OUT=${1:-.}
+for SHADER in sprite.vert sprite.frag sprite_bindless.frag text.frag; do
+	glslc -mfmt=num "$SHADER" -o "$OUT/$SHADER.inc" || exit 1
+done
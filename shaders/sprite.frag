@@ -0,0 +1,14 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragUV;
+
+// The draw's texture, bound per draw when there is no descriptor indexing.
+layout(set = 1, binding = 0) uniform sampler2D tex;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = fragColor * texture(tex, fragUV);
+}
@@ -0,0 +1,36 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Per vertex: corner of the unit quad.
+layout(location = 0) in vec2 inCorner;
+
+// Per instance, must match CSpriteBatch::Instance.
+layout(location = 1) in vec2 inPosition;
+layout(location = 2) in vec2 inSize;
+layout(location = 3) in vec4 inUV;
+layout(location = 4) in float inRotation;
+layout(location = 5) in vec4 inColor;
+layout(location = 6) in uint inTexture;
+
+// Maps pixel coordinates to clip space.
+layout(push_constant) uniform PushConstants {
+    vec2 scale;
+    vec2 offset;
+} pc;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragUV;
+// Index into the texture table, only read by sprite_bindless.frag.
+layout(location = 2) flat out uint fragTexture;
+
+void main() {
+    vec2 local = (inCorner - 0.5) * inSize;
+    float c = cos(inRotation);
+    float s = sin(inRotation);
+    vec2 world = inPosition + vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+
+    gl_Position = vec4(world * pc.scale + pc.offset, 0.0, 1.0);
+    fragColor = inColor;
+    fragUV = mix(inUV.xy, inUV.zw, inCorner);
+    fragTexture = inTexture;
+}
@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragTexture;
+
+// The whole texture table, instances of a draw may use different textures.
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = fragColor * texture(textures[nonuniformEXT(fragTexture)], fragUV);
+}
@@ -0,0 +1,18 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragUV;
+
+// Signed distance field glyphs, 0.5 is on the outline and larger is inside.
+layout(set = 0, binding = 0) uniform sampler2D atlas;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    float dist = texture(atlas, fragUV).r - 0.5;
+    // About one pixel of antialiasing at any scale.
+    float width = max(fwidth(dist), 1e-4) * 0.5;
+    float alpha = smoothstep(-width, width, dist);
+    outColor = vec4(fragColor.rgb, fragColor.a * alpha);
+}
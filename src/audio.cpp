@@ -0,0 +1,810 @@
+#include <SDL.h>
+#include <SuperSDL/audio.hpp>
+#include <SuperSDL/profiler.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SPS_AUDIO_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace sps {
+
+namespace {
+
+// Positions are 32.32 fixed point frames.
+constexpr uint64_t OneStep = uint64_t(1) << 32;
+// The top 24 bits of the fraction convert to float exactly.
+constexpr float FracScale = 1.0f / 16777216.0f;
+// Keeps End + Step from overflowing the position.
+constexpr uint32_t MaxSoundFrames = 1u << 31;
+constexpr float MinPitch = 1.0f / 64.0f;
+constexpr float MaxPitch = 16.0f;
+constexpr float Pi = 3.14159265358979f;
+
+// Gain at the first frame and how much it changes per frame.
+struct GainRamp {
+	float m_Start;
+	float m_Step;
+};
+
+struct AudioKernelTable {
+	void (*m_pResample)(const float *, uint64_t, uint64_t, float *, uint32_t);
+	void (*m_pMixMono)(float *, float *, const float *, GainRamp, GainRamp, uint32_t);
+	void (*m_pMixStereo)(float *, float *, const float *, const float *, GainRamp, GainRamp, uint32_t);
+	void (*m_pInterleave)(const float *, const float *, float, float *, uint32_t);
+};
+
+// The kernels compute the same expressions in the same order, so every
+// implementation gives the same samples.
+
+// Src at Position, Position + Step, ... interpolated between the two
+// nearest frames. Reads one frame past the last position.
+void resampleScalar(const float *pSrc, uint64_t Position, uint64_t Step, float *pDst, uint32_t Count) {
+	for (uint32_t i = 0; i < Count; i++, Position += Step) {
+		const float *pFrame = pSrc + (Position >> 32);
+		float Frac = float(uint32_t(Position) >> 8) * FracScale;
+		pDst[i] = pFrame[0] + (pFrame[1] - pFrame[0]) * Frac;
+	}
+}
+
+void mixMonoScalar(float *pLeft, float *pRight, const float *pSrc, GainRamp Left, GainRamp Right, uint32_t Count) {
+	for (uint32_t i = 0; i < Count; i++) {
+		pLeft[i] += pSrc[i] * (Left.m_Start + float(i) * Left.m_Step);
+		pRight[i] += pSrc[i] * (Right.m_Start + float(i) * Right.m_Step);
+	}
+}
+
+void mixStereoScalar(float *pLeft, float *pRight, const float *pSrcLeft, const float *pSrcRight, GainRamp Left, GainRamp Right, uint32_t Count) {
+	for (uint32_t i = 0; i < Count; i++) {
+		pLeft[i] += pSrcLeft[i] * (Left.m_Start + float(i) * Left.m_Step);
+		pRight[i] += pSrcRight[i] * (Right.m_Start + float(i) * Right.m_Step);
+	}
+}
+
+// Applies the master volume and clamps to [-1, 1].
+void interleaveScalar(const float *pLeft, const float *pRight, float Volume, float *pOut, uint32_t Count) {
+	for (uint32_t i = 0; i < Count; i++) {
+		pOut[2 * i] = std::min(std::max(pLeft[i] * Volume, -1.0f), 1.0f);
+		pOut[2 * i + 1] = std::min(std::max(pRight[i] * Volume, -1.0f), 1.0f);
+	}
+}
+
+#ifdef SPS_AUDIO_SSE2
+
+// The frames are gathered one by one, the interpolation runs 4 wide.
+void resampleSse2(const float *pSrc, uint64_t Position, uint64_t Step, float *pDst, uint32_t Count) {
+	const __m128 Scale = _mm_set1_ps(FracScale);
+	uint32_t i = 0;
+	for (; i + 4 <= Count; i += 4) {
+		uint64_t P0 = Position;
+		uint64_t P1 = P0 + Step;
+		uint64_t P2 = P1 + Step;
+		uint64_t P3 = P2 + Step;
+		Position = P3 + Step;
+		const float *pF0 = pSrc + (P0 >> 32);
+		const float *pF1 = pSrc + (P1 >> 32);
+		const float *pF2 = pSrc + (P2 >> 32);
+		const float *pF3 = pSrc + (P3 >> 32);
+		__m128 A = _mm_setr_ps(pF0[0], pF1[0], pF2[0], pF3[0]);
+		__m128 B = _mm_setr_ps(pF0[1], pF1[1], pF2[1], pF3[1]);
+		__m128i Bits = _mm_setr_epi32(int32_t(uint32_t(P0)), int32_t(uint32_t(P1)), int32_t(uint32_t(P2)), int32_t(uint32_t(P3)));
+		__m128 Frac = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(Bits, 8)), Scale);
+		_mm_storeu_ps(pDst + i, _mm_add_ps(A, _mm_mul_ps(_mm_sub_ps(B, A), Frac)));
+	}
+	resampleScalar(pSrc, Position, Step, pDst + i, Count - i);
+}
+
+void mixMonoSse2(float *pLeft, float *pRight, const float *pSrc, GainRamp Left, GainRamp Right, uint32_t Count) {
+	const __m128 StartLeft = _mm_set1_ps(Left.m_Start);
+	const __m128 StepLeft = _mm_set1_ps(Left.m_Step);
+	const __m128 StartRight = _mm_set1_ps(Right.m_Start);
+	const __m128 StepRight = _mm_set1_ps(Right.m_Step);
+	__m128 Index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	uint32_t i = 0;
+	for (; i + 4 <= Count; i += 4) {
+		__m128 Src = _mm_loadu_ps(pSrc + i);
+		__m128 GainLeft = _mm_add_ps(StartLeft, _mm_mul_ps(Index, StepLeft));
+		__m128 GainRight = _mm_add_ps(StartRight, _mm_mul_ps(Index, StepRight));
+		_mm_storeu_ps(pLeft + i, _mm_add_ps(_mm_loadu_ps(pLeft + i), _mm_mul_ps(Src, GainLeft)));
+		_mm_storeu_ps(pRight + i, _mm_add_ps(_mm_loadu_ps(pRight + i), _mm_mul_ps(Src, GainRight)));
+		Index = _mm_add_ps(Index, _mm_set1_ps(4.0f));
+	}
+	for (; i < Count; i++) {
+		pLeft[i] += pSrc[i] * (Left.m_Start + float(i) * Left.m_Step);
+		pRight[i] += pSrc[i] * (Right.m_Start + float(i) * Right.m_Step);
+	}
+}
+
+void mixStereoSse2(float *pLeft, float *pRight, const float *pSrcLeft, const float *pSrcRight, GainRamp Left, GainRamp Right, uint32_t Count) {
+	const __m128 StartLeft = _mm_set1_ps(Left.m_Start);
+	const __m128 StepLeft = _mm_set1_ps(Left.m_Step);
+	const __m128 StartRight = _mm_set1_ps(Right.m_Start);
+	const __m128 StepRight = _mm_set1_ps(Right.m_Step);
+	__m128 Index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	uint32_t i = 0;
+	for (; i + 4 <= Count; i += 4) {
+		__m128 GainLeft = _mm_add_ps(StartLeft, _mm_mul_ps(Index, StepLeft));
+		__m128 GainRight = _mm_add_ps(StartRight, _mm_mul_ps(Index, StepRight));
+		_mm_storeu_ps(pLeft + i, _mm_add_ps(_mm_loadu_ps(pLeft + i), _mm_mul_ps(_mm_loadu_ps(pSrcLeft + i), GainLeft)));
+		_mm_storeu_ps(pRight + i, _mm_add_ps(_mm_loadu_ps(pRight + i), _mm_mul_ps(_mm_loadu_ps(pSrcRight + i), GainRight)));
+		Index = _mm_add_ps(Index, _mm_set1_ps(4.0f));
+	}
+	for (; i < Count; i++) {
+		pLeft[i] += pSrcLeft[i] * (Left.m_Start + float(i) * Left.m_Step);
+		pRight[i] += pSrcRight[i] * (Right.m_Start + float(i) * Right.m_Step);
+	}
+}
+
+void interleaveSse2(const float *pLeft, const float *pRight, float Volume, float *pOut, uint32_t Count) {
+	const __m128 Scale = _mm_set1_ps(Volume);
+	const __m128 Min = _mm_set1_ps(-1.0f);
+	const __m128 Max = _mm_set1_ps(1.0f);
+	uint32_t i = 0;
+	for (; i + 4 <= Count; i += 4) {
+		__m128 Left = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(pLeft + i), Scale), Min), Max);
+		__m128 Right = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(pRight + i), Scale), Min), Max);
+		_mm_storeu_ps(pOut + 2 * i, _mm_unpacklo_ps(Left, Right));
+		_mm_storeu_ps(pOut + 2 * i + 4, _mm_unpackhi_ps(Left, Right));
+	}
+	interleaveScalar(pLeft + i, pRight + i, Volume, pOut + 2 * i, Count - i);
+}
+
+#endif
+
+const AudioKernelTable s_aKernelTables[] = {
+	{resampleScalar, mixMonoScalar, mixStereoScalar, interleaveScalar},
+#ifdef SPS_AUDIO_SSE2
+	{resampleSse2, mixMonoSse2, mixStereoSse2, interleaveSse2},
+#else
+	{resampleScalar, mixMonoScalar, mixStereoScalar, interleaveScalar},
+#endif
+};
+
+EAudioKernels bestAudioKernels() {
+#ifdef SPS_AUDIO_SSE2
+	return AUDIO_KERNELS_SSE2;
+#else
+	return AUDIO_KERNELS_SCALAR;
+#endif
+}
+
+EAudioKernels &currentAudioKernels() {
+	static EAudioKernels s_Kernels = bestAudioKernels();
+	return s_Kernels;
+}
+
+const AudioKernelTable &kernels() {
+	return s_aKernelTables[currentAudioKernels()];
+}
+
+uint64_t toStep(double BaseStep, float Pitch) {
+	return uint64_t(BaseStep * std::clamp(Pitch, MinPitch, MaxPitch) * double(OneStep));
+}
+
+} // namespace
+
+EAudioKernels getAudioKernels() {
+	return currentAudioKernels();
+}
+
+EAudioKernels setAudioKernels(EAudioKernels Kernels) {
+	currentAudioKernels() = std::min(Kernels, bestAudioKernels());
+	return currentAudioKernels();
+}
+
+const char *getAudioKernelsName(EAudioKernels Kernels) {
+	switch (Kernels) {
+	case AUDIO_KERNELS_SCALAR:
+		return "scalar";
+	case AUDIO_KERNELS_SSE2:
+		return "sse2";
+	}
+	return "unknown";
+}
+
+CAudioMixer::CAudioMixer() : CLoggable("audio"), m_Commands(CommandQueueSize), m_Finished(MaxVoices) {
+	m_Device = 0;
+	m_Frequency = 0;
+	m_Samples = 0;
+	m_pVoices = std::make_unique<Voice[]>(MaxVoices);
+	m_pActive = std::make_unique<uint32_t[]>(MaxVoices);
+	m_ActiveCount = 0;
+	m_MasterVolume = 1.0f;
+	m_Callbacks = 0;
+	m_Frames = 0;
+	m_MixTicks = 0;
+	m_MaxMixTicks = 0;
+	m_Underruns = 0;
+	m_StreamRunning = false;
+
+	// Voice 0 is never used so the handle 0 stays invalid.
+	m_VoiceSlots.resize(MaxVoices);
+	for (uint32_t i = MaxVoices - 1; i > 0; i--)
+		m_FreeVoices.push_back(i);
+	m_Sounds.emplace_back();
+	m_SoundGenerations.push_back(0);
+}
+
+CAudioMixer::~CAudioMixer() {
+	quit();
+}
+
+void CAudioMixer::init(uint32_t Frequency, uint32_t Samples) {
+	if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+		Log()->warn("No audio, sounds won't play: {}", SDL_GetError());
+		return;
+	}
+
+	// Whatever format and channel layout the device has, SDL converts to it.
+	SDL_AudioSpec Desired = {};
+	Desired.freq = static_cast<int>(Frequency);
+	Desired.format = AUDIO_F32SYS;
+	Desired.channels = 2;
+	Desired.samples = static_cast<Uint16>(Samples);
+	Desired.callback = audioCallback;
+	Desired.userdata = this;
+	SDL_AudioSpec Obtained;
+	m_Device = SDL_OpenAudioDevice(nullptr, 0, &Desired, &Obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+	if (m_Device == 0) {
+		Log()->warn("Couldn't open an audio device, sounds won't play: {}", SDL_GetError());
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+		return;
+	}
+	m_Frequency = Obtained.freq;
+	m_Samples = Obtained.samples;
+	Log()->info("Opened {} audio at {} Hz, {} frames per callback.", SDL_GetCurrentAudioDriver(), m_Frequency, m_Samples);
+
+	m_StreamRunning = true;
+	m_StreamThread = std::thread(&CAudioMixer::streamLoop, this);
+	SDL_PauseAudioDevice(m_Device, 0);
+}
+
+void CAudioMixer::quit() {
+	if (m_Device == 0)
+		return;
+	// Waits for the callback to return.
+	SDL_CloseAudioDevice(m_Device);
+	m_Device = 0;
+	{
+		std::lock_guard<std::mutex> Lock(m_StreamMutex);
+		m_StreamRunning = false;
+	}
+	m_StreamWake.notify_one();
+	m_StreamThread.join();
+	SDL_QuitSubSystem(SDL_INIT_AUDIO);
+
+	// Nothing plays anymore, whatever was in flight is dropped.
+	Command Dropped;
+	while (m_Commands.pop(Dropped)) {
+	}
+	uint32_t Finished;
+	while (m_Finished.pop(Finished)) {
+	}
+	m_ActiveCount = 0;
+	m_OpenedStreams.clear();
+	m_ClosedStreams.clear();
+	m_Streams.clear();
+	m_FreeVoices.clear();
+	for (uint32_t i = MaxVoices - 1; i > 0; i--) {
+		m_VoiceSlots[i].m_Playing = false;
+		m_VoiceSlots[i].m_Sound = 0;
+		m_VoiceSlots[i].m_pStream = nullptr;
+		m_FreeVoices.push_back(i);
+	}
+	m_Stats.m_Voices = 0;
+	for (uint32_t Id = 1; Id < m_Sounds.size(); Id++) {
+		if (m_Sounds[Id])
+			destroySound(Id);
+	}
+}
+
+void CAudioMixer::audioCallback(void *pUserData, Uint8 *pStream, int Length) {
+	CAudioMixer *pMixer = static_cast<CAudioMixer *>(pUserData);
+	pMixer->mix(reinterpret_cast<float *>(pStream), static_cast<uint32_t>(Length) / (2 * sizeof(float)));
+}
+
+void CAudioMixer::streamLoop() {
+	SPS_PROFILE_THREAD("audio_stream");
+	std::unique_lock<std::mutex> Lock(m_StreamMutex);
+	while (m_StreamRunning) {
+		for (std::unique_ptr<Stream> &pStream : m_OpenedStreams)
+			m_Streams.push_back(std::move(pStream));
+		m_OpenedStreams.clear();
+		for (Stream *pClosed : m_ClosedStreams) {
+			auto It = std::find_if(m_Streams.begin(), m_Streams.end(), [pClosed](const std::unique_ptr<Stream> &pStream) { return pStream.get() == pClosed; });
+			if (It != m_Streams.end()) {
+				std::swap(*It, m_Streams.back());
+				m_Streams.pop_back();
+			}
+		}
+		m_ClosedStreams.clear();
+
+		// Only this thread touches m_Streams, the stream functions run
+		// without the lock.
+		Lock.unlock();
+		{
+			SPS_PROFILE_SCOPE("CAudioMixer::fillStreams");
+			for (std::unique_ptr<Stream> &pStream : m_Streams) {
+				while (!pStream->m_Ended && pStream->m_Primed < StreamChunks)
+					fillChunk(*pStream, pStream->m_Primed++);
+				uint32_t Chunk;
+				while (!pStream->m_Ended && pStream->m_Free.pop(Chunk))
+					fillChunk(*pStream, Chunk);
+			}
+		}
+		Lock.lock();
+
+		// A chunk lasts tens of milliseconds, polling this often keeps every
+		// stream a few chunks ahead without the callback having to wake us.
+		m_StreamWake.wait_for(Lock, StreamPoll, [this] { return !m_StreamRunning || !m_OpenedStreams.empty(); });
+	}
+}
+
+void CAudioMixer::fillChunk(Stream &Stream, uint32_t Chunk) {
+	float *apPlanes[2];
+	for (uint32_t c = 0; c < Stream.m_Channels; c++)
+		apPlanes[c] = Stream.plane(Chunk, c) + 1;
+	uint32_t Frames = std::min(Stream.m_Read(apPlanes, StreamChunkFrames), StreamChunkFrames);
+	for (uint32_t c = 0; c < Stream.m_Channels; c++) {
+		apPlanes[c][-1] = Stream.m_aLast[c];
+		if (Frames > 0)
+			Stream.m_aLast[c] = apPlanes[c][Frames - 1];
+		if (Frames < StreamChunkFrames)
+			apPlanes[c][Frames] = 0.0f;
+	}
+	Stream.m_aFrames[Chunk] = Frames;
+	Stream.m_Ended = Frames < StreamChunkFrames;
+	// Can't fail, there are as many slots as chunks.
+	Stream.m_Ready.push(Chunk);
+}
+
+void CAudioMixer::applyCommands() {
+	Command Command;
+	while (m_Commands.pop(Command)) {
+		Voice &Voice = m_pVoices[Command.m_Voice];
+		switch (Command.m_Type) {
+		case COMMAND_PLAY:
+			Voice.m_pSound = Command.m_pSound;
+			Voice.m_pStream = Command.m_pStream;
+			Voice.m_Chunk = -1;
+			if (Voice.m_pSound) {
+				uint32_t Frames = Voice.m_pSound->m_Frames;
+				Voice.m_Channels = Voice.m_pSound->m_Channels;
+				// Without looping the last frame comes from the tail.
+				Voice.m_Frames = Command.m_Loop ? Frames : Frames - 1;
+				for (uint32_t c = 0; c < Voice.m_Channels; c++)
+					Voice.m_apPlanes[c] = &Voice.m_pSound->m_Samples[c * (Frames + 1)];
+			} else {
+				Voice.m_Channels = Voice.m_pStream->m_Channels;
+				Voice.m_Frames = 0;
+			}
+			Voice.m_Position = 0;
+			Voice.m_Step = Command.m_Step;
+			Voice.m_GainLeft = Voice.m_TargetLeft = Command.m_GainLeft;
+			Voice.m_GainRight = Voice.m_TargetRight = Command.m_GainRight;
+			Voice.m_Loop = Command.m_Loop && Voice.m_pSound;
+			Voice.m_Tail = false;
+			Voice.m_Stopping = false;
+			Voice.m_Started = false;
+			m_pActive[m_ActiveCount++] = Command.m_Voice;
+			break;
+		case COMMAND_STOP:
+			Voice.m_TargetLeft = 0.0f;
+			Voice.m_TargetRight = 0.0f;
+			Voice.m_Stopping = true;
+			break;
+		case COMMAND_GAIN:
+			if (!Voice.m_Stopping) {
+				Voice.m_TargetLeft = Command.m_GainLeft;
+				Voice.m_TargetRight = Command.m_GainRight;
+			}
+			break;
+		case COMMAND_PITCH:
+			Voice.m_Step = Command.m_Step;
+			break;
+		}
+	}
+}
+
+bool CAudioMixer::fetchChunk(Voice &Voice) {
+	uint32_t Chunk;
+	if (!Voice.m_pStream->m_Ready.pop(Chunk))
+		return false;
+	Voice.m_Chunk = static_cast<int32_t>(Chunk);
+	Voice.m_Frames = Voice.m_pStream->m_aFrames[Chunk];
+	Voice.m_LastChunk = Voice.m_Frames < StreamChunkFrames;
+	// Plays the last frame too, fading into the silent one after it.
+	if (Voice.m_LastChunk)
+		Voice.m_Frames++;
+	for (uint32_t c = 0; c < Voice.m_Channels; c++)
+		Voice.m_apPlanes[c] = Voice.m_pStream->plane(Chunk, c);
+	Voice.m_Started = true;
+	return true;
+}
+
+bool CAudioMixer::renderVoice(Voice &Voice, uint32_t Count) {
+	const AudioKernelTable &Kernels = kernels();
+	GainRamp Left = {Voice.m_GainLeft, (Voice.m_TargetLeft - Voice.m_GainLeft) / Count};
+	GainRamp Right = {Voice.m_GainRight, (Voice.m_TargetRight - Voice.m_GainRight) / Count};
+	Voice.m_GainLeft = Voice.m_TargetLeft;
+	Voice.m_GainRight = Voice.m_TargetRight;
+
+	uint32_t Done = 0;
+	while (Done < Count) {
+		if (Voice.m_pStream && Voice.m_Chunk < 0 && !fetchChunk(Voice)) {
+			// The rest of the block stays silent, the stream thread may
+			// catch up by the next one.
+			if (Voice.m_Started)
+				m_Underruns.fetch_add(1, std::memory_order_relaxed);
+			break;
+		}
+
+		uint64_t End = uint64_t(Voice.m_Frames) << 32;
+		if (Voice.m_Position >= End) {
+			if (Voice.m_Loop) {
+				Voice.m_Position %= End;
+				continue;
+			}
+			if (Voice.m_pSound && !Voice.m_Tail) {
+				// The last frame fades into silence, not into the first.
+				for (uint32_t c = 0; c < Voice.m_Channels; c++)
+					Voice.m_apPlanes[c] = Voice.m_pSound->m_aaTail[c];
+				Voice.m_Frames = 1;
+				Voice.m_Tail = true;
+				Voice.m_Position -= End;
+				continue;
+			}
+			if (Voice.m_pStream && !Voice.m_LastChunk) {
+				// Can't fail, there are as many slots as chunks.
+				Voice.m_pStream->m_Free.push(static_cast<uint32_t>(Voice.m_Chunk));
+				Voice.m_Chunk = -1;
+				Voice.m_Position -= End;
+				continue;
+			}
+			return false;
+		}
+
+		// Frames until the position passes the end of the samples.
+		uint32_t Frames = static_cast<uint32_t>(std::min<uint64_t>(Count - Done, (End - Voice.m_Position + Voice.m_Step - 1) / Voice.m_Step));
+		const float *apSource[2];
+		if (Voice.m_Step == OneStep && uint32_t(Voice.m_Position) == 0) {
+			for (uint32_t c = 0; c < Voice.m_Channels; c++)
+				apSource[c] = Voice.m_apPlanes[c] + (Voice.m_Position >> 32);
+		} else {
+			for (uint32_t c = 0; c < Voice.m_Channels; c++) {
+				Kernels.m_pResample(Voice.m_apPlanes[c], Voice.m_Position, Voice.m_Step, m_aScratch[c], Frames);
+				apSource[c] = m_aScratch[c];
+			}
+		}
+
+		GainRamp SegmentLeft = {Left.m_Start + float(Done) * Left.m_Step, Left.m_Step};
+		GainRamp SegmentRight = {Right.m_Start + float(Done) * Right.m_Step, Right.m_Step};
+		if (Voice.m_Channels == 1)
+			Kernels.m_pMixMono(m_aBus[0] + Done, m_aBus[1] + Done, apSource[0], SegmentLeft, SegmentRight, Frames);
+		else
+			Kernels.m_pMixStereo(m_aBus[0] + Done, m_aBus[1] + Done, apSource[0], apSource[1], SegmentLeft, SegmentRight, Frames);
+
+		Voice.m_Position += uint64_t(Frames) * Voice.m_Step;
+		Done += Frames;
+	}
+	// Faded out over this block.
+	return !Voice.m_Stopping;
+}
+
+void CAudioMixer::mix(float *pOut, uint32_t Frames) {
+	uint64_t Start = SDL_GetPerformanceCounter();
+	applyCommands();
+
+	const AudioKernelTable &Kernels = kernels();
+	float Volume = m_MasterVolume.load(std::memory_order_relaxed);
+	for (uint32_t Offset = 0; Offset < Frames; Offset += BlockFrames) {
+		uint32_t Count = std::min(BlockFrames, Frames - Offset);
+		std::memset(m_aBus, 0, sizeof(m_aBus));
+		for (uint32_t i = 0; i < m_ActiveCount;) {
+			uint32_t Id = m_pActive[i];
+			if (renderVoice(m_pVoices[Id], Count)) {
+				i++;
+				continue;
+			}
+			// Can't fail, there is a slot for every voice.
+			m_Finished.push(Id);
+			m_pActive[i] = m_pActive[--m_ActiveCount];
+		}
+		Kernels.m_pInterleave(m_aBus[0], m_aBus[1], Volume, pOut + 2 * Offset, Count);
+	}
+
+	uint64_t Ticks = SDL_GetPerformanceCounter() - Start;
+	m_Callbacks.fetch_add(1, std::memory_order_relaxed);
+	m_Frames.fetch_add(Frames, std::memory_order_relaxed);
+	m_MixTicks.fetch_add(Ticks, std::memory_order_relaxed);
+	if (Ticks > m_MaxMixTicks.load(std::memory_order_relaxed))
+		m_MaxMixTicks.store(Ticks, std::memory_order_relaxed);
+}
+
+void CAudioMixer::update() {
+	SPS_PROFILE_SCOPE("CAudioMixer::update");
+	uint32_t Id;
+	while (m_Finished.pop(Id)) {
+		VoiceSlot &Slot = m_VoiceSlots[Id];
+		if (Slot.m_Sound) {
+			Sound &Sound = *m_Sounds[Slot.m_Sound];
+			if (--Sound.m_Voices == 0 && Sound.m_Released)
+				destroySound(Slot.m_Sound);
+		}
+		if (Slot.m_pStream) {
+			std::lock_guard<std::mutex> Lock(m_StreamMutex);
+			m_ClosedStreams.push_back(Slot.m_pStream);
+		}
+		Slot.m_Playing = false;
+		Slot.m_Sound = 0;
+		Slot.m_pStream = nullptr;
+		m_FreeVoices.push_back(Id);
+		m_Stats.m_Voices--;
+	}
+}
+
+SoundHandle CAudioMixer::loadSound(const std::string &Path) {
+	SDL_AudioSpec Spec;
+	Uint8 *pBuffer;
+	Uint32 Length;
+	if (!SDL_LoadWAV(Path.c_str(), &Spec, &pBuffer, &Length)) {
+		Log()->error("Couldn't load {}: {}", Path, SDL_GetError());
+		return SoundHandle();
+	}
+
+	uint32_t Channels = std::min<uint32_t>(Spec.channels, 2);
+	SDL_AudioCVT Convert;
+	if (SDL_BuildAudioCVT(&Convert, Spec.format, Spec.channels, Spec.freq, AUDIO_F32SYS, static_cast<Uint8>(Channels), Spec.freq) < 0) {
+		Log()->error("Couldn't convert {}: {}", Path, SDL_GetError());
+		SDL_FreeWAV(pBuffer);
+		return SoundHandle();
+	}
+	std::vector<float> Samples((size_t(Length) * Convert.len_mult + sizeof(float) - 1) / sizeof(float));
+	std::memcpy(Samples.data(), pBuffer, Length);
+	SDL_FreeWAV(pBuffer);
+	Convert.buf = reinterpret_cast<Uint8 *>(Samples.data());
+	Convert.len = static_cast<int>(Length);
+	if (SDL_ConvertAudio(&Convert) != 0) {
+		Log()->error("Couldn't convert {}: {}", Path, SDL_GetError());
+		return SoundHandle();
+	}
+
+	uint32_t Frames = static_cast<uint32_t>(Convert.len_cvt / (Channels * sizeof(float)));
+	return createSound(Path, Samples.data(), Frames, Channels, Spec.freq);
+}
+
+SoundHandle CAudioMixer::createSound(const std::string &Name, const float *pSamples, uint32_t Frames, uint32_t Channels, uint32_t Rate) {
+	if (Channels < 1 || Channels > 2 || Rate == 0 || Frames == 0 || Frames >= MaxSoundFrames) {
+		Log()->error("Sound {} has {} channels and {} frames at {} Hz, which can't be played", Name, Channels, Frames, Rate);
+		return SoundHandle();
+	}
+
+	uint32_t Id;
+	if (!m_FreeSounds.empty()) {
+		Id = m_FreeSounds.back();
+		m_FreeSounds.pop_back();
+	} else {
+		Id = static_cast<uint32_t>(m_Sounds.size());
+		m_Sounds.emplace_back();
+		m_SoundGenerations.push_back(0);
+	}
+	// Skips 0 when it wraps around.
+	if (++m_SoundGenerations[Id] == 0)
+		m_SoundGenerations[Id] = 1;
+
+	m_Sounds[Id] = std::make_unique<Sound>();
+	Sound &Sound = *m_Sounds[Id];
+	Sound.m_Name = Name;
+	Sound.m_Channels = Channels;
+	Sound.m_Rate = Rate;
+	Sound.m_Frames = Frames;
+	Sound.m_Samples.resize(size_t(Channels) * (Frames + 1));
+	for (uint32_t c = 0; c < Channels; c++) {
+		float *pPlane = &Sound.m_Samples[c * (Frames + 1)];
+		for (uint32_t i = 0; i < Frames; i++)
+			pPlane[i] = pSamples[size_t(i) * Channels + c];
+		pPlane[Frames] = pPlane[0];
+		Sound.m_aaTail[c][0] = pPlane[Frames - 1];
+		Sound.m_aaTail[c][1] = 0.0f;
+	}
+	SPS_LOG_DEBUG("Created sound {}, {} channels, {} frames at {} Hz", Name, Channels, Frames, Rate);
+	return SoundHandle{Id, m_SoundGenerations[Id]};
+}
+
+void CAudioMixer::releaseSound(SoundHandle Handle) {
+	Sound *pSound = getSound(Handle);
+	if (!pSound)
+		return;
+	pSound->m_Released = true;
+	if (pSound->m_Voices == 0)
+		destroySound(Handle.m_Id);
+}
+
+void CAudioMixer::destroySound(uint32_t Id) {
+	m_Sounds[Id].reset();
+	m_FreeSounds.push_back(Id);
+}
+
+CAudioMixer::Sound *CAudioMixer::getSound(SoundHandle Handle) const {
+	if (Handle.m_Id == 0 || Handle.m_Id >= m_Sounds.size() || Handle.m_Generation != m_SoundGenerations[Handle.m_Id])
+		return nullptr;
+	Sound *pSound = m_Sounds[Handle.m_Id].get();
+	return pSound && !pSound->m_Released ? pSound : nullptr;
+}
+
+CAudioMixer::VoiceSlot *CAudioMixer::getVoice(VoiceHandle Handle) {
+	if (Handle.m_Id == 0 || Handle.m_Id >= MaxVoices)
+		return nullptr;
+	VoiceSlot &Slot = m_VoiceSlots[Handle.m_Id];
+	return Slot.m_Playing && Slot.m_Generation == Handle.m_Generation ? &Slot : nullptr;
+}
+
+void CAudioMixer::computeGains(const VoiceSlot &Slot, float &Left, float &Right) const {
+	float Pan = std::clamp(Slot.m_Pan, -1.0f, 1.0f);
+	if (Slot.m_Channels == 1) {
+		float Angle = (Pan + 1.0f) * 0.25f * Pi;
+		Left = Slot.m_Volume * std::cos(Angle);
+		Right = Slot.m_Volume * std::sin(Angle);
+	} else {
+		Left = Slot.m_Volume * std::min(1.0f, 1.0f - Pan);
+		Right = Slot.m_Volume * std::min(1.0f, 1.0f + Pan);
+	}
+}
+
+bool CAudioMixer::sendCommand(const Command &Command) {
+	if (m_Commands.push(Command))
+		return true;
+	m_Stats.m_DroppedCommands++;
+	SPS_LOG_RATE_LIMITED(warn, 1.0, "The audio command queue is full, a command was dropped");
+	return false;
+}
+
+VoiceHandle CAudioMixer::startVoice(Command &Play, const VoiceParams &Params, uint32_t Channels, uint32_t Rate) {
+	if (!isOpen())
+		return VoiceHandle();
+	if (m_FreeVoices.empty()) {
+		m_Stats.m_DroppedVoices++;
+		SPS_LOG_RATE_LIMITED(warn, 1.0, "All {} voices are playing, a sound was dropped", MaxVoices - 1);
+		return VoiceHandle();
+	}
+
+	uint32_t Id = m_FreeVoices.back();
+	VoiceSlot &Slot = m_VoiceSlots[Id];
+	Slot.m_Channels = Channels;
+	Slot.m_BaseStep = double(Rate) / m_Frequency;
+	Slot.m_Volume = Params.m_Volume;
+	Slot.m_Pan = Params.m_Pan;
+
+	Play.m_Type = COMMAND_PLAY;
+	Play.m_Voice = Id;
+	Play.m_Step = toStep(Slot.m_BaseStep, Params.m_Pitch);
+	Play.m_Loop = Params.m_Loop;
+	computeGains(Slot, Play.m_GainLeft, Play.m_GainRight);
+	if (!sendCommand(Play))
+		return VoiceHandle();
+
+	m_FreeVoices.pop_back();
+	// Skips 0 when it wraps around.
+	if (++Slot.m_Generation == 0)
+		Slot.m_Generation = 1;
+	Slot.m_Playing = true;
+	m_Stats.m_Voices++;
+	m_Stats.m_PeakVoices = std::max(m_Stats.m_PeakVoices, m_Stats.m_Voices);
+	return VoiceHandle{Id, Slot.m_Generation};
+}
+
+VoiceHandle CAudioMixer::play(SoundHandle Handle, const VoiceParams &Params) {
+	Sound *pSound = getSound(Handle);
+	if (!pSound)
+		return VoiceHandle();
+
+	Command Play = {};
+	Play.m_pSound = pSound;
+	VoiceHandle Voice = startVoice(Play, Params, pSound->m_Channels, pSound->m_Rate);
+	if (Voice) {
+		m_VoiceSlots[Voice.m_Id].m_Sound = Handle.m_Id;
+		pSound->m_Voices++;
+	}
+	return Voice;
+}
+
+VoiceHandle CAudioMixer::playStream(const std::string &Name, uint32_t Channels, uint32_t Rate, StreamFunction Read, const VoiceParams &Params) {
+	if (Channels < 1 || Channels > 2 || Rate == 0) {
+		Log()->error("Stream {} has {} channels at {} Hz, which can't be played", Name, Channels, Rate);
+		return VoiceHandle();
+	}
+	if (!isOpen())
+		return VoiceHandle();
+
+	auto pStream = std::make_unique<Stream>();
+	pStream->m_Name = Name;
+	pStream->m_Read = std::move(Read);
+	pStream->m_Channels = Channels;
+	pStream->m_Samples.resize(size_t(StreamChunks) * Channels * (StreamChunkFrames + 1));
+
+	// The voice waits for the first chunk without counting underruns.
+	Command Play = {};
+	Play.m_pStream = pStream.get();
+	VoiceHandle Voice = startVoice(Play, Params, Channels, Rate);
+	if (!Voice)
+		return Voice;
+	m_VoiceSlots[Voice.m_Id].m_pStream = pStream.get();
+	{
+		std::lock_guard<std::mutex> Lock(m_StreamMutex);
+		m_OpenedStreams.push_back(std::move(pStream));
+	}
+	m_StreamWake.notify_one();
+	return Voice;
+}
+
+void CAudioMixer::stop(VoiceHandle Handle) {
+	if (!getVoice(Handle))
+		return;
+	Command Stop = {};
+	Stop.m_Type = COMMAND_STOP;
+	Stop.m_Voice = Handle.m_Id;
+	sendCommand(Stop);
+}
+
+void CAudioMixer::setVolume(VoiceHandle Handle, float Volume) {
+	VoiceSlot *pSlot = getVoice(Handle);
+	if (!pSlot)
+		return;
+	pSlot->m_Volume = Volume;
+	Command Gain = {};
+	Gain.m_Type = COMMAND_GAIN;
+	Gain.m_Voice = Handle.m_Id;
+	computeGains(*pSlot, Gain.m_GainLeft, Gain.m_GainRight);
+	sendCommand(Gain);
+}
+
+void CAudioMixer::setPan(VoiceHandle Handle, float Pan) {
+	VoiceSlot *pSlot = getVoice(Handle);
+	if (!pSlot)
+		return;
+	pSlot->m_Pan = Pan;
+	Command Gain = {};
+	Gain.m_Type = COMMAND_GAIN;
+	Gain.m_Voice = Handle.m_Id;
+	computeGains(*pSlot, Gain.m_GainLeft, Gain.m_GainRight);
+	sendCommand(Gain);
+}
+
+void CAudioMixer::setPitch(VoiceHandle Handle, float Pitch) {
+	VoiceSlot *pSlot = getVoice(Handle);
+	if (!pSlot)
+		return;
+	Command Step = {};
+	Step.m_Type = COMMAND_PITCH;
+	Step.m_Voice = Handle.m_Id;
+	Step.m_Step = toStep(pSlot->m_BaseStep, Pitch);
+	sendCommand(Step);
+}
+
+bool CAudioMixer::isPlaying(VoiceHandle Handle) const {
+	if (Handle.m_Id == 0 || Handle.m_Id >= MaxVoices)
+		return false;
+	const VoiceSlot &Slot = m_VoiceSlots[Handle.m_Id];
+	return Slot.m_Playing && Slot.m_Generation == Handle.m_Generation;
+}
+
+void CAudioMixer::setPaused(bool Paused) {
+	if (m_Device)
+		SDL_PauseAudioDevice(m_Device, Paused ? 1 : 0);
+}
+
+AudioStats CAudioMixer::getStats() const {
+	AudioStats Stats = m_Stats;
+	double TickTime = 1.0 / double(SDL_GetPerformanceFrequency());
+	Stats.m_Callbacks = m_Callbacks.load(std::memory_order_relaxed);
+	Stats.m_Frames = m_Frames.load(std::memory_order_relaxed);
+	Stats.m_MixTime = m_MixTicks.load(std::memory_order_relaxed) * TickTime;
+	Stats.m_MaxMixTime = m_MaxMixTicks.load(std::memory_order_relaxed) * TickTime;
+	Stats.m_Underruns = m_Underruns.load(std::memory_order_relaxed);
+	return Stats;
+}
+
+} // namespace sps
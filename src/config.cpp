@@ -0,0 +1,181 @@
+#include <SuperSDL/config.hpp>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include <toml.hpp>
+
+namespace sps {
+
+namespace {
+
+const char *const s_pTemplate = R"(# SuperSDL config, uncomment a key to override the game's choice.
+# Keys marked (live) are applied while the game runs, the others on the next start.
+
+[engine]
+# Worker threads besides the main one, one per core when not set. 0 runs
+# every job on the main thread.
+#worker_threads = 0
+
+[renderer]
+# Window size in pixels. (live)
+#width = 640
+#height = 480
+# immediate, mailbox, fifo or fifo_relaxed, falls back to fifo if unsupported. (live)
+#present_mode = "mailbox"
+# Swap chain images, 0 uses one more than the minimum. (live)
+#swapchain_images = 0
+# Frames the CPU may record ahead of the GPU.
+#frames_in_flight = 2
+# Vulkan validation layers.
+#validation = false
+# Bindless textures when the GPU supports descriptor indexing.
+#bindless = true
+
+[game]
+# Frames per second, 0 runs uncapped. (live)
+#target_fps = 60
+# Records scopes and writes trace.json to the config path on exit. (live)
+#profiler = false
+)";
+
+// Null if the table or the key doesn't exist.
+const toml::value *find(const toml::value &Data, const char *pTable, const char *pKey) {
+	if (!Data.is_table())
+		return nullptr;
+	auto Table = Data.as_table().find(pTable);
+	if (Table == Data.as_table().end() || !Table->second.is_table())
+		return nullptr;
+	auto Value = Table->second.as_table().find(pKey);
+	if (Value == Table->second.as_table().end())
+		return nullptr;
+	return &Value->second;
+}
+
+void invalid(const char *pTable, const char *pKey, const char *pExpected) {
+	throw std::runtime_error(std::string(pTable) + "." + pKey + " must be " + pExpected);
+}
+
+void read(const toml::value &Data, const char *pTable, const char *pKey, std::optional<uint32_t> &Out) {
+	if (const toml::value *pValue = find(Data, pTable, pKey)) {
+		if (!pValue->is_integer() || pValue->as_integer() < 0 || pValue->as_integer() > INT32_MAX)
+			invalid(pTable, pKey, "a non-negative integer");
+		Out = uint32_t(pValue->as_integer());
+	}
+}
+
+void read(const toml::value &Data, const char *pTable, const char *pKey, std::optional<double> &Out) {
+	if (const toml::value *pValue = find(Data, pTable, pKey)) {
+		if (pValue->is_integer())
+			Out = double(pValue->as_integer());
+		else if (pValue->is_floating())
+			Out = pValue->as_floating();
+		else
+			invalid(pTable, pKey, "a number");
+	}
+}
+
+void read(const toml::value &Data, const char *pTable, const char *pKey, std::optional<bool> &Out) {
+	if (const toml::value *pValue = find(Data, pTable, pKey)) {
+		if (!pValue->is_boolean())
+			invalid(pTable, pKey, "true or false");
+		Out = pValue->as_boolean();
+	}
+}
+
+void read(const toml::value &Data, const char *pTable, const char *pKey, std::optional<vk::PresentModeKHR> &Out) {
+	if (const toml::value *pValue = find(Data, pTable, pKey)) {
+		std::string Mode = pValue->is_string() ? toml::get<std::string>(*pValue) : "";
+		if (Mode == "immediate")
+			Out = vk::PresentModeKHR::eImmediate;
+		else if (Mode == "mailbox")
+			Out = vk::PresentModeKHR::eMailbox;
+		else if (Mode == "fifo")
+			Out = vk::PresentModeKHR::eFifo;
+		else if (Mode == "fifo_relaxed")
+			Out = vk::PresentModeKHR::eFifoRelaxed;
+		else
+			invalid(pTable, pKey, "immediate, mailbox, fifo or fifo_relaxed");
+	}
+}
+
+} // namespace
+
+CConfig::CConfig() : CLoggable("config") {
+}
+
+void CConfig::load(const std::string &Path) {
+	m_Path = Path;
+	m_File = Path;
+	m_NextPoll = std::chrono::steady_clock::now();
+
+	std::error_code Error;
+	if (!std::filesystem::exists(m_File, Error))
+		writeTemplate();
+
+	m_LastWrite = std::filesystem::last_write_time(m_File, Error);
+	if (!Error && parse(m_Values))
+		Log()->info("Loaded {}", m_Path);
+}
+
+bool CConfig::poll(ConfigValues &Previous) {
+	auto Now = std::chrono::steady_clock::now();
+	if (m_Path.empty() || Now < m_NextPoll)
+		return false;
+	m_NextPoll = Now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(PollInterval));
+
+	std::error_code Error;
+	auto LastWrite = std::filesystem::last_write_time(m_File, Error);
+	// A missing file keeps the values it had.
+	if (Error || LastWrite == m_LastWrite)
+		return false;
+	m_LastWrite = LastWrite;
+
+	ConfigValues Values;
+	if (!parse(Values))
+		return false;
+
+	Log()->info("Reloaded {}", m_Path);
+	Previous = m_Values;
+	m_Values = Values;
+	return true;
+}
+
+bool CConfig::parse(ConfigValues &Values) {
+	try {
+		toml::value Data = toml::parse(m_Path);
+
+		read(Data, "engine", "worker_threads", Values.m_WorkerThreads);
+
+		read(Data, "renderer", "width", Values.m_Width);
+		read(Data, "renderer", "height", Values.m_Height);
+		read(Data, "renderer", "present_mode", Values.m_PresentMode);
+		read(Data, "renderer", "swapchain_images", Values.m_SwapChainImages);
+		read(Data, "renderer", "frames_in_flight", Values.m_FramesInFlight);
+		read(Data, "renderer", "validation", Values.m_Validation);
+		read(Data, "renderer", "bindless", Values.m_Bindless);
+
+		read(Data, "game", "target_fps", Values.m_TargetFrameRate);
+		read(Data, "game", "profiler", Values.m_Profiler);
+	} catch (std::exception &Error) {
+		Log()->error("Couldn't read {}, keeping the previous settings: {}", m_Path, Error.what());
+		return false;
+	}
+
+	if ((Values.m_Width && *Values.m_Width == 0) || (Values.m_Height && *Values.m_Height == 0)) {
+		Log()->error("Couldn't read {}, keeping the previous settings: the window size can't be 0", m_Path);
+		return false;
+	}
+	return true;
+}
+
+void CConfig::writeTemplate() {
+	std::ofstream File(m_Path);
+	if (!File) {
+		Log()->info("Couldn't write a config template to {}", m_Path);
+		return;
+	}
+	File << s_pTemplate;
+	Log()->info("Wrote a config template to {}", m_Path);
+}
+
+} // namespace sps
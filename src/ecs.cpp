@@ -0,0 +1,363 @@
+#include <SuperSDL/ecs.hpp>
+#include <SuperSDL/profiler.hpp>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace sps {
+
+namespace {
+
+std::array<ComponentInfo, MaxComponentTypes> s_aComponents;
+std::atomic<uint32_t> s_ComponentCount(0);
+
+} // namespace
+
+uint32_t registerComponent(const ComponentInfo &Info) {
+	// Only called while initializing the function local static of
+	// componentId<T>(), the fetch_add hands out distinct slots.
+	uint32_t Id = s_ComponentCount.fetch_add(1);
+	if (Id >= MaxComponentTypes)
+		throw std::runtime_error("too many component types");
+	s_aComponents[Id] = Info;
+	return Id;
+}
+
+const ComponentInfo &getComponentInfo(uint32_t Id) {
+	return s_aComponents[Id];
+}
+
+// CEntityCommands
+
+CEntityCommands::CEntityCommands() {
+	m_Page = 0;
+	m_Count = 0;
+}
+
+CEntityCommands::~CEntityCommands() {
+	clear();
+}
+
+void *CEntityCommands::allocate(size_t Size) {
+	while (m_Page < m_Pages.size()) {
+		Page &Current = m_Pages[m_Page];
+		if (Current.m_Capacity - Current.m_Used >= Size) {
+			void *pData = Current.m_pData.get() + Current.m_Used;
+			Current.m_Used += Size;
+			return pData;
+		}
+		m_Page++;
+	}
+
+	// Commands bigger than a page get a page of their own.
+	Page New;
+	New.m_Capacity = std::max(PageSize, Size);
+	New.m_pData.reset(new unsigned char[New.m_Capacity]);
+	New.m_Used = Size;
+	m_Pages.push_back(std::move(New));
+	m_Page = m_Pages.size() - 1;
+	return m_Pages.back().m_pData.get();
+}
+
+void CEntityCommands::destroy(Entity E) {
+	push([E](CWorld &World) { World.destroy(E); });
+}
+
+void CEntityCommands::discard(Page &Current, size_t Offset) {
+	while (Offset < Current.m_Used) {
+		Header *pHeader = reinterpret_cast<Header *>(Current.m_pData.get() + Offset);
+		pHeader->m_pDiscard(Current.m_pData.get() + Offset + align(sizeof(Header)));
+		Offset += pHeader->m_Size;
+	}
+	Current.m_Used = 0;
+}
+
+void CEntityCommands::apply(CWorld &World) {
+	// A command may record more commands, those are run by the next apply.
+	std::vector<Page> Pages = std::move(m_Pages);
+	m_Pages.clear();
+	m_Page = 0;
+	m_Count = 0;
+
+	// The next command to run. When one throws, the ones after it are
+	// destroyed without running so their captures don't leak.
+	struct DiscardGuard {
+		std::vector<Page> &m_Pages;
+		size_t m_Page;
+		size_t m_Offset;
+
+		~DiscardGuard() {
+			for (; m_Page < m_Pages.size(); m_Page++, m_Offset = 0)
+				discard(m_Pages[m_Page], m_Offset);
+		}
+	} Guard{Pages, 0, 0};
+
+	for (; Guard.m_Page < Pages.size(); Guard.m_Page++, Guard.m_Offset = 0) {
+		Page &Current = Pages[Guard.m_Page];
+		while (Guard.m_Offset < Current.m_Used) {
+			unsigned char *pCommand = Current.m_pData.get() + Guard.m_Offset;
+			Header *pHeader = reinterpret_cast<Header *>(pCommand);
+			// Moved past first, a command that throws destroys itself.
+			Guard.m_Offset += pHeader->m_Size;
+			pHeader->m_pApply(pCommand + align(sizeof(Header)), World);
+		}
+		Current.m_Used = 0;
+	}
+
+	// Keep the pages for the next frame, unless new ones were needed meanwhile.
+	if (m_Pages.empty())
+		m_Pages = std::move(Pages);
+}
+
+void CEntityCommands::clear() {
+	for (Page &Current : m_Pages)
+		discard(Current, 0);
+	m_Page = 0;
+	m_Count = 0;
+}
+
+// CWorld
+
+void *CWorld::Archetype::component(uint32_t Row, uint32_t Column) const {
+	uint32_t Size = getComponentInfo(m_Components[Column]).m_Size;
+	return m_Chunks[Row / m_ChunkCapacity].m_pData + m_Offsets[Column] + size_t(Row % m_ChunkCapacity) * Size;
+}
+
+CWorld::CWorld() : CLoggable("world"), m_Iterating(0) {
+	m_pJobs = nullptr;
+	m_EntityCount = 0;
+}
+
+CWorld::~CWorld() {
+	quit();
+}
+
+void CWorld::init(CJobSystem *pJobs) {
+	m_pJobs = pJobs;
+	m_Commands.resize(pJobs ? std::max(1u, pJobs->getThreadCount()) : 1);
+}
+
+void CWorld::quit() {
+	for (auto &Commands : m_Commands)
+		Commands.clear();
+
+	for (auto &pArchetype : m_Archetypes) {
+		for (uint32_t Column = 0; Column < pArchetype->m_Components.size(); Column++) {
+			const ComponentInfo &Info = getComponentInfo(pArchetype->m_Components[Column]);
+			for (uint32_t Row = 0; Row < pArchetype->m_Count; Row++)
+				Info.m_pDestroy(pArchetype->component(Row, Column));
+		}
+		for (Chunk &Chunk : pArchetype->m_Chunks)
+			::operator delete(Chunk.m_pData, std::align_val_t(64));
+	}
+
+	m_Archetypes.clear();
+	m_ArchetypeMap.clear();
+	m_Queries.clear();
+	m_Entities.clear();
+	m_FreeEntities.clear();
+	m_EntityCount = 0;
+	m_Systems.clear();
+}
+
+CWorld::Archetype *CWorld::getArchetype(ComponentMask Mask) {
+	auto It = m_ArchetypeMap.find(Mask);
+	if (It != m_ArchetypeMap.end())
+		return It->second;
+
+	auto pArchetype = std::make_unique<Archetype>();
+	pArchetype->m_Mask = Mask;
+	std::fill(std::begin(pArchetype->m_aColumn), std::end(pArchetype->m_aColumn), -1);
+	for (uint32_t Id = 0; Id < MaxComponentTypes; Id++) {
+		if (Mask & (ComponentMask(1) << Id)) {
+			pArchetype->m_aColumn[Id] = int8_t(pArchetype->m_Components.size());
+			pArchetype->m_Components.push_back(Id);
+		}
+	}
+
+	// As many entities as fit in a chunk, the entity column first and every
+	// component column aligned for its type.
+	auto Layout = [&](uint32_t Capacity) {
+		size_t Offset = sizeof(Entity) * size_t(Capacity);
+		pArchetype->m_Offsets.clear();
+		for (uint32_t Id : pArchetype->m_Components) {
+			const ComponentInfo &Info = getComponentInfo(Id);
+			Offset = (Offset + Info.m_Align - 1) / Info.m_Align * Info.m_Align;
+			pArchetype->m_Offsets.push_back(uint32_t(Offset));
+			Offset += size_t(Info.m_Size) * Capacity;
+		}
+		return Offset;
+	};
+
+	size_t EntityBytes = sizeof(Entity);
+	for (uint32_t Id : pArchetype->m_Components)
+		EntityBytes += getComponentInfo(Id).m_Size;
+	uint32_t Capacity = uint32_t(std::max<size_t>(1, ChunkSize / EntityBytes));
+	while (Capacity > 1 && Layout(Capacity) > ChunkSize)
+		Capacity--;
+	pArchetype->m_ChunkCapacity = Capacity;
+	// Bigger than ChunkSize only for components that don't fit one on their own.
+	pArchetype->m_ChunkBytes = std::max(ChunkSize, Layout(Capacity));
+
+	Archetype *pResult = pArchetype.get();
+	m_Archetypes.push_back(std::move(pArchetype));
+	m_ArchetypeMap[Mask] = pResult;
+	return pResult;
+}
+
+CWorld::Archetype *CWorld::addEdge(Archetype *pFrom, uint32_t Component) {
+	if (!pFrom->m_apAdd[Component]) {
+		Archetype *pTo = getArchetype(pFrom->m_Mask | (ComponentMask(1) << Component));
+		pFrom->m_apAdd[Component] = pTo;
+		pTo->m_apRemove[Component] = pFrom;
+	}
+	return pFrom->m_apAdd[Component];
+}
+
+CWorld::Archetype *CWorld::removeEdge(Archetype *pFrom, uint32_t Component) {
+	if (!pFrom->m_apRemove[Component]) {
+		Archetype *pTo = getArchetype(pFrom->m_Mask & ~(ComponentMask(1) << Component));
+		pFrom->m_apRemove[Component] = pTo;
+		pTo->m_apAdd[Component] = pFrom;
+	}
+	return pFrom->m_apRemove[Component];
+}
+
+const std::vector<CWorld::Archetype *> &CWorld::query(ComponentMask Mask) {
+	Query &Query = m_Queries[Mask];
+	for (; Query.m_Checked < m_Archetypes.size(); Query.m_Checked++) {
+		Archetype *pArchetype = m_Archetypes[Query.m_Checked].get();
+		if ((pArchetype->m_Mask & Mask) == Mask)
+			Query.m_Archetypes.push_back(pArchetype);
+	}
+	return Query.m_Archetypes;
+}
+
+Entity CWorld::allocateEntity() {
+	Entity E;
+	if (!m_FreeEntities.empty()) {
+		E.m_Index = m_FreeEntities.back();
+		m_FreeEntities.pop_back();
+	} else {
+		E.m_Index = static_cast<uint32_t>(m_Entities.size());
+		m_Entities.emplace_back();
+	}
+	E.m_Generation = m_Entities[E.m_Index].m_Generation;
+	m_EntityCount++;
+	return E;
+}
+
+uint32_t CWorld::allocateRow(Archetype &Archetype, Entity E) {
+	uint32_t Row = Archetype.m_Count;
+	uint32_t Chunk = Row / Archetype.m_ChunkCapacity;
+	if (Chunk == Archetype.m_Chunks.size())
+		Archetype.m_Chunks.push_back({static_cast<unsigned char *>(::operator new(Archetype.m_ChunkBytes, std::align_val_t(64)))});
+
+	Archetype.entities(Chunk)[Row % Archetype.m_ChunkCapacity] = E;
+	Archetype.m_Count++;
+
+	EntityRecord &Record = m_Entities[E.m_Index];
+	Record.m_pArchetype = &Archetype;
+	Record.m_Row = Row;
+	return Row;
+}
+
+void CWorld::removeRow(Archetype &Archetype, uint32_t Row) {
+	uint32_t Last = Archetype.m_Count - 1;
+	if (Row != Last) {
+		for (uint32_t Column = 0; Column < Archetype.m_Components.size(); Column++)
+			getComponentInfo(Archetype.m_Components[Column]).m_pRelocate(Archetype.component(Row, Column), Archetype.component(Last, Column));
+
+		Entity Moved = Archetype.entities(Last / Archetype.m_ChunkCapacity)[Last % Archetype.m_ChunkCapacity];
+		Archetype.entities(Row / Archetype.m_ChunkCapacity)[Row % Archetype.m_ChunkCapacity] = Moved;
+		m_Entities[Moved.m_Index].m_Row = Row;
+	}
+	Archetype.m_Count--;
+}
+
+void CWorld::moveEntity(Entity E, Archetype &To) {
+	EntityRecord &Record = m_Entities[E.m_Index];
+	Archetype &From = *Record.m_pArchetype;
+	uint32_t FromRow = Record.m_Row;
+	uint32_t ToRow = allocateRow(To, E);
+
+	// Components both have are moved over, the others are destroyed. The
+	// one that is being added is constructed by the caller.
+	for (uint32_t Column = 0; Column < From.m_Components.size(); Column++) {
+		uint32_t Id = From.m_Components[Column];
+		const ComponentInfo &Info = getComponentInfo(Id);
+		if (To.m_aColumn[Id] >= 0)
+			Info.m_pRelocate(To.component(ToRow, To.m_aColumn[Id]), From.component(FromRow, Column));
+		else
+			Info.m_pDestroy(From.component(FromRow, Column));
+	}
+	removeRow(From, FromRow);
+}
+
+const CWorld::EntityRecord *CWorld::record(Entity E) const {
+	if (E.m_Index >= m_Entities.size())
+		return nullptr;
+	const EntityRecord &Record = m_Entities[E.m_Index];
+	if (Record.m_Generation != E.m_Generation || !Record.m_pArchetype)
+		return nullptr;
+	return &Record;
+}
+
+void CWorld::checkStructural() const {
+	if (m_Iterating.load(std::memory_order_relaxed) > 0) {
+		Log()->error("structural change while iterating, record it in commands() instead");
+		throw std::runtime_error("structural change while iterating");
+	}
+}
+
+void CWorld::destroy(Entity E) {
+	checkStructural();
+	const EntityRecord *pRecord = record(E);
+	if (!pRecord)
+		return;
+
+	Archetype &Archetype = *pRecord->m_pArchetype;
+	uint32_t Row = pRecord->m_Row;
+	for (uint32_t Column = 0; Column < Archetype.m_Components.size(); Column++)
+		getComponentInfo(Archetype.m_Components[Column]).m_pDestroy(Archetype.component(Row, Column));
+	removeRow(Archetype, Row);
+
+	EntityRecord &Record = m_Entities[E.m_Index];
+	Record.m_pArchetype = nullptr;
+	// Skips 0 when wrapping around, it marks invalid handles.
+	Record.m_Generation = Record.m_Generation + 1 == 0 ? 1 : Record.m_Generation + 1;
+	m_FreeEntities.push_back(E.m_Index);
+	m_EntityCount--;
+}
+
+CEntityCommands &CWorld::commands() {
+	uint32_t Thread = m_pJobs ? m_pJobs->getThreadIndex() : 0;
+	if (Thread >= m_Commands.size()) {
+		Log()->error("commands() called from a thread outside of the job system");
+		throw std::runtime_error("commands() called from a foreign thread");
+	}
+	return m_Commands[Thread];
+}
+
+void CWorld::flush() {
+	for (auto &Commands : m_Commands) {
+		if (Commands.size() > 0)
+			Commands.apply(*this);
+	}
+}
+
+void CWorld::addSystem(const char *pName, std::function<void(CWorld &, double)> Run) {
+	m_Systems.push_back({pName, std::move(Run)});
+}
+
+void CWorld::update(double Delta) {
+	for (auto &System : m_Systems) {
+		{
+			SPS_PROFILE_SCOPE(System.m_pName);
+			System.m_Run(*this, Delta);
+		}
+		flush();
+	}
+}
+
+} // namespace sps
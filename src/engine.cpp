@@ -1,28 +1,74 @@
 #include <SDL_filesystem.h>
 #include <SDL_stdinc.h>
 #include <SuperSDL/engine.hpp>
+#include <exception>
+#include <thread>
 
 namespace sps {
 
 CEngine::CEngine() : CLoggable("engine"), m_AppConfigPath() {
+	m_WorkerThreads = CJobSystem::AutoWorkers;
 }
 
 void CEngine::init(const char *pOrgName, const char *pGameName) {
 	m_pOrgName = pOrgName;
 	m_pGameName = pGameName;
 
-	SDL_Init(SDL_INIT_EVERYTHING);
-	Log()->info("Initialized engine.");
-
+	// Works before SDL_Init().
 	char* path = SDL_GetPrefPath(pOrgName, pGameName); 
 	m_AppConfigPath = path;
 	SDL_free(path);
 
 	Log()->info("Config path: {}", m_AppConfigPath);
+
+	// The config is parsed while SDL connects to the display and audio
+	// drivers. It says how many workers to start, so this can't be a job.
+	std::exception_ptr ConfigError;
+	auto LoadConfig = [this, &ConfigError]() {
+		try {
+			m_Startup.time("loadConfig", [this]() { m_Config.load(m_AppConfigPath + "config.toml"); });
+		} catch (...) {
+			ConfigError = std::current_exception();
+		}
+	};
+	std::thread ConfigThread;
+	if (m_Startup.isParallel())
+		ConfigThread = std::thread(LoadConfig);
+	else
+		LoadConfig();
+
+	m_Startup.time("SDL_Init", []() { SDL_Init(SDL_INIT_EVERYTHING); });
+	if (ConfigThread.joinable())
+		ConfigThread.join();
+	if (ConfigError)
+		std::rethrow_exception(ConfigError);
+	Log()->info("Initialized engine.");
+
+	if (m_Config.get().m_WorkerThreads)
+		m_WorkerThreads = *m_Config.get().m_WorkerThreads;
+
+	m_Startup.time("startJobs", [this]() { m_Jobs.init(m_WorkerThreads); });
+	m_Memory.init(&m_Jobs);
+
+	// Opening the device can take a while, it happens beside the renderer's
+	// startup.
+	auto OpenAudio = [this]() { m_Startup.time("openAudio", [this]() { m_Audio.init(); }); };
+	if (m_Startup.isParallel())
+		m_Jobs.schedule(OpenAudio, &m_Starting);
+	else
+		OpenAudio();
+}
+
+void CEngine::waitForStartup() {
+	m_Jobs.wait(m_Starting);
 }
 
 void CEngine::quit() {
 	Log()->info("Stopping engine.");
+	waitForStartup();
+	m_Audio.quit();
+	m_Memory.quit();
+	m_Jobs.quit();
 	SDL_Quit();
 }
 
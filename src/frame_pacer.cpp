@@ -0,0 +1,108 @@
+#include <SuperSDL/frame_pacer.hpp>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace sps {
+
+using seconds_t = std::chrono::duration<double>;
+
+CFramePacer::CFramePacer() : m_TargetFrameTime(0.0) {
+	reset();
+}
+
+void CFramePacer::setTargetFrameRate(double Fps) {
+	m_TargetFrameTime = Fps > 0.0 ? 1.0 / Fps : 0.0;
+	m_Stats.m_TargetFrameTime = m_TargetFrameTime;
+	m_NextDeadline = clock_t::now() + std::chrono::duration_cast<clock_t::duration>(seconds_t(m_TargetFrameTime));
+}
+
+double CFramePacer::getTargetFrameRate() const {
+	return m_TargetFrameTime > 0.0 ? 1.0 / m_TargetFrameTime : 0.0;
+}
+
+void CFramePacer::reset() {
+	// Start pessimistic, the estimate converges after a few frames.
+	m_SleepEstimate = 5e-3;
+	m_SleepMean = 5e-3;
+	m_SleepM2 = 0.0;
+	m_SleepCount = 1;
+
+	m_History.fill(0.0);
+	m_Stats = FrameStats();
+	m_Stats.m_TargetFrameTime = m_TargetFrameTime;
+
+	m_LastFrame = clock_t::now();
+	m_NextDeadline = m_LastFrame + std::chrono::duration_cast<clock_t::duration>(seconds_t(m_TargetFrameTime));
+}
+
+void CFramePacer::sleepUntil(clock_t::time_point Deadline) {
+	// Sleep in small steps while we are confident we won't overshoot.
+	for (;;) {
+		auto Now = clock_t::now();
+		double Remaining = seconds_t(Deadline - Now).count();
+		if (Remaining <= m_SleepEstimate)
+			break;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		double Observed = seconds_t(clock_t::now() - Now).count();
+		m_SleepCount++;
+		double Delta = Observed - m_SleepMean;
+		m_SleepMean += Delta / m_SleepCount;
+		m_SleepM2 += Delta * (Observed - m_SleepMean);
+		double StdDev = std::sqrt(m_SleepM2 / (m_SleepCount - 1));
+		m_SleepEstimate = m_SleepMean + StdDev;
+	}
+
+	// Spin for the rest, yielding so we don't starve other threads.
+	while (clock_t::now() < Deadline)
+		std::this_thread::yield();
+}
+
+void CFramePacer::waitForNextFrame() {
+	if (m_TargetFrameTime > 0.0) {
+		auto Now = clock_t::now();
+		if (Now < m_NextDeadline) {
+			sleepUntil(m_NextDeadline);
+			m_NextDeadline += std::chrono::duration_cast<clock_t::duration>(seconds_t(m_TargetFrameTime));
+		} else {
+			m_Stats.m_MissedDeadlines++;
+			// If we fell behind by more than a frame, resync instead of
+			// trying to catch up with a burst of short frames.
+			auto Step = std::chrono::duration_cast<clock_t::duration>(seconds_t(m_TargetFrameTime));
+			m_NextDeadline += Step;
+			if (m_NextDeadline < Now)
+				m_NextDeadline = Now + Step;
+		}
+	}
+
+	auto Now = clock_t::now();
+	recordFrame(seconds_t(Now - m_LastFrame).count());
+	m_LastFrame = Now;
+}
+
+void CFramePacer::recordFrame(double FrameTime) {
+	m_History[m_Stats.m_FrameCount % HistorySize] = FrameTime;
+	m_Stats.m_FrameCount++;
+	m_Stats.m_LastFrameTime = FrameTime;
+
+	size_t Count = std::min<uint64_t>(m_Stats.m_FrameCount, HistorySize);
+	double Sum = 0.0, Error = 0.0;
+	double Min = m_History[0], Max = m_History[0];
+
+	for (size_t i = 0; i < Count; i++) {
+		Sum += m_History[i];
+		Min = std::min(Min, m_History[i]);
+		Max = std::max(Max, m_History[i]);
+		if (m_TargetFrameTime > 0.0)
+			Error += std::abs(m_History[i] - m_TargetFrameTime);
+	}
+
+	m_Stats.m_AverageFrameTime = Sum / Count;
+	m_Stats.m_MinFrameTime = Min;
+	m_Stats.m_MaxFrameTime = Max;
+	m_Stats.m_PacingError = Error / Count;
+}
+
+} // namespace sps
@@ -1,27 +1,202 @@
+#include <SDL.h>
 #include <SuperSDL/game.hpp>
+#include <SuperSDL/profiler.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 
 namespace sps {
 
 CGame::CGame(const char *pOrgName, const char *pGameName) 
 	: CLoggable("game"), m_Renderer(&m_Engine) {
 	m_Stop = false;
+	m_Headless = false;
+	m_Profiling = false;
+	m_UpdateStep = 1.0 / 60.0;
+	// Avoid the spiral of death when a frame takes too long.
+	m_MaxFrameTime = 0.25;
 	m_pOrgName = pOrgName;
 	m_pGameName = pGameName;
+	m_Pacer.setTargetFrameRate(60.0);
 }
 
 void CGame::start() {
 	Log()->info("Starting game.");
+	if (m_Headless) {
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+		SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+	}
+	if (SDL_getenv("SUPERSDL_PROFILE"))
+		m_Profiling = true;
+
+	CProfiler::get().setEnabled(m_Profiling);
+	SPS_PROFILE_THREAD("main");
+
+	CStartup &Startup = m_Engine.startup();
+	Startup.begin();
 	m_Engine.init(m_pOrgName, m_pGameName);
+	applyConfig(ConfigValues(), m_Engine.config().get(), false);
+	m_World.init(&m_Engine.jobs());
+
+	// Assets requested now are decoded while the renderer starts.
+	m_Renderer.assets().start(&m_Engine.jobs());
+	Startup.time("onPreload", [this]() {
+		SPS_PROFILE_SCOPE("onPreload");
+		onPreload();
+	});
 	m_Renderer.init();
+	m_Engine.waitForStartup();
+
+	Startup.time("onLoad", [this]() {
+		SPS_PROFILE_SCOPE("onLoad");
+		onLoad();
+	});
+	run();
 
-	stop();
-	while (!m_Stop) {}
+	const FrameStats &Stats = getFrameStats();
+	Log()->info("Ran {} frames and {} updates, avg frame time {:.3f}ms, pacing error {:.3f}ms, {} missed deadlines.",
+				Stats.m_FrameCount, Stats.m_UpdateCount, Stats.m_AverageFrameTime * 1000.0,
+				Stats.m_PacingError * 1000.0, Stats.m_MissedDeadlines);
+	const MemoryStats &Memory = getMemoryStats();
+	if (isTrackingHeap())
+		Log()->info("Heap allocations: {} in the last frame, {} frames in a row without, at most {} in a frame; frame arenas {} KiB at peak.",
+					Memory.m_FrameAllocations, Memory.m_QuietFrames, Memory.m_MaxFrameAllocations, Memory.m_ArenaPeak >> 10);
+
+	// Components may hold renderer resources.
+	m_World.quit();
+	m_Renderer.quit();
+
+	if (m_Profiling) {
+		std::string Path = m_Engine.getConfigPath() + "trace.json";
+		if (CProfiler::get().exportChromeTrace(Path))
+			Log()->info("Wrote profile to {}", Path);
+		else
+			Log()->error("Couldn't write profile to {}", Path);
+	}
 
 	m_Engine.quit();
 }
 
+void CGame::run() {
+	using clock_t = std::chrono::steady_clock;
+
+	auto Previous = clock_t::now();
+	double Accumulator = 0.0;
+	m_Pacer.reset();
+
+	while (!m_Stop) {
+		SPS_PROFILE_SCOPE("frame");
+		auto Now = clock_t::now();
+		double FrameTime = std::chrono::duration<double>(Now - Previous).count();
+		Previous = Now;
+		Accumulator += std::min(FrameTime, m_MaxFrameTime);
+
+		// The GPU may hold the frame back, input sampled before that would
+		// be stale by the time the simulation reads it.
+		m_Renderer.waitForFrame();
+
+		{
+			SPS_PROFILE_SCOPE("events");
+			m_Input.pump();
+			m_Input.update();
+			if (m_Input.snapshot().m_QuitRequested)
+				stop();
+			m_Engine.audio().update();
+
+			ConfigValues PreviousConfig;
+			if (m_Engine.config().poll(PreviousConfig))
+				applyConfig(PreviousConfig, m_Engine.config().get(), true);
+		}
+
+		while (Accumulator >= m_UpdateStep) {
+			SPS_PROFILE_SCOPE("update");
+			m_World.update(m_UpdateStep);
+			onUpdate(m_UpdateStep);
+			m_World.flush();
+			m_Input.consume();
+			m_Pacer.countUpdate();
+			Accumulator -= m_UpdateStep;
+		}
+
+		{
+			SPS_PROFILE_SCOPE("render");
+			m_Renderer.beginFrame();
+			onRender(Accumulator / m_UpdateStep);
+			// Also drops what onRender declared when no frame was started.
+			m_Renderer.endFrame();
+		}
+
+		if (!m_Engine.startup().isFinished() && m_Renderer.getFrameNumber() > 0)
+			m_Engine.startup().finish();
+
+		// Every job of the frame is done, its scratch memory can go.
+		m_Engine.memory().endFrame();
+
+		SPS_PROFILE_SCOPE("pace");
+		m_Pacer.waitForNextFrame();
+	}
+}
+
+void CGame::applyConfig(const ConfigValues &Previous, const ConfigValues &Values, bool Running) {
+	// Settings the game changed itself survive edits of unrelated keys.
+	auto Changed = [](const auto &Old, const auto &New) { return New && New != Old; };
+
+	if (Changed(Previous.m_Width, Values.m_Width) || Changed(Previous.m_Height, Values.m_Height)) {
+		vk::Extent2D Size = m_Renderer.getWindowSize();
+		m_Renderer.setWindowSize(Values.m_Width.value_or(Size.width), Values.m_Height.value_or(Size.height));
+	}
+	if (Changed(Previous.m_PresentMode, Values.m_PresentMode))
+		m_Renderer.setPresentMode(*Values.m_PresentMode);
+	if (Changed(Previous.m_SwapChainImages, Values.m_SwapChainImages))
+		m_Renderer.setSwapChainImages(*Values.m_SwapChainImages);
+	if (Changed(Previous.m_TargetFrameRate, Values.m_TargetFrameRate))
+		m_Pacer.setTargetFrameRate(*Values.m_TargetFrameRate);
+	if (Changed(Previous.m_Profiler, Values.m_Profiler)) {
+		// Once on, whatever was recorded is still written on exit.
+		m_Profiling = m_Profiling || *Values.m_Profiler;
+		CProfiler::get().setEnabled(*Values.m_Profiler);
+	}
+
+	if (!Running) {
+		if (Values.m_FramesInFlight)
+			m_Renderer.setFramesInFlight(*Values.m_FramesInFlight);
+		if (Values.m_Validation)
+			m_Renderer.setValidation(*Values.m_Validation);
+		if (Values.m_Bindless)
+			m_Renderer.setBindless(*Values.m_Bindless);
+		return;
+	}
+
+	if (Changed(Previous.m_WorkerThreads, Values.m_WorkerThreads))
+		Log()->warn("worker_threads changed, restart to apply it");
+	if (Changed(Previous.m_FramesInFlight, Values.m_FramesInFlight))
+		Log()->warn("frames_in_flight changed, restart to apply it");
+	if (Changed(Previous.m_Validation, Values.m_Validation))
+		Log()->warn("validation changed, restart to apply it");
+	if (Changed(Previous.m_Bindless, Values.m_Bindless))
+		Log()->warn("bindless changed, restart to apply it");
+}
+
 void CGame::stop() {
 	m_Stop = true;
 }
 
+void CGame::setHeadless(bool Headless, uint32_t Width, uint32_t Height) {
+	m_Headless = Headless;
+	m_Renderer.setHeadless(Headless, Width, Height);
+}
+
+void CGame::setUpdateRate(double Hz) {
+	// A step of 0, negative or NaN would never leave the update loop.
+	if (!(Hz > 0.0) || !std::isfinite(Hz)) {
+		Log()->error("Update rate must be positive, ignoring {}", Hz);
+		return;
+	}
+	m_UpdateStep = 1.0 / Hz;
+}
+
+void CGame::setTargetFrameRate(double Fps) {
+	m_Pacer.setTargetFrameRate(Fps);
+}
+
 } // namespace sps
@@ -0,0 +1,507 @@
+#include <SDL.h>
+#include <SuperSDL/asset_streamer.hpp>
+#include <SuperSDL/profiler.hpp>
+#include <SuperSDL/renderer.hpp>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace sps {
+
+static bool readFile(const std::string &Path, std::vector<uint8_t> &Data) {
+	std::ifstream File(Path, std::ios::binary);
+	if (!File)
+		return false;
+	Data.assign(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+	return !File.bad();
+}
+
+// SDL2 only decodes BMP without SDL_image, games with other formats pass
+// their own decoder.
+static bool decodeBmp(const std::string &Path, TextureData &Texture) {
+	SDL_Surface *pLoaded = SDL_LoadBMP(Path.c_str());
+	if (!pLoaded)
+		return false;
+	SDL_Surface *pSurface = SDL_ConvertSurfaceFormat(pLoaded, SDL_PIXELFORMAT_RGBA32, 0);
+	SDL_FreeSurface(pLoaded);
+	if (!pSurface)
+		return false;
+
+	Texture.m_Width = pSurface->w;
+	Texture.m_Height = pSurface->h;
+	Texture.m_Pixels.resize(size_t(Texture.m_Width) * Texture.m_Height * 4);
+	size_t RowSize = size_t(Texture.m_Width) * 4;
+	for (uint32_t y = 0; y < Texture.m_Height; y++)
+		std::memcpy(&Texture.m_Pixels[y * RowSize], static_cast<uint8_t *>(pSurface->pixels) + y * pSurface->pitch, RowSize);
+
+	SDL_FreeSurface(pSurface);
+	return true;
+}
+
+CAssetStreamer::CAssetStreamer() : CLoggable("assets") {
+	m_pRenderer = nullptr;
+	m_pJobs = nullptr;
+	m_TransferFamily = 0;
+	m_GraphicsFamily = 0;
+	m_FirstBatch = 0;
+	m_BatchCount = 0;
+	m_StagingSize = 0;
+	m_StagingHead = 0;
+	m_StagingTail = 0;
+}
+
+void CAssetStreamer::start(CJobSystem *pJobs) {
+	m_pJobs = pJobs;
+	m_Assets.clear();
+	m_Assets.emplace_back();
+	m_Stats = AssetStreamerStats();
+}
+
+void CAssetStreamer::init(CRenderer *pRenderer, CJobSystem *pJobs, vk::Queue TransferQueue, uint32_t TransferFamily, uint32_t GraphicsFamily, vk::DeviceSize StagingSize) {
+	if (!m_pJobs)
+		start(pJobs);
+	m_pRenderer = pRenderer;
+	m_Device = m_pRenderer->getDevice();
+	m_TransferQueue = TransferQueue;
+	m_TransferFamily = TransferFamily;
+	m_GraphicsFamily = GraphicsFamily;
+
+	m_CommandPool = m_Device.createCommandPool(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_TransferFamily));
+	auto CommandBuffers = m_Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(m_CommandPool, vk::CommandBufferLevel::ePrimary, MaxBatches));
+
+	m_Batches.resize(MaxBatches);
+	for (uint32_t i = 0; i < MaxBatches; i++) {
+		m_Batches[i].m_CommandBuffer = CommandBuffers[i];
+		m_Batches[i].m_Fence = m_Device.createFence(vk::FenceCreateInfo());
+	}
+	m_FirstBatch = 0;
+	m_BatchCount = 0;
+
+	m_StagingSize = StagingSize;
+	m_pRenderer->createBuffer(m_StagingSize, vk::BufferUsageFlagBits::eTransferSrc,
+							  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+							  m_StagingBuffer, m_StagingMemory);
+	m_StagingHead = 0;
+	m_StagingTail = 0;
+
+	m_Stats.m_StagingCapacity = m_StagingSize;
+
+	if (hasDedicatedQueue())
+		Log()->info("Streaming assets on transfer queue family {}", m_TransferFamily);
+	else
+		Log()->info("No dedicated transfer queue, streaming assets on the graphics queue");
+}
+
+void CAssetStreamer::quit() {
+	// Workers may still be decoding into assets we are about to free.
+	m_pJobs->wait(m_Decoding);
+
+	uint32_t Leaks = 0;
+	for (Asset *pAsset : m_Assets) {
+		if (!pAsset)
+			continue;
+		if (!pAsset->m_Released && Leaks++ < 16)
+			Log()->warn("Asset '{}' was never released", pAsset->m_Name);
+		destroy(*pAsset);
+		m_AssetPool.destroy(pAsset);
+	}
+	if (Leaks > 0)
+		Log()->warn("{} assets were never released", Leaks);
+	m_Assets.clear();
+	m_Generations.clear();
+	m_FreeIds.clear();
+	m_Decoded.clear();
+	m_Uploadable.clear();
+	m_Released.clear();
+
+	for (auto &Batch : m_Batches)
+		m_Device.destroyFence(Batch.m_Fence);
+	m_Batches.clear();
+	m_Device.destroyCommandPool(m_CommandPool);
+
+	m_pRenderer->destroyBuffer(m_StagingBuffer, m_StagingMemory);
+	m_pJobs = nullptr;
+}
+
+AssetHandle CAssetStreamer::create(EAssetType Type, const std::string &Name) {
+	uint32_t Id;
+	if (!m_FreeIds.empty()) {
+		Id = m_FreeIds.back();
+		m_FreeIds.pop_back();
+	} else {
+		Id = m_Assets.size();
+		m_Assets.emplace_back();
+		m_Generations.push_back(0);
+	}
+	// Skips 0 when it wraps around.
+	if (++m_Generations[Id] == 0)
+		m_Generations[Id] = 1;
+
+	m_Assets[Id] = m_AssetPool.create();
+	Asset &Asset = *m_Assets[Id];
+	Asset.m_Type = Type;
+	Asset.m_State = ASSET_PENDING;
+	Asset.m_Name = Name;
+	Asset.m_RequestTime = std::chrono::steady_clock::now();
+	m_Stats.m_Pending++;
+	return AssetHandle{Id, m_Generations[Id]};
+}
+
+void CAssetStreamer::decode(Asset *pAsset, uint32_t Id) {
+	SPS_PROFILE_SCOPE("decodeAsset");
+	bool Decoded = false;
+	try {
+		if (pAsset->m_Type == ASSET_TEXTURE) {
+			TextureData &Texture = pAsset->m_Texture;
+			Decoded = pAsset->m_DecodeTexture(Texture) && Texture.m_Width > 0 && Texture.m_Height > 0 &&
+					  Texture.m_Pixels.size() == size_t(Texture.m_Width) * Texture.m_Height * 4;
+		} else {
+			Decoded = pAsset->m_ReadBuffer(pAsset->m_Data) && !pAsset->m_Data.empty();
+		}
+	} catch (std::exception &Error) {
+		Log()->error("Decoding {} threw: {}", pAsset->m_Name, Error.what());
+	}
+
+	if (!Decoded)
+		Log()->error("Failed to load {}", pAsset->m_Name);
+	pAsset->m_Decoded = Decoded;
+	pAsset->m_DecodeTexture = nullptr;
+	pAsset->m_ReadBuffer = nullptr;
+
+	std::lock_guard<std::mutex> Lock(m_DecodedMutex);
+	m_Decoded.push_back(Id);
+}
+
+AssetHandle CAssetStreamer::loadTexture(const std::string &Path) {
+	return loadTexture(Path, [Path](TextureData &Texture) { return decodeBmp(Path, Texture); });
+}
+
+AssetHandle CAssetStreamer::loadTexture(const std::string &Name, std::function<bool(TextureData &)> Decode) {
+	AssetHandle Handle = create(ASSET_TEXTURE, Name);
+	Asset *pAsset = m_Assets[Handle.m_Id];
+	pAsset->m_DecodeTexture = std::move(Decode);
+
+	uint32_t Id = Handle.m_Id;
+	m_pJobs->schedule([this, pAsset, Id]() { decode(pAsset, Id); }, &m_Decoding);
+	return Handle;
+}
+
+AssetHandle CAssetStreamer::loadBuffer(const std::string &Path, vk::BufferUsageFlags Usage) {
+	return loadBuffer(Path, Usage, [Path](std::vector<uint8_t> &Data) { return readFile(Path, Data); });
+}
+
+AssetHandle CAssetStreamer::loadBuffer(const std::string &Name, vk::BufferUsageFlags Usage, std::function<bool(std::vector<uint8_t> &)> Read) {
+	AssetHandle Handle = create(ASSET_BUFFER, Name);
+	Asset *pAsset = m_Assets[Handle.m_Id];
+	pAsset->m_ReadBuffer = std::move(Read);
+	pAsset->m_BufferUsage = Usage;
+
+	uint32_t Id = Handle.m_Id;
+	m_pJobs->schedule([this, pAsset, Id]() { decode(pAsset, Id); }, &m_Decoding);
+	return Handle;
+}
+
+bool CAssetStreamer::allocateStaging(vk::DeviceSize Size, vk::DeviceSize &Offset) {
+	// 16 satisfies the texel and the 4 byte alignment of buffer to image copies.
+	uint64_t Position = (m_StagingHead + 15) & ~uint64_t(15);
+	// Allocations never wrap, skip to the start of the ring instead.
+	if (Position % m_StagingSize + Size > m_StagingSize)
+		Position = (Position / m_StagingSize + 1) * m_StagingSize;
+	if (Position + Size - m_StagingTail > m_StagingSize)
+		return false;
+
+	Offset = Position % m_StagingSize;
+	m_StagingHead = Position + Size;
+	return true;
+}
+
+bool CAssetStreamer::recordUpload(vk::CommandBuffer Cmd, Asset &Asset) {
+	const void *pData = Asset.m_Type == ASSET_TEXTURE ? static_cast<const void *>(Asset.m_Texture.m_Pixels.data()) : Asset.m_Data.data();
+	vk::DeviceSize Size = Asset.m_Type == ASSET_TEXTURE ? Asset.m_Texture.m_Pixels.size() : Asset.m_Data.size();
+
+	vk::DeviceSize Offset;
+	if (!allocateStaging(Size, Offset))
+		return false;
+
+	std::memcpy(static_cast<uint8_t *>(m_StagingMemory.m_pMapped) + Offset, pData, Size);
+
+	// The graphics queue acquires the resource once the batch finished.
+	uint32_t SrcFamily = hasDedicatedQueue() ? m_TransferFamily : VK_QUEUE_FAMILY_IGNORED;
+	uint32_t DstFamily = hasDedicatedQueue() ? m_GraphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+	vk::AccessFlags DstAccess = hasDedicatedQueue() ? vk::AccessFlags() : vk::AccessFlagBits::eMemoryRead;
+
+	if (Asset.m_Type == ASSET_TEXTURE) {
+		vk::ImageSubresourceRange Range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+		vk::ImageMemoryBarrier ToTransfer(
+			vk::AccessFlags(), vk::AccessFlagBits::eTransferWrite,
+			vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, Asset.m_Image, Range);
+		Cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+							vk::DependencyFlags(), nullptr, nullptr, ToTransfer);
+
+		vk::BufferImageCopy Region(
+			Offset, 0, 0,
+			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+			vk::Offset3D(0, 0, 0), vk::Extent3D(Asset.m_Extent.width, Asset.m_Extent.height, 1));
+		Cmd.copyBufferToImage(m_StagingBuffer, Asset.m_Image, vk::ImageLayout::eTransferDstOptimal, Region);
+
+		vk::ImageMemoryBarrier Release(
+			vk::AccessFlagBits::eTransferWrite, DstAccess,
+			vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+			SrcFamily, DstFamily, Asset.m_Image, Range);
+		Cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands,
+							vk::DependencyFlags(), nullptr, nullptr, Release);
+
+		Asset.m_Texture = TextureData();
+	} else {
+		Cmd.copyBuffer(m_StagingBuffer, Asset.m_Buffer, vk::BufferCopy(Offset, 0, Size));
+
+		vk::BufferMemoryBarrier Release(
+			vk::AccessFlagBits::eTransferWrite, DstAccess,
+			SrcFamily, DstFamily, Asset.m_Buffer, 0, VK_WHOLE_SIZE);
+		Cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands,
+							vk::DependencyFlags(), nullptr, Release, nullptr);
+
+		Asset.m_Data = std::vector<uint8_t>();
+	}
+
+	m_Stats.m_BytesUploaded += Size;
+	return true;
+}
+
+void CAssetStreamer::recordAcquire(vk::CommandBuffer Cmd, Asset &Asset) {
+	// Must match the release recorded on the transfer queue.
+	if (Asset.m_Type == ASSET_TEXTURE) {
+		vk::ImageMemoryBarrier Acquire(
+			vk::AccessFlags(), vk::AccessFlagBits::eShaderRead,
+			vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+			m_TransferFamily, m_GraphicsFamily, Asset.m_Image,
+			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+		Cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eAllCommands,
+							vk::DependencyFlags(), nullptr, nullptr, Acquire);
+	} else {
+		vk::BufferMemoryBarrier Acquire(
+			vk::AccessFlags(), vk::AccessFlagBits::eMemoryRead,
+			m_TransferFamily, m_GraphicsFamily, Asset.m_Buffer, 0, VK_WHOLE_SIZE);
+		Cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eAllCommands,
+							vk::DependencyFlags(), nullptr, Acquire, nullptr);
+	}
+}
+
+void CAssetStreamer::finishBatches(vk::CommandBuffer FrameCmd) {
+	auto Now = std::chrono::steady_clock::now();
+
+	while (m_BatchCount > 0) {
+		Batch &Oldest = m_Batches[m_FirstBatch];
+		if (m_Device.getFenceStatus(Oldest.m_Fence) != vk::Result::eSuccess)
+			break;
+
+		for (uint32_t Id : Oldest.m_Assets) {
+			Asset &Asset = *m_Assets[Id];
+			if (hasDedicatedQueue())
+				recordAcquire(FrameCmd, Asset);
+			if (Asset.m_Type == ASSET_TEXTURE)
+				Asset.m_TextureIndex = m_pRenderer->textures().add(Asset.m_ImageView);
+			Asset.m_State = ASSET_READY;
+			m_Stats.m_Pending--;
+			SPS_LOG_DEBUG("Loaded {} in {:.2f}ms", Asset.m_Name, std::chrono::duration<double, std::milli>(Now - Asset.m_RequestTime).count());
+		}
+
+		Oldest.m_Assets.clear();
+		m_Device.resetFences(Oldest.m_Fence);
+		m_StagingTail = Oldest.m_StagingEnd;
+		m_FirstBatch = (m_FirstBatch + 1) % MaxBatches;
+		m_BatchCount--;
+	}
+}
+
+void CAssetStreamer::submitBatch() {
+	// Nothing in flight, start at the beginning so a large upload never waits
+	// for space that isn't coming back.
+	if (m_BatchCount == 0)
+		m_StagingHead = m_StagingTail = 0;
+
+	Batch &Next = m_Batches[(m_FirstBatch + m_BatchCount) % MaxBatches];
+	vk::CommandBuffer Cmd = Next.m_CommandBuffer;
+	Cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+	// Uploads go in request order, the first one that doesn't fit waits for
+	// older batches to free staging space.
+	size_t Done = 0;
+	for (; Done < m_Uploadable.size(); Done++) {
+		uint32_t Id = m_Uploadable[Done];
+		Asset &Asset = *m_Assets[Id];
+
+		vk::DeviceSize Size = Asset.m_Type == ASSET_TEXTURE ? Asset.m_Texture.m_Pixels.size() : Asset.m_Data.size();
+		if (Size > m_StagingSize) {
+			Log()->error("{} needs {} bytes of staging memory, only {} are available", Asset.m_Name, Size, m_StagingSize);
+			Asset.m_State = ASSET_FAILED;
+			m_Stats.m_Pending--;
+			continue;
+		}
+
+		if (!Asset.m_Image && !Asset.m_Buffer) {
+			try {
+				if (Asset.m_Type == ASSET_TEXTURE) {
+					Asset.m_Extent = vk::Extent2D(Asset.m_Texture.m_Width, Asset.m_Texture.m_Height);
+					vk::ImageCreateInfo ImageInfo(
+						vk::ImageCreateFlags(), vk::ImageType::e2D, vk::Format::eR8G8B8A8Unorm,
+						vk::Extent3D(Asset.m_Extent.width, Asset.m_Extent.height, 1), 1, 1,
+						vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal,
+						vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+						vk::SharingMode::eExclusive);
+					Asset.m_Image = m_Device.createImage(ImageInfo);
+					Asset.m_Memory = m_pRenderer->getAllocator().allocateImage(Asset.m_Image, vk::MemoryPropertyFlagBits::eDeviceLocal);
+					Asset.m_ImageView = m_Device.createImageView(vk::ImageViewCreateInfo(
+						vk::ImageViewCreateFlags(), Asset.m_Image, vk::ImageViewType::e2D, vk::Format::eR8G8B8A8Unorm,
+						vk::ComponentMapping(), vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)));
+				} else {
+					m_pRenderer->createBuffer(Size, Asset.m_BufferUsage | vk::BufferUsageFlagBits::eTransferDst,
+											  vk::MemoryPropertyFlagBits::eDeviceLocal, Asset.m_Buffer, Asset.m_Memory);
+				}
+			} catch (std::exception &Error) {
+				Log()->error("Failed to create {}: {}", Asset.m_Name, Error.what());
+				destroy(Asset);
+				Asset.m_State = ASSET_FAILED;
+				m_Stats.m_Pending--;
+				continue;
+			}
+		}
+
+		if (!recordUpload(Cmd, Asset))
+			break;
+		Next.m_Assets.push_back(Id);
+	}
+	m_Uploadable.erase(m_Uploadable.begin(), m_Uploadable.begin() + Done);
+
+	Cmd.end();
+	if (Next.m_Assets.empty())
+		return;
+
+	Next.m_StagingEnd = m_StagingHead;
+	vk::SubmitInfo SubmitInfo(0, nullptr, nullptr, 1, &Cmd);
+	m_TransferQueue.submit(SubmitInfo, Next.m_Fence);
+	m_BatchCount++;
+}
+
+void CAssetStreamer::update(vk::CommandBuffer FrameCmd) {
+	SPS_PROFILE_SCOPE("CAssetStreamer::update");
+	finishBatches(FrameCmd);
+
+	// Assets released while loading wait until workers and the transfer
+	// queue are done with them.
+	for (size_t i = 0; i < m_Released.size();) {
+		if (m_Assets[m_Released[i]]->m_State == ASSET_PENDING) {
+			i++;
+			continue;
+		}
+		retire(m_Released[i]);
+		m_Released[i] = m_Released.back();
+		m_Released.pop_back();
+	}
+
+	{
+		std::lock_guard<std::mutex> Lock(m_DecodedMutex);
+		for (uint32_t Id : m_Decoded) {
+			Asset &Asset = *m_Assets[Id];
+			if (Asset.m_Decoded) {
+				m_Uploadable.push_back(Id);
+			} else {
+				Asset.m_State = ASSET_FAILED;
+				m_Stats.m_Pending--;
+			}
+		}
+		m_Decoded.clear();
+	}
+
+	if (!m_Uploadable.empty() && m_BatchCount < MaxBatches) {
+		SPS_PROFILE_SCOPE("submitUploads");
+		submitBatch();
+	}
+
+	m_Stats.m_BatchesInFlight = m_BatchCount;
+	m_Stats.m_StagingUsed = m_StagingHead - m_StagingTail;
+}
+
+void CAssetStreamer::release(AssetHandle Handle) {
+	Asset *pAsset = get(Handle);
+	if (!pAsset)
+		return;
+	pAsset->m_Released = true;
+	if (pAsset->m_State == ASSET_PENDING)
+		m_Released.push_back(Handle.m_Id);
+	else
+		retire(Handle.m_Id);
+}
+
+void CAssetStreamer::destroy(Asset &Asset) {
+	if (Asset.m_ImageView)
+		m_Device.destroyImageView(Asset.m_ImageView);
+	if (Asset.m_Image)
+		m_Device.destroyImage(Asset.m_Image);
+	if (Asset.m_Buffer)
+		m_Device.destroyBuffer(Asset.m_Buffer);
+	if (Asset.m_Memory)
+		m_pRenderer->getAllocator().free(Asset.m_Memory);
+	Asset.m_ImageView = nullptr;
+	Asset.m_Image = nullptr;
+	Asset.m_Buffer = nullptr;
+	Asset.m_Memory = GpuAllocation();
+}
+
+void CAssetStreamer::retire(uint32_t Id) {
+	Asset &Asset = *m_Assets[Id];
+	CGpuResources &Resources = m_pRenderer->resources();
+	m_pRenderer->textures().remove(Asset.m_TextureIndex);
+	// Either an image or a buffer, the memory goes with it.
+	Resources.destroyLater(Asset.m_ImageView);
+	if (Asset.m_Image)
+		Resources.destroyLater(Asset.m_Image, Asset.m_Memory);
+	else
+		Resources.destroyLater(Asset.m_Buffer, Asset.m_Memory);
+	m_AssetPool.destroy(m_Assets[Id]);
+	m_Assets[Id] = nullptr;
+	m_FreeIds.push_back(Id);
+}
+
+CAssetStreamer::Asset *CAssetStreamer::get(AssetHandle Handle) const {
+	if (Handle.m_Id == 0 || Handle.m_Id >= m_Assets.size() || Handle.m_Generation != m_Generations[Handle.m_Id])
+		return nullptr;
+	Asset *pAsset = m_Assets[Handle.m_Id];
+	return pAsset && !pAsset->m_Released ? pAsset : nullptr;
+}
+
+EAssetState CAssetStreamer::getState(AssetHandle Handle) const {
+	Asset *pAsset = get(Handle);
+	return pAsset ? pAsset->m_State.load() : ASSET_FAILED;
+}
+
+vk::ImageView CAssetStreamer::getImageView(AssetHandle Handle) const {
+	Asset *pAsset = get(Handle);
+	return pAsset && pAsset->m_State == ASSET_READY ? pAsset->m_ImageView : vk::ImageView();
+}
+
+uint32_t CAssetStreamer::getTextureIndex(AssetHandle Handle) const {
+	Asset *pAsset = get(Handle);
+	return pAsset && pAsset->m_State == ASSET_READY ? pAsset->m_TextureIndex : CTextureTable::WhiteTexture;
+}
+
+vk::Image CAssetStreamer::getImage(AssetHandle Handle) const {
+	Asset *pAsset = get(Handle);
+	return pAsset && pAsset->m_State == ASSET_READY ? pAsset->m_Image : vk::Image();
+}
+
+vk::Extent2D CAssetStreamer::getExtent(AssetHandle Handle) const {
+	Asset *pAsset = get(Handle);
+	return pAsset && pAsset->m_State == ASSET_READY ? pAsset->m_Extent : vk::Extent2D();
+}
+
+vk::Buffer CAssetStreamer::getBuffer(AssetHandle Handle) const {
+	Asset *pAsset = get(Handle);
+	return pAsset && pAsset->m_State == ASSET_READY ? pAsset->m_Buffer : vk::Buffer();
+}
+
+} // namespace sps
@@ -1,38 +1,419 @@
 #include <SuperSDL/color.hpp>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SPS_COLOR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Compiled with a target attribute and picked at run time, so the library
+// itself keeps building for the baseline instruction set.
+#if defined(SPS_COLOR_SSE2) && defined(__GNUC__)
+#define SPS_COLOR_AVX2 1
+#include <immintrin.h>
+#endif
 
 namespace sps {
-CColor::CColor() : CColor(0) {}
 
-CColor::CColor(int r, int g, int b, int a) {
-	this->r = r / 255.f;
-	this->g = g / 255.f;
-	this->b = b / 255.f;
-	this->a = a / 255.f;
+namespace {
+
+// Linear to sRGB is approximated by a line per segment. The segments split
+// every octave of [2^-13, 1) into 16, below it the result rounds to 0 anyway.
+constexpr uint32_t SrgbMinBits = 0x39000000; // 2^-13
+constexpr uint32_t SrgbMaxBits = 0x3F7FFFFF; // just below 1
+constexpr uint32_t SrgbSegmentShift = 19;
+constexpr uint32_t SrgbSegments = ((SrgbMaxBits - SrgbMinBits) >> SrgbSegmentShift) + 1;
+
+struct SrgbSegment {
+	// In levels, including the 0.5 that rounds the truncation.
+	float m_Base;
+	float m_Slope;
+};
+
+struct ColorTables {
+	float m_aToLinear[256];
+	SrgbSegment m_aToSrgb[SrgbSegments];
+
+	static double srgbToLinear(double v) {
+		return v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+	}
+
+	static double linearToSrgb(double v) {
+		return v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+	}
+
+	static float fromBits(uint32_t Bits) {
+		float Value;
+		std::memcpy(&Value, &Bits, sizeof(Value));
+		return Value;
+	}
+
+	ColorTables() {
+		for (int i = 0; i < 256; i++)
+			m_aToLinear[i] = float(srgbToLinear(i / 255.0));
+
+		for (uint32_t i = 0; i < SrgbSegments; i++) {
+			double Start = fromBits(SrgbMinBits + (i << SrgbSegmentShift));
+			double End = fromBits(SrgbMinBits + ((i + 1) << SrgbSegmentShift));
+			double StartLevel = linearToSrgb(Start) * 255.0;
+			double EndLevel = linearToSrgb(End) * 255.0;
+			// The curve is concave, the chord lies below it. Lifting it by
+			// half of its largest distance, at the midpoint, halves the error.
+			double Mid = linearToSrgb((Start + End) * 0.5) * 255.0;
+			double Lift = (Mid - (StartLevel + EndLevel) * 0.5) * 0.5;
+			m_aToSrgb[i].m_Base = float(StartLevel + Lift + 0.5);
+			m_aToSrgb[i].m_Slope = float(EndLevel - StartLevel);
+		}
+	}
+};
+
+const ColorTables &tables() {
+	static const ColorTables s_Tables;
+	return s_Tables;
+}
+
+constexpr float SrgbFracScale = 1.0f / (1 << SrgbSegmentShift);
+
+float clamp01(float v) {
+	// Written like maxps/minps so that NaN becomes 0 on every path.
+	v = v > 0.0f ? v : 0.0f;
+	return v < 1.0f ? v : 1.0f;
+}
+
+uint32_t toSrgb8(const SrgbSegment *pSegments, float v) {
+	float Min = ColorTables::fromBits(SrgbMinBits);
+	float Max = ColorTables::fromBits(SrgbMaxBits);
+	v = v > Min ? v : Min;
+	v = v < Max ? v : Max;
+
+	uint32_t Bits;
+	std::memcpy(&Bits, &v, sizeof(Bits));
+	uint32_t Offset = Bits - SrgbMinBits;
+	const SrgbSegment &Segment = pSegments[Offset >> SrgbSegmentShift];
+	float Frac = float(Offset & ((1 << SrgbSegmentShift) - 1)) * SrgbFracScale;
+	return uint32_t(Segment.m_Base + Segment.m_Slope * Frac);
+}
+
+// Scalar
+
+void unpackSrgbScalar(const uint32_t *pSrc, const ColorPlanes &Dst, size_t Count) {
+	const float *pToLinear = tables().m_aToLinear;
+	for (size_t i = 0; i < Count; i++) {
+		uint32_t Packed = pSrc[i];
+		Dst.m_pR[i] = pToLinear[Packed & 0xFF];
+		Dst.m_pG[i] = pToLinear[(Packed >> 8) & 0xFF];
+		Dst.m_pB[i] = pToLinear[(Packed >> 16) & 0xFF];
+		Dst.m_pA[i] = float(Packed >> 24) * (1.0f / 255.0f);
+	}
+}
+
+void packSrgbScalar(const ColorPlanes &Src, uint32_t *pDst, size_t Count) {
+	const SrgbSegment *pSegments = tables().m_aToSrgb;
+	for (size_t i = 0; i < Count; i++) {
+		uint32_t A = uint32_t(clamp01(Src.m_pA[i]) * 255.0f + 0.5f);
+		pDst[i] = toSrgb8(pSegments, Src.m_pR[i]) | (toSrgb8(pSegments, Src.m_pG[i]) << 8) |
+				  (toSrgb8(pSegments, Src.m_pB[i]) << 16) | (A << 24);
+	}
+}
+
+void premultiplyScalar(const ColorPlanes &Colors, size_t Count) {
+	for (size_t i = 0; i < Count; i++) {
+		float A = Colors.m_pA[i];
+		Colors.m_pR[i] *= A;
+		Colors.m_pG[i] *= A;
+		Colors.m_pB[i] *= A;
+	}
+}
+
+void blendOverScalar(const ColorPlanes &Dst, const ColorPlanes &Src, size_t Count) {
+	for (size_t i = 0; i < Count; i++) {
+		float Inv = 1.0f - Src.m_pA[i];
+		Dst.m_pR[i] = Src.m_pR[i] + Dst.m_pR[i] * Inv;
+		Dst.m_pG[i] = Src.m_pG[i] + Dst.m_pG[i] * Inv;
+		Dst.m_pB[i] = Src.m_pB[i] + Dst.m_pB[i] * Inv;
+		Dst.m_pA[i] = Src.m_pA[i] + Dst.m_pA[i] * Inv;
+	}
+}
+
+#ifdef SPS_COLOR_SSE2
+
+// Without gathers the table lookups are scalar either way, only the
+// deinterleaving and the alpha channel are vectorized.
+void unpackSrgbSse2(const uint32_t *pSrc, const ColorPlanes &Dst, size_t Count) {
+	const float *pToLinear = tables().m_aToLinear;
+	const __m128i ByteMask = _mm_set1_epi32(0xFF);
+	const __m128 AlphaScale = _mm_set1_ps(1.0f / 255.0f);
+	alignas(16) uint32_t aR[4], aG[4], aB[4];
+
+	size_t i = 0;
+	for (; i + 4 <= Count; i += 4) {
+		__m128i Packed = _mm_loadu_si128((const __m128i *)(pSrc + i));
+		_mm_store_si128((__m128i *)aR, _mm_and_si128(Packed, ByteMask));
+		_mm_store_si128((__m128i *)aG, _mm_and_si128(_mm_srli_epi32(Packed, 8), ByteMask));
+		_mm_store_si128((__m128i *)aB, _mm_and_si128(_mm_srli_epi32(Packed, 16), ByteMask));
+		__m128 A = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(Packed, 24)), AlphaScale);
+
+		_mm_storeu_ps(Dst.m_pR + i, _mm_setr_ps(pToLinear[aR[0]], pToLinear[aR[1]], pToLinear[aR[2]], pToLinear[aR[3]]));
+		_mm_storeu_ps(Dst.m_pG + i, _mm_setr_ps(pToLinear[aG[0]], pToLinear[aG[1]], pToLinear[aG[2]], pToLinear[aG[3]]));
+		_mm_storeu_ps(Dst.m_pB + i, _mm_setr_ps(pToLinear[aB[0]], pToLinear[aB[1]], pToLinear[aB[2]], pToLinear[aB[3]]));
+		_mm_storeu_ps(Dst.m_pA + i, A);
+	}
+
+	ColorPlanes Rest = {Dst.m_pR + i, Dst.m_pG + i, Dst.m_pB + i, Dst.m_pA + i};
+	unpackSrgbScalar(pSrc + i, Rest, Count - i);
+}
+
+__m128i toSrgb8Sse2(const SrgbSegment *pSegments, __m128 v) {
+	const __m128 Min = _mm_castsi128_ps(_mm_set1_epi32(SrgbMinBits));
+	const __m128 Max = _mm_castsi128_ps(_mm_set1_epi32(SrgbMaxBits));
+	v = _mm_min_ps(_mm_max_ps(v, Min), Max);
+
+	__m128i Offset = _mm_sub_epi32(_mm_castps_si128(v), _mm_set1_epi32(SrgbMinBits));
+	alignas(16) uint32_t aIndex[4];
+	_mm_store_si128((__m128i *)aIndex, _mm_srli_epi32(Offset, SrgbSegmentShift));
+	__m128 Base = _mm_setr_ps(pSegments[aIndex[0]].m_Base, pSegments[aIndex[1]].m_Base,
+							  pSegments[aIndex[2]].m_Base, pSegments[aIndex[3]].m_Base);
+	__m128 Slope = _mm_setr_ps(pSegments[aIndex[0]].m_Slope, pSegments[aIndex[1]].m_Slope,
+							   pSegments[aIndex[2]].m_Slope, pSegments[aIndex[3]].m_Slope);
+
+	__m128i FracBits = _mm_and_si128(Offset, _mm_set1_epi32((1 << SrgbSegmentShift) - 1));
+	__m128 Frac = _mm_mul_ps(_mm_cvtepi32_ps(FracBits), _mm_set1_ps(SrgbFracScale));
+	return _mm_cvttps_epi32(_mm_add_ps(Base, _mm_mul_ps(Slope, Frac)));
+}
+
+void packSrgbSse2(const ColorPlanes &Src, uint32_t *pDst, size_t Count) {
+	const SrgbSegment *pSegments = tables().m_aToSrgb;
+	const __m128 Zero = _mm_setzero_ps();
+	const __m128 One = _mm_set1_ps(1.0f);
+
+	size_t i = 0;
+	for (; i + 4 <= Count; i += 4) {
+		__m128i R = toSrgb8Sse2(pSegments, _mm_loadu_ps(Src.m_pR + i));
+		__m128i G = toSrgb8Sse2(pSegments, _mm_loadu_ps(Src.m_pG + i));
+		__m128i B = toSrgb8Sse2(pSegments, _mm_loadu_ps(Src.m_pB + i));
+		__m128 Alpha = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(Src.m_pA + i), Zero), One);
+		__m128i A = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(Alpha, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+
+		__m128i Packed = _mm_or_si128(_mm_or_si128(R, _mm_slli_epi32(G, 8)),
+									  _mm_or_si128(_mm_slli_epi32(B, 16), _mm_slli_epi32(A, 24)));
+		_mm_storeu_si128((__m128i *)(pDst + i), Packed);
+	}
+
+	ColorPlanes Rest = {Src.m_pR + i, Src.m_pG + i, Src.m_pB + i, Src.m_pA + i};
+	packSrgbScalar(Rest, pDst + i, Count - i);
+}
+
+void premultiplySse2(const ColorPlanes &Colors, size_t Count) {
+	size_t i = 0;
+	for (; i + 4 <= Count; i += 4) {
+		__m128 A = _mm_loadu_ps(Colors.m_pA + i);
+		_mm_storeu_ps(Colors.m_pR + i, _mm_mul_ps(_mm_loadu_ps(Colors.m_pR + i), A));
+		_mm_storeu_ps(Colors.m_pG + i, _mm_mul_ps(_mm_loadu_ps(Colors.m_pG + i), A));
+		_mm_storeu_ps(Colors.m_pB + i, _mm_mul_ps(_mm_loadu_ps(Colors.m_pB + i), A));
+	}
+
+	ColorPlanes Rest = {Colors.m_pR + i, Colors.m_pG + i, Colors.m_pB + i, Colors.m_pA + i};
+	premultiplyScalar(Rest, Count - i);
+}
+
+void blendOverSse2(const ColorPlanes &Dst, const ColorPlanes &Src, size_t Count) {
+	const __m128 One = _mm_set1_ps(1.0f);
+	size_t i = 0;
+	for (; i + 4 <= Count; i += 4) {
+		__m128 SrcA = _mm_loadu_ps(Src.m_pA + i);
+		__m128 Inv = _mm_sub_ps(One, SrcA);
+		_mm_storeu_ps(Dst.m_pR + i, _mm_add_ps(_mm_loadu_ps(Src.m_pR + i), _mm_mul_ps(_mm_loadu_ps(Dst.m_pR + i), Inv)));
+		_mm_storeu_ps(Dst.m_pG + i, _mm_add_ps(_mm_loadu_ps(Src.m_pG + i), _mm_mul_ps(_mm_loadu_ps(Dst.m_pG + i), Inv)));
+		_mm_storeu_ps(Dst.m_pB + i, _mm_add_ps(_mm_loadu_ps(Src.m_pB + i), _mm_mul_ps(_mm_loadu_ps(Dst.m_pB + i), Inv)));
+		_mm_storeu_ps(Dst.m_pA + i, _mm_add_ps(SrcA, _mm_mul_ps(_mm_loadu_ps(Dst.m_pA + i), Inv)));
+	}
+
+	ColorPlanes RestDst = {Dst.m_pR + i, Dst.m_pG + i, Dst.m_pB + i, Dst.m_pA + i};
+	ColorPlanes RestSrc = {Src.m_pR + i, Src.m_pG + i, Src.m_pB + i, Src.m_pA + i};
+	blendOverScalar(RestDst, RestSrc, Count - i);
+}
+
+#endif
+
+#ifdef SPS_COLOR_AVX2
+
+#define SPS_AVX2 __attribute__((target("avx2")))
+
+SPS_AVX2 void unpackSrgbAvx2(const uint32_t *pSrc, const ColorPlanes &Dst, size_t Count) {
+	const float *pToLinear = tables().m_aToLinear;
+	const __m256i ByteMask = _mm256_set1_epi32(0xFF);
+	const __m256 AlphaScale = _mm256_set1_ps(1.0f / 255.0f);
+
+	size_t i = 0;
+	for (; i + 8 <= Count; i += 8) {
+		__m256i Packed = _mm256_loadu_si256((const __m256i *)(pSrc + i));
+		__m256i R = _mm256_and_si256(Packed, ByteMask);
+		__m256i G = _mm256_and_si256(_mm256_srli_epi32(Packed, 8), ByteMask);
+		__m256i B = _mm256_and_si256(_mm256_srli_epi32(Packed, 16), ByteMask);
+		__m256 A = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(Packed, 24)), AlphaScale);
+
+		_mm256_storeu_ps(Dst.m_pR + i, _mm256_i32gather_ps(pToLinear, R, 4));
+		_mm256_storeu_ps(Dst.m_pG + i, _mm256_i32gather_ps(pToLinear, G, 4));
+		_mm256_storeu_ps(Dst.m_pB + i, _mm256_i32gather_ps(pToLinear, B, 4));
+		_mm256_storeu_ps(Dst.m_pA + i, A);
+	}
+
+	ColorPlanes Rest = {Dst.m_pR + i, Dst.m_pG + i, Dst.m_pB + i, Dst.m_pA + i};
+	unpackSrgbScalar(pSrc + i, Rest, Count - i);
+}
+
+SPS_AVX2 __m256i toSrgb8Avx2(const SrgbSegment *pSegments, __m256 v) {
+	const __m256 Min = _mm256_castsi256_ps(_mm256_set1_epi32(SrgbMinBits));
+	const __m256 Max = _mm256_castsi256_ps(_mm256_set1_epi32(SrgbMaxBits));
+	v = _mm256_min_ps(_mm256_max_ps(v, Min), Max);
+
+	__m256i Offset = _mm256_sub_epi32(_mm256_castps_si256(v), _mm256_set1_epi32(SrgbMinBits));
+	__m256i Index = _mm256_srli_epi32(Offset, SrgbSegmentShift);
+	// Segments are pairs of floats, hence the stride of 8 bytes.
+	__m256 Base = _mm256_i32gather_ps(&pSegments->m_Base, Index, 8);
+	__m256 Slope = _mm256_i32gather_ps(&pSegments->m_Slope, Index, 8);
+
+	__m256i FracBits = _mm256_and_si256(Offset, _mm256_set1_epi32((1 << SrgbSegmentShift) - 1));
+	__m256 Frac = _mm256_mul_ps(_mm256_cvtepi32_ps(FracBits), _mm256_set1_ps(SrgbFracScale));
+	return _mm256_cvttps_epi32(_mm256_add_ps(Base, _mm256_mul_ps(Slope, Frac)));
+}
+
+SPS_AVX2 void packSrgbAvx2(const ColorPlanes &Src, uint32_t *pDst, size_t Count) {
+	const SrgbSegment *pSegments = tables().m_aToSrgb;
+	const __m256 Zero = _mm256_setzero_ps();
+	const __m256 One = _mm256_set1_ps(1.0f);
+
+	size_t i = 0;
+	for (; i + 8 <= Count; i += 8) {
+		__m256i R = toSrgb8Avx2(pSegments, _mm256_loadu_ps(Src.m_pR + i));
+		__m256i G = toSrgb8Avx2(pSegments, _mm256_loadu_ps(Src.m_pG + i));
+		__m256i B = toSrgb8Avx2(pSegments, _mm256_loadu_ps(Src.m_pB + i));
+		__m256 Alpha = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(Src.m_pA + i), Zero), One);
+		__m256i A = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(Alpha, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+
+		__m256i Packed = _mm256_or_si256(_mm256_or_si256(R, _mm256_slli_epi32(G, 8)),
+										 _mm256_or_si256(_mm256_slli_epi32(B, 16), _mm256_slli_epi32(A, 24)));
+		_mm256_storeu_si256((__m256i *)(pDst + i), Packed);
+	}
+
+	ColorPlanes Rest = {Src.m_pR + i, Src.m_pG + i, Src.m_pB + i, Src.m_pA + i};
+	packSrgbScalar(Rest, pDst + i, Count - i);
+}
+
+SPS_AVX2 void premultiplyAvx2(const ColorPlanes &Colors, size_t Count) {
+	size_t i = 0;
+	for (; i + 8 <= Count; i += 8) {
+		__m256 A = _mm256_loadu_ps(Colors.m_pA + i);
+		_mm256_storeu_ps(Colors.m_pR + i, _mm256_mul_ps(_mm256_loadu_ps(Colors.m_pR + i), A));
+		_mm256_storeu_ps(Colors.m_pG + i, _mm256_mul_ps(_mm256_loadu_ps(Colors.m_pG + i), A));
+		_mm256_storeu_ps(Colors.m_pB + i, _mm256_mul_ps(_mm256_loadu_ps(Colors.m_pB + i), A));
+	}
+
+	ColorPlanes Rest = {Colors.m_pR + i, Colors.m_pG + i, Colors.m_pB + i, Colors.m_pA + i};
+	premultiplyScalar(Rest, Count - i);
 }
 
-CColor::CColor(int r, int g, int b) {
-	this->r = r / 255.f;
-	this->g = g / 255.f;
-	this->b = b / 255.f;
-	this->a = 1.f;
+SPS_AVX2 void blendOverAvx2(const ColorPlanes &Dst, const ColorPlanes &Src, size_t Count) {
+	const __m256 One = _mm256_set1_ps(1.0f);
+	size_t i = 0;
+	for (; i + 8 <= Count; i += 8) {
+		__m256 SrcA = _mm256_loadu_ps(Src.m_pA + i);
+		__m256 Inv = _mm256_sub_ps(One, SrcA);
+		_mm256_storeu_ps(Dst.m_pR + i, _mm256_add_ps(_mm256_loadu_ps(Src.m_pR + i), _mm256_mul_ps(_mm256_loadu_ps(Dst.m_pR + i), Inv)));
+		_mm256_storeu_ps(Dst.m_pG + i, _mm256_add_ps(_mm256_loadu_ps(Src.m_pG + i), _mm256_mul_ps(_mm256_loadu_ps(Dst.m_pG + i), Inv)));
+		_mm256_storeu_ps(Dst.m_pB + i, _mm256_add_ps(_mm256_loadu_ps(Src.m_pB + i), _mm256_mul_ps(_mm256_loadu_ps(Dst.m_pB + i), Inv)));
+		_mm256_storeu_ps(Dst.m_pA + i, _mm256_add_ps(SrcA, _mm256_mul_ps(_mm256_loadu_ps(Dst.m_pA + i), Inv)));
+	}
+
+	ColorPlanes RestDst = {Dst.m_pR + i, Dst.m_pG + i, Dst.m_pB + i, Dst.m_pA + i};
+	ColorPlanes RestSrc = {Src.m_pR + i, Src.m_pG + i, Src.m_pB + i, Src.m_pA + i};
+	blendOverScalar(RestDst, RestSrc, Count - i);
+}
+
+#undef SPS_AVX2
+
+#endif
+
+struct ColorKernelTable {
+	void (*m_pUnpackSrgb)(const uint32_t *, const ColorPlanes &, size_t);
+	void (*m_pPackSrgb)(const ColorPlanes &, uint32_t *, size_t);
+	void (*m_pPremultiply)(const ColorPlanes &, size_t);
+	void (*m_pBlendOver)(const ColorPlanes &, const ColorPlanes &, size_t);
+};
+
+const ColorKernelTable s_aKernelTables[] = {
+	{unpackSrgbScalar, packSrgbScalar, premultiplyScalar, blendOverScalar},
+#ifdef SPS_COLOR_SSE2
+	{unpackSrgbSse2, packSrgbSse2, premultiplySse2, blendOverSse2},
+#else
+	{unpackSrgbScalar, packSrgbScalar, premultiplyScalar, blendOverScalar},
+#endif
+#ifdef SPS_COLOR_AVX2
+	{unpackSrgbAvx2, packSrgbAvx2, premultiplyAvx2, blendOverAvx2},
+#else
+	{unpackSrgbScalar, packSrgbScalar, premultiplyScalar, blendOverScalar},
+#endif
+};
+
+EColorKernels bestColorKernels() {
+#ifdef SPS_COLOR_AVX2
+	if (__builtin_cpu_supports("avx2"))
+		return COLOR_KERNELS_AVX2;
+#endif
+#ifdef SPS_COLOR_SSE2
+	return COLOR_KERNELS_SSE2;
+#else
+	return COLOR_KERNELS_SCALAR;
+#endif
 }
 
-CColor::CColor(int all) : CColor(all, all, all, all) {}
+EColorKernels &currentColorKernels() {
+	static EColorKernels s_Kernels = bestColorKernels();
+	return s_Kernels;
+}
+
+const ColorKernelTable &kernels() {
+	return s_aKernelTables[currentColorKernels()];
+}
+
+} // namespace
+
+EColorKernels getColorKernels() {
+	return currentColorKernels();
+}
+
+EColorKernels setColorKernels(EColorKernels Kernels) {
+	currentColorKernels() = std::min(Kernels, bestColorKernels());
+	return currentColorKernels();
+}
+
+const char *getColorKernelsName(EColorKernels Kernels) {
+	switch (Kernels) {
+	case COLOR_KERNELS_SCALAR:
+		return "scalar";
+	case COLOR_KERNELS_SSE2:
+		return "sse2";
+	case COLOR_KERNELS_AVX2:
+		return "avx2";
+	}
+	return "unknown";
+}
 
-CColor CColor::from_hex(int hex) {
-	return CColor((hex & 0xFF0000) >> 16, (hex & 0xFF00) >> 8, (hex & 0xFF));
+void unpackSrgb(const uint32_t *pSrc, const ColorPlanes &Dst, size_t Count) {
+	kernels().m_pUnpackSrgb(pSrc, Dst, Count);
 }
 
-CColor CColor::operator+(const CColor &other) {
-	return CColor(r + other.r, g + other.g, b + other.b, a + other.a);
+void packSrgb(const ColorPlanes &Src, uint32_t *pDst, size_t Count) {
+	kernels().m_pPackSrgb(Src, pDst, Count);
 }
 
-CColor CColor::operator-(const CColor &other) {
-	return CColor(r - other.r, g - other.g, b - other.b, a - other.a);
+void premultiply(const ColorPlanes &Colors, size_t Count) {
+	kernels().m_pPremultiply(Colors, Count);
 }
 
-CColor CColor::operator*(const CColor &other) {
-	return CColor(r * other.r, g * other.g, b * other.b, a * other.a);
+void blendOver(const ColorPlanes &Dst, const ColorPlanes &Src, size_t Count) {
+	kernels().m_pBlendOver(Dst, Src, Count);
 }
 
 } // namespace sps
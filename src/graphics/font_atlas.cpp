@@ -0,0 +1,242 @@
+#include <SuperSDL/font_atlas.hpp>
+#include <algorithm>
+#include <cstring>
+#include <ft2build.h>
+#include <stdexcept>
+#include FT_FREETYPE_H
+#include FT_MODULE_H
+
+namespace sps {
+
+uint32_t decodeUtf8(std::string_view Text, size_t &i) {
+	uint8_t Lead = Text[i++];
+	if (Lead < 0x80)
+		return Lead;
+
+	// The range of the first continuation byte rules out overlong forms,
+	// surrogates and code points past U+10FFFF, as in table 3-7 of the
+	// Unicode standard. C0, C1 and F5 to FF never start a sequence.
+	uint32_t Extra;
+	uint32_t CodePoint;
+	uint8_t Min = 0x80;
+	uint8_t Max = 0xBF;
+	if (Lead >= 0xC2 && Lead <= 0xDF) {
+		Extra = 1;
+		CodePoint = Lead & 0x1F;
+	} else if (Lead >= 0xE0 && Lead <= 0xEF) {
+		Extra = 2;
+		CodePoint = Lead & 0x0F;
+		if (Lead == 0xE0)
+			Min = 0xA0;
+		else if (Lead == 0xED)
+			Max = 0x9F;
+	} else if (Lead >= 0xF0 && Lead <= 0xF4) {
+		Extra = 3;
+		CodePoint = Lead & 0x07;
+		if (Lead == 0xF0)
+			Min = 0x90;
+		else if (Lead == 0xF4)
+			Max = 0x8F;
+	} else {
+		return 0xFFFD;
+	}
+
+	// A bad byte isn't consumed, it may start the next sequence.
+	for (uint32_t n = 0; n < Extra; n++) {
+		if (i >= Text.size() || uint8_t(Text[i]) < Min || uint8_t(Text[i]) > Max)
+			return 0xFFFD;
+		CodePoint = (CodePoint << 6) | (uint8_t(Text[i++]) & 0x3F);
+		Min = 0x80;
+		Max = 0xBF;
+	}
+	return CodePoint;
+}
+
+CFontAtlas::CFontAtlas() : CLoggable("font") {
+	m_pLibrary = nullptr;
+	m_Width = 0;
+	m_Height = 0;
+	m_DirtyMin = glm::uvec2(0);
+	m_DirtyMax = glm::uvec2(0);
+}
+
+CFontAtlas::~CFontAtlas() {
+	quit();
+}
+
+void CFontAtlas::init(uint32_t Width, uint32_t Height) {
+	if (FT_Init_FreeType(&m_pLibrary)) {
+		Log()->error("Failed to initialize FreeType");
+		throw std::runtime_error("failed to initialize freetype");
+	}
+
+	FT_Int SpreadProperty = Spread;
+	FT_Property_Set(m_pLibrary, "sdf", "spread", &SpreadProperty);
+
+	m_Width = Width;
+	m_Height = Height;
+	m_Pixels.assign(size_t(Width) * Height, 0);
+	m_Packer.init(Width, Height);
+
+	// The GPU copy starts out undefined.
+	m_DirtyMin = glm::uvec2(0);
+	m_DirtyMax = glm::uvec2(Width, Height);
+}
+
+void CFontAtlas::quit() {
+	for (auto &pFont : m_Fonts)
+		FT_Done_Face(pFont->m_pFace);
+	m_Fonts.clear();
+
+	if (m_pLibrary)
+		FT_Done_FreeType(m_pLibrary);
+	m_pLibrary = nullptr;
+}
+
+uint32_t CFontAtlas::loadFont(const std::string &Path) {
+	auto pFont = std::make_unique<Font>();
+
+	if (FT_New_Face(m_pLibrary, Path.c_str(), 0, &pFont->m_pFace)) {
+		Log()->error("Failed to load font {}", Path);
+		throw std::runtime_error("failed to load font");
+	}
+
+	FT_Face Face = pFont->m_pFace;
+	FT_Set_Pixel_Sizes(Face, 0, BaseSize);
+	pFont->m_HasKerning = FT_HAS_KERNING(Face);
+	pFont->m_LineHeight = Face->size->metrics.height / 64.0f;
+	pFont->m_Ascender = Face->size->metrics.ascender / 64.0f;
+
+	SPS_LOG_DEBUG("Loaded font {} ({} {}, {} glyphs)", Path, Face->family_name, Face->style_name, Face->num_glyphs);
+
+	m_Fonts.push_back(std::move(pFont));
+	return m_Fonts.size() - 1;
+}
+
+const GlyphInfo &CFontAtlas::getGlyph(Font &Font, uint32_t GlyphIndex) {
+	auto It = Font.m_Glyphs.find(GlyphIndex);
+	if (It != Font.m_Glyphs.end())
+		return It->second;
+
+	GlyphInfo &Info = Font.m_Glyphs[GlyphIndex];
+	FT_Face Face = Font.m_pFace;
+
+	if (FT_Load_Glyph(Face, GlyphIndex, FT_LOAD_DEFAULT))
+		return Info;
+	Info.m_Advance = Face->glyph->advance.x / 64.0f;
+
+	// Spaces and the like have nothing to draw.
+	if (Face->glyph->format != FT_GLYPH_FORMAT_OUTLINE || Face->glyph->outline.n_points == 0) {
+		Info.m_Valid = true;
+		return Info;
+	}
+
+	if (FT_Render_Glyph(Face->glyph, FT_RENDER_MODE_SDF))
+		return Info;
+
+	const FT_Bitmap &Bitmap = Face->glyph->bitmap;
+	// One pixel of padding keeps bilinear filtering from bleeding between glyphs.
+	uint32_t X, Y;
+	if (!m_Packer.pack(Bitmap.width + 2, Bitmap.rows + 2, X, Y)) {
+		SPS_LOG_RATE_LIMITED(warn, 1.0, "Font atlas is full ({}x{}), glyphs won't be drawn", m_Width, m_Height);
+		m_Stats.m_GlyphsDropped++;
+		// Not cached, it's tried again once a layout needs it.
+		m_Dropped = GlyphInfo();
+		m_Dropped.m_Advance = Info.m_Advance;
+		Font.m_Glyphs.erase(GlyphIndex);
+		return m_Dropped;
+	}
+
+	Info.m_X = X + 1;
+	Info.m_Y = Y + 1;
+	Info.m_Width = Bitmap.width;
+	Info.m_Height = Bitmap.rows;
+	Info.m_Offset = glm::vec2(Face->glyph->bitmap_left, -Face->glyph->bitmap_top);
+	Info.m_Valid = true;
+
+	for (uint32_t Row = 0; Row < Bitmap.rows; Row++)
+		std::memcpy(&m_Pixels[size_t(Info.m_Y + Row) * m_Width + Info.m_X], Bitmap.buffer + size_t(Row) * Bitmap.pitch, Bitmap.width);
+
+	if (m_DirtyMax.x <= m_DirtyMin.x || m_DirtyMax.y <= m_DirtyMin.y) {
+		m_DirtyMin = glm::uvec2(Info.m_X, Info.m_Y);
+		m_DirtyMax = glm::uvec2(Info.m_X + Info.m_Width, Info.m_Y + Info.m_Height);
+	} else {
+		m_DirtyMin = glm::min(m_DirtyMin, glm::uvec2(Info.m_X, Info.m_Y));
+		m_DirtyMax = glm::max(m_DirtyMax, glm::uvec2(Info.m_X + Info.m_Width, Info.m_Y + Info.m_Height));
+	}
+
+	m_Stats.m_GlyphsRasterized++;
+	return Info;
+}
+
+const TextLayout &CFontAtlas::layout(uint32_t FontId, std::string_view Text) {
+	Font &Font = *m_Fonts.at(FontId);
+
+	auto It = Font.m_Layouts.find(std::string(Text));
+	if (It != Font.m_Layouts.end()) {
+		m_Stats.m_LayoutHits++;
+		return It->second;
+	}
+	m_Stats.m_LayoutMisses++;
+
+	// Text that changes every frame would grow the cache forever.
+	if (Font.m_Layouts.size() >= MaxCachedLayouts)
+		Font.m_Layouts.clear();
+
+	TextLayout &Layout = Font.m_Layouts[std::string(Text)];
+	Layout.m_Glyphs.reserve(Text.size());
+	uint32_t Dropped = m_Stats.m_GlyphsDropped;
+
+	glm::vec2 Pen(0.0f, Font.m_Ascender);
+	uint32_t Previous = 0;
+	uint32_t Lines = 1;
+
+	for (size_t i = 0; i < Text.size();) {
+		uint32_t CodePoint = decodeUtf8(Text, i);
+		if (CodePoint == '\n') {
+			Layout.m_Size.x = std::max(Layout.m_Size.x, Pen.x);
+			Pen = glm::vec2(0.0f, Pen.y + Font.m_LineHeight);
+			Previous = 0;
+			Lines++;
+			continue;
+		}
+
+		uint32_t GlyphIndex = FT_Get_Char_Index(Font.m_pFace, CodePoint);
+		if (Font.m_HasKerning && Previous && GlyphIndex) {
+			FT_Vector Kerning;
+			if (!FT_Get_Kerning(Font.m_pFace, Previous, GlyphIndex, FT_KERNING_DEFAULT, &Kerning))
+				Pen.x += Kerning.x / 64.0f;
+		}
+
+		const GlyphInfo &Info = getGlyph(Font, GlyphIndex);
+		if (Info.m_Valid && Info.m_Width > 0)
+			Layout.m_Glyphs.push_back({Pen + Info.m_Offset, &Info});
+
+		Pen.x += Info.m_Advance;
+		Previous = GlyphIndex;
+	}
+
+	Layout.m_Size.x = std::max(Layout.m_Size.x, Pen.x);
+	Layout.m_Size.y = Lines * Font.m_LineHeight;
+	if (m_Stats.m_GlyphsDropped == Dropped)
+		return Layout;
+
+	m_Uncached = std::move(Layout);
+	Font.m_Layouts.erase(std::string(Text));
+	return m_Uncached;
+}
+
+bool CFontAtlas::getDirty(glm::uvec2 &Min, glm::uvec2 &Max) const {
+	if (m_DirtyMax.x <= m_DirtyMin.x || m_DirtyMax.y <= m_DirtyMin.y)
+		return false;
+	Min = m_DirtyMin;
+	Max = m_DirtyMax;
+	return true;
+}
+
+void CFontAtlas::clearDirty() {
+	m_DirtyMin = glm::uvec2(0);
+	m_DirtyMax = glm::uvec2(0);
+}
+
+} // namespace sps
@@ -0,0 +1,343 @@
+#include <SuperSDL/gpu_allocator.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace sps {
+
+// A block of device memory split with the buddy system. Free ranges are kept
+// per order, order 0 being MinAllocationSize.
+struct GpuMemoryBlock {
+	vk::DeviceMemory m_Memory;
+	void *m_pMapped = nullptr;
+	vk::DeviceSize m_Size = 0;
+	vk::DeviceSize m_MinSize = 0;
+	vk::DeviceSize m_Used = 0;
+	uint32_t m_MaxOrder = 0;
+	size_t m_Pool = 0;
+	std::vector<std::set<vk::DeviceSize>> m_FreeLists;
+
+	bool allocate(uint32_t Order, vk::DeviceSize &Offset) {
+		uint32_t Found = Order;
+		while (Found <= m_MaxOrder && m_FreeLists[Found].empty())
+			Found++;
+		if (Found > m_MaxOrder)
+			return false;
+
+		Offset = *m_FreeLists[Found].begin();
+		m_FreeLists[Found].erase(m_FreeLists[Found].begin());
+
+		// Split until we reach the requested size, keeping the upper halves.
+		while (Found > Order) {
+			Found--;
+			m_FreeLists[Found].insert(Offset + (m_MinSize << Found));
+		}
+
+		m_Used += m_MinSize << Order;
+		return true;
+	}
+
+	void free(uint32_t Order, vk::DeviceSize Offset) {
+		m_Used -= m_MinSize << Order;
+
+		// Merge with the buddy for as long as it is free too.
+		while (Order < m_MaxOrder) {
+			vk::DeviceSize Buddy = Offset ^ (m_MinSize << Order);
+			auto It = m_FreeLists[Order].find(Buddy);
+			if (It == m_FreeLists[Order].end())
+				break;
+			m_FreeLists[Order].erase(It);
+			Offset = std::min(Offset, Buddy);
+			Order++;
+		}
+
+		m_FreeLists[Order].insert(Offset);
+	}
+
+	vk::DeviceSize largestFree() const {
+		for (uint32_t Order = m_MaxOrder + 1; Order-- > 0;) {
+			if (!m_FreeLists[Order].empty())
+				return m_MinSize << Order;
+		}
+		return 0;
+	}
+};
+
+static uint32_t orderForSize(vk::DeviceSize Size, vk::DeviceSize MinSize) {
+	uint32_t Order = 0;
+	while ((MinSize << Order) < Size)
+		Order++;
+	return Order;
+}
+
+CGpuAllocator::CGpuAllocator() : CLoggable("gpualloc") {
+	m_TransientFrameSize = 0;
+	m_TransientFrame = 0;
+	m_TransientHead = 0;
+	m_TransientWarned = false;
+}
+
+CGpuAllocator::~CGpuAllocator() = default;
+
+void CGpuAllocator::init(vk::PhysicalDevice PhysicalDevice, vk::Device Device, uint32_t FramesInFlight, vk::DeviceSize TransientFrameSize) {
+	m_PhysicalDevice = PhysicalDevice;
+	m_Device = Device;
+	m_MemoryProperties = m_PhysicalDevice.getMemoryProperties();
+	m_Stats.m_MaxDeviceAllocations = m_PhysicalDevice.getProperties().limits.maxMemoryAllocationCount;
+
+	for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; i++) {
+		Log()->debug("Memory heap {}: {} MiB{}", i, m_MemoryProperties.memoryHeaps[i].size >> 20,
+					 m_MemoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal ? " (device local)" : "");
+	}
+
+	m_TransientFrameSize = TransientFrameSize;
+	vk::BufferCreateInfo BufferInfo(
+		vk::BufferCreateFlags(),
+		m_TransientFrameSize * FramesInFlight,
+		vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer |
+			vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer |
+			vk::BufferUsageFlagBits::eTransferSrc,
+		vk::SharingMode::eExclusive);
+	m_TransientBuffer = m_Device.createBuffer(BufferInfo);
+	// Device local host visible memory is the best spot for this if the device has any.
+	m_TransientMemory = allocateBuffer(m_TransientBuffer,
+									   vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+									   vk::MemoryPropertyFlagBits::eDeviceLocal);
+	m_Stats.m_TransientCapacity = m_TransientFrameSize;
+
+	Log()->debug("GPU allocator ready, {} KiB of transient memory per frame", m_TransientFrameSize >> 10);
+}
+
+void CGpuAllocator::quit() {
+	m_Device.destroyBuffer(m_TransientBuffer);
+	free(m_TransientMemory);
+
+	logStats();
+	if (m_Stats.m_AllocationCount > 0)
+		Log()->warn("{} GPU allocations still alive at shutdown", m_Stats.m_AllocationCount);
+
+	for (auto &Pool : m_Pools) {
+		for (auto &pBlock : Pool.m_Blocks)
+			freeDeviceMemory(pBlock->m_Memory, pBlock->m_pMapped != nullptr);
+		Pool.m_Blocks.clear();
+	}
+	m_Pools.clear();
+}
+
+uint32_t CGpuAllocator::findMemoryType(uint32_t TypeFilter, vk::MemoryPropertyFlags Required, vk::MemoryPropertyFlags Preferred) const {
+	for (vk::MemoryPropertyFlags Wanted : {Required | Preferred, Required}) {
+		for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++) {
+			if ((TypeFilter & (1 << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & Wanted) == Wanted)
+				return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find a suitable memory type");
+}
+
+CGpuAllocator::Pool &CGpuAllocator::getPool(uint32_t MemoryType, bool Linear) {
+	for (auto &Pool : m_Pools) {
+		if (Pool.m_MemoryType == MemoryType && Pool.m_Linear == Linear)
+			return Pool;
+	}
+
+	// Don't let a single block take a big share of small heaps such as the
+	// 256MiB host visible device local one.
+	vk::DeviceSize HeapSize = m_MemoryProperties.memoryHeaps[m_MemoryProperties.memoryTypes[MemoryType].heapIndex].size;
+	vk::DeviceSize BlockSize = DefaultBlockSize;
+	while (BlockSize > HeapSize / 8 && BlockSize > (1u << 20))
+		BlockSize >>= 1;
+
+	m_Pools.push_back({MemoryType, Linear, BlockSize, {}});
+	return m_Pools.back();
+}
+
+vk::DeviceMemory CGpuAllocator::allocateDeviceMemory(vk::DeviceSize Size, uint32_t MemoryType, void **ppMapped) {
+	if (m_Stats.m_DeviceAllocations >= m_Stats.m_MaxDeviceAllocations)
+		throw std::runtime_error("maxMemoryAllocationCount reached");
+
+	vk::DeviceMemory Memory;
+	try {
+		Memory = m_Device.allocateMemory(vk::MemoryAllocateInfo(Size, MemoryType));
+	} catch (vk::SystemError &err) {
+		Log()->error("Failed to allocate {} KiB of device memory: {}", Size >> 10, err.what());
+		throw std::runtime_error("failed to allocate device memory");
+	}
+
+	*ppMapped = nullptr;
+	if (m_MemoryProperties.memoryTypes[MemoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+		*ppMapped = m_Device.mapMemory(Memory, 0, VK_WHOLE_SIZE);
+
+	m_Stats.m_DeviceAllocations++;
+	m_Stats.m_ReservedBytes += Size;
+	return Memory;
+}
+
+void CGpuAllocator::freeDeviceMemory(vk::DeviceMemory Memory, bool Mapped) {
+	if (Mapped)
+		m_Device.unmapMemory(Memory);
+	m_Device.freeMemory(Memory);
+	m_Stats.m_DeviceAllocations--;
+}
+
+GpuMemoryBlock *CGpuAllocator::createBlock(Pool &Pool) {
+	auto pBlock = std::make_unique<GpuMemoryBlock>();
+	pBlock->m_Size = Pool.m_BlockSize;
+	pBlock->m_MinSize = MinAllocationSize;
+	pBlock->m_MaxOrder = orderForSize(Pool.m_BlockSize, MinAllocationSize);
+	pBlock->m_Pool = &Pool - m_Pools.data();
+	pBlock->m_FreeLists.resize(pBlock->m_MaxOrder + 1);
+	pBlock->m_FreeLists[pBlock->m_MaxOrder].insert(0);
+	pBlock->m_Memory = allocateDeviceMemory(Pool.m_BlockSize, Pool.m_MemoryType, &pBlock->m_pMapped);
+
+	m_Stats.m_BlockCount++;
+	SPS_LOG_DEBUG("New {} KiB block for memory type {} ({})", Pool.m_BlockSize >> 10, Pool.m_MemoryType, Pool.m_Linear ? "linear" : "optimal");
+
+	Pool.m_Blocks.push_back(std::move(pBlock));
+	return Pool.m_Blocks.back().get();
+}
+
+void CGpuAllocator::destroyBlock(GpuMemoryBlock *pBlock) {
+	auto &Blocks = m_Pools[pBlock->m_Pool].m_Blocks;
+	freeDeviceMemory(pBlock->m_Memory, pBlock->m_pMapped != nullptr);
+	m_Stats.m_ReservedBytes -= pBlock->m_Size;
+	m_Stats.m_BlockCount--;
+
+	Blocks.erase(std::find_if(Blocks.begin(), Blocks.end(), [&](const auto &p) { return p.get() == pBlock; }));
+}
+
+GpuAllocation CGpuAllocator::allocate(const vk::MemoryRequirements &Requirements, vk::MemoryPropertyFlags Required, vk::MemoryPropertyFlags Preferred, bool Linear) {
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+
+	GpuAllocation Allocation;
+	Allocation.m_MemoryType = findMemoryType(Requirements.memoryTypeBits, Required, Preferred);
+	Allocation.m_RequestedSize = Requirements.size;
+
+	Pool &Pool = getPool(Allocation.m_MemoryType, Linear);
+	vk::DeviceSize Size = std::max({Requirements.size, Requirements.alignment, MinAllocationSize});
+
+	if (Size > Pool.m_BlockSize / 2) {
+		// Not worth sub-allocating, it would waste most of a block.
+		Allocation.m_Memory = allocateDeviceMemory(Requirements.size, Allocation.m_MemoryType, &Allocation.m_pMapped);
+		Allocation.m_Size = Requirements.size;
+		m_Stats.m_DedicatedCount++;
+	} else {
+		Allocation.m_Order = orderForSize(Size, MinAllocationSize);
+
+		GpuMemoryBlock *pBlock = nullptr;
+		for (auto &pCandidate : Pool.m_Blocks) {
+			if (pCandidate->allocate(Allocation.m_Order, Allocation.m_Offset)) {
+				pBlock = pCandidate.get();
+				break;
+			}
+		}
+
+		if (!pBlock) {
+			pBlock = createBlock(Pool);
+			pBlock->allocate(Allocation.m_Order, Allocation.m_Offset);
+		}
+
+		Allocation.m_pBlock = pBlock;
+		Allocation.m_Memory = pBlock->m_Memory;
+		Allocation.m_Size = MinAllocationSize << Allocation.m_Order;
+		if (pBlock->m_pMapped)
+			Allocation.m_pMapped = static_cast<char *>(pBlock->m_pMapped) + Allocation.m_Offset;
+	}
+
+	m_Stats.m_AllocationCount++;
+	m_Stats.m_UsedBytes += Allocation.m_Size;
+	m_Stats.m_RequestedBytes += Allocation.m_RequestedSize;
+	return Allocation;
+}
+
+void CGpuAllocator::free(GpuAllocation &Allocation) {
+	if (!Allocation)
+		return;
+
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+
+	if (!Allocation.m_pBlock) {
+		freeDeviceMemory(Allocation.m_Memory, Allocation.m_pMapped != nullptr);
+		m_Stats.m_ReservedBytes -= Allocation.m_Size;
+		m_Stats.m_DedicatedCount--;
+	} else {
+		GpuMemoryBlock *pBlock = Allocation.m_pBlock;
+		pBlock->free(Allocation.m_Order, Allocation.m_Offset);
+
+		// Keep one block around per pool so we don't thrash on churn.
+		if (pBlock->m_Used == 0 && m_Pools[pBlock->m_Pool].m_Blocks.size() > 1)
+			destroyBlock(pBlock);
+	}
+
+	m_Stats.m_AllocationCount--;
+	m_Stats.m_UsedBytes -= Allocation.m_Size;
+	m_Stats.m_RequestedBytes -= Allocation.m_RequestedSize;
+	Allocation = GpuAllocation();
+}
+
+GpuAllocation CGpuAllocator::allocateBuffer(vk::Buffer Buffer, vk::MemoryPropertyFlags Required, vk::MemoryPropertyFlags Preferred) {
+	GpuAllocation Allocation = allocate(m_Device.getBufferMemoryRequirements(Buffer), Required, Preferred, true);
+	m_Device.bindBufferMemory(Buffer, Allocation.m_Memory, Allocation.m_Offset);
+	return Allocation;
+}
+
+GpuAllocation CGpuAllocator::allocateImage(vk::Image Image, vk::MemoryPropertyFlags Required, vk::MemoryPropertyFlags Preferred) {
+	// We only create optimally tiled images.
+	GpuAllocation Allocation = allocate(m_Device.getImageMemoryRequirements(Image), Required, Preferred, false);
+	m_Device.bindImageMemory(Image, Allocation.m_Memory, Allocation.m_Offset);
+	return Allocation;
+}
+
+void CGpuAllocator::beginFrame(uint32_t Frame) {
+	m_Stats.m_TransientUsed = m_TransientHead.load(std::memory_order_relaxed);
+	m_TransientFrame = Frame;
+	m_TransientHead.store(0, std::memory_order_relaxed);
+	m_TransientWarned.store(false, std::memory_order_relaxed);
+}
+
+TransientAllocation CGpuAllocator::allocateTransient(vk::DeviceSize Size, vk::DeviceSize Alignment) {
+	vk::DeviceSize Head = m_TransientHead.load(std::memory_order_relaxed);
+	vk::DeviceSize Aligned;
+
+	do {
+		Aligned = (Head + Alignment - 1) & ~(Alignment - 1);
+		if (Aligned + Size > m_TransientFrameSize) {
+			if (!m_TransientWarned.exchange(true))
+				Log()->warn("Transient memory exhausted ({} KiB per frame)", m_TransientFrameSize >> 10);
+			return TransientAllocation();
+		}
+	} while (!m_TransientHead.compare_exchange_weak(Head, Aligned + Size, std::memory_order_relaxed));
+
+	TransientAllocation Allocation;
+	Allocation.m_Buffer = m_TransientBuffer;
+	Allocation.m_Offset = m_TransientFrameSize * m_TransientFrame + Aligned;
+	Allocation.m_pMapped = static_cast<char *>(m_TransientMemory.m_pMapped) + Allocation.m_Offset;
+	return Allocation;
+}
+
+GpuAllocatorStats CGpuAllocator::getStats() const {
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+
+	GpuAllocatorStats Stats = m_Stats;
+	Stats.m_FreeBytes = 0;
+	Stats.m_LargestFreeRange = 0;
+	for (const auto &Pool : m_Pools) {
+		for (const auto &pBlock : Pool.m_Blocks) {
+			Stats.m_FreeBytes += pBlock->m_Size - pBlock->m_Used;
+			Stats.m_LargestFreeRange = std::max(Stats.m_LargestFreeRange, pBlock->largestFree());
+		}
+	}
+	return Stats;
+}
+
+void CGpuAllocator::logStats() const {
+	GpuAllocatorStats Stats = getStats();
+	Log()->info("GPU memory: {} allocations in {} blocks + {} dedicated, {}/{} device allocations",
+				Stats.m_AllocationCount, Stats.m_BlockCount, Stats.m_DedicatedCount,
+				Stats.m_DeviceAllocations, Stats.m_MaxDeviceAllocations);
+	Log()->info("GPU memory: {} KiB reserved, {} KiB used, {} KiB requested, fragmentation {:.1f}% internal / {:.1f}% external",
+				Stats.m_ReservedBytes >> 10, Stats.m_UsedBytes >> 10, Stats.m_RequestedBytes >> 10,
+				Stats.internalFragmentation() * 100.0, Stats.externalFragmentation() * 100.0);
+	Log()->info("GPU memory: transient {}/{} KiB used last frame", Stats.m_TransientUsed >> 10, Stats.m_TransientCapacity >> 10);
+}
+
+} // namespace sps
@@ -0,0 +1,140 @@
+#include <SuperSDL/gpu_profiler.hpp>
+
+namespace sps {
+
+CGpuProfiler::CGpuProfiler() {
+	m_QueriesPerFrame = 0;
+	m_TimestampMask = 0;
+	m_Period = 0.0;
+	m_Frame = 0;
+	m_FrameTime = 0.0;
+	m_pTrack = nullptr;
+}
+
+bool CGpuProfiler::init(vk::PhysicalDevice PhysicalDevice, vk::Device Device, uint32_t QueueFamily, uint32_t FramesInFlight, uint32_t MaxScopes) {
+	m_Device = Device;
+
+	uint32_t ValidBits = PhysicalDevice.getQueueFamilyProperties()[QueueFamily].timestampValidBits;
+	if (ValidBits == 0)
+		return false;
+
+	m_TimestampMask = ValidBits >= 64 ? ~0ull : (1ull << ValidBits) - 1;
+	m_Period = PhysicalDevice.getProperties().limits.timestampPeriod;
+	// The frame itself plus the nested scopes.
+	m_QueriesPerFrame = (MaxScopes + 1) * 2;
+
+	vk::QueryPoolCreateInfo CreateInfo(vk::QueryPoolCreateFlags(), vk::QueryType::eTimestamp, m_QueriesPerFrame * FramesInFlight);
+	m_Pool = m_Device.createQueryPool(CreateInfo);
+
+	m_Frames.resize(FramesInFlight);
+	for (auto &Frame : m_Frames)
+		Frame.m_Scopes.reserve(MaxScopes + 1);
+	m_Results.resize(m_QueriesPerFrame);
+	m_pTrack = CProfiler::get().addTrack("GPU");
+
+	return true;
+}
+
+void CGpuProfiler::quit() {
+	m_Device.destroyQueryPool(m_Pool);
+	m_Pool = nullptr;
+}
+
+uint32_t CGpuProfiler::writeTimestamp(vk::CommandBuffer Cmd, vk::PipelineStageFlagBits Stage) {
+	FrameQueries &Frame = m_Frames[m_Frame];
+	uint32_t Query = m_Frame * m_QueriesPerFrame + Frame.m_Used++;
+	Cmd.writeTimestamp(Stage, m_Pool, Query);
+	return Query - m_Frame * m_QueriesPerFrame;
+}
+
+void CGpuProfiler::beginFrame(vk::CommandBuffer Cmd, uint32_t Frame) {
+	if (!m_Pool)
+		return;
+
+	m_Frame = Frame;
+	FrameQueries &Queries = m_Frames[m_Frame];
+	Queries.m_Scopes.clear();
+	Queries.m_Stack.clear();
+	Queries.m_Used = 0;
+
+	Cmd.resetQueryPool(m_Pool, m_Frame * m_QueriesPerFrame, m_QueriesPerFrame);
+	Queries.m_Scopes.push_back({"frame", writeTimestamp(Cmd, vk::PipelineStageFlagBits::eTopOfPipe), 0});
+}
+
+void CGpuProfiler::endFrame(vk::CommandBuffer Cmd) {
+	if (!m_Pool)
+		return;
+
+	FrameQueries &Frame = m_Frames[m_Frame];
+	while (!Frame.m_Stack.empty())
+		endScope(Cmd);
+	Frame.m_Scopes[0].m_End = writeTimestamp(Cmd, vk::PipelineStageFlagBits::eBottomOfPipe);
+}
+
+void CGpuProfiler::beginScope(vk::CommandBuffer Cmd, const char *pName) {
+	if (!m_Pool || !CProfiler::get().isEnabled())
+		return;
+
+	FrameQueries &Frame = m_Frames[m_Frame];
+	// Keep two queries for the end of the frame scope.
+	if (Frame.m_Used + 3 > m_QueriesPerFrame) {
+		Frame.m_Stack.push_back(UINT32_MAX);
+		return;
+	}
+
+	Frame.m_Stack.push_back(Frame.m_Scopes.size());
+	Frame.m_Scopes.push_back({pName, writeTimestamp(Cmd, vk::PipelineStageFlagBits::eTopOfPipe), 0});
+}
+
+void CGpuProfiler::endScope(vk::CommandBuffer Cmd) {
+	if (!m_Pool)
+		return;
+
+	FrameQueries &Frame = m_Frames[m_Frame];
+	// The profiler may have been turned on in the middle of the scope.
+	if (Frame.m_Stack.empty())
+		return;
+
+	uint32_t Index = Frame.m_Stack.back();
+	Frame.m_Stack.pop_back();
+	if (Index != UINT32_MAX)
+		Frame.m_Scopes[Index].m_End = writeTimestamp(Cmd, vk::PipelineStageFlagBits::eBottomOfPipe);
+}
+
+void CGpuProfiler::resolve(uint32_t Frame) {
+	if (!m_Pool)
+		return;
+
+	FrameQueries &Queries = m_Frames[Frame];
+	if (Queries.m_Used == 0 || Queries.m_Scopes.empty() || Queries.m_Scopes[0].m_End == 0)
+		return;
+
+	vk::Result Result = m_Device.getQueryPoolResults(m_Pool, Frame * m_QueriesPerFrame, Queries.m_Used,
+													 Queries.m_Used * sizeof(uint64_t), m_Results.data(),
+													 sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+	Queries.m_Used = 0;
+	if (Result != vk::Result::eSuccess)
+		return;
+
+	auto Ticks = [&](const Scope &S) {
+		return (m_Results[S.m_End] - m_Results[S.m_Begin]) & m_TimestampMask;
+	};
+
+	const Scope &FrameScope = Queries.m_Scopes[0];
+	m_FrameTime = Ticks(FrameScope) * m_Period * 1e-9;
+
+	if (!CProfiler::get().isEnabled())
+		return;
+
+	// GPU and CPU clocks aren't calibrated against each other, so the GPU
+	// frame is placed at the time it was submitted.
+	uint64_t Base = m_Results[FrameScope.m_Begin];
+	for (const auto &S : Queries.m_Scopes) {
+		if (S.m_End == 0)
+			continue;
+		uint64_t Start = Queries.m_SubmitTime + uint64_t(((m_Results[S.m_Begin] - Base) & m_TimestampMask) * m_Period);
+		m_pTrack->push(S.m_pName, Start, uint64_t(Ticks(S) * m_Period));
+	}
+}
+
+} // namespace sps
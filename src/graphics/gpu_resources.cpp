@@ -0,0 +1,231 @@
+#include <SuperSDL/gpu_resources.hpp>
+#include <stdexcept>
+
+namespace sps {
+
+namespace {
+
+// Leaks reported one by one at quit(), the rest are only counted.
+constexpr uint32_t MaxReportedLeaks = 16;
+
+} // namespace
+
+CGpuResources::CGpuResources() : CLoggable("resources") {
+	m_pAllocator = nullptr;
+	m_Frame = 0;
+}
+
+void CGpuResources::init(vk::Device Device, CGpuAllocator *pAllocator) {
+	m_Device = Device;
+	m_pAllocator = pAllocator;
+	m_Frame = 0;
+}
+
+void CGpuResources::quit() {
+	// Whoever listened is gone by now.
+	m_ViewRetired = nullptr;
+	uint32_t Leaks = 0;
+	auto Report = [&](const char *pType, const std::string &Name) {
+		if (Leaks++ < MaxReportedLeaks)
+			Log()->warn("Leaked {} '{}'", pType, Name);
+	};
+
+	m_Pipelines.forEach([&](GpuPipeline &Pipeline) {
+		Report("pipeline", Pipeline.m_Name);
+		destroyLater(Pipeline.m_Pipeline);
+	});
+	m_Shaders.forEach([&](GpuShader &Shader) {
+		Report("shader", Shader.m_Name);
+		destroyLater(Shader.m_Module);
+	});
+	m_Images.forEach([&](GpuImage &Image) {
+		Report("image", Image.m_Name);
+		destroyLater(Image.m_View);
+		destroyLater(Image.m_Image, Image.m_Memory);
+	});
+	m_Buffers.forEach([&](GpuBuffer &Buffer) {
+		Report("buffer", Buffer.m_Name);
+		destroyLater(Buffer.m_Buffer, Buffer.m_Memory);
+	});
+	if (Leaks > 0)
+		Log()->warn("{} GPU resources were never destroyed", Leaks);
+
+	m_Pipelines.clear();
+	m_Shaders.clear();
+	m_Images.clear();
+	m_Buffers.clear();
+
+	for (Garbage &G : m_Garbage)
+		destroyNow(G);
+	m_Garbage.clear();
+}
+
+void CGpuResources::beginFrame(uint64_t Frame, uint64_t FirstUnfinished) {
+	m_Frame = Frame;
+	while (!m_Garbage.empty() && m_Garbage.front().m_Frame < FirstUnfinished) {
+		destroyNow(m_Garbage.front());
+		m_Garbage.pop_front();
+	}
+}
+
+void CGpuResources::queue(vk::ObjectType Type, uint64_t Object, GpuAllocation Memory) {
+	m_Garbage.push_back({m_Frame, Type, Object, Memory});
+	if (Type == vk::ObjectType::eImageView && m_ViewRetired)
+		m_ViewRetired(vk::ImageView(VkImageView(Object)));
+}
+
+void CGpuResources::destroyNow(Garbage &G) {
+	switch (G.m_Type) {
+	case vk::ObjectType::eBuffer:
+		m_Device.destroyBuffer(vk::Buffer(VkBuffer(G.m_Object)));
+		break;
+	case vk::ObjectType::eBufferView:
+		m_Device.destroyBufferView(vk::BufferView(VkBufferView(G.m_Object)));
+		break;
+	case vk::ObjectType::eImage:
+		m_Device.destroyImage(vk::Image(VkImage(G.m_Object)));
+		break;
+	case vk::ObjectType::eImageView:
+		m_Device.destroyImageView(vk::ImageView(VkImageView(G.m_Object)));
+		break;
+	case vk::ObjectType::eSampler:
+		m_Device.destroySampler(vk::Sampler(VkSampler(G.m_Object)));
+		break;
+	case vk::ObjectType::ePipeline:
+		m_Device.destroyPipeline(vk::Pipeline(VkPipeline(G.m_Object)));
+		break;
+	case vk::ObjectType::ePipelineLayout:
+		m_Device.destroyPipelineLayout(vk::PipelineLayout(VkPipelineLayout(G.m_Object)));
+		break;
+	case vk::ObjectType::eShaderModule:
+		m_Device.destroyShaderModule(vk::ShaderModule(VkShaderModule(G.m_Object)));
+		break;
+	case vk::ObjectType::eRenderPass:
+		m_Device.destroyRenderPass(vk::RenderPass(VkRenderPass(G.m_Object)));
+		break;
+	case vk::ObjectType::eFramebuffer:
+		m_Device.destroyFramebuffer(vk::Framebuffer(VkFramebuffer(G.m_Object)));
+		break;
+	case vk::ObjectType::eDescriptorPool:
+		m_Device.destroyDescriptorPool(vk::DescriptorPool(VkDescriptorPool(G.m_Object)));
+		break;
+	case vk::ObjectType::eDescriptorSetLayout:
+		m_Device.destroyDescriptorSetLayout(vk::DescriptorSetLayout(VkDescriptorSetLayout(G.m_Object)));
+		break;
+	default:
+		Log()->error("Can't destroy objects of type {}", vk::to_string(G.m_Type));
+		break;
+	}
+
+	if (G.m_Memory)
+		m_pAllocator->free(G.m_Memory);
+	m_Stats.m_Destroyed++;
+}
+
+BufferHandle CGpuResources::createBuffer(const std::string &Name, vk::DeviceSize Size, vk::BufferUsageFlags Usage, vk::MemoryPropertyFlags Required, vk::MemoryPropertyFlags Preferred) {
+	GpuBuffer Buffer;
+	Buffer.m_Name = Name;
+	Buffer.m_Size = Size;
+	Buffer.m_Buffer = m_Device.createBuffer(vk::BufferCreateInfo(vk::BufferCreateFlags(), Size, Usage, vk::SharingMode::eExclusive));
+	try {
+		Buffer.m_Memory = m_pAllocator->allocateBuffer(Buffer.m_Buffer, Required, Preferred);
+	} catch (...) {
+		m_Device.destroyBuffer(Buffer.m_Buffer);
+		throw;
+	}
+	return m_Buffers.add(std::move(Buffer));
+}
+
+ImageHandle CGpuResources::createImage(const std::string &Name, const vk::ImageCreateInfo &Info, vk::ImageAspectFlags Aspect) {
+	GpuImage Image;
+	Image.m_Name = Name;
+	Image.m_Extent = Info.extent;
+	Image.m_Format = Info.format;
+	Image.m_Image = m_Device.createImage(Info);
+	try {
+		Image.m_Memory = m_pAllocator->allocateImage(Image.m_Image, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+		vk::ImageViewType ViewType = vk::ImageViewType::e2D;
+		if (Info.imageType == vk::ImageType::e1D)
+			ViewType = vk::ImageViewType::e1D;
+		else if (Info.imageType == vk::ImageType::e3D)
+			ViewType = vk::ImageViewType::e3D;
+		else if (Info.arrayLayers > 1)
+			ViewType = vk::ImageViewType::e2DArray;
+		vk::ImageViewCreateInfo ViewInfo(vk::ImageViewCreateFlags(), Image.m_Image, ViewType, Info.format, vk::ComponentMapping(),
+										 vk::ImageSubresourceRange(Aspect, 0, Info.mipLevels, 0, Info.arrayLayers));
+		Image.m_View = m_Device.createImageView(ViewInfo);
+	} catch (...) {
+		if (Image.m_Memory)
+			m_pAllocator->free(Image.m_Memory);
+		m_Device.destroyImage(Image.m_Image);
+		throw;
+	}
+	return m_Images.add(std::move(Image));
+}
+
+ShaderHandle CGpuResources::createShader(const EmbeddedShader &Shader) {
+	GpuShader Module;
+	Module.m_Name = Shader.m_pName;
+	Module.m_Module = m_Device.createShaderModule(vk::ShaderModuleCreateInfo(vk::ShaderModuleCreateFlags(), Shader.m_CodeSize, Shader.m_pCode));
+	return m_Shaders.add(std::move(Module));
+}
+
+PipelineHandle CGpuResources::createPipeline(const std::string &Name, const vk::GraphicsPipelineCreateInfo &Info, vk::PipelineCache Cache) {
+	vk::Pipeline Pipeline;
+	try {
+		Pipeline = m_Device.createGraphicsPipeline(Cache, Info).value;
+	} catch (vk::SystemError &err) {
+		Log()->error("Failed to create pipeline '{}': {}", Name, err.what());
+		throw std::runtime_error("failed to create graphics pipeline");
+	}
+	return m_Pipelines.add({Name, Pipeline});
+}
+
+void CGpuResources::destroy(BufferHandle Handle) {
+	GpuBuffer Buffer;
+	if (!m_Buffers.remove(Handle, Buffer)) {
+		m_Stats.m_StaleHandles += static_cast<bool>(Handle);
+		return;
+	}
+	destroyLater(Buffer.m_Buffer, Buffer.m_Memory);
+}
+
+void CGpuResources::destroy(ImageHandle Handle) {
+	GpuImage Image;
+	if (!m_Images.remove(Handle, Image)) {
+		m_Stats.m_StaleHandles += static_cast<bool>(Handle);
+		return;
+	}
+	destroyLater(Image.m_View);
+	destroyLater(Image.m_Image, Image.m_Memory);
+}
+
+void CGpuResources::destroy(PipelineHandle Handle) {
+	GpuPipeline Pipeline;
+	if (!m_Pipelines.remove(Handle, Pipeline)) {
+		m_Stats.m_StaleHandles += static_cast<bool>(Handle);
+		return;
+	}
+	destroyLater(Pipeline.m_Pipeline);
+}
+
+void CGpuResources::destroy(ShaderHandle Handle) {
+	GpuShader Shader;
+	if (!m_Shaders.remove(Handle, Shader)) {
+		m_Stats.m_StaleHandles += static_cast<bool>(Handle);
+		return;
+	}
+	destroyLater(Shader.m_Module);
+}
+
+const GpuResourceStats &CGpuResources::getStats() const {
+	m_Stats.m_Buffers = m_Buffers.getCount();
+	m_Stats.m_Images = m_Images.getCount();
+	m_Stats.m_Pipelines = m_Pipelines.getCount();
+	m_Stats.m_Shaders = m_Shaders.getCount();
+	m_Stats.m_PendingDestroys = static_cast<uint32_t>(m_Garbage.size());
+	return m_Stats;
+}
+
+} // namespace sps
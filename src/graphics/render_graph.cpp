@@ -0,0 +1,837 @@
+#include <SuperSDL/render_graph.hpp>
+#include <SuperSDL/renderer.hpp>
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+
+namespace sps {
+
+namespace {
+
+// Framebuffers kept for imported images that change between frames, e.g. one
+// per swap chain image. Past this they are all dropped.
+constexpr size_t MaxFramebuffers = 16;
+
+const vk::AccessFlags WriteAccess = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eColorAttachmentWrite |
+									vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eTransferWrite |
+									vk::AccessFlagBits::eHostWrite | vk::AccessFlagBits::eMemoryWrite;
+
+struct UsageInfo {
+	vk::ImageLayout m_Layout;
+	vk::PipelineStageFlags m_Stages;
+	vk::AccessFlags m_Access;
+	vk::ImageUsageFlags m_ImageUsage;
+	bool m_Write;
+	bool m_Attachment;
+};
+
+UsageInfo getUsageInfo(ERenderGraphUsage Usage, ERenderGraphPass Type) {
+	const vk::PipelineStageFlags Shader = Type == RENDER_GRAPH_COMPUTE ? vk::PipelineStageFlagBits::eComputeShader : vk::PipelineStageFlagBits::eFragmentShader;
+	const vk::PipelineStageFlags Depth = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+
+	switch (Usage) {
+	case RENDER_GRAPH_COLOR:
+		return {vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+				vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite, vk::ImageUsageFlagBits::eColorAttachment, true, true};
+	case RENDER_GRAPH_DEPTH:
+		return {vk::ImageLayout::eDepthStencilAttachmentOptimal, Depth,
+				vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+				vk::ImageUsageFlagBits::eDepthStencilAttachment, true, true};
+	case RENDER_GRAPH_DEPTH_READ:
+		return {vk::ImageLayout::eDepthStencilReadOnlyOptimal, Depth, vk::AccessFlagBits::eDepthStencilAttachmentRead,
+				vk::ImageUsageFlagBits::eDepthStencilAttachment, false, true};
+	case RENDER_GRAPH_INPUT:
+		return {vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eInputAttachmentRead,
+				vk::ImageUsageFlagBits::eInputAttachment, false, true};
+	case RENDER_GRAPH_SAMPLED:
+		return {vk::ImageLayout::eShaderReadOnlyOptimal, Shader, vk::AccessFlagBits::eShaderRead, vk::ImageUsageFlagBits::eSampled, false, false};
+	case RENDER_GRAPH_STORAGE:
+		return {vk::ImageLayout::eGeneral, Shader, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+				vk::ImageUsageFlagBits::eStorage, true, false};
+	case RENDER_GRAPH_TRANSFER_SRC:
+		return {vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead,
+				vk::ImageUsageFlagBits::eTransferSrc, false, false};
+	case RENDER_GRAPH_TRANSFER_DST:
+	default:
+		return {vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite,
+				vk::ImageUsageFlagBits::eTransferDst, true, false};
+	}
+}
+
+bool isUsageAllowed(ERenderGraphUsage Usage, ERenderGraphPass Type) {
+	switch (Usage) {
+	case RENDER_GRAPH_COLOR:
+	case RENDER_GRAPH_DEPTH:
+	case RENDER_GRAPH_DEPTH_READ:
+	case RENDER_GRAPH_INPUT:
+		return Type == RENDER_GRAPH_GRAPHICS;
+	case RENDER_GRAPH_SAMPLED:
+	case RENDER_GRAPH_STORAGE:
+		return Type != RENDER_GRAPH_TRANSFER;
+	case RENDER_GRAPH_TRANSFER_SRC:
+	case RENDER_GRAPH_TRANSFER_DST:
+		return Type == RENDER_GRAPH_TRANSFER;
+	default:
+		return false;
+	}
+}
+
+vk::ImageAspectFlags getAspect(vk::Format Format) {
+	switch (Format) {
+	case vk::Format::eD16Unorm:
+	case vk::Format::eX8D24UnormPack32:
+	case vk::Format::eD32Sfloat:
+		return vk::ImageAspectFlagBits::eDepth;
+	case vk::Format::eD16UnormS8Uint:
+	case vk::Format::eD24UnormS8Uint:
+	case vk::Format::eD32SfloatS8Uint:
+		return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+	case vk::Format::eS8Uint:
+		return vk::ImageAspectFlagBits::eStencil;
+	default:
+		return vk::ImageAspectFlagBits::eColor;
+	}
+}
+
+vk::DeviceSize alignUp(vk::DeviceSize Value, vk::DeviceSize Alignment) {
+	return Alignment > 1 ? (Value + Alignment - 1) / Alignment * Alignment : Value;
+}
+
+} // namespace
+
+CRenderGraph::CRenderGraph() : CLoggable("rendergraph") {
+	m_pRenderer = nullptr;
+}
+
+void CRenderGraph::init(CRenderer *pRenderer) {
+	m_pRenderer = pRenderer;
+	m_Device = m_pRenderer->getDevice();
+	m_Stats = RenderGraphStats();
+}
+
+void CRenderGraph::quit() {
+	release();
+	reset();
+	m_Signature.clear();
+}
+
+void CRenderGraph::reset() {
+	m_Passes.clear();
+	m_Images.clear();
+}
+
+uint32_t CRenderGraph::addImage(ImageDecl &&NewImage) {
+	if (NewImage.m_Desc.m_Extent.width == 0 || NewImage.m_Desc.m_Extent.height == 0) {
+		Log()->error("Image '{}' is empty", NewImage.m_Name);
+		throw std::runtime_error("render graph image without extent");
+	}
+	m_Images.push_back(std::move(NewImage));
+	return static_cast<uint32_t>(m_Images.size() - 1);
+}
+
+RenderGraphImage CRenderGraph::createImage(const std::string &Name, const RenderGraphImageDesc &Desc) {
+	return {addImage({Name, Desc, false, nullptr, nullptr, vk::ImageLayout::eUndefined, vk::ImageLayout::eUndefined})};
+}
+
+RenderGraphImage CRenderGraph::importImage(const std::string &Name, const RenderGraphImageDesc &Desc, vk::Image Image, vk::ImageView View,
+										   vk::ImageLayout Initial, vk::ImageLayout Final) {
+	return {addImage({Name, Desc, true, Image, View, Initial, Final})};
+}
+
+std::pmr::memory_resource *CRenderGraph::frameMemory() const {
+	return m_pRenderer->frameMemory();
+}
+
+uint32_t CRenderGraph::addPass(const std::string &Name, ERenderGraphPass Type, RecordFunction Record) {
+	m_Passes.push_back({Name, Type, std::move(Record), std::pmr::vector<Use>(frameMemory()), false});
+	return static_cast<uint32_t>(m_Passes.size() - 1);
+}
+
+void CRenderGraph::use(uint32_t PassIndex, RenderGraphImage Image, ERenderGraphUsage Usage, std::optional<vk::ClearValue> Clear) {
+	PassDecl &P = m_Passes[PassIndex];
+	if (!Image || Image.m_Index >= m_Images.size()) {
+		Log()->error("Pass '{}' uses an image that wasn't declared this frame", P.m_Name);
+		throw std::runtime_error("unknown render graph image");
+	}
+	const ImageDecl &I = m_Images[Image.m_Index];
+	if (!isUsageAllowed(Usage, P.m_Type)) {
+		Log()->error("Pass '{}' can't use '{}' that way", P.m_Name, I.m_Name);
+		throw std::runtime_error("render graph usage not allowed by the pass type");
+	}
+	for (const Use &Other : P.m_Uses) {
+		if (Other.m_Image == Image.m_Index) {
+			Log()->error("Pass '{}' uses '{}' twice", P.m_Name, I.m_Name);
+			throw std::runtime_error("render graph image used twice by a pass");
+		}
+		// All attachments of a pass make up one framebuffer.
+		const ImageDecl &OtherImage = m_Images[Other.m_Image];
+		if (getUsageInfo(Usage, P.m_Type).m_Attachment && getUsageInfo(Other.m_Usage, P.m_Type).m_Attachment &&
+			(OtherImage.m_Desc.m_Extent != I.m_Desc.m_Extent || OtherImage.m_Desc.m_Samples != I.m_Desc.m_Samples)) {
+			Log()->error("Attachments '{}' and '{}' of pass '{}' differ in size", OtherImage.m_Name, I.m_Name, P.m_Name);
+			throw std::runtime_error("render graph attachments differ in size");
+		}
+	}
+	UsageInfo Info = getUsageInfo(Usage, P.m_Type);
+	if (!Info.m_Write || !Info.m_Attachment)
+		Clear.reset();
+	P.m_Uses.push_back({Image.m_Index, Usage, Clear});
+}
+
+vk::Image CRenderGraph::getImage(RenderGraphImage Image) const {
+	const ImageDecl &I = m_Images[Image.m_Index];
+	if (I.m_Imported)
+		return I.m_Image;
+	uint32_t Transient = Image.m_Index < m_ImageTransients.size() ? m_ImageTransients[Image.m_Index] : UINT32_MAX;
+	return Transient != UINT32_MAX ? m_Transients[Transient].m_Image : vk::Image();
+}
+
+vk::ImageView CRenderGraph::getView(RenderGraphImage Image) const {
+	const ImageDecl &I = m_Images[Image.m_Index];
+	if (I.m_Imported)
+		return I.m_View;
+	uint32_t Transient = Image.m_Index < m_ImageTransients.size() ? m_ImageTransients[Image.m_Index] : UINT32_MAX;
+	return Transient != UINT32_MAX ? m_Transients[Transient].m_View : vk::ImageView();
+}
+
+void CRenderGraph::computeSignature(std::pmr::vector<uint64_t> &Signature) const {
+	// Everything the plan depends on, which leaves out the imported images'
+	// handles, the clear values and what passes record.
+	Signature.clear();
+	Signature.push_back(m_Images.size());
+	for (const ImageDecl &I : m_Images) {
+		Signature.push_back(uint64_t(I.m_Imported) | uint64_t(I.m_Desc.m_Format) << 1 | uint64_t(I.m_Desc.m_Samples) << 33);
+		Signature.push_back(uint64_t(I.m_Desc.m_Extent.width) | uint64_t(I.m_Desc.m_Extent.height) << 32);
+		Signature.push_back(uint64_t(I.m_InitialLayout) | uint64_t(I.m_FinalLayout) << 32);
+	}
+	for (const PassDecl &P : m_Passes) {
+		Signature.push_back(uint64_t(P.m_Type) | uint64_t(P.m_SideEffect) << 8 | uint64_t(P.m_Uses.size()) << 32);
+		for (const Use &U : P.m_Uses)
+			Signature.push_back(uint64_t(U.m_Image) | uint64_t(U.m_Usage) << 32 | uint64_t(U.m_Clear.has_value()) << 48);
+	}
+}
+
+void CRenderGraph::release() {
+	CGpuResources &Resources = m_pRenderer->resources();
+	for (auto &[Key, Framebuffer] : m_Framebuffers)
+		Resources.destroyLater(Framebuffer);
+	m_Framebuffers.clear();
+	for (RenderPass &Pass : m_RenderPasses)
+		Resources.destroyLater(Pass.m_RenderPass);
+	m_RenderPasses.clear();
+
+	for (MemoryBlock &Block : m_Blocks) {
+		// The memory goes with the last image bound to it.
+		for (size_t i = 0; i < Block.m_Images.size(); i++) {
+			TransientImage &T = m_Transients[Block.m_Images[i]];
+			Resources.destroyLater(T.m_View);
+			Resources.destroyLater(T.m_Image, i + 1 == Block.m_Images.size() ? Block.m_Memory : GpuAllocation());
+		}
+	}
+	m_Blocks.clear();
+	m_Transients.clear();
+	m_ImageTransients.clear();
+	m_Steps.clear();
+	m_PassSubpass.clear();
+}
+
+void CRenderGraph::cull(std::vector<bool> &Alive) {
+	// Walks the passes backwards, a pass is needed if it writes an image a
+	// later needed pass reads, or one that is imported.
+	Alive.assign(m_Passes.size(), false);
+	std::vector<bool> Needed(m_Images.size());
+	for (size_t i = 0; i < m_Images.size(); i++)
+		Needed[i] = m_Images[i].m_Imported;
+
+	for (size_t p = m_Passes.size(); p-- > 0;) {
+		const PassDecl &P = m_Passes[p];
+		bool Keep = P.m_SideEffect;
+		for (const Use &U : P.m_Uses)
+			Keep |= getUsageInfo(U.m_Usage, P.m_Type).m_Write && Needed[U.m_Image];
+		if (!Keep) {
+			m_Stats.m_CulledPasses++;
+			continue;
+		}
+		Alive[p] = true;
+
+		// Cleared images don't need what earlier passes wrote, anything else
+		// a pass uses is read, written attachments are loaded.
+		for (const Use &U : P.m_Uses)
+			Needed[U.m_Image] = !U.m_Clear.has_value();
+	}
+}
+
+bool CRenderGraph::canMerge(const Step &Group, uint32_t PassIndex) const {
+	const PassDecl &P = m_Passes[PassIndex];
+	const PassDecl &First = m_Passes[Group.m_Passes.front()];
+	// Subpasses are tracked in 64 bit masks.
+	if (Group.m_Passes.size() >= 64)
+		return false;
+
+	const ImageDecl *pAttachment = nullptr;
+	const ImageDecl *pFirstAttachment = nullptr;
+	for (const Use &U : P.m_Uses) {
+		if (getUsageInfo(U.m_Usage, P.m_Type).m_Attachment)
+			pAttachment = &m_Images[U.m_Image];
+	}
+	for (const Use &U : First.m_Uses) {
+		if (getUsageInfo(U.m_Usage, First.m_Type).m_Attachment)
+			pFirstAttachment = &m_Images[U.m_Image];
+	}
+	if (!pAttachment || !pFirstAttachment || pAttachment->m_Desc.m_Extent != pFirstAttachment->m_Desc.m_Extent ||
+		pAttachment->m_Desc.m_Samples != pFirstAttachment->m_Desc.m_Samples)
+		return false;
+
+	// An image can't be an attachment of the render pass and be sampled or
+	// stored to during it, only input attachments read what earlier
+	// subpasses wrote.
+	for (const Use &U : P.m_Uses) {
+		bool Attachment = getUsageInfo(U.m_Usage, P.m_Type).m_Attachment;
+		for (uint32_t Other : Group.m_Passes) {
+			for (const Use &OtherUse : m_Passes[Other].m_Uses) {
+				if (OtherUse.m_Image == U.m_Image && getUsageInfo(OtherUse.m_Usage, RENDER_GRAPH_GRAPHICS).m_Attachment != Attachment)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+void CRenderGraph::buildSteps(const std::vector<bool> &Alive) {
+	m_PassSubpass.assign(m_Passes.size(), 0);
+	for (uint32_t p = 0; p < m_Passes.size(); p++) {
+		if (!Alive[p])
+			continue;
+
+		bool Graphics = m_Passes[p].m_Type == RENDER_GRAPH_GRAPHICS;
+		if (Graphics) {
+			bool HasAttachment = false;
+			for (const Use &U : m_Passes[p].m_Uses)
+				HasAttachment |= getUsageInfo(U.m_Usage, RENDER_GRAPH_GRAPHICS).m_Attachment;
+			if (!HasAttachment) {
+				Log()->error("Graphics pass '{}' has no attachments", m_Passes[p].m_Name);
+				throw std::runtime_error("render graph pass without attachments");
+			}
+		}
+
+		if (Graphics && !m_Steps.empty() && m_Steps.back().m_RenderPass != UINT32_MAX && canMerge(m_Steps.back(), p)) {
+			m_PassSubpass[p] = static_cast<uint32_t>(m_Steps.back().m_Passes.size());
+			m_Steps.back().m_Passes.push_back(p);
+			m_Stats.m_MergedPasses++;
+			continue;
+		}
+
+		Step S;
+		S.m_Passes.push_back(p);
+		if (Graphics) {
+			S.m_RenderPass = static_cast<uint32_t>(m_RenderPasses.size());
+			m_RenderPasses.emplace_back();
+		}
+		m_Steps.push_back(std::move(S));
+	}
+	// Leaves the imported images in their final layouts.
+	m_Steps.emplace_back();
+}
+
+void CRenderGraph::createTransients() {
+	m_ImageTransients.assign(m_Images.size(), UINT32_MAX);
+	for (uint32_t s = 0; s < m_Steps.size(); s++) {
+		for (uint32_t p : m_Steps[s].m_Passes) {
+			const PassDecl &P = m_Passes[p];
+			for (const Use &U : P.m_Uses) {
+				const ImageDecl &I = m_Images[U.m_Image];
+				if (I.m_Imported)
+					continue;
+
+				uint32_t &Index = m_ImageTransients[U.m_Image];
+				if (Index == UINT32_MAX) {
+					Index = static_cast<uint32_t>(m_Transients.size());
+					TransientImage T = {};
+					T.m_Info.imageType = vk::ImageType::e2D;
+					T.m_Info.format = I.m_Desc.m_Format;
+					T.m_Info.extent = vk::Extent3D(I.m_Desc.m_Extent.width, I.m_Desc.m_Extent.height, 1);
+					T.m_Info.mipLevels = 1;
+					T.m_Info.arrayLayers = 1;
+					T.m_Info.samples = I.m_Desc.m_Samples;
+					T.m_Info.tiling = vk::ImageTiling::eOptimal;
+					T.m_Info.sharingMode = vk::SharingMode::eExclusive;
+					T.m_Info.initialLayout = vk::ImageLayout::eUndefined;
+					T.m_Aspect = getAspect(I.m_Desc.m_Format);
+					T.m_First = s;
+					m_Transients.push_back(T);
+				}
+
+				UsageInfo Info = getUsageInfo(U.m_Usage, P.m_Type);
+				TransientImage &T = m_Transients[Index];
+				T.m_Last = s;
+				T.m_Info.usage |= Info.m_ImageUsage;
+				T.m_Stages |= Info.m_Stages;
+				T.m_WriteAccess |= Info.m_Access & WriteAccess;
+			}
+		}
+	}
+
+	for (TransientImage &T : m_Transients) {
+		T.m_Image = m_Device.createImage(T.m_Info);
+		T.m_Requirements = m_Device.getImageMemoryRequirements(T.m_Image);
+		m_Stats.m_TransientBytes += T.m_Requirements.size;
+	}
+	m_Stats.m_TransientImages = static_cast<uint32_t>(m_Transients.size());
+}
+
+void CRenderGraph::aliasTransients() {
+	// Largest first, each image goes in the first block where it fits next
+	// to the images alive at the same time. Blocks are as large as their
+	// first image.
+	std::vector<uint32_t> Order(m_Transients.size());
+	std::iota(Order.begin(), Order.end(), 0u);
+	std::stable_sort(Order.begin(), Order.end(), [&](uint32_t A, uint32_t B) {
+		return m_Transients[A].m_Requirements.size > m_Transients[B].m_Requirements.size;
+	});
+
+	std::vector<std::pair<vk::DeviceSize, vk::DeviceSize>> Taken;
+	for (uint32_t t : Order) {
+		TransientImage &T = m_Transients[t];
+		const vk::MemoryRequirements &R = T.m_Requirements;
+
+		bool Placed = false;
+		for (uint32_t b = 0; b < m_Blocks.size() && !Placed; b++) {
+			MemoryBlock &Block = m_Blocks[b];
+			if (!(Block.m_MemoryTypeBits & R.memoryTypeBits) || R.size > Block.m_Size)
+				continue;
+
+			Taken.clear();
+			for (uint32_t Other : Block.m_Images) {
+				const TransientImage &O = m_Transients[Other];
+				if (O.m_First <= T.m_Last && T.m_First <= O.m_Last)
+					Taken.emplace_back(O.m_Offset, O.m_Offset + O.m_Requirements.size);
+			}
+			std::sort(Taken.begin(), Taken.end());
+
+			vk::DeviceSize Offset = 0;
+			for (const auto &[Start, End] : Taken) {
+				if (alignUp(Offset, R.alignment) + R.size <= Start)
+					break;
+				Offset = std::max(Offset, End);
+			}
+			Offset = alignUp(Offset, R.alignment);
+			if (Offset + R.size > Block.m_Size)
+				continue;
+
+			T.m_Block = b;
+			T.m_Offset = Offset;
+			Block.m_Images.push_back(t);
+			Block.m_Alignment = std::max(Block.m_Alignment, R.alignment);
+			Block.m_MemoryTypeBits &= R.memoryTypeBits;
+			Placed = true;
+		}
+
+		if (!Placed) {
+			T.m_Block = static_cast<uint32_t>(m_Blocks.size());
+			T.m_Offset = 0;
+			m_Blocks.push_back({R.size, R.alignment, R.memoryTypeBits, {t}, GpuAllocation()});
+		}
+	}
+
+	CGpuAllocator &Allocator = m_pRenderer->getAllocator();
+	for (MemoryBlock &Block : m_Blocks) {
+		m_Stats.m_AliasedBytes += Block.m_Size;
+		Block.m_Memory = Allocator.allocate(vk::MemoryRequirements(Block.m_Size, Block.m_Alignment, Block.m_MemoryTypeBits),
+											vk::MemoryPropertyFlagBits::eDeviceLocal, {}, false);
+		for (uint32_t t : Block.m_Images) {
+			TransientImage &T = m_Transients[t];
+			m_Device.bindImageMemory(T.m_Image, Block.m_Memory.m_Memory, Block.m_Memory.m_Offset + T.m_Offset);
+			T.m_View = m_Device.createImageView(vk::ImageViewCreateInfo(vk::ImageViewCreateFlags(), T.m_Image, vk::ImageViewType::e2D,
+																		T.m_Info.format, vk::ComponentMapping(),
+																		vk::ImageSubresourceRange(T.m_Aspect, 0, 1, 0, 1)));
+		}
+	}
+}
+
+void CRenderGraph::createRenderPasses() {
+	// Whether an image holds something worth loading when a step begins.
+	std::vector<bool> Written(m_Images.size());
+	std::vector<uint32_t> LastStep(m_Images.size(), 0);
+	for (size_t i = 0; i < m_Images.size(); i++)
+		Written[i] = m_Images[i].m_Imported && m_Images[i].m_InitialLayout != vk::ImageLayout::eUndefined;
+	for (uint32_t s = 0; s < m_Steps.size(); s++) {
+		for (uint32_t p : m_Steps[s].m_Passes) {
+			for (const Use &U : m_Passes[p].m_Uses)
+				LastStep[U.m_Image] = s;
+		}
+	}
+
+	for (uint32_t s = 0; s < m_Steps.size(); s++) {
+		const Step &S = m_Steps[s];
+		if (S.m_RenderPass != UINT32_MAX) {
+			RenderPass &RP = m_RenderPasses[S.m_RenderPass];
+			uint32_t Subpasses = static_cast<uint32_t>(S.m_Passes.size());
+
+			std::vector<vk::AttachmentDescription> Attachments;
+			std::vector<std::vector<vk::AttachmentReference>> Colors(Subpasses), Inputs(Subpasses);
+			std::vector<vk::AttachmentReference> Depths(Subpasses, vk::AttachmentReference(VK_ATTACHMENT_UNUSED, vk::ImageLayout::eUndefined));
+			// The subpasses each attachment is used in, as a bit mask.
+			std::vector<uint64_t> UsedIn;
+			std::vector<vk::SubpassDependency> Dependencies;
+
+			for (uint32_t Sub = 0; Sub < Subpasses; Sub++) {
+				uint32_t p = S.m_Passes[Sub];
+				const PassDecl &P = m_Passes[p];
+				for (uint32_t u = 0; u < P.m_Uses.size(); u++) {
+					const Use &U = P.m_Uses[u];
+					UsageInfo Info = getUsageInfo(U.m_Usage, P.m_Type);
+					if (!Info.m_Attachment)
+						continue;
+					const ImageDecl &I = m_Images[U.m_Image];
+
+					auto It = std::find(RP.m_Attachments.begin(), RP.m_Attachments.end(), U.m_Image);
+					uint32_t Index = static_cast<uint32_t>(It - RP.m_Attachments.begin());
+					if (It == RP.m_Attachments.end()) {
+						vk::AttachmentLoadOp Load = vk::AttachmentLoadOp::eDontCare;
+						if (U.m_Clear)
+							Load = vk::AttachmentLoadOp::eClear;
+						else if (Written[U.m_Image])
+							Load = vk::AttachmentLoadOp::eLoad;
+						vk::AttachmentStoreOp Store = I.m_Imported || LastStep[U.m_Image] > s ? vk::AttachmentStoreOp::eStore
+																							 : vk::AttachmentStoreOp::eDontCare;
+						bool Stencil = static_cast<bool>(getAspect(I.m_Desc.m_Format) & vk::ImageAspectFlagBits::eStencil);
+
+						// Barriers before the render pass move the images to
+						// the layout of their first use.
+						Attachments.emplace_back(vk::AttachmentDescriptionFlags(), I.m_Desc.m_Format, I.m_Desc.m_Samples, Load, Store,
+												 Stencil ? Load : vk::AttachmentLoadOp::eDontCare, Stencil ? Store : vk::AttachmentStoreOp::eDontCare,
+												 Info.m_Layout, Info.m_Layout);
+						RP.m_Attachments.push_back(U.m_Image);
+						RP.m_FirstUses.emplace_back(p, u);
+						RP.m_Extent = I.m_Desc.m_Extent;
+						UsedIn.push_back(0);
+					}
+					Attachments[Index].finalLayout = Info.m_Layout;
+
+					vk::AttachmentReference Ref(Index, Info.m_Layout);
+					if (U.m_Usage == RENDER_GRAPH_COLOR)
+						Colors[Sub].push_back(Ref);
+					else if (U.m_Usage == RENDER_GRAPH_INPUT)
+						Inputs[Sub].push_back(Ref);
+					else
+						Depths[Sub] = Ref;
+
+					// Depends on every earlier subpass using the image,
+					// unless both only read it.
+					for (uint32_t Earlier = 0; Earlier < Sub; Earlier++) {
+						if (!(UsedIn[Index] >> Earlier & 1))
+							continue;
+						const PassDecl &E = m_Passes[S.m_Passes[Earlier]];
+						for (const Use &EarlierUse : E.m_Uses) {
+							if (EarlierUse.m_Image != U.m_Image)
+								continue;
+							UsageInfo EarlierInfo = getUsageInfo(EarlierUse.m_Usage, E.m_Type);
+							if (!EarlierInfo.m_Write && !Info.m_Write)
+								continue;
+
+							auto Dependency = std::find_if(Dependencies.begin(), Dependencies.end(), [&](const vk::SubpassDependency &D) {
+								return D.srcSubpass == Earlier && D.dstSubpass == Sub;
+							});
+							if (Dependency == Dependencies.end()) {
+								Dependencies.emplace_back(Earlier, Sub, vk::PipelineStageFlags(), vk::PipelineStageFlags(), vk::AccessFlags(),
+														  vk::AccessFlags(), vk::DependencyFlagBits::eByRegion);
+								Dependency = Dependencies.end() - 1;
+							}
+							Dependency->srcStageMask |= EarlierInfo.m_Stages;
+							Dependency->dstStageMask |= Info.m_Stages;
+							Dependency->srcAccessMask |= EarlierInfo.m_Access & WriteAccess;
+							Dependency->dstAccessMask |= Info.m_Access;
+						}
+					}
+					UsedIn[Index] |= uint64_t(1) << Sub;
+				}
+			}
+
+			// Attachments used before and after a subpass but not by it.
+			std::vector<std::vector<uint32_t>> Preserves(Subpasses);
+			for (uint32_t a = 0; a < UsedIn.size(); a++) {
+				for (uint32_t Sub = 1; Sub + 1 < Subpasses; Sub++) {
+					uint64_t Before = UsedIn[a] & ((uint64_t(1) << Sub) - 1);
+					uint64_t After = UsedIn[a] >> (Sub + 1);
+					if (Before && After && !(UsedIn[a] >> Sub & 1))
+						Preserves[Sub].push_back(a);
+				}
+			}
+
+			std::vector<vk::SubpassDescription> Descriptions(Subpasses);
+			for (uint32_t Sub = 0; Sub < Subpasses; Sub++) {
+				vk::SubpassDescription &D = Descriptions[Sub];
+				D.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+				D.inputAttachmentCount = static_cast<uint32_t>(Inputs[Sub].size());
+				D.pInputAttachments = Inputs[Sub].data();
+				D.colorAttachmentCount = static_cast<uint32_t>(Colors[Sub].size());
+				D.pColorAttachments = Colors[Sub].data();
+				D.pDepthStencilAttachment = Depths[Sub].attachment != VK_ATTACHMENT_UNUSED ? &Depths[Sub] : nullptr;
+				D.preserveAttachmentCount = static_cast<uint32_t>(Preserves[Sub].size());
+				D.pPreserveAttachments = Preserves[Sub].data();
+			}
+
+			vk::RenderPassCreateInfo Info(vk::RenderPassCreateFlags(), Attachments, Descriptions, Dependencies);
+			RP.m_RenderPass = m_Device.createRenderPass(Info);
+			m_Stats.m_RenderPasses++;
+			m_Stats.m_SubpassDependencies += static_cast<uint32_t>(Dependencies.size());
+		}
+
+		for (uint32_t p : S.m_Passes) {
+			for (const Use &U : m_Passes[p].m_Uses)
+				Written[U.m_Image] = Written[U.m_Image] || getUsageInfo(U.m_Usage, m_Passes[p].m_Type).m_Write;
+		}
+	}
+}
+
+void CRenderGraph::planBarriers() {
+	struct State {
+		vk::ImageLayout m_Layout = vk::ImageLayout::eUndefined;
+		// The last write, and the reads since.
+		vk::PipelineStageFlags m_WriteStages;
+		vk::AccessFlags m_WriteAccess;
+		vk::PipelineStageFlags m_ReadStages;
+		// Where the last write has been made visible.
+		vk::PipelineStageFlags m_VisibleStages;
+		vk::AccessFlags m_VisibleAccess;
+	};
+
+	std::vector<State> States(m_Images.size());
+	for (uint32_t i = 0; i < m_Images.size(); i++) {
+		State &S = States[i];
+		if (m_Images[i].m_Imported) {
+			// Nothing is known of what used it before.
+			S.m_Layout = m_Images[i].m_InitialLayout;
+			S.m_WriteStages = vk::PipelineStageFlagBits::eAllCommands;
+			S.m_WriteAccess = vk::AccessFlagBits::eMemoryWrite;
+		} else if (m_ImageTransients[i] != UINT32_MAX) {
+			// The memory was last used by an image aliasing it, or by this
+			// image in the previous frame.
+			const MemoryBlock &Block = m_Blocks[m_Transients[m_ImageTransients[i]].m_Block];
+			for (uint32_t Other : Block.m_Images) {
+				S.m_WriteStages |= m_Transients[Other].m_Stages;
+				S.m_WriteAccess |= m_Transients[Other].m_WriteAccess;
+			}
+		}
+	}
+
+	std::vector<uint32_t> Seen(m_Images.size(), UINT32_MAX);
+	for (uint32_t s = 0; s < m_Steps.size(); s++) {
+		Step &St = m_Steps[s];
+		BarrierBatch &Batch = St.m_Barriers;
+
+		for (uint32_t p : St.m_Passes) {
+			const PassDecl &P = m_Passes[p];
+			for (const Use &U : P.m_Uses) {
+				UsageInfo Info = getUsageInfo(U.m_Usage, P.m_Type);
+				State &S = States[U.m_Image];
+
+				// Later subpasses are synchronized by the render pass.
+				if (Seen[U.m_Image] == s) {
+					S.m_Layout = Info.m_Layout;
+					if (Info.m_Write) {
+						S.m_WriteStages = Info.m_Stages;
+						S.m_WriteAccess = Info.m_Access & WriteAccess;
+						S.m_ReadStages = vk::PipelineStageFlags();
+						S.m_VisibleStages = vk::PipelineStageFlags();
+						S.m_VisibleAccess = vk::AccessFlags();
+					} else {
+						S.m_ReadStages |= Info.m_Stages;
+						S.m_VisibleStages |= Info.m_Stages;
+						S.m_VisibleAccess |= Info.m_Access;
+					}
+					continue;
+				}
+				Seen[U.m_Image] = s;
+
+				bool Transition = S.m_Layout != Info.m_Layout;
+				if (Transition || Info.m_Write) {
+					// Waits for the last write and the reads since, which
+					// needs no memory dependency if nothing was written.
+					vk::PipelineStageFlags Src = S.m_WriteStages | S.m_ReadStages;
+					if (Transition || S.m_WriteAccess) {
+						vk::ImageLayout Old = U.m_Clear ? vk::ImageLayout::eUndefined : S.m_Layout;
+						Batch.m_Barriers.push_back({U.m_Image, Old, Info.m_Layout, S.m_WriteAccess, Info.m_Access});
+					}
+					if (Src) {
+						Batch.m_SrcStages |= Src;
+						Batch.m_DstStages |= Info.m_Stages;
+					} else if (Transition) {
+						Batch.m_DstStages |= Info.m_Stages;
+					}
+
+					S.m_Layout = Info.m_Layout;
+					if (Info.m_Write) {
+						S.m_WriteStages = Info.m_Stages;
+						S.m_WriteAccess = Info.m_Access & WriteAccess;
+						S.m_ReadStages = vk::PipelineStageFlags();
+						S.m_VisibleStages = vk::PipelineStageFlags();
+						S.m_VisibleAccess = vk::AccessFlags();
+					} else {
+						S.m_ReadStages = Info.m_Stages;
+						S.m_VisibleStages = Info.m_Stages;
+						S.m_VisibleAccess = Info.m_Access;
+					}
+				} else {
+					// Reads in the same layout only wait for a write that
+					// isn't visible to them yet.
+					bool Visible = (Info.m_Stages & S.m_VisibleStages) == Info.m_Stages && (Info.m_Access & S.m_VisibleAccess) == Info.m_Access;
+					if (S.m_WriteAccess && !Visible) {
+						Batch.m_Barriers.push_back({U.m_Image, S.m_Layout, S.m_Layout, S.m_WriteAccess, Info.m_Access});
+						Batch.m_SrcStages |= S.m_WriteStages;
+						Batch.m_DstStages |= Info.m_Stages;
+						S.m_VisibleStages |= Info.m_Stages;
+						S.m_VisibleAccess |= Info.m_Access;
+					}
+					S.m_ReadStages |= Info.m_Stages;
+				}
+			}
+		}
+	}
+
+	// Whatever uses the imported images after the graph does so in their
+	// final layouts, with everything the graph wrote visible.
+	BarrierBatch &Final = m_Steps.back().m_Barriers;
+	for (uint32_t i = 0; i < m_Images.size(); i++) {
+		const ImageDecl &I = m_Images[i];
+		const State &S = States[i];
+		if (!I.m_Imported || I.m_FinalLayout == vk::ImageLayout::eUndefined || (S.m_Layout == I.m_FinalLayout && !S.m_WriteAccess))
+			continue;
+		Final.m_Barriers.push_back({i, S.m_Layout, I.m_FinalLayout, S.m_WriteAccess, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite});
+		Final.m_SrcStages |= S.m_WriteStages | S.m_ReadStages;
+		Final.m_DstStages |= vk::PipelineStageFlagBits::eAllCommands;
+	}
+
+	for (const Step &St : m_Steps) {
+		m_Stats.m_ImageBarriers += static_cast<uint32_t>(St.m_Barriers.m_Barriers.size());
+		m_Stats.m_BarrierBatches += St.m_Barriers.m_SrcStages || !St.m_Barriers.m_Barriers.empty();
+	}
+}
+
+void CRenderGraph::compile() {
+	auto Start = std::chrono::steady_clock::now();
+	release();
+
+	uint32_t Compiles = m_Stats.m_Compiles;
+	m_Stats = RenderGraphStats();
+	m_Stats.m_Compiles = Compiles + 1;
+	m_Stats.m_Passes = static_cast<uint32_t>(m_Passes.size());
+	for (const PassDecl &P : m_Passes)
+		m_Stats.m_NaiveBarriers += static_cast<uint32_t>(P.m_Uses.size());
+	for (const ImageDecl &I : m_Images)
+		m_Stats.m_NaiveBarriers += I.m_Imported;
+
+	std::vector<bool> Alive;
+	cull(Alive);
+	buildSteps(Alive);
+	createTransients();
+	aliasTransients();
+	createRenderPasses();
+	planBarriers();
+
+	m_Stats.m_CompileTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	SPS_LOG_DEBUG("Compiled {} passes into {} render passes and {} other steps, {} culled and {} merged, {} barriers in {} batches, "
+				 "{} KiB of transient images in {} KiB",
+				 m_Stats.m_Passes, m_Stats.m_RenderPasses, m_Steps.size() - 1 - m_Stats.m_RenderPasses, m_Stats.m_CulledPasses,
+				 m_Stats.m_MergedPasses, m_Stats.m_ImageBarriers, m_Stats.m_BarrierBatches, m_Stats.m_TransientBytes >> 10,
+				 m_Stats.m_AliasedBytes >> 10);
+}
+
+vk::Framebuffer CRenderGraph::getFramebuffer(const RenderPass &Pass) {
+	std::pmr::vector<uint64_t> Key(frameMemory());
+	std::pmr::vector<vk::ImageView> Views(frameMemory());
+	Key.push_back(uint64_t(static_cast<VkRenderPass>(Pass.m_RenderPass)));
+	for (uint32_t Image : Pass.m_Attachments) {
+		Views.push_back(getView({Image}));
+		Key.push_back(uint64_t(static_cast<VkImageView>(Views.back())));
+	}
+
+	auto It = m_Framebuffers.find(Key);
+	if (It != m_Framebuffers.end())
+		return It->second;
+
+	if (m_Framebuffers.size() >= MaxFramebuffers) {
+		for (auto &[OldKey, Framebuffer] : m_Framebuffers)
+			m_pRenderer->resources().destroyLater(Framebuffer);
+		m_Framebuffers.clear();
+	}
+	vk::FramebufferCreateInfo Info(vk::FramebufferCreateFlags(), Pass.m_RenderPass, Views, Pass.m_Extent.width, Pass.m_Extent.height, 1);
+	vk::Framebuffer Framebuffer = m_Device.createFramebuffer(Info);
+	m_Framebuffers.emplace(std::vector<uint64_t>(Key.begin(), Key.end()), Framebuffer);
+	return Framebuffer;
+}
+
+void CRenderGraph::forgetView(vk::ImageView View) {
+	uint64_t Handle = uint64_t(static_cast<VkImageView>(View));
+	for (auto It = m_Framebuffers.begin(); It != m_Framebuffers.end();) {
+		// The render pass comes first, the views after it.
+		if (std::find(It->first.begin() + 1, It->first.end(), Handle) != It->first.end()) {
+			m_pRenderer->resources().destroyLater(It->second);
+			It = m_Framebuffers.erase(It);
+		} else {
+			++It;
+		}
+	}
+}
+
+void CRenderGraph::recordBarriers(vk::CommandBuffer Cmd, const BarrierBatch &Batch) const {
+	if (Batch.m_Barriers.empty() && !Batch.m_SrcStages)
+		return;
+
+	std::pmr::vector<vk::ImageMemoryBarrier> Barriers(frameMemory());
+	Barriers.reserve(Batch.m_Barriers.size());
+	for (const Barrier &B : Batch.m_Barriers) {
+		vk::ImageSubresourceRange Range(getAspect(m_Images[B.m_Image].m_Desc.m_Format), 0, 1, 0, 1);
+		Barriers.emplace_back(B.m_SrcAccess, B.m_DstAccess, B.m_OldLayout, B.m_NewLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+							  getImage({B.m_Image}), Range);
+	}
+	vk::PipelineStageFlags Src = Batch.m_SrcStages ? Batch.m_SrcStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+	vk::PipelineStageFlags Dst = Batch.m_DstStages ? Batch.m_DstStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eBottomOfPipe);
+	Cmd.pipelineBarrier(Src, Dst, vk::DependencyFlags(), nullptr, nullptr, Barriers);
+}
+
+void CRenderGraph::execute(vk::CommandBuffer Cmd) {
+	if (m_Passes.empty())
+		return;
+
+	std::pmr::vector<uint64_t> Signature(frameMemory());
+	computeSignature(Signature);
+	if (!std::equal(Signature.begin(), Signature.end(), m_Signature.begin(), m_Signature.end())) {
+		compile();
+		m_Signature.assign(Signature.begin(), Signature.end());
+	}
+
+	std::pmr::vector<vk::ClearValue> ClearValues(frameMemory());
+	for (const Step &S : m_Steps) {
+		recordBarriers(Cmd, S.m_Barriers);
+
+		if (S.m_RenderPass == UINT32_MAX) {
+			for (uint32_t p : S.m_Passes) {
+				if (m_Passes[p].m_Record)
+					m_Passes[p].m_Record(Cmd, RenderGraphPassInfo());
+			}
+			continue;
+		}
+
+		const RenderPass &RP = m_RenderPasses[S.m_RenderPass];
+		ClearValues.clear();
+		for (const auto &[PassIndex, UseIndex] : RP.m_FirstUses)
+			ClearValues.push_back(m_Passes[PassIndex].m_Uses[UseIndex].m_Clear.value_or(vk::ClearValue()));
+
+		vk::RenderPassBeginInfo BeginInfo(RP.m_RenderPass, getFramebuffer(RP), vk::Rect2D(vk::Offset2D(0, 0), RP.m_Extent), ClearValues);
+		Cmd.beginRenderPass(BeginInfo, vk::SubpassContents::eInline);
+		for (uint32_t p : S.m_Passes) {
+			RenderGraphPassInfo Info;
+			Info.m_RenderPass = RP.m_RenderPass;
+			Info.m_Subpass = m_PassSubpass[p];
+			Info.m_Extent = RP.m_Extent;
+			if (Info.m_Subpass > 0)
+				Cmd.nextSubpass(vk::SubpassContents::eInline);
+			if (m_Passes[p].m_Record)
+				m_Passes[p].m_Record(Cmd, Info);
+		}
+		Cmd.endRenderPass();
+	}
+}
+
+} // namespace sps
@@ -1,16 +1,21 @@
 #include "SuperSDL/engine.hpp"
 #include <SDL.h>
 #include <SDL_vulkan.h>
+#include <SuperSDL/profiler.hpp>
 #include <SuperSDL/renderer.hpp>
+#include <SuperSDL/shader.hpp>
+#include <SuperSDL/startup.hpp>
 #include <SuperSDL/util.hpp>
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iterator>
-#include <map>
 #include <set>
 #include <stdexcept>
 #include <utility>
@@ -28,7 +33,7 @@ const bool EnableValidationLayers = false;
 const bool EnableValidationLayers = true;
 #endif
 
-const std::vector<const char *> DeviceExtensions = {
+const std::vector<const char *> PresentDeviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData, void *pUserData) {
@@ -38,51 +43,216 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityF
 	return VK_FALSE;
 }
 
-static std::vector<char> readFile(const std::string &filename) {
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-	if (!file.is_open()) {
-		throw std::runtime_error("failed to open file!");
-	}
-
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> buffer(fileSize);
-
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
-
-	file.close();
+// The two calls of vkEnumerate* and vkGet*s, into a vector from any memory
+// resource. Call(pCount, pData) makes one of them, the list is asked for again
+// when it changed in between.
+template <typename T, typename F>
+static void enumerateInto(std::pmr::vector<T> &Out, F &&Call, const char *pWhat) {
+	vk::Result Result;
+	do {
+		uint32_t Count = 0;
+		Result = Call(&Count, nullptr);
+		if (Result == vk::Result::eSuccess) {
+			Out.resize(Count);
+			Result = Call(&Count, Out.data());
+			Out.resize(Count);
+		}
+	} while (Result == vk::Result::eIncomplete);
 
-	return buffer;
+	if (Result != vk::Result::eSuccess)
+		throw vk::SystemError(vk::make_error_code(Result), pWhat);
 }
 
 CRenderer::CRenderer(CEngine *pEngine) : CLoggable("renderer"), m_Window(nullptr, nullptr) {
 	m_pEngine = pEngine;
+	m_FramesInFlight = 2;
+	m_CurrentFrame = 0;
+	m_ImageIndex = 0;
+	m_FrameStarted = false;
+	m_RecordThreads = 0;
+	m_PipelineCacheWarm = false;
+	m_MaxSprites = 1 << 16;
+	m_FontAtlasSize = 1024;
+	m_StagingSize = 32 << 20;
+	m_Bindless = true;
+	m_DescriptorIndexing = false;
+	m_MaxTextures = 4096;
+	m_PresentMode = vk::PresentModeKHR::eMailbox;
+	m_RequestedImageCount = 0;
+	m_SwapChainDirty = false;
+	m_DrawableWidth = 0;
+	m_DrawableHeight = 0;
+	m_TransientMemorySize = 16 << 20;
+	m_Headless = false;
+	m_HeadlessExtent = vk::Extent2D(640, 480);
+	m_ReadbackRequested = false;
+	m_CpuFrameTime = 0.0;
+	m_FrameNumber = 0;
 
 	m_ValidationLayers = {"VK_LAYER_KHRONOS_validation"};
+	m_Validation = EnableValidationLayers;
+	m_WindowWidth = 640;
+	m_WindowHeight = 480;
 }
 
 void CRenderer::init() {
-	// TODO: Use a config
-	Log()->info("Starting vulkan renderer...");
-	m_Window = util::makeResource(SDL_CreateWindow, SDL_DestroyWindow, "", SDL_WINDOWPOS_UNDEFINED,
-								  SDL_WINDOWPOS_UNDEFINED,
-								  640, 480,
-								  SDL_WINDOW_VULKAN);
-	createInstance();
-	setupDebugCallback();
-	create_surface();
-	pickPhysicalDevice();
-	createLogicalDevice();
-	createSwapChain();
-	createImageViews();
+	SPS_PROFILE_SCOPE("CRenderer::init");
+	Log()->info("Starting vulkan renderer{}...", m_Headless ? " (headless)" : "");
+	CStartup &Startup = engine()->startup();
+	CJobSystem &Jobs = engine()->jobs();
+
+	// Vulkan objects are created one after the other on this thread, what
+	// doesn't need them goes on the job system: the pipeline cache file is
+	// read while the device is created and the pipelines are compiled while
+	// the frame resources are set up.
+	auto ReadCache = [this, &Startup]() { Startup.time("readPipelineCache", [this]() { readPipelineCache(); }); };
+	if (Startup.isParallel())
+		Jobs.schedule(ReadCache, &m_PipelineCacheRead);
+	else
+		ReadCache();
+
+	if (!m_Headless) {
+		Startup.time("createWindow", [this]() {
+			m_Window = util::makeResource(SDL_CreateWindow, SDL_DestroyWindow, "", SDL_WINDOWPOS_UNDEFINED,
+										  SDL_WINDOWPOS_UNDEFINED,
+										  m_WindowWidth, m_WindowHeight,
+										  SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+		});
+		m_DeviceExtensions = PresentDeviceExtensions;
+	}
+	Startup.time("createInstance", [this]() {
+		createInstance();
+		setupDebugCallback();
+		if (!m_Headless)
+			create_surface();
+	});
+	Startup.time("pickPhysicalDevice", [this]() { pickPhysicalDevice(); });
+	Startup.time("createLogicalDevice", [this]() { createLogicalDevice(); });
+	m_Allocator.init(m_PhysicalDevice, m_Device, m_FramesInFlight, m_TransientMemorySize);
+	m_Resources.init(m_Device, &m_Allocator);
+	m_Resources.setViewRetiredCallback([this](vk::ImageView View) { m_Graph.forgetView(View); });
+	Jobs.wait(m_PipelineCacheRead);
+	loadPipelineCache();
+	Startup.time("createSwapChain", [this]() {
+		if (m_Headless) {
+			createOffscreenTargets();
+		} else if (!createSwapChain()) {
+			Log()->error("failed to create swap chain, the window has no size");
+			throw std::runtime_error("failed to create swap chain");
+		}
+		createImageViews();
+		createRenderPass();
+	});
+	{
+		SPS_PROFILE_SCOPE("createTextRenderer");
+		m_TextRenderer.init(this, m_FontAtlasSize, m_FontAtlasSize);
+	}
+	if (m_Bindless && !m_DescriptorIndexing)
+		Log()->info("The device lacks descriptor indexing, textures won't be bindless");
+	m_Textures.init(this, m_Bindless && m_DescriptorIndexing, m_MaxTextures);
+	m_Graph.init(this);
+	createGraphicsPipeline();
+
+	Startup.time("createFrameResources", [this, &Jobs]() {
+		createFramebuffers();
+		createFrameResources();
+		{
+			SPS_PROFILE_SCOPE("createGpuProfiler");
+			if (!m_GpuProfiler.init(m_PhysicalDevice, m_Device, m_DeviceInfo.m_Families.m_GraphicsFamily.value(), m_FramesInFlight, 64))
+				Log()->info("Timestamps not supported, GPU frame times won't be available");
+		}
+		m_SpriteBatch.init(this, m_MaxSprites);
+		{
+			SPS_PROFILE_SCOPE("createAssetStreamer");
+			const QueueFamilyIndices &Indices = m_DeviceInfo.m_Families;
+			m_Assets.init(this, &Jobs, m_TransferQueue, Indices.m_TransferFamily.value(), Indices.m_GraphicsFamily.value(), m_StagingSize);
+		}
+	});
+	// Shows how long this thread was left waiting for the compiles.
+	Startup.time("waitForPipelines", [this]() { waitForPipelines(); });
 	Log()->info("Renderer started.");
 }
 
 void CRenderer::quit() {
+	Log()->info("Stopping renderer.");
+	m_Device.waitIdle();
+
+	// Hand out whatever the GPU finished since the last frame.
+	for (uint32_t i = 0; i < m_Frames.size(); i++)
+		resolveFrame(i);
+
+	m_Assets.quit();
+	m_SpriteBatch.quit();
+	m_Graph.quit();
+	m_Textures.quit();
+	m_TextRenderer.quit();
+	m_GpuProfiler.quit();
+
+	for (auto &Readback : m_Readbacks)
+		destroyBuffer(Readback.m_Buffer, Readback.m_Memory);
+	m_Readbacks.clear();
+
+	for (auto &Frame : m_Frames) {
+		for (auto &Thread : Frame.m_Threads)
+			m_Device.destroyCommandPool(Thread.m_CommandPool);
+		m_Device.destroyFence(Frame.m_InFlight);
+		m_Device.destroySemaphore(Frame.m_RenderFinished);
+		m_Device.destroySemaphore(Frame.m_ImageAvailable);
+		m_Device.destroyCommandPool(Frame.m_CommandPool);
+	}
+	m_Frames.clear();
+	m_ImagesInFlight.clear();
+
+	for (auto Framebuffer : m_SwapChainFramebuffers)
+		m_Device.destroyFramebuffer(Framebuffer);
+	m_SwapChainFramebuffers.clear();
+
+	for (auto Pipeline : m_Pipelines)
+		m_Device.destroyPipeline(Pipeline);
+	m_Pipelines.clear();
+
+	savePipelineCache();
+	m_Device.destroyPipelineCache(m_PipelineCache);
+	m_Device.destroyPipelineLayout(m_PipelineLayout);
+	m_Device.destroyRenderPass(m_RenderPass);
+
+	for (auto View : m_SwapChainImageViews)
+		m_Device.destroyImageView(View);
+	m_SwapChainImageViews.clear();
+
+	if (m_Headless) {
+		for (size_t i = 0; i < m_SwapChainImages.size(); i++) {
+			m_Device.destroyImage(m_SwapChainImages[i]);
+			m_Allocator.free(m_OffscreenMemory[i]);
+		}
+		m_OffscreenMemory.clear();
+	}
+	m_SwapChainImages.clear();
+
+	m_Resources.quit();
+	m_Allocator.quit();
+
+	destroyRetiredSwapChains(true);
+	if (m_SwapChain)
+		m_Device.destroySwapchainKHR(m_SwapChain);
+	m_Device.destroy();
+
+	if (m_Surface)
+		m_Instance.destroySurfaceKHR(m_Surface);
+	if (m_DebugMessenger)
+		m_Instance.destroyDebugUtilsMessengerEXT(m_DebugMessenger);
+	m_Instance.destroy();
+	m_Window.reset();
+}
+
+void CRenderer::setFramesInFlight(uint32_t Count) {
+	if (!m_Frames.empty())
+		throw std::runtime_error("frames in flight can't be changed after init");
+	m_FramesInFlight = std::max(1u, Count);
 }
 
 void CRenderer::createInstance() {
+	SPS_PROFILE_SCOPE("createInstance");
 	{
 		PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = m_DynamicLoader.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr");
 		if (vkGetInstanceProcAddr == nullptr) {
@@ -90,7 +260,7 @@ void CRenderer::createInstance() {
 		}
 		VULKAN_HPP_DEFAULT_DISPATCHER.init(vkGetInstanceProcAddr);
 
-		if (EnableValidationLayers && !checkValidationLayerSupport()) {
+		if (m_Validation && !checkValidationLayerSupport()) {
 			throw std::runtime_error("validation layers requested, but not available!");
 		}
 		auto AppInfo = vk::ApplicationInfo(
@@ -103,27 +273,22 @@ void CRenderer::createInstance() {
 		unsigned int count;
 		std::vector<const char *> RequiredExtensions = {};
 
-#ifndef NDEBUG
-		RequiredExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-#endif
+		if (m_Validation)
+			RequiredExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
 		size_t AdditionExtCount = RequiredExtensions.size();
 
-		if (SDL_Vulkan_GetInstanceExtensions(m_Window.get(), &count, nullptr)) {
-			RequiredExtensions.resize(AdditionExtCount + count);
-		}
-
-		SDL_Vulkan_GetInstanceExtensions(m_Window.get(), &count, RequiredExtensions.data() + AdditionExtCount);
+		// Headless rendering doesn't need any surface extension.
+		if (!m_Headless) {
+			if (SDL_Vulkan_GetInstanceExtensions(m_Window.get(), &count, nullptr)) {
+				RequiredExtensions.resize(AdditionExtCount + count);
+			}
 
-		for (const auto &ext : RequiredExtensions) {
-			Log()->info("Vulkan - Required extension: {}", ext);
+			SDL_Vulkan_GetInstanceExtensions(m_Window.get(), &count, RequiredExtensions.data() + AdditionExtCount);
 		}
 
-		// This shows all the available extensions
-		auto AvailableExtensions = vk::enumerateInstanceExtensionProperties();
-
-		for (const auto &ext : AvailableExtensions) {
-			Log()->debug("Vulkan - Available extension: {}", ext.extensionName);
+		for (const auto &ext : RequiredExtensions) {
+			Log()->debug("Vulkan - Required extension: {}", ext);
 		}
 
 		auto CreateInfo = vk::InstanceCreateInfo(
@@ -132,7 +297,7 @@ void CRenderer::createInstance() {
 			0, nullptr,
 			RequiredExtensions.size(), RequiredExtensions.data());
 
-		if (EnableValidationLayers) {
+		if (m_Validation) {
 			CreateInfo.enabledLayerCount = m_ValidationLayers.size();
 			CreateInfo.ppEnabledLayerNames = m_ValidationLayers.data();
 			Log()->debug("Vulkan - Enabled validation layers (size={})", m_ValidationLayers.size());
@@ -149,13 +314,11 @@ void CRenderer::createInstance() {
 	// TODO: Initialize it also with a device later: https://github.com/KhronosGroup/Vulkan-Hpp#extensions--per-device-function-pointers
 }
 
-int CRenderer::ratePhysicalDevice(const vk::PhysicalDevice &device) const {
-	Log()->debug("Rating physical device: {}", device.getProperties().deviceName.data());
+int CRenderer::ratePhysicalDevice(const PhysicalDeviceInfo &Info) const {
+	const vk::PhysicalDeviceProperties &Properties = Info.m_Properties;
+	Log()->debug("Rating physical device: {}", Properties.deviceName.data());
 	int score = 0;
 
-	vk::PhysicalDeviceProperties Properties = device.getProperties();
-	vk::PhysicalDeviceFeatures Features = device.getFeatures();
-
 	// Favor dedicated gpus
 	if (Properties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu)
 		score += 1000;
@@ -163,10 +326,13 @@ int CRenderer::ratePhysicalDevice(const vk::PhysicalDevice &device) const {
 	Log()->debug("MaxImageDimension2D: {}", Properties.limits.maxImageDimension2D);
 	score += Properties.limits.maxImageDimension2D;
 
-	if (!Features.geometryShader)
-		return 0;
+	// Sprites with different textures share draws when it's bindless.
+	if (Info.m_DescriptorIndexing) {
+		Log()->debug("Supports descriptor indexing");
+		score += 500;
+	}
 
-	if (!isDeviceSuitable(device))
+	if (!isDeviceSuitable(Info))
 		return 0;
 
 	Log()->debug("Score: {}", score);
@@ -174,51 +340,92 @@ int CRenderer::ratePhysicalDevice(const vk::PhysicalDevice &device) const {
 	return score;
 }
 
-bool CRenderer::checkDeviceExtSupport(const vk::PhysicalDevice &Device) const {
-	std::set<std::string> RequiredExtensions(DeviceExtensions.begin(), DeviceExtensions.end());
-
-	for (const auto &ext : Device.enumerateDeviceExtensionProperties()) {
-		RequiredExtensions.erase(ext.extensionName.data());
+bool CRenderer::checkDeviceExtSupport(const vk::PhysicalDevice &Device, std::pmr::memory_resource *pMemory) const {
+	std::pmr::vector<vk::ExtensionProperties> Available(pMemory);
+	enumerateInto(Available, [&](uint32_t *pCount, vk::ExtensionProperties *pProperties) {
+		return Device.enumerateDeviceExtensionProperties(nullptr, pCount, pProperties);
+	}, "vkEnumerateDeviceExtensionProperties");
+
+	// A handful of names against a few hundred, a set would cost more.
+	for (const char *pRequired : m_DeviceExtensions) {
+		auto It = std::find_if(Available.begin(), Available.end(), [pRequired](const vk::ExtensionProperties &Extension) {
+			return std::strcmp(Extension.extensionName.data(), pRequired) == 0;
+		});
+		if (It == Available.end())
+			return false;
 	}
-
-	return RequiredExtensions.empty();
+	return true;
 }
 
-bool CRenderer::isDeviceSuitable(const vk::PhysicalDevice &Device) const {
-	QueueFamilyIndices Indices = findQueueFamilies(Device);
+bool CRenderer::checkDescriptorIndexing(const vk::PhysicalDevice &Device, const vk::PhysicalDeviceProperties &Properties) const {
+	// Core since Vulkan 1.2, older devices are treated as lacking it.
+	if (Properties.apiVersion < VK_API_VERSION_1_2)
+		return false;
 
-	bool ExtensionsSupported = checkDeviceExtSupport(Device);
+	auto Features = Device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDescriptorIndexingFeatures>();
+	const auto &Indexing = Features.get<vk::PhysicalDeviceDescriptorIndexingFeatures>();
+	return Indexing.runtimeDescriptorArray && Indexing.descriptorBindingPartiallyBound &&
+		   Indexing.descriptorBindingSampledImageUpdateAfterBind && Indexing.descriptorBindingUpdateUnusedWhilePending &&
+		   Indexing.shaderSampledImageArrayNonUniformIndexing;
+}
 
-	bool SwapChainGood = false;
-	if (ExtensionsSupported) {
-		SwapChainSupportDetails Details = querySwapChainSupport(Device);
-		SwapChainGood = !Details.m_Formats.empty() && !Details.m_PresentModes.empty();
+CRenderer::PhysicalDeviceInfo CRenderer::queryPhysicalDevice(const vk::PhysicalDevice &Device, std::pmr::memory_resource *pMemory) const {
+	PhysicalDeviceInfo Info;
+	Info.m_Device = Device;
+	Info.m_Properties = Device.getProperties();
+	Info.m_DescriptorIndexing = checkDescriptorIndexing(Device, Info.m_Properties);
+	Info.m_Families = findQueueFamilies(Device, pMemory);
+	Info.m_ExtensionsSupported = checkDeviceExtSupport(Device, pMemory);
+
+	Info.m_SwapChainGood = m_Headless;
+	if (Info.m_ExtensionsSupported && !m_Headless) {
+		SwapChainSupportDetails Details = querySwapChainSupport(Device, pMemory);
+		Info.m_SwapChainGood = !Details.m_Formats.empty() && !Details.m_PresentModes.empty();
 	}
+	return Info;
+}
 
-	return Indices.isComplete() && ExtensionsSupported && SwapChainGood;
+bool CRenderer::isDeviceSuitable(const PhysicalDeviceInfo &Info) const {
+	return Info.m_Families.isComplete() && Info.m_ExtensionsSupported && Info.m_SwapChainGood;
 }
 
 void CRenderer::pickPhysicalDevice() {
+	SPS_PROFILE_SCOPE("pickPhysicalDevice");
 	Log()->debug("Picking a physical device");
-	std::multimap<int, vk::PhysicalDevice> Candidates;
-
-	for (const auto &device : m_Instance.enumeratePhysicalDevices()) {
-		int score = ratePhysicalDevice(device);
-		Candidates.insert(std::make_pair(score, device));
+	std::pmr::memory_resource *pMemory = frameMemory();
+	std::pmr::vector<vk::PhysicalDevice> Devices(pMemory);
+	enumerateInto(Devices, [this](uint32_t *pCount, vk::PhysicalDevice *pDevices) {
+		return m_Instance.enumeratePhysicalDevices(pCount, pDevices);
+	}, "vkEnumeratePhysicalDevices");
+
+	int BestScore = 0;
+	for (const vk::PhysicalDevice &Device : Devices) {
+		PhysicalDeviceInfo Info = queryPhysicalDevice(Device, pMemory);
+		int Score = ratePhysicalDevice(Info);
+		// Ties go to the device listed last.
+		if (Score > 0 && Score >= BestScore) {
+			BestScore = Score;
+			m_DeviceInfo = Info;
+		}
 	}
 
-	if (Candidates.rbegin()->first > 0) {
-		m_PhysicalDevice = Candidates.rbegin()->second;
-		Log()->debug("Picked physical device: {}", m_PhysicalDevice.getProperties().deviceName.data());
+	if (BestScore > 0) {
+		m_PhysicalDevice = m_DeviceInfo.m_Device;
+		m_DescriptorIndexing = m_DeviceInfo.m_DescriptorIndexing;
+		Log()->debug("Picked physical device: {}", m_DeviceInfo.m_Properties.deviceName.data());
 	} else {
 		throw std::runtime_error("Failed to find a suitable GPU.");
 	}
 }
 
-CRenderer::QueueFamilyIndices CRenderer::findQueueFamilies(const vk::PhysicalDevice &Device) const {
+CRenderer::QueueFamilyIndices CRenderer::findQueueFamilies(const vk::PhysicalDevice &Device, std::pmr::memory_resource *pMemory) const {
 	QueueFamilyIndices Indices;
 
-	auto Properties = Device.getQueueFamilyProperties();
+	std::pmr::vector<vk::QueueFamilyProperties> Properties(pMemory);
+	enumerateInto(Properties, [&Device](uint32_t *pCount, vk::QueueFamilyProperties *pProperties) {
+		Device.getQueueFamilyProperties(pCount, pProperties);
+		return vk::Result::eSuccess;
+	}, "vkGetPhysicalDeviceQueueFamilyProperties");
 
 	int i = 0;
 	for (const auto &QueueFamily : Properties) {
@@ -226,40 +433,78 @@ CRenderer::QueueFamilyIndices CRenderer::findQueueFamilies(const vk::PhysicalDev
 			Indices.m_GraphicsFamily = i;
 		}
 
-		if (QueueFamily.queueCount > 0 && Device.getSurfaceSupportKHR(i, m_Surface)) {
+		if (QueueFamily.queueCount > 0 && !m_Headless && Device.getSurfaceSupportKHR(i, m_Surface)) {
 			Indices.m_PresentFamily = i;
 		}
 
+		// Nothing is presented when headless, the graphics queue stands in.
+		if (m_Headless)
+			Indices.m_PresentFamily = Indices.m_GraphicsFamily;
+
 		if (Indices.isComplete())
 			break;
 		i++;
 	}
 
+	// A family that can only transfer is usually backed by the copy engine,
+	// which works alongside rendering. Families with compute are the next best.
+	int BestScore = -1;
+	for (uint32_t Family = 0; Family < Properties.size(); Family++) {
+		vk::QueueFlags Flags = Properties[Family].queueFlags;
+		if (Properties[Family].queueCount == 0 || !(Flags & vk::QueueFlagBits::eTransfer) || (Flags & vk::QueueFlagBits::eGraphics))
+			continue;
+		int Score = (Flags & vk::QueueFlagBits::eCompute) ? 1 : 2;
+		if (Score > BestScore) {
+			BestScore = Score;
+			Indices.m_TransferFamily = Family;
+		}
+	}
+	if (!Indices.m_TransferFamily)
+		Indices.m_TransferFamily = Indices.m_GraphicsFamily;
+
 	return Indices;
 }
 
 void CRenderer::createLogicalDevice() {
+	SPS_PROFILE_SCOPE("createLogicalDevice");
 	Log()->debug("Creating logical device");
-	QueueFamilyIndices Indices = findQueueFamilies(m_PhysicalDevice);
+	const QueueFamilyIndices &Indices = m_DeviceInfo.m_Families;
 
 	float priority = 1.0f;
 
-	auto QueueCreateInfo = vk::DeviceQueueCreateInfo(
-		vk::DeviceQueueCreateFlags(),
-		Indices.m_GraphicsFamily.value(),
-		1, &priority);
+	// The present and transfer queues may live in different families than the graphics one.
+	std::set<uint32_t> UniqueFamilies = {Indices.m_GraphicsFamily.value(), Indices.m_PresentFamily.value(), Indices.m_TransferFamily.value()};
+	std::vector<vk::DeviceQueueCreateInfo> QueueCreateInfos;
+
+	for (uint32_t Family : UniqueFamilies) {
+		QueueCreateInfos.push_back(vk::DeviceQueueCreateInfo(
+			vk::DeviceQueueCreateFlags(),
+			Family,
+			1, &priority));
+	}
 
 	auto DeviceFeatures = vk::PhysicalDeviceFeatures();
 
 	auto DeviceCreateInfo = vk::DeviceCreateInfo(
 		vk::DeviceCreateFlags(),
-		1, &QueueCreateInfo);
+		QueueCreateInfos.size(), QueueCreateInfos.data());
 
 	DeviceCreateInfo.pEnabledFeatures = &DeviceFeatures;
-	DeviceCreateInfo.enabledExtensionCount = DeviceExtensions.size();
-	DeviceCreateInfo.ppEnabledExtensionNames = DeviceExtensions.data();
 
-	if (EnableValidationLayers) {
+	// Just what the bindless texture table uses.
+	vk::PhysicalDeviceDescriptorIndexingFeatures IndexingFeatures;
+	if (m_Bindless && m_DescriptorIndexing) {
+		IndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		IndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		IndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		IndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		IndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		DeviceCreateInfo.pNext = &IndexingFeatures;
+	}
+	DeviceCreateInfo.enabledExtensionCount = m_DeviceExtensions.size();
+	DeviceCreateInfo.ppEnabledExtensionNames = m_DeviceExtensions.data();
+
+	if (m_Validation) {
 		DeviceCreateInfo.enabledLayerCount = m_ValidationLayers.size();
 		DeviceCreateInfo.ppEnabledLayerNames = m_ValidationLayers.data();
 	}
@@ -274,10 +519,12 @@ void CRenderer::createLogicalDevice() {
 	VULKAN_HPP_DEFAULT_DISPATCHER.init(m_Device);
 	m_GraphicsQueue = m_Device.getQueue(Indices.m_GraphicsFamily.value(), 0);
 	m_PresentQueue = m_Device.getQueue(Indices.m_PresentFamily.value(), 0);
+	m_TransferQueue = m_Device.getQueue(Indices.m_TransferFamily.value(), 0);
 	Log()->debug("Logical device created");
 }
 
 void CRenderer::create_surface() {
+	SPS_PROFILE_SCOPE("create_surface");
 	Log()->debug("Creating surface");
 	if (!SDL_Vulkan_CreateSurface(m_Window.get(), static_cast<VkInstance>(m_Instance), reinterpret_cast<VkSurfaceKHR *>(&m_Surface))) {
 		Log()->error("Error creating a surface to draw on!");
@@ -287,7 +534,7 @@ void CRenderer::create_surface() {
 }
 
 void CRenderer::setupDebugCallback() {
-	if (!EnableValidationLayers)
+	if (!m_Validation)
 		return;
 
 	auto CreateDebugInfo = vk::DebugUtilsMessengerCreateInfoEXT(
@@ -297,20 +544,24 @@ void CRenderer::setupDebugCallback() {
 		debugCallback,
 		nullptr);
 
-	m_Instance.createDebugUtilsMessengerEXT(CreateDebugInfo);
+	m_DebugMessenger = m_Instance.createDebugUtilsMessengerEXT(CreateDebugInfo);
 }
 
-CRenderer::SwapChainSupportDetails CRenderer::querySwapChainSupport(const vk::PhysicalDevice &Device) const {
-	SwapChainSupportDetails Details;
+CRenderer::SwapChainSupportDetails CRenderer::querySwapChainSupport(const vk::PhysicalDevice &Device, std::pmr::memory_resource *pMemory) const {
+	SwapChainSupportDetails Details(pMemory);
 
 	Details.m_Capabilities = Device.getSurfaceCapabilitiesKHR(m_Surface);
-	Details.m_Formats = Device.getSurfaceFormatsKHR(m_Surface);
-	Details.m_PresentModes = Device.getSurfacePresentModesKHR(m_Surface);
+	enumerateInto(Details.m_Formats, [&](uint32_t *pCount, vk::SurfaceFormatKHR *pFormats) {
+		return Device.getSurfaceFormatsKHR(m_Surface, pCount, pFormats);
+	}, "vkGetPhysicalDeviceSurfaceFormatsKHR");
+	enumerateInto(Details.m_PresentModes, [&](uint32_t *pCount, vk::PresentModeKHR *pModes) {
+		return Device.getSurfacePresentModesKHR(m_Surface, pCount, pModes);
+	}, "vkGetPhysicalDeviceSurfacePresentModesKHR");
 
 	return Details;
 }
 
-vk::SurfaceFormatKHR CRenderer::chooseSurfaceFormat(const std::vector<vk::SurfaceFormatKHR> &Formats) const {
+vk::SurfaceFormatKHR CRenderer::chooseSurfaceFormat(const std::pmr::vector<vk::SurfaceFormatKHR> &Formats) const {
 	for (const auto &Format : Formats) {
 		if (Format.format == vk::Format::eB8G8R8A8Srgb && Format.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear) {
 			return Format;
@@ -320,16 +571,15 @@ vk::SurfaceFormatKHR CRenderer::chooseSurfaceFormat(const std::vector<vk::Surfac
 	return Formats[0];
 }
 
-vk::PresentModeKHR CRenderer::choosePresentMode(const std::vector<vk::PresentModeKHR> &Modes) const {
-	// https://vulkan-tutorial.com/en/Drawing_a_triangle/Presentation/Swap_chain
-
-	for (const auto &Mode : Modes) {
-		if (Mode == vk::PresentModeKHR::eMailbox)
-			return Mode;
-	}
+vk::PresentModeKHR CRenderer::choosePresentMode(const std::pmr::vector<vk::PresentModeKHR> &Modes) const {
+	if (std::find(Modes.begin(), Modes.end(), m_PresentMode) != Modes.end())
+		return m_PresentMode;
 
+	// The only mode every implementation has to support.
+	Log()->info("Present mode {} not supported, using FIFO", vk::to_string(m_PresentMode));
 	return vk::PresentModeKHR::eFifo;
 }
+
 vk::Extent2D CRenderer::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR &Capabilities) const {
 	if (Capabilities.currentExtent.width != UINT32_MAX)
 		return Capabilities.currentExtent;
@@ -344,15 +594,26 @@ vk::Extent2D CRenderer::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR &Capab
 	}
 }
 
-void CRenderer::createSwapChain() {
-	Log()->debug("Creating swap chain");
-	SwapChainSupportDetails Details = querySwapChainSupport(m_PhysicalDevice);
+bool CRenderer::createSwapChain() {
+	SPS_PROFILE_SCOPE("createSwapChain");
+	SPS_LOG_DEBUG("Creating swap chain");
+	SwapChainSupportDetails Details = querySwapChainSupport(m_PhysicalDevice, frameMemory());
 
-	vk::SurfaceFormatKHR Format = chooseSurfaceFormat(Details.m_Formats);
-	vk::PresentModeKHR Mode = choosePresentMode(Details.m_PresentModes);
+	// The extent may be clamped, resizes are detected on the window's size.
+	SDL_Vulkan_GetDrawableSize(m_Window.get(), &m_DrawableWidth, &m_DrawableHeight);
 	vk::Extent2D Extent = chooseSwapExtent(Details.m_Capabilities);
+	// Minimized, there is nothing to present to.
+	if (Extent.width == 0 || Extent.height == 0)
+		return false;
+
+	// The render pass and pipelines depend on the format, so it's only picked once.
+	if (!m_SwapChain)
+		m_SurfaceFormat = chooseSurfaceFormat(Details.m_Formats);
+	vk::SurfaceFormatKHR Format = m_SurfaceFormat;
+	vk::PresentModeKHR Mode = choosePresentMode(Details.m_PresentModes);
 
-	uint32_t ImageCount = Details.m_Capabilities.minImageCount + 1;
+	uint32_t ImageCount = m_RequestedImageCount > 0 ? m_RequestedImageCount : Details.m_Capabilities.minImageCount + 1;
+	ImageCount = std::max(ImageCount, Details.m_Capabilities.minImageCount);
 
 	if (Details.m_Capabilities.maxImageCount > 0 && ImageCount > Details.m_Capabilities.maxImageCount)
 		ImageCount = Details.m_Capabilities.maxImageCount;
@@ -367,20 +628,20 @@ void CRenderer::createSwapChain() {
 		1,
 		vk::ImageUsageFlagBits::eColorAttachment);
 
-	QueueFamilyIndices Indices = findQueueFamilies(m_PhysicalDevice);
+	const QueueFamilyIndices &Indices = m_DeviceInfo.m_Families;
 	uint32_t FamilyIndices[] = {Indices.m_GraphicsFamily.value(), Indices.m_PresentFamily.value()};
 
 	if (Indices.m_GraphicsFamily != Indices.m_PresentFamily) {
 		CreateInfo.imageSharingMode = vk::SharingMode::eConcurrent;
 		CreateInfo.queueFamilyIndexCount = 2;
 		CreateInfo.pQueueFamilyIndices = FamilyIndices;
-		Log()->debug("Using concurrent image sharing mode");
+		SPS_LOG_DEBUG("Using concurrent image sharing mode");
 	} else {
 		CreateInfo.imageSharingMode = vk::SharingMode::eExclusive;
 		CreateInfo.queueFamilyIndexCount = 0;
 		CreateInfo.pQueueFamilyIndices = nullptr;
 		// Best perfomance
-		Log()->debug("Using exclusive image sharing mode");
+		SPS_LOG_DEBUG("Using exclusive image sharing mode");
 	}
 
 	CreateInfo.preTransform = Details.m_Capabilities.currentTransform;
@@ -388,6 +649,8 @@ void CRenderer::createSwapChain() {
 
 	CreateInfo.presentMode = Mode;
 	CreateInfo.clipped = VK_TRUE;
+	// Lets the driver hand resources over from the swap chain being replaced.
+	CreateInfo.oldSwapchain = m_SwapChain;
 
 	try {
 		m_SwapChain = m_Device.createSwapchainKHR(CreateInfo);
@@ -400,11 +663,89 @@ void CRenderer::createSwapChain() {
 	m_SwapChainImageFormat = Format.format;
 	m_SwapChainExtent = Extent;
 
-	Log()->debug("Swap chain created");
+	m_PresentStats = PresentStats();
+	m_PresentStats.m_Mode = Mode;
+	m_PresentStats.m_ImageCount = m_SwapChainImages.size();
+
+	SPS_LOG_DEBUG("Swap chain created ({}x{}, {} images, {})", Extent.width, Extent.height, m_SwapChainImages.size(), vk::to_string(Mode));
+	return true;
+}
+
+bool CRenderer::recreateSwapChain() {
+	SPS_PROFILE_SCOPE("recreateSwapChain");
+
+	// Frames in flight may still render to the old images, they are
+	// destroyed once those frames are done instead of waiting for the GPU.
+	RetiredSwapChain Retired;
+	Retired.m_SwapChain = m_SwapChain;
+	Retired.m_Frame = m_FrameNumber;
+
+	if (!createSwapChain())
+		return false;
+
+	Retired.m_ImageViews = std::move(m_SwapChainImageViews);
+	Retired.m_Framebuffers = std::move(m_SwapChainFramebuffers);
+	m_RetiredSwapChains.push_back(std::move(Retired));
+
+	createImageViews();
+	createFramebuffers();
+	m_ImagesInFlight.assign(m_SwapChainImages.size(), vk::Fence());
+	m_SwapChainDirty = false;
+
+	Log()->info("Swap chain recreated: {}x{}, {} images, {}", m_SwapChainExtent.width, m_SwapChainExtent.height,
+				m_SwapChainImages.size(), vk::to_string(m_PresentStats.m_Mode));
+	return true;
+}
+
+void CRenderer::destroyRetiredSwapChains(bool All) {
+	for (size_t i = 0; i < m_RetiredSwapChains.size();) {
+		RetiredSwapChain &Retired = m_RetiredSwapChains[i];
+		if (!All && m_FrameNumber < Retired.m_Frame + m_FramesInFlight) {
+			i++;
+			continue;
+		}
+
+		for (auto Framebuffer : Retired.m_Framebuffers)
+			m_Device.destroyFramebuffer(Framebuffer);
+		for (auto View : Retired.m_ImageViews)
+			m_Device.destroyImageView(View);
+		m_Device.destroySwapchainKHR(Retired.m_SwapChain);
+
+		m_RetiredSwapChains.erase(m_RetiredSwapChains.begin() + i);
+	}
+}
+
+void CRenderer::setWindowSize(uint32_t Width, uint32_t Height) {
+	m_WindowWidth = Width;
+	m_WindowHeight = Height;
+	// The swap chain follows in the next frame.
+	if (m_Window)
+		SDL_SetWindowSize(m_Window.get(), Width, Height);
+}
+
+void CRenderer::setPresentMode(vk::PresentModeKHR Mode) {
+	if (Mode == m_PresentMode)
+		return;
+	m_PresentMode = Mode;
+	m_SwapChainDirty = m_SwapChain ? true : false;
+}
+
+void CRenderer::setSwapChainImages(uint32_t Count) {
+	if (Count == m_RequestedImageCount)
+		return;
+	m_RequestedImageCount = Count;
+	m_SwapChainDirty = m_SwapChain ? true : false;
+}
+
+std::vector<vk::PresentModeKHR> CRenderer::getSupportedPresentModes() const {
+	if (m_Headless)
+		return {};
+	return m_PhysicalDevice.getSurfacePresentModesKHR(m_Surface);
 }
 
 void CRenderer::createImageViews() {
-	Log()->debug("Creating image views");
+	SPS_PROFILE_SCOPE("createImageViews");
+	SPS_LOG_DEBUG("Creating image views");
 	m_SwapChainImageViews.resize(m_SwapChainImages.size());
 
 	for (size_t i = 0; i < m_SwapChainImageViews.size(); i++) {
@@ -429,10 +770,12 @@ void CRenderer::createImageViews() {
 		}
 	}
 
-	Log()->debug("Created image views");
+	SPS_LOG_DEBUG("Created image views");
 }
 
 void CRenderer::createRenderPass() {
+	SPS_PROFILE_SCOPE("createRenderPass");
+	Log()->debug("Creating render pass");
 	vk::AttachmentDescription colorAttachment = {};
 	colorAttachment.format = m_SwapChainImageFormat;
 	colorAttachment.samples = vk::SampleCountFlagBits::e1;
@@ -441,7 +784,8 @@ void CRenderer::createRenderPass() {
 	colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
 	colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
 	colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
-	colorAttachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+	// Offscreen targets end up ready to be copied for readback.
+	colorAttachment.finalLayout = m_Headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
 
 	vk::AttachmentReference colorAttachmentRef = {};
 	colorAttachmentRef.attachment = 0;
@@ -452,62 +796,91 @@ void CRenderer::createRenderPass() {
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &colorAttachmentRef;
 
+	// Wait for the image to be released by the presentation engine before writing to it.
+	vk::SubpassDependency dependency = {};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	dependency.srcAccessMask = vk::AccessFlags();
+	dependency.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+
+	// Offscreen targets may be copied for readback after the render pass,
+	// the implicit dependency at its end doesn't make the writes visible.
+	vk::SubpassDependency readbackDependency = {};
+	readbackDependency.srcSubpass = 0;
+	readbackDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+	readbackDependency.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	readbackDependency.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+	readbackDependency.dstStageMask = vk::PipelineStageFlagBits::eTransfer;
+	readbackDependency.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+	vk::SubpassDependency dependencies[] = {dependency, readbackDependency};
+
 	vk::RenderPassCreateInfo renderPassInfo = {};
 	renderPassInfo.attachmentCount = 1;
 	renderPassInfo.pAttachments = &colorAttachment;
 	renderPassInfo.subpassCount = 1;
 	renderPassInfo.pSubpasses = &subpass;
+	renderPassInfo.dependencyCount = m_Headless ? 2 : 1;
+	renderPassInfo.pDependencies = dependencies;
+
+	try {
+		m_RenderPass = m_Device.createRenderPass(renderPassInfo);
+	} catch (vk::SystemError &err) {
+		Log()->error("Failed to create render pass: {}", err.what());
+		throw std::runtime_error("failed to create render pass");
+	}
 }
 
 void CRenderer::createGraphicsPipeline() {
-	auto VertShaderCode = readFile("shaders/vert.spv");
-	auto FragShaderCode = readFile("shaders/frag.spv");
-
-	vk::ShaderModule VertShader = createShaderModule(VertShaderCode);
-	vk::ShaderModule FragShader = createShaderModule(FragShaderCode);
-
-	vk::PipelineShaderStageCreateInfo Stages[] = {
-		{vk::PipelineShaderStageCreateFlags(),
-		 vk::ShaderStageFlagBits::eVertex,
-		 VertShader,
-		 "main"},
-		{vk::PipelineShaderStageCreateFlags(),
-		 vk::ShaderStageFlagBits::eFragment,
-		 FragShader,
-		 "main"}};
-
-	auto VertexInputInfo = vk::PipelineVertexInputStateCreateInfo(
+	SPS_PROFILE_SCOPE("createGraphicsPipeline");
+	Log()->debug("Creating sprite pipelines");
+	m_pPipelineBuild = std::make_unique<PipelineBuild>();
+	PipelineBuild &Build = *m_pPipelineBuild;
+
+	// The SPIR-V is compiled into the library, making modules of it is cheap.
+	// The driver compiles them when the pipelines are created.
+	Build.m_aShaders[0] = m_Resources.createShader(CShaderRegistry::get("sprite.vert"));
+	Build.m_aShaders[1] = m_Resources.createShader(CShaderRegistry::get(m_Textures.isBindless() ? "sprite_bindless.frag" : "sprite.frag"));
+	Build.m_aShaders[2] = m_Resources.createShader(CShaderRegistry::get("text.frag"));
+	vk::ShaderModule VertShader = m_Resources.get(Build.m_aShaders[0])->m_Module;
+	vk::ShaderModule FragShader = m_Resources.get(Build.m_aShaders[1])->m_Module;
+	vk::ShaderModule TextShader = m_Resources.get(Build.m_aShaders[2])->m_Module;
+
+	Build.m_Bindings = CSpriteBatch::getBindingDescriptions();
+	Build.m_Attributes = CSpriteBatch::getAttributeDescriptions();
+
+	Build.m_VertexInput = vk::PipelineVertexInputStateCreateInfo(
 		vk::PipelineVertexInputStateCreateFlags(),
-		0,
-		nullptr,
-		0,
-		nullptr);
+		Build.m_Bindings.size(),
+		Build.m_Bindings.data(),
+		Build.m_Attributes.size(),
+		Build.m_Attributes.data());
 
-	auto InputAssembly = vk::PipelineInputAssemblyStateCreateInfo(
+	Build.m_InputAssembly = vk::PipelineInputAssemblyStateCreateInfo(
 		vk::PipelineInputAssemblyStateCreateFlags(),
 		vk::PrimitiveTopology::eTriangleList,
 		VK_FALSE);
 
-	vk::Viewport Viewport(0, 0, m_SwapChainExtent.width, m_SwapChainExtent.height, 0.0f, 1.0f);
+	// Set while recording, so the pipelines survive swap chain resizes.
+	Build.m_Viewport.viewportCount = 1;
+	Build.m_Viewport.scissorCount = 1;
 
-	vk::Rect2D Scissor(vk::Offset2D(0, 0), m_SwapChainExtent);
+	Build.m_aDynamicStates[0] = vk::DynamicState::eViewport;
+	Build.m_aDynamicStates[1] = vk::DynamicState::eScissor;
+	Build.m_DynamicState = vk::PipelineDynamicStateCreateInfo(vk::PipelineDynamicStateCreateFlags(), 2, Build.m_aDynamicStates);
 
-	vk::PipelineViewportStateCreateInfo ViewportState = {};
-	ViewportState.viewportCount = 1;
-	ViewportState.pViewports = &Viewport;
-	ViewportState.scissorCount = 1;
-	ViewportState.pScissors = &Scissor;
-
-	vk::PipelineRasterizationStateCreateInfo Rasterizer = {};
+	vk::PipelineRasterizationStateCreateInfo &Rasterizer = Build.m_Rasterizer;
 	Rasterizer.depthClampEnable = VK_FALSE;
 	Rasterizer.rasterizerDiscardEnable = VK_FALSE;
 	Rasterizer.polygonMode = vk::PolygonMode::eFill;
 	Rasterizer.lineWidth = 1.0f;
-	Rasterizer.cullMode = vk::CullModeFlagBits::eBack;
+	// Sprites may be mirrored with a negative size.
+	Rasterizer.cullMode = vk::CullModeFlagBits::eNone;
 	Rasterizer.frontFace = vk::FrontFace::eClockwise;
 	Rasterizer.depthBiasEnable = VK_FALSE;
 
-	vk::PipelineMultisampleStateCreateInfo Multisampling = {};
+	vk::PipelineMultisampleStateCreateInfo &Multisampling = Build.m_Multisampling;
 	Multisampling.sampleShadingEnable = VK_FALSE;
 	Multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
 	Multisampling.minSampleShading = 1.0f;			// Optional
@@ -515,38 +888,654 @@ void CRenderer::createGraphicsPipeline() {
 	Multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
 	Multisampling.alphaToOneEnable = VK_FALSE;		// Optional
 
-	vk::PipelineColorBlendAttachmentState ColorBlendAttachment;
-	ColorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-	ColorBlendAttachment.blendEnable = VK_FALSE;
-
-	vk::PipelineColorBlendStateCreateInfo ColorBlending = {};
-	ColorBlending.logicOpEnable = VK_FALSE;
-	ColorBlending.logicOp = vk::LogicOp::eCopy;
-	ColorBlending.attachmentCount = 1;
-	ColorBlending.pAttachments = &ColorBlendAttachment;
-	ColorBlending.blendConstants[0] = 0.0f;
-	ColorBlending.blendConstants[1] = 0.0f;
-	ColorBlending.blendConstants[2] = 0.0f;
-	ColorBlending.blendConstants[3] = 0.0f;
-
 	vk::PipelineLayoutCreateInfo PipelineLayoutInfo = {};
-	PipelineLayoutInfo.setLayoutCount = 0;			  // Optional
-	PipelineLayoutInfo.pSetLayouts = nullptr;		  // Optional
-	PipelineLayoutInfo.pushConstantRangeCount = 0;	  // Optional
-	PipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+	// Set 0 is the font atlas, only the text pipeline reads it. Set 1 is the
+	// texture table the other pipelines sample.
+	vk::DescriptorSetLayout SetLayouts[] = {m_TextRenderer.getSetLayout(), m_Textures.getSetLayout()};
+	PipelineLayoutInfo.setLayoutCount = 2;
+	PipelineLayoutInfo.pSetLayouts = SetLayouts;
+	vk::PushConstantRange PushConstants(vk::ShaderStageFlagBits::eVertex, 0, sizeof(float) * 4);
+	PipelineLayoutInfo.pushConstantRangeCount = 1;
+	PipelineLayoutInfo.pPushConstantRanges = &PushConstants;
 
 	m_PipelineLayout = m_Device.createPipelineLayout(PipelineLayoutInfo);
 
-	m_Device.destroyShaderModule(FragShader);
+	// The pipelines only differ in how they blend, and text in how it's shaded.
+	for (uint32_t i = 0; i < NUM_SPRITE_PIPELINES; i++) {
+		vk::PipelineShaderStageCreateInfo *pStages = Build.m_aaStages[i];
+		pStages[0] = vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eVertex, VertShader, "main");
+		pStages[1] = vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eFragment,
+													   i == SPRITE_PIPELINE_TEXT ? TextShader : FragShader, "main");
+
+		vk::PipelineColorBlendAttachmentState &ColorBlendAttachment = Build.m_aBlendAttachments[i];
+		ColorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+		ColorBlendAttachment.blendEnable = VK_TRUE;
+		ColorBlendAttachment.colorBlendOp = vk::BlendOp::eAdd;
+		ColorBlendAttachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+		ColorBlendAttachment.dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+		ColorBlendAttachment.alphaBlendOp = vk::BlendOp::eAdd;
+		if (i == SPRITE_PIPELINE_ADDITIVE) {
+			ColorBlendAttachment.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+			ColorBlendAttachment.dstColorBlendFactor = vk::BlendFactor::eOne;
+		} else {
+			ColorBlendAttachment.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+			ColorBlendAttachment.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+		}
+
+		vk::PipelineColorBlendStateCreateInfo &ColorBlending = Build.m_aColorBlending[i];
+		ColorBlending.logicOpEnable = VK_FALSE;
+		ColorBlending.logicOp = vk::LogicOp::eCopy;
+		ColorBlending.attachmentCount = 1;
+		ColorBlending.pAttachments = &ColorBlendAttachment;
+		ColorBlending.blendConstants[0] = 0.0f;
+		ColorBlending.blendConstants[1] = 0.0f;
+		ColorBlending.blendConstants[2] = 0.0f;
+		ColorBlending.blendConstants[3] = 0.0f;
+
+		vk::GraphicsPipelineCreateInfo &PipelineInfo = Build.m_aInfos[i];
+		PipelineInfo.stageCount = 2;
+		PipelineInfo.pStages = pStages;
+		PipelineInfo.pVertexInputState = &Build.m_VertexInput;
+		PipelineInfo.pInputAssemblyState = &Build.m_InputAssembly;
+		PipelineInfo.pViewportState = &Build.m_Viewport;
+		PipelineInfo.pRasterizationState = &Build.m_Rasterizer;
+		PipelineInfo.pMultisampleState = &Build.m_Multisampling;
+		PipelineInfo.pColorBlendState = &ColorBlending;
+		PipelineInfo.pDynamicState = &Build.m_DynamicState;
+		PipelineInfo.layout = m_PipelineLayout;
+		PipelineInfo.renderPass = m_RenderPass;
+		PipelineInfo.subpass = 0;
+	}
+
+	// One job per pipeline, drivers compile them on the calling thread. The
+	// pipeline cache is internally synchronized.
+	static const char *const s_apSteps[NUM_SPRITE_PIPELINES] = {"compileAlphaPipeline", "compileAdditivePipeline", "compileTextPipeline"};
+	CStartup &Startup = engine()->startup();
+	m_Pipelines.assign(NUM_SPRITE_PIPELINES, vk::Pipeline());
+	Build.m_Start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < NUM_SPRITE_PIPELINES; i++) {
+		auto Compile = [this, &Startup, i]() {
+			Startup.time(s_apSteps[i], [this, i]() {
+				SPS_PROFILE_SCOPE("compilePipeline");
+				try {
+					m_Pipelines[i] = m_Device.createGraphicsPipeline(m_PipelineCache, m_pPipelineBuild->m_aInfos[i]).value;
+				} catch (vk::SystemError &err) {
+					Log()->error("Failed to create graphics pipeline: {}", err.what());
+					m_pPipelineBuild->m_Failed.fetch_add(1, std::memory_order_relaxed);
+				}
+			});
+		};
+		if (Startup.isParallel())
+			engine()->jobs().schedule(Compile, &m_PipelineJobs);
+		else
+			Compile();
+	}
+}
+
+void CRenderer::waitForPipelines() {
+	if (!m_pPipelineBuild)
+		return;
+	engine()->jobs().wait(m_PipelineJobs);
+
+	double Elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_pPipelineBuild->m_Start).count();
+	Log()->info("Compiled {} pipelines in {:.2f}ms ({} pipeline cache)", m_Pipelines.size(), Elapsed, m_PipelineCacheWarm ? "warm" : "cold");
+
+	// Pipelines don't need their modules once created.
+	bool Failed = m_pPipelineBuild->m_Failed.load(std::memory_order_relaxed) > 0;
+	for (ShaderHandle Shader : m_pPipelineBuild->m_aShaders)
+		m_Resources.destroy(Shader);
+	m_pPipelineBuild.reset();
+
+	if (Failed)
+		throw std::runtime_error("failed to create graphics pipeline");
+}
+
+void CRenderer::setHeadless(bool Headless, uint32_t Width, uint32_t Height) {
+	if (!m_Frames.empty())
+		throw std::runtime_error("headless mode can't be changed after init");
+	m_Headless = Headless;
+	m_HeadlessExtent = vk::Extent2D(Width, Height);
+}
+
+void CRenderer::createOffscreenTargets() {
+	SPS_PROFILE_SCOPE("createOffscreenTargets");
+	Log()->debug("Creating {} offscreen targets ({}x{})", m_FramesInFlight, m_HeadlessExtent.width, m_HeadlessExtent.height);
+	m_SwapChainImageFormat = vk::Format::eR8G8B8A8Unorm;
+	m_SwapChainExtent = m_HeadlessExtent;
+
+	vk::ImageCreateInfo ImageInfo = {};
+	ImageInfo.imageType = vk::ImageType::e2D;
+	ImageInfo.format = m_SwapChainImageFormat;
+	ImageInfo.extent = vk::Extent3D(m_SwapChainExtent.width, m_SwapChainExtent.height, 1);
+	ImageInfo.mipLevels = 1;
+	ImageInfo.arrayLayers = 1;
+	ImageInfo.samples = vk::SampleCountFlagBits::e1;
+	ImageInfo.tiling = vk::ImageTiling::eOptimal;
+	ImageInfo.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+	ImageInfo.sharingMode = vk::SharingMode::eExclusive;
+	ImageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+	m_SwapChainImages.resize(m_FramesInFlight);
+	m_OffscreenMemory.resize(m_FramesInFlight);
+	for (uint32_t i = 0; i < m_FramesInFlight; i++) {
+		m_SwapChainImages[i] = m_Device.createImage(ImageInfo);
+		m_OffscreenMemory[i] = m_Allocator.allocateImage(m_SwapChainImages[i], vk::MemoryPropertyFlagBits::eDeviceLocal);
+	}
+
+	// Cached memory makes reading the pixels back on the CPU a lot faster.
+	m_Readbacks.resize(m_FramesInFlight);
+	vk::DeviceSize Size = vk::DeviceSize(m_SwapChainExtent.width) * m_SwapChainExtent.height * 4;
+	for (auto &Readback : m_Readbacks) {
+		vk::BufferCreateInfo BufferInfo(vk::BufferCreateFlags(), Size, vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive);
+		Readback.m_Buffer = m_Device.createBuffer(BufferInfo);
+		Readback.m_Memory = m_Allocator.allocateBuffer(Readback.m_Buffer,
+													   vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+													   vk::MemoryPropertyFlagBits::eHostCached);
+	}
+}
+
+void CRenderer::requestReadback() {
+	if (!m_Headless) {
+		SPS_LOG_RATE_LIMITED(warn, 1.0, "Readback is only supported in headless mode");
+		return;
+	}
+	m_ReadbackRequested = true;
 }
 
-vk::ShaderModule CRenderer::createShaderModule(const std::vector<char> &code) {
-	auto CreateInfo = vk::ShaderModuleCreateInfo(
-		vk::ShaderModuleCreateFlags(),
-		code.size(),
-		reinterpret_cast<const uint32_t *>(code.data()));
+void CRenderer::recordReadback(vk::CommandBuffer Cmd) {
+	Readback &Target = m_Readbacks[m_CurrentFrame];
+
+	vk::BufferImageCopy Region = {};
+	Region.imageSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+	Region.imageExtent = vk::Extent3D(m_SwapChainExtent.width, m_SwapChainExtent.height, 1);
+	Cmd.copyImageToBuffer(m_SwapChainImages[m_ImageIndex], vk::ImageLayout::eTransferSrcOptimal, Target.m_Buffer, Region);
+
+	vk::BufferMemoryBarrier Barrier(
+		vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+		Target.m_Buffer, 0, VK_WHOLE_SIZE);
+	Cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+						vk::DependencyFlags(), nullptr, Barrier, nullptr);
+
+	Target.m_Pending = true;
+	Target.m_Frame = m_FrameNumber;
+}
+
+void CRenderer::resolveFrame(uint32_t Slot) {
+	// The fence of this slot signaled, so nothing here can stall.
+	m_GpuProfiler.resolve(Slot);
+
+	if (Slot < m_Readbacks.size() && m_Readbacks[Slot].m_Pending) {
+		Readback &Target = m_Readbacks[Slot];
+		Target.m_Pending = false;
+
+		if (m_ReadbackCallback) {
+			FrameReadback Result;
+			Result.m_Frame = Target.m_Frame;
+			Result.m_Width = m_SwapChainExtent.width;
+			Result.m_Height = m_SwapChainExtent.height;
+			Result.m_Format = m_SwapChainImageFormat;
+			Result.m_pPixels = static_cast<const uint8_t *>(Target.m_Memory.m_pMapped);
+			Result.m_Size = vk::DeviceSize(Result.m_Width) * Result.m_Height * 4;
+			m_ReadbackCallback(Result);
+		}
+	}
+}
+
+void CRenderer::createFramebuffers() {
+	SPS_PROFILE_SCOPE("createFramebuffers");
+	SPS_LOG_DEBUG("Creating framebuffers");
+	m_SwapChainFramebuffers.resize(m_SwapChainImageViews.size());
+
+	for (size_t i = 0; i < m_SwapChainImageViews.size(); i++) {
+		vk::FramebufferCreateInfo CreateInfo = {};
+		CreateInfo.renderPass = m_RenderPass;
+		CreateInfo.attachmentCount = 1;
+		CreateInfo.pAttachments = &m_SwapChainImageViews[i];
+		CreateInfo.width = m_SwapChainExtent.width;
+		CreateInfo.height = m_SwapChainExtent.height;
+		CreateInfo.layers = 1;
+
+		m_SwapChainFramebuffers[i] = m_Device.createFramebuffer(CreateInfo);
+	}
+}
+
+void CRenderer::createFrameResources() {
+	SPS_PROFILE_SCOPE("createFrameResources");
+	Log()->debug("Creating resources for {} frames in flight", m_FramesInFlight);
+	const QueueFamilyIndices &Indices = m_DeviceInfo.m_Families;
+
+	m_Frames.resize(m_FramesInFlight);
+	m_ImagesInFlight.assign(m_SwapChainImages.size(), vk::Fence());
+
+	for (auto &Frame : m_Frames) {
+		// One transient pool per frame, reset as a whole instead of per buffer.
+		vk::CommandPoolCreateInfo PoolInfo(
+			vk::CommandPoolCreateFlagBits::eTransient,
+			Indices.m_GraphicsFamily.value());
+		Frame.m_CommandPool = m_Device.createCommandPool(PoolInfo);
+
+		vk::CommandBufferAllocateInfo AllocInfo(
+			Frame.m_CommandPool,
+			vk::CommandBufferLevel::ePrimary,
+			1);
+		Frame.m_CommandBuffer = m_Device.allocateCommandBuffers(AllocInfo)[0];
+
+		// Secondary buffers are allocated as needed while recording.
+		Frame.m_Threads.resize(std::max(1u, engine()->jobs().getThreadCount()));
+		for (auto &Thread : Frame.m_Threads)
+			Thread.m_CommandPool = m_Device.createCommandPool(PoolInfo);
+
+		Frame.m_ImageAvailable = m_Device.createSemaphore(vk::SemaphoreCreateInfo());
+		Frame.m_RenderFinished = m_Device.createSemaphore(vk::SemaphoreCreateInfo());
+		// Created signaled so the first wait on each slot returns immediately.
+		Frame.m_InFlight = m_Device.createFence(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+	}
+
+	m_CurrentFrame = 0;
+}
+
+void CRenderer::waitForFrame() {
+	// Only blocks when the CPU is m_FramesInFlight frames ahead of the GPU.
+	SPS_PROFILE_SCOPE("waitForFrame");
+	(void)m_Device.waitForFences(m_Frames[m_CurrentFrame].m_InFlight, VK_TRUE, UINT64_MAX);
+}
+
+bool CRenderer::beginFrame() {
+	FrameData &Frame = m_Frames[m_CurrentFrame];
+	// Before anything can fail, declarations of a frame that wasn't started
+	// must not pile up.
+	m_Graph.reset();
+
+	waitForFrame();
+	resolveFrame(m_CurrentFrame);
+
+	m_FrameStart = std::chrono::steady_clock::now();
+
+	if (m_Headless) {
+		// One offscreen target per frame slot, nothing to acquire.
+		m_ImageIndex = m_CurrentFrame;
+	} else {
+		destroyRetiredSwapChains(false);
+
+		int Width, Height;
+		SDL_Vulkan_GetDrawableSize(m_Window.get(), &Width, &Height);
+		if (m_SwapChainDirty || Width != m_DrawableWidth || Height != m_DrawableHeight) {
+			// Minimized, skip frames until there is something to draw to.
+			if (!recreateSwapChain())
+				return false;
+		}
+
+		SPS_PROFILE_SCOPE("acquireImage");
+		vk::ResultValue<uint32_t> Acquired(vk::Result::eErrorOutOfDateKHR, 0);
+		// The swap chain can go out of date between the size check and the
+		// acquire, in which case it's recreated once and acquired again.
+		for (int Attempt = 0; Attempt < 2; Attempt++) {
+			try {
+				Acquired = m_Device.acquireNextImageKHR(m_SwapChain, UINT64_MAX, Frame.m_ImageAvailable, nullptr);
+				break;
+			} catch (vk::OutOfDateKHRError &) {
+				if (Attempt > 0 || !recreateSwapChain())
+					return false;
+			}
+		}
+		if (Acquired.result != vk::Result::eSuccess && Acquired.result != vk::Result::eSuboptimalKHR)
+			return false;
+		// Still usable, replaced next frame.
+		if (Acquired.result == vk::Result::eSuboptimalKHR)
+			m_SwapChainDirty = true;
+		m_ImageIndex = Acquired.value;
+	}
+
+	// The image may still be used by an older frame if the swap chain has
+	// more images than we have frames in flight.
+	if (m_ImagesInFlight[m_ImageIndex])
+		(void)m_Device.waitForFences(m_ImagesInFlight[m_ImageIndex], VK_TRUE, UINT64_MAX);
+	m_ImagesInFlight[m_ImageIndex] = Frame.m_InFlight;
+
+	// The GPU is done with this slot, so is it with its transient memory.
+	m_Allocator.beginFrame(m_CurrentFrame);
+
+	m_Device.resetCommandPool(Frame.m_CommandPool, vk::CommandPoolResetFlags());
+	for (auto &Thread : Frame.m_Threads) {
+		if (Thread.m_Used > 0)
+			m_Device.resetCommandPool(Thread.m_CommandPool, vk::CommandPoolResetFlags());
+		Thread.m_Used = 0;
+	}
+	Frame.m_Secondaries.clear();
+
+	vk::CommandBufferBeginInfo BeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+	Frame.m_CommandBuffer.begin(BeginInfo);
+
+	Frame.m_FrameNumber = m_FrameNumber;
+	m_GpuProfiler.beginFrame(Frame.m_CommandBuffer, m_CurrentFrame);
+	m_TextRenderer.resetStats();
+
+	// Objects destroyed during earlier frames go once every frame that may
+	// use them finished, which other slots' fences tell without waiting.
+	uint64_t FirstUnfinished = m_FrameNumber;
+	for (auto &Other : m_Frames) {
+		if (&Other != &Frame && m_Device.getFenceStatus(Other.m_InFlight) != vk::Result::eSuccess)
+			FirstUnfinished = std::min(FirstUnfinished, Other.m_FrameNumber);
+	}
+	m_Resources.beginFrame(m_FrameNumber, FirstUnfinished);
+	m_Textures.update(Frame.m_CommandBuffer, m_FrameNumber, FirstUnfinished);
+
+	// Finished uploads are acquired here, before anything can use them.
+	m_Assets.update(Frame.m_CommandBuffer);
+
+	m_SpriteBatch.setView(getViewRect());
+
+	// The render pass is only begun in endFrame(), secondary buffers just
+	// need to know which one they will run in.
+	m_FrameStarted = true;
+	return true;
+}
+
+void CRenderer::endFrame() {
+	if (!m_FrameStarted) {
+		// Passes were declared into frame memory that is about to be reused.
+		m_Graph.reset();
+		return;
+	}
+
+	FrameData &Frame = m_Frames[m_CurrentFrame];
+	{
+		SPS_PROFILE_SCOPE("flushSprites");
+		flushSprites();
+	}
+	m_FrameStarted = false;
+
+	// Glyphs rasterized this frame, copies aren't allowed inside the pass.
+	m_TextRenderer.upload(Frame.m_CommandBuffer);
+
+	// Offscreen passes, whatever they produce is ready for the sprites.
+	if (!m_Graph.empty()) {
+		SPS_PROFILE_SCOPE("renderGraph");
+		SPS_PROFILE_GPU_SCOPE(m_GpuProfiler, Frame.m_CommandBuffer, "graph");
+		m_Graph.execute(Frame.m_CommandBuffer);
+	}
+	// Its declarations live in frame memory, they go with the frame.
+	m_Graph.reset();
+
+	// Only secondary buffers are allowed inside the pass, so it's timed as a whole.
+	m_GpuProfiler.beginScope(Frame.m_CommandBuffer, "pass");
+
+	vk::ClearValue ClearColor(vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}));
+	vk::RenderPassBeginInfo PassInfo(
+		m_RenderPass,
+		m_SwapChainFramebuffers[m_ImageIndex],
+		vk::Rect2D(vk::Offset2D(0, 0), m_SwapChainExtent),
+		1, &ClearColor);
+	Frame.m_CommandBuffer.beginRenderPass(PassInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+
+	if (!Frame.m_Secondaries.empty())
+		Frame.m_CommandBuffer.executeCommands(Frame.m_Secondaries);
+	Frame.m_CommandBuffer.endRenderPass();
+	m_GpuProfiler.endScope(Frame.m_CommandBuffer);
+
+	if (m_ReadbackRequested) {
+		SPS_PROFILE_GPU_SCOPE(m_GpuProfiler, Frame.m_CommandBuffer, "readback");
+		recordReadback(Frame.m_CommandBuffer);
+		m_ReadbackRequested = false;
+	}
+
+	m_GpuProfiler.endFrame(Frame.m_CommandBuffer);
+	Frame.m_CommandBuffer.end();
+
+	vk::PipelineStageFlags WaitStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	vk::SubmitInfo SubmitInfo(
+		1, &Frame.m_ImageAvailable, &WaitStage,
+		1, &Frame.m_CommandBuffer,
+		1, &Frame.m_RenderFinished);
+
+	if (m_Headless) {
+		SubmitInfo.waitSemaphoreCount = 0;
+		SubmitInfo.signalSemaphoreCount = 0;
+	}
+
+	{
+		SPS_PROFILE_SCOPE("submit");
+		m_Device.resetFences(Frame.m_InFlight);
+		m_GraphicsQueue.submit(SubmitInfo, Frame.m_InFlight);
+	}
+	m_GpuProfiler.markSubmitted(CProfiler::get().now());
+
+	if (!m_Headless) {
+		SPS_PROFILE_SCOPE("present");
+		vk::PresentInfoKHR PresentInfo(
+			1, &Frame.m_RenderFinished,
+			1, &m_SwapChain, &m_ImageIndex);
+		try {
+			if (m_PresentQueue.presentKHR(PresentInfo) == vk::Result::eSuboptimalKHR)
+				m_SwapChainDirty = true;
+		} catch (vk::OutOfDateKHRError &) {
+			m_SwapChainDirty = true;
+		}
+		updatePresentStats();
+	}
+
+	m_CpuFrameTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_FrameStart).count();
+	m_FrameNumber++;
+
+	m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesInFlight;
+}
+
+void CRenderer::updatePresentStats() {
+	auto Now = std::chrono::steady_clock::now();
+	PresentStats &Stats = m_PresentStats;
+	// The first present after a (re)creation has no predecessor.
+	if (Stats.m_Presents > 0) {
+		double Interval = std::chrono::duration<double>(Now - m_LastPresent).count();
+		Stats.m_LastInterval = Interval;
+		Stats.m_MaxInterval = std::max(Stats.m_MaxInterval, Interval);
+		Stats.m_AverageInterval += (Interval - Stats.m_AverageInterval) / Stats.m_Presents;
+	}
+	Stats.m_Presents++;
+	m_LastPresent = Now;
+}
+
+vk::CommandBuffer CRenderer::beginSecondary(FrameData &Frame) {
+	uint32_t Thread = engine()->jobs().getThreadIndex();
+	if (Thread >= Frame.m_Threads.size())
+		throw std::runtime_error("Command buffers can only be recorded by job system threads");
+
+	ThreadCommands &Commands = Frame.m_Threads[Thread];
+	if (Commands.m_Used == Commands.m_Buffers.size()) {
+		vk::CommandBufferAllocateInfo AllocInfo(Commands.m_CommandPool, vk::CommandBufferLevel::eSecondary, 8);
+		auto Buffers = m_Device.allocateCommandBuffers(AllocInfo);
+		Commands.m_Buffers.insert(Commands.m_Buffers.end(), Buffers.begin(), Buffers.end());
+	}
+
+	vk::CommandBuffer Cmd = Commands.m_Buffers[Commands.m_Used++];
+	vk::CommandBufferInheritanceInfo Inheritance(m_RenderPass, 0, m_SwapChainFramebuffers[m_ImageIndex]);
+	vk::CommandBufferBeginInfo BeginInfo(
+		vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+		&Inheritance);
+	Cmd.begin(BeginInfo);
+	return Cmd;
+}
+
+void CRenderer::recordParallel(uint32_t Count, const std::function<void(vk::CommandBuffer, uint32_t)> &Record) {
+	if (!m_FrameStarted || Count == 0)
+		return;
+
+	FrameData &Frame = m_Frames[m_CurrentFrame];
+	size_t Base = Frame.m_Secondaries.size();
+	// Every task writes its own slot, which fixes the execution order.
+	Frame.m_Secondaries.resize(Base + Count);
+
+	engine()->jobs().parallelFor(0, Count, [&](uint32_t Begin, uint32_t End) {
+		for (uint32_t i = Begin; i < End; i++) {
+			vk::CommandBuffer Cmd = beginSecondary(Frame);
+			Record(Cmd, i);
+			Cmd.end();
+			Frame.m_Secondaries[Base + i] = Cmd;
+		}
+	}, 1);
+}
+
+void CRenderer::flushSprites() {
+	uint32_t Draws = m_SpriteBatch.prepare();
+
+	if (Draws > 0) {
+		// Below this many draws per buffer the overhead isn't worth it.
+		constexpr uint32_t MinDrawsPerBuffer = 256;
+		uint32_t Threads = std::max(1u, engine()->jobs().getThreadCount());
+		if (m_RecordThreads > 0)
+			Threads = std::min(Threads, m_RecordThreads);
+		uint32_t Buffers = std::clamp(Draws / MinDrawsPerBuffer, 1u, Threads);
+
+		// Pixel coordinates with the origin at the top left.
+		float Transform[4] = {
+			2.0f / m_SwapChainExtent.width, 2.0f / m_SwapChainExtent.height,
+			-1.0f, -1.0f};
+
+		vk::Viewport Viewport(0, 0, m_SwapChainExtent.width, m_SwapChainExtent.height, 0.0f, 1.0f);
+		vk::Rect2D Scissor(vk::Offset2D(0, 0), m_SwapChainExtent);
+
+		auto Record = [&](vk::CommandBuffer Cmd, uint32_t i) {
+			Cmd.setViewport(0, Viewport);
+			Cmd.setScissor(0, Scissor);
+			Cmd.pushConstants(m_PipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(Transform), Transform);
+			m_TextRenderer.bind(Cmd, m_PipelineLayout);
+			m_SpriteBatch.record(Cmd, m_Pipelines, m_PipelineLayout, uint64_t(Draws) * i / Buffers, uint64_t(Draws) * (i + 1) / Buffers);
+		};
+		// Its captures don't fit in a std::function, a reference does
+		// without allocating.
+		recordParallel(Buffers, std::cref(Record));
+	}
+
+	m_SpriteBatch.finish();
+}
+
+void CRenderer::createBuffer(vk::DeviceSize Size, vk::BufferUsageFlags Usage, vk::MemoryPropertyFlags Properties, vk::Buffer &Buffer, GpuAllocation &Allocation) {
+	vk::BufferCreateInfo BufferInfo(vk::BufferCreateFlags(), Size, Usage, vk::SharingMode::eExclusive);
+	Buffer = m_Device.createBuffer(BufferInfo);
+
+	try {
+		Allocation = m_Allocator.allocateBuffer(Buffer, Properties);
+	} catch (...) {
+		m_Device.destroyBuffer(Buffer);
+		throw;
+	}
+}
+
+void CRenderer::destroyBuffer(vk::Buffer &Buffer, GpuAllocation &Allocation) {
+	m_Device.destroyBuffer(Buffer);
+	m_Allocator.free(Allocation);
+	Buffer = nullptr;
+}
+
+// Prepended to the cache data so we can tell whether it was made by this device and driver.
+struct PipelineCacheHeader {
+	uint32_t m_Magic;
+	uint32_t m_DataSize;
+	uint32_t m_VendorID;
+	uint32_t m_DeviceID;
+	uint32_t m_DriverVersion;
+	uint8_t m_UUID[VK_UUID_SIZE];
+};
+
+static const uint32_t PipelineCacheMagic = 0x53505043; // "SPPC"
+
+std::string CRenderer::getPipelineCachePath() {
+	return engine()->getConfigPath() + "pipeline_cache.bin";
+}
+
+void CRenderer::readPipelineCache() {
+	SPS_PROFILE_SCOPE("readPipelineCache");
+	m_PipelineCacheFile.clear();
+	std::ifstream File(getPipelineCachePath(), std::ios::ate | std::ios::binary);
+	if (!File.is_open())
+		return;
+
+	std::streamoff FileSize = File.tellg();
+	if (FileSize <= 0)
+		return;
+	m_PipelineCacheFile.resize(size_t(FileSize));
+	File.seekg(0);
+	if (!File.read(m_PipelineCacheFile.data(), FileSize))
+		m_PipelineCacheFile.clear();
+}
+
+void CRenderer::loadPipelineCache() {
+	SPS_PROFILE_SCOPE("loadPipelineCache");
+	const char *pData = nullptr;
+	size_t DataSize = 0;
+	PipelineCacheHeader Header;
+
+	if (m_PipelineCacheFile.size() >= sizeof(Header)) {
+		std::memcpy(&Header, m_PipelineCacheFile.data(), sizeof(Header));
+
+		const vk::PhysicalDeviceProperties &Properties = m_DeviceInfo.m_Properties;
+		bool Valid = Header.m_Magic == PipelineCacheMagic &&
+					 Header.m_DataSize == m_PipelineCacheFile.size() - sizeof(Header) &&
+					 Header.m_VendorID == Properties.vendorID &&
+					 Header.m_DeviceID == Properties.deviceID &&
+					 Header.m_DriverVersion == Properties.driverVersion &&
+					 std::memcmp(Header.m_UUID, Properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+
+		if (Valid) {
+			pData = m_PipelineCacheFile.data() + sizeof(Header);
+			DataSize = Header.m_DataSize;
+		} else {
+			Log()->info("Discarding pipeline cache made by another device or driver");
+		}
+	}
+
+	vk::PipelineCacheCreateInfo CreateInfo(vk::PipelineCacheCreateFlags(), DataSize, pData);
+
+	try {
+		m_PipelineCache = m_Device.createPipelineCache(CreateInfo);
+		m_PipelineCacheWarm = DataSize > 0;
+	} catch (vk::SystemError &err) {
+		// The driver refused the data, start from an empty cache instead.
+		Log()->warn("Failed to load pipeline cache: {}", err.what());
+		m_PipelineCache = m_Device.createPipelineCache(vk::PipelineCacheCreateInfo());
+		m_PipelineCacheWarm = false;
+	}
+
+	Log()->debug("Pipeline cache: {} ({} bytes)", m_PipelineCacheWarm ? "loaded" : "empty", DataSize);
+	m_PipelineCacheFile = std::vector<char>();
+}
+
+void CRenderer::savePipelineCache() {
+	SPS_PROFILE_SCOPE("savePipelineCache");
+	std::vector<uint8_t> Data = m_Device.getPipelineCacheData(m_PipelineCache);
+	const vk::PhysicalDeviceProperties &Properties = m_DeviceInfo.m_Properties;
+
+	PipelineCacheHeader Header;
+	Header.m_Magic = PipelineCacheMagic;
+	Header.m_DataSize = Data.size();
+	Header.m_VendorID = Properties.vendorID;
+	Header.m_DeviceID = Properties.deviceID;
+	Header.m_DriverVersion = Properties.driverVersion;
+	std::memcpy(Header.m_UUID, Properties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+
+	// Write to a temporary file first so a crash can't leave a torn cache behind.
+	std::string Path = getPipelineCachePath();
+	std::string TmpPath = Path + ".tmp";
+	{
+		std::ofstream File(TmpPath, std::ios::binary | std::ios::trunc);
+		if (!File.is_open()) {
+			Log()->warn("Failed to save pipeline cache to {}", TmpPath);
+			return;
+		}
+		File.write(reinterpret_cast<const char *>(&Header), sizeof(Header));
+		File.write(reinterpret_cast<const char *>(Data.data()), Data.size());
+	}
+
+	// Unlike std::rename, replaces the old cache on Windows too.
+	std::error_code Error;
+	std::filesystem::rename(TmpPath, Path, Error);
+	if (Error) {
+		Log()->warn("Failed to save pipeline cache to {}: {}", Path, Error.message());
+		std::filesystem::remove(TmpPath, Error);
+		return;
+	}
 
-	return m_Device.createShaderModule(CreateInfo);
+	Log()->debug("Saved pipeline cache ({} bytes)", Data.size());
 }
 
 bool CRenderer::checkValidationLayerSupport() {
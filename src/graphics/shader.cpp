@@ -0,0 +1,57 @@
+#include <SuperSDL/shader.hpp>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace sps {
+
+// The .inc files are generated by glslc -mfmt=num, see CMakeLists.txt and
+// shaders/compile.sh. New shaders have to be added in both places.
+
+alignas(4) static constexpr uint32_t SpriteVert[] = {
+#include "sprite.vert.inc"
+};
+
+alignas(4) static constexpr uint32_t SpriteFrag[] = {
+#include "sprite.frag.inc"
+};
+
+alignas(4) static constexpr uint32_t SpriteBindlessFrag[] = {
+#include "sprite_bindless.frag.inc"
+};
+
+alignas(4) static constexpr uint32_t TextFrag[] = {
+#include "text.frag.inc"
+};
+
+static constexpr EmbeddedShader Shaders[] = {
+	{"sprite.vert", SpriteVert, sizeof(SpriteVert)},
+	{"sprite.frag", SpriteFrag, sizeof(SpriteFrag)},
+	{"sprite_bindless.frag", SpriteBindlessFrag, sizeof(SpriteBindlessFrag)},
+	{"text.frag", TextFrag, sizeof(TextFrag)},
+};
+
+const EmbeddedShader *CShaderRegistry::find(const char *pName) {
+	for (const auto &Shader : Shaders) {
+		if (std::strcmp(Shader.m_pName, pName) == 0)
+			return &Shader;
+	}
+	return nullptr;
+}
+
+const EmbeddedShader &CShaderRegistry::get(const char *pName) {
+	const EmbeddedShader *pShader = find(pName);
+	if (!pShader)
+		throw std::runtime_error(std::string("unknown shader: ") + pName);
+	return *pShader;
+}
+
+const EmbeddedShader *CShaderRegistry::begin() {
+	return std::begin(Shaders);
+}
+
+const EmbeddedShader *CShaderRegistry::end() {
+	return std::end(Shaders);
+}
+
+} // namespace sps
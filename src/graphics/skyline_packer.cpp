@@ -0,0 +1,107 @@
+#include <SuperSDL/skyline_packer.hpp>
+#include <algorithm>
+
+namespace sps {
+
+CSkylinePacker::CSkylinePacker() {
+	m_Width = 0;
+	m_Height = 0;
+	m_UsedArea = 0;
+}
+
+void CSkylinePacker::init(uint32_t Width, uint32_t Height) {
+	m_Width = Width;
+	m_Height = Height;
+	reset();
+}
+
+void CSkylinePacker::reset() {
+	m_UsedArea = 0;
+	m_Skyline.clear();
+	m_Skyline.push_back({0, 0, m_Width});
+}
+
+bool CSkylinePacker::fits(size_t Index, uint32_t Width, uint32_t Height, uint32_t &Y) const {
+	uint32_t X = m_Skyline[Index].m_X;
+	if (X + Width > m_Width)
+		return false;
+
+	// The rectangle rests on the highest segment it spans.
+	Y = 0;
+	uint32_t Remaining = Width;
+	for (size_t i = Index; Remaining > 0; i++) {
+		Y = std::max(Y, m_Skyline[i].m_Y);
+		if (Y + Height > m_Height)
+			return false;
+		Remaining -= std::min(Remaining, m_Skyline[i].m_Width);
+	}
+	return true;
+}
+
+bool CSkylinePacker::pack(uint32_t Width, uint32_t Height, uint32_t &X, uint32_t &Y) {
+	if (Width == 0 || Height == 0) {
+		X = 0;
+		Y = 0;
+		return true;
+	}
+
+	size_t Best = SIZE_MAX;
+	uint32_t BestY = 0;
+	uint32_t BestBottom = UINT32_MAX;
+	uint32_t BestWidth = UINT32_MAX;
+
+	// Bottom-left: lowest resulting top edge, then the narrowest segment.
+	for (size_t i = 0; i < m_Skyline.size(); i++) {
+		uint32_t CandidateY;
+		if (!fits(i, Width, Height, CandidateY))
+			continue;
+
+		uint32_t Bottom = CandidateY + Height;
+		if (Bottom < BestBottom || (Bottom == BestBottom && m_Skyline[i].m_Width < BestWidth)) {
+			Best = i;
+			BestY = CandidateY;
+			BestBottom = Bottom;
+			BestWidth = m_Skyline[i].m_Width;
+		}
+	}
+
+	if (Best == SIZE_MAX)
+		return false;
+
+	X = m_Skyline[Best].m_X;
+	Y = BestY;
+
+	m_Skyline.insert(m_Skyline.begin() + Best, {X, BestY + Height, Width});
+
+	// Cut the segments now hidden below the new one.
+	for (size_t i = Best + 1; i < m_Skyline.size();) {
+		Segment &Current = m_Skyline[i];
+		uint32_t End = X + Width;
+		if (Current.m_X >= End)
+			break;
+
+		uint32_t Shrink = End - Current.m_X;
+		if (Shrink >= Current.m_Width) {
+			m_Skyline.erase(m_Skyline.begin() + i);
+			continue;
+		}
+		Current.m_X += Shrink;
+		Current.m_Width -= Shrink;
+		break;
+	}
+
+	// Merge neighbours at the same height.
+	for (size_t i = 0; i + 1 < m_Skyline.size();) {
+		if (m_Skyline[i].m_Y == m_Skyline[i + 1].m_Y) {
+			m_Skyline[i].m_Width += m_Skyline[i + 1].m_Width;
+			m_Skyline.erase(m_Skyline.begin() + i + 1);
+		} else {
+			i++;
+		}
+	}
+
+	m_UsedArea += uint64_t(Width) * Height;
+	return true;
+}
+
+} // namespace sps
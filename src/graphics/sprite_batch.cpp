@@ -0,0 +1,180 @@
+#include <SuperSDL/renderer.hpp>
+#include <SuperSDL/sprite_batch.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace sps {
+
+CSpriteBatch::CSpriteBatch() : CLoggable("spritebatch") {
+	m_pRenderer = nullptr;
+	m_MaxSprites = 0;
+	m_Dropped = 0;
+	m_Culled = 0;
+	m_PipelineBinds = 0;
+	m_DescriptorBinds = 0;
+}
+
+std::array<vk::VertexInputBindingDescription, 2> CSpriteBatch::getBindingDescriptions() {
+	return {
+		vk::VertexInputBindingDescription(0, sizeof(glm::vec2), vk::VertexInputRate::eVertex),
+		vk::VertexInputBindingDescription(1, sizeof(Instance), vk::VertexInputRate::eInstance)};
+}
+
+std::array<vk::VertexInputAttributeDescription, 7> CSpriteBatch::getAttributeDescriptions() {
+	return {
+		vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32Sfloat, 0),
+		vk::VertexInputAttributeDescription(1, 1, vk::Format::eR32G32Sfloat, offsetof(Instance, m_Position)),
+		vk::VertexInputAttributeDescription(2, 1, vk::Format::eR32G32Sfloat, offsetof(Instance, m_Size)),
+		vk::VertexInputAttributeDescription(3, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(Instance, m_UV)),
+		vk::VertexInputAttributeDescription(4, 1, vk::Format::eR32Sfloat, offsetof(Instance, m_Rotation)),
+		vk::VertexInputAttributeDescription(5, 1, vk::Format::eR8G8B8A8Unorm, offsetof(Instance, m_Color)),
+		vk::VertexInputAttributeDescription(6, 1, vk::Format::eR32Uint, offsetof(Instance, m_Texture))};
+}
+
+void CSpriteBatch::init(CRenderer *pRenderer, uint32_t MaxSprites) {
+	m_pRenderer = pRenderer;
+	m_MaxSprites = MaxSprites;
+
+	// The unit quad, expanded per instance in the vertex shader.
+	const glm::vec2 Corners[] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}};
+	const uint16_t Indices[] = {0, 1, 2, 2, 3, 0};
+
+	m_pRenderer->createBuffer(sizeof(Corners) + sizeof(Indices),
+							  vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer,
+							  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+							  m_QuadBuffer, m_QuadMemory);
+
+	std::memcpy(m_QuadMemory.m_pMapped, Corners, sizeof(Corners));
+	std::memcpy(static_cast<char *>(m_QuadMemory.m_pMapped) + sizeof(Corners), Indices, sizeof(Indices));
+
+	m_Sprites.reserve(m_MaxSprites);
+	m_SortEntries.reserve(m_MaxSprites);
+
+	Log()->debug("Sprite batch ready ({} sprites per frame)", m_MaxSprites);
+}
+
+void CSpriteBatch::quit() {
+	m_pRenderer->destroyBuffer(m_QuadBuffer, m_QuadMemory);
+}
+
+void CSpriteBatch::draw(const Sprite &Sprite) {
+	if (!m_View.overlaps(getSpriteBounds(Sprite))) {
+		m_Culled++;
+		return;
+	}
+	if (m_Sprites.size() >= m_MaxSprites) {
+		m_Dropped++;
+		return;
+	}
+	m_Sprites.push_back(Sprite);
+}
+
+uint32_t CSpriteBatch::prepare() {
+	m_PrepareStart = std::chrono::steady_clock::now();
+
+	m_SortEntries.clear();
+	m_Batches.clear();
+	m_PipelineBinds = 0;
+	m_DescriptorBinds = 0;
+
+	m_Stats.m_SpriteCount = m_Sprites.size();
+	m_Stats.m_DrawCount = 0;
+	m_Stats.m_PipelineBinds = 0;
+	m_Stats.m_DescriptorBinds = 0;
+
+	if (!m_Sprites.empty())
+		m_Instances = m_pRenderer->getAllocator().allocateTransient(sizeof(Instance) * m_Sprites.size());
+
+	if (!m_Sprites.empty() && !m_Instances) {
+		m_Dropped += m_Sprites.size();
+	} else if (!m_Sprites.empty()) {
+		for (uint32_t i = 0; i < m_Sprites.size(); i++) {
+			const Sprite &S = m_Sprites[i];
+			// Textures are sorted on when bindless too, so the output doesn't
+			// depend on the path.
+			uint64_t Key = (uint64_t(S.m_Layer) << 48) | (uint64_t(S.m_Pipeline) << 32) | S.m_Texture;
+			m_SortEntries.push_back({Key, i});
+		}
+
+		// Games usually submit in mostly sorted order, skip the sort when we can.
+		if (!std::is_sorted(m_SortEntries.begin(), m_SortEntries.end()))
+			std::sort(m_SortEntries.begin(), m_SortEntries.end());
+
+		Instance *pOut = static_cast<Instance *>(m_Instances.m_pMapped);
+		const CTextureTable &Textures = m_pRenderer->textures();
+		bool Bindless = Textures.isBindless();
+
+		for (uint32_t i = 0; i < m_SortEntries.size(); i++) {
+			const Sprite &S = m_Sprites[m_SortEntries[i].m_Index];
+			// Glyphs and removed textures end up here too.
+			uint32_t Texture = Textures.contains(S.m_Texture) ? S.m_Texture : CTextureTable::WhiteTexture;
+
+			// Written sequentially, the mapping may be write-combined.
+			pOut[i] = {S.m_Position, S.m_Size, S.m_UV, S.m_Rotation, S.m_Color, Texture};
+
+			if (m_Batches.empty() || m_Batches.back().m_Pipeline != S.m_Pipeline || (!Bindless && m_Batches.back().m_Texture != Texture))
+				m_Batches.push_back({S.m_Pipeline, Texture, i, 0});
+			m_Batches.back().m_InstanceCount++;
+		}
+	}
+
+	m_Stats.m_DroppedSprites = m_Dropped;
+	m_Stats.m_CulledSprites = m_Culled;
+	m_Stats.m_DrawCount = m_Batches.size();
+	m_RecordStart = std::chrono::steady_clock::now();
+	return m_Batches.size();
+}
+
+void CSpriteBatch::record(vk::CommandBuffer Cmd, const std::vector<vk::Pipeline> &Pipelines, vk::PipelineLayout Layout, uint32_t First, uint32_t Last) {
+	if (First >= Last)
+		return;
+
+	// Every command buffer starts without any state bound.
+	vk::Buffer Buffers[] = {m_QuadBuffer, m_Instances.m_Buffer};
+	vk::DeviceSize Offsets[] = {0, m_Instances.m_Offset};
+	Cmd.bindVertexBuffers(0, 2, Buffers, Offsets);
+	Cmd.bindIndexBuffer(m_QuadBuffer, sizeof(glm::vec2) * 4, vk::IndexType::eUint16);
+
+	const CTextureTable &Textures = m_pRenderer->textures();
+	uint32_t BoundPipeline = UINT32_MAX;
+	uint32_t BoundTexture = UINT32_MAX;
+	uint32_t Binds = 0;
+	uint32_t DescriptorBinds = 0;
+	for (uint32_t i = First; i < Last; i++) {
+		const SpriteDrawBatch &Batch = m_Batches[i];
+		if (Batch.m_Pipeline != BoundPipeline) {
+			Cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, Pipelines[Batch.m_Pipeline]);
+			BoundPipeline = Batch.m_Pipeline;
+			Binds++;
+		}
+		// Bindless batches mix textures, the whole table is bound once.
+		if (BoundTexture == UINT32_MAX || (!Textures.isBindless() && Batch.m_Texture != BoundTexture)) {
+			Textures.bind(Cmd, Layout, Batch.m_Texture);
+			BoundTexture = Batch.m_Texture;
+			DescriptorBinds++;
+		}
+		Cmd.drawIndexed(6, Batch.m_InstanceCount, 0, 0, Batch.m_FirstInstance);
+	}
+
+	m_PipelineBinds.fetch_add(Binds, std::memory_order_relaxed);
+	m_DescriptorBinds.fetch_add(DescriptorBinds, std::memory_order_relaxed);
+}
+
+void CSpriteBatch::finish() {
+	if (m_Dropped > 0) {
+		SPS_LOG_RATE_LIMITED(warn, 1.0, "Dropped {} sprites, the batch holds {} per frame", m_Dropped, m_MaxSprites);
+		m_Dropped = 0;
+	}
+
+	m_Culled = 0;
+	m_Sprites.clear();
+	m_Stats.m_PipelineBinds = m_PipelineBinds.load(std::memory_order_relaxed);
+	m_Stats.m_DescriptorBinds = m_DescriptorBinds.load(std::memory_order_relaxed);
+
+	auto Now = std::chrono::steady_clock::now();
+	m_Stats.m_SubmitTime = std::chrono::duration<double>(Now - m_PrepareStart).count();
+	m_Stats.m_RecordTime = std::chrono::duration<double>(Now - m_RecordStart).count();
+}
+
+} // namespace sps
@@ -0,0 +1,161 @@
+#include <SuperSDL/renderer.hpp>
+#include <SuperSDL/text_renderer.hpp>
+#include <chrono>
+#include <cstring>
+
+namespace sps {
+
+CTextRenderer::CTextRenderer() : CLoggable("text") {
+	m_pRenderer = nullptr;
+	m_ImageReady = false;
+}
+
+void CTextRenderer::init(CRenderer *pRenderer, uint32_t AtlasWidth, uint32_t AtlasHeight) {
+	m_pRenderer = pRenderer;
+	vk::Device Device = m_pRenderer->getDevice();
+
+	m_Atlas.init(AtlasWidth, AtlasHeight);
+
+	vk::ImageCreateInfo ImageInfo = {};
+	ImageInfo.imageType = vk::ImageType::e2D;
+	ImageInfo.format = vk::Format::eR8Unorm;
+	ImageInfo.extent = vk::Extent3D(AtlasWidth, AtlasHeight, 1);
+	ImageInfo.mipLevels = 1;
+	ImageInfo.arrayLayers = 1;
+	ImageInfo.samples = vk::SampleCountFlagBits::e1;
+	ImageInfo.tiling = vk::ImageTiling::eOptimal;
+	ImageInfo.usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+	ImageInfo.sharingMode = vk::SharingMode::eExclusive;
+	ImageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+	m_Image = Device.createImage(ImageInfo);
+	m_ImageMemory = m_pRenderer->getAllocator().allocateImage(m_Image, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	m_ImageReady = false;
+
+	vk::ImageViewCreateInfo ViewInfo(
+		vk::ImageViewCreateFlags(), m_Image, vk::ImageViewType::e2D, vk::Format::eR8Unorm,
+		vk::ComponentMapping(),
+		vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+	m_ImageView = Device.createImageView(ViewInfo);
+
+	// The distance field is meant to be filtered, that's what keeps edges smooth at any scale.
+	vk::SamplerCreateInfo SamplerInfo = {};
+	SamplerInfo.magFilter = vk::Filter::eLinear;
+	SamplerInfo.minFilter = vk::Filter::eLinear;
+	SamplerInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+	SamplerInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+	SamplerInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+	SamplerInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+	m_Sampler = Device.createSampler(SamplerInfo);
+
+	vk::DescriptorSetLayoutBinding Binding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment);
+	m_SetLayout = Device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo(vk::DescriptorSetLayoutCreateFlags(), 1, &Binding));
+
+	vk::DescriptorPoolSize PoolSize(vk::DescriptorType::eCombinedImageSampler, 1);
+	m_DescriptorPool = Device.createDescriptorPool(vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlags(), 1, 1, &PoolSize));
+	m_DescriptorSet = Device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(m_DescriptorPool, 1, &m_SetLayout))[0];
+
+	vk::DescriptorImageInfo DescriptorImage(m_Sampler, m_ImageView, vk::ImageLayout::eShaderReadOnlyOptimal);
+	vk::WriteDescriptorSet Write(m_DescriptorSet, 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &DescriptorImage);
+	Device.updateDescriptorSets(Write, nullptr);
+
+	Log()->debug("Text renderer ready ({}x{} atlas)", AtlasWidth, AtlasHeight);
+}
+
+void CTextRenderer::quit() {
+	vk::Device Device = m_pRenderer->getDevice();
+
+	Device.destroyDescriptorPool(m_DescriptorPool);
+	Device.destroyDescriptorSetLayout(m_SetLayout);
+	Device.destroySampler(m_Sampler);
+	Device.destroyImageView(m_ImageView);
+	Device.destroyImage(m_Image);
+	m_pRenderer->getAllocator().free(m_ImageMemory);
+
+	m_Atlas.quit();
+}
+
+void CTextRenderer::draw(uint32_t Font, std::string_view Text, glm::vec2 Position, float PixelSize, uint32_t Color, uint16_t Layer) {
+	auto Start = std::chrono::steady_clock::now();
+
+	const TextLayout &Layout = m_Atlas.layout(Font, Text);
+	float Scale = PixelSize / CFontAtlas::BaseSize;
+	glm::vec2 AtlasSize(m_Atlas.getWidth(), m_Atlas.getHeight());
+
+	Sprite Glyph;
+	Glyph.m_Color = Color;
+	Glyph.m_Texture = AtlasTexture;
+	Glyph.m_Pipeline = SPRITE_PIPELINE_TEXT;
+	Glyph.m_Layer = Layer;
+
+	for (const auto &Placed : Layout.m_Glyphs) {
+		const GlyphInfo &Info = *Placed.m_pInfo;
+		glm::vec2 Size(Info.m_Width, Info.m_Height);
+		glm::vec2 Min(Info.m_X, Info.m_Y);
+
+		Glyph.m_Size = Size * Scale;
+		Glyph.m_Position = Position + (Placed.m_Position + Size * 0.5f) * Scale;
+		Glyph.m_UV = glm::vec4(Min / AtlasSize, (Min + Size) / AtlasSize);
+		m_pRenderer->drawSprite(Glyph);
+	}
+
+	m_Stats.m_GlyphsDrawn += Layout.m_Glyphs.size();
+	m_Stats.m_LayoutTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+glm::vec2 CTextRenderer::measure(uint32_t Font, std::string_view Text, float PixelSize) {
+	return m_Atlas.layout(Font, Text).m_Size * (PixelSize / CFontAtlas::BaseSize);
+}
+
+void CTextRenderer::upload(vk::CommandBuffer Cmd) {
+	glm::uvec2 Min, Max;
+	if (!m_Atlas.getDirty(Min, Max))
+		return;
+
+	uint32_t Width = Max.x - Min.x;
+	uint32_t Height = Max.y - Min.y;
+	TransientAllocation Staging = m_pRenderer->getAllocator().allocateTransient(vk::DeviceSize(Width) * Height);
+	// Stays dirty, we try again next frame.
+	if (!Staging)
+		return;
+
+	const uint8_t *pPixels = m_Atlas.getPixels();
+	uint8_t *pOut = static_cast<uint8_t *>(Staging.m_pMapped);
+	for (uint32_t Row = 0; Row < Height; Row++)
+		std::memcpy(pOut + size_t(Row) * Width, pPixels + size_t(Min.y + Row) * m_Atlas.getWidth() + Min.x, Width);
+
+	vk::ImageSubresourceRange Range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+	// Earlier frames may still be sampling the atlas, the barrier orders the
+	// copy after them.
+	vk::ImageMemoryBarrier ToTransfer(
+		vk::AccessFlags(), vk::AccessFlagBits::eTransferWrite,
+		m_ImageReady ? vk::ImageLayout::eShaderReadOnlyOptimal : vk::ImageLayout::eUndefined,
+		vk::ImageLayout::eTransferDstOptimal,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_Image, Range);
+	Cmd.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer,
+						vk::DependencyFlags(), nullptr, nullptr, ToTransfer);
+
+	// The atlas starts out dirty as a whole, so the first copy defines every texel.
+	vk::BufferImageCopy Region(
+		Staging.m_Offset, Width, Height,
+		vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+		vk::Offset3D(Min.x, Min.y, 0), vk::Extent3D(Width, Height, 1));
+	Cmd.copyBufferToImage(Staging.m_Buffer, m_Image, vk::ImageLayout::eTransferDstOptimal, Region);
+
+	vk::ImageMemoryBarrier ToShader(
+		vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead,
+		vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_Image, Range);
+	Cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+						vk::DependencyFlags(), nullptr, nullptr, ToShader);
+
+	m_ImageReady = true;
+	m_Atlas.clearDirty();
+}
+
+void CTextRenderer::bind(vk::CommandBuffer Cmd, vk::PipelineLayout Layout) const {
+	Cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, Layout, 0, m_DescriptorSet, nullptr);
+}
+
+} // namespace sps
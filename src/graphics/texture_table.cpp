@@ -0,0 +1,166 @@
+#include <SuperSDL/renderer.hpp>
+#include <SuperSDL/texture_table.hpp>
+#include <algorithm>
+#include <array>
+
+namespace sps {
+
+CTextureTable::CTextureTable() : CLoggable("textures") {
+	m_pRenderer = nullptr;
+	m_Bindless = false;
+	m_Capacity = 0;
+	m_Frame = 0;
+	m_Count = 0;
+	m_WhiteReady = false;
+}
+
+void CTextureTable::init(CRenderer *pRenderer, bool Bindless, uint32_t Capacity) {
+	m_pRenderer = pRenderer;
+	m_Device = m_pRenderer->getDevice();
+	m_Bindless = Bindless;
+	m_Frame = 0;
+	m_Count = 0;
+
+	if (m_Bindless) {
+		// Update-after-bind descriptors have limits of their own.
+		auto Properties = m_pRenderer->getPhysicalDevice().getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingProperties>();
+		const auto &Limits = Properties.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+		Capacity = std::min({Capacity, Limits.maxDescriptorSetUpdateAfterBindSampledImages, Limits.maxDescriptorSetUpdateAfterBindSamplers,
+							 Limits.maxPerStageDescriptorUpdateAfterBindSampledImages, Limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+	}
+	m_Capacity = std::max(Capacity, 1u);
+
+	vk::SamplerCreateInfo SamplerInfo = {};
+	SamplerInfo.magFilter = vk::Filter::eLinear;
+	SamplerInfo.minFilter = vk::Filter::eLinear;
+	SamplerInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+	SamplerInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+	SamplerInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+	SamplerInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+	m_Sampler = m_Device.createSampler(SamplerInfo);
+
+	if (m_Bindless) {
+		vk::DescriptorSetLayoutBinding Binding(0, vk::DescriptorType::eCombinedImageSampler, m_Capacity, vk::ShaderStageFlagBits::eFragment);
+		vk::DescriptorBindingFlags BindingFlags = vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending |
+												  vk::DescriptorBindingFlagBits::ePartiallyBound;
+		vk::DescriptorSetLayoutBindingFlagsCreateInfo FlagsInfo(1, &BindingFlags);
+		vk::DescriptorSetLayoutCreateInfo LayoutInfo(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool, 1, &Binding);
+		LayoutInfo.pNext = &FlagsInfo;
+		m_SetLayout = m_Device.createDescriptorSetLayout(LayoutInfo);
+
+		vk::DescriptorPoolSize PoolSize(vk::DescriptorType::eCombinedImageSampler, m_Capacity);
+		m_DescriptorPool = m_Device.createDescriptorPool(vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind, 1, 1, &PoolSize));
+		m_Sets = m_Device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(m_DescriptorPool, 1, &m_SetLayout));
+	} else {
+		vk::DescriptorSetLayoutBinding Binding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment);
+		m_SetLayout = m_Device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo(vk::DescriptorSetLayoutCreateFlags(), 1, &Binding));
+
+		vk::DescriptorPoolSize PoolSize(vk::DescriptorType::eCombinedImageSampler, m_Capacity);
+		m_DescriptorPool = m_Device.createDescriptorPool(vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlags(), m_Capacity, 1, &PoolSize));
+	}
+
+	vk::ImageCreateInfo ImageInfo = {};
+	ImageInfo.imageType = vk::ImageType::e2D;
+	ImageInfo.format = vk::Format::eR8G8B8A8Unorm;
+	ImageInfo.extent = vk::Extent3D(1, 1, 1);
+	ImageInfo.mipLevels = 1;
+	ImageInfo.arrayLayers = 1;
+	ImageInfo.samples = vk::SampleCountFlagBits::e1;
+	ImageInfo.tiling = vk::ImageTiling::eOptimal;
+	ImageInfo.usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+	m_White = m_pRenderer->resources().createImage("white", ImageInfo);
+	m_WhiteReady = false;
+
+	// Every other index is handed out after it.
+	add(m_pRenderer->resources().get(m_White)->m_View);
+
+	if (m_Bindless)
+		Log()->info("Bindless textures, {} per table", m_Capacity);
+	else
+		Log()->info("Textures are bound one by one, {} at most", m_Capacity);
+}
+
+void CTextureTable::quit() {
+	m_Device.destroyDescriptorPool(m_DescriptorPool);
+	m_Device.destroyDescriptorSetLayout(m_SetLayout);
+	m_Device.destroySampler(m_Sampler);
+	m_pRenderer->resources().destroy(m_White);
+
+	m_Sets.clear();
+	m_Used.clear();
+	m_FreeIndices.clear();
+	m_Removed.clear();
+	m_Count = 0;
+}
+
+void CTextureTable::update(vk::CommandBuffer FrameCmd, uint64_t Frame, uint64_t FirstUnfinished) {
+	m_Frame = Frame;
+	while (!m_Removed.empty() && m_Removed.front().m_Frame < FirstUnfinished) {
+		m_FreeIndices.push_back(m_Removed.front().m_Index);
+		m_Removed.pop_front();
+	}
+
+	if (!m_WhiteReady) {
+		vk::Image Image = m_pRenderer->resources().get(m_White)->m_Image;
+		vk::ImageSubresourceRange Range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+		vk::ImageMemoryBarrier ToTransfer(
+			vk::AccessFlags(), vk::AccessFlagBits::eTransferWrite,
+			vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, Image, Range);
+		FrameCmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+								 vk::DependencyFlags(), nullptr, nullptr, ToTransfer);
+
+		FrameCmd.clearColorImage(Image, vk::ImageLayout::eTransferDstOptimal, vk::ClearColorValue(std::array<float, 4>{1.0f, 1.0f, 1.0f, 1.0f}), Range);
+
+		vk::ImageMemoryBarrier ToShader(
+			vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead,
+			vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, Image, Range);
+		FrameCmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+								 vk::DependencyFlags(), nullptr, nullptr, ToShader);
+		m_WhiteReady = true;
+	}
+}
+
+void CTextureTable::write(uint32_t Index, vk::ImageView View) {
+	vk::DescriptorImageInfo DescriptorImage(m_Sampler, View, vk::ImageLayout::eShaderReadOnlyOptimal);
+	vk::WriteDescriptorSet Write(m_Bindless ? m_Sets[0] : m_Sets[Index], 0, m_Bindless ? Index : 0, 1, vk::DescriptorType::eCombinedImageSampler, &DescriptorImage);
+	m_Device.updateDescriptorSets(Write, nullptr);
+}
+
+uint32_t CTextureTable::add(vk::ImageView View) {
+	uint32_t Index;
+	if (!m_FreeIndices.empty()) {
+		Index = m_FreeIndices.back();
+		m_FreeIndices.pop_back();
+	} else if (m_Used.size() < m_Capacity) {
+		Index = static_cast<uint32_t>(m_Used.size());
+		m_Used.push_back(false);
+		if (!m_Bindless)
+			m_Sets.push_back(m_Device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(m_DescriptorPool, 1, &m_SetLayout))[0]);
+	} else {
+		SPS_LOG_RATE_LIMITED(warn, 1.0, "The texture table is full ({} textures), drawing white instead", m_Capacity);
+		return WhiteTexture;
+	}
+
+	write(Index, View);
+	m_Used[Index] = true;
+	m_Count++;
+	return Index;
+}
+
+void CTextureTable::remove(uint32_t Index) {
+	if (Index == WhiteTexture || !contains(Index))
+		return;
+	m_Used[Index] = false;
+	m_Count--;
+	m_Removed.push_back({m_Frame, Index});
+}
+
+void CTextureTable::bind(vk::CommandBuffer Cmd, vk::PipelineLayout Layout, uint32_t Texture) const {
+	vk::DescriptorSet Set = m_Bindless ? m_Sets[0] : m_Sets[contains(Texture) ? Texture : WhiteTexture];
+	Cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, Layout, 1, Set, nullptr);
+}
+
+} // namespace sps
@@ -0,0 +1,154 @@
+#include <SDL_timer.h>
+#include <SuperSDL/input.hpp>
+#include <SuperSDL/profiler.hpp>
+#include <algorithm>
+
+namespace sps {
+
+CInput::CInput() : CLoggable("input"), m_Events(QueueSize) {
+	m_Current = 0;
+	m_Deferred = 0;
+}
+
+void CInput::pump() {
+	SPS_PROFILE_SCOPE("CInput::pump");
+	SDL_PumpEvents();
+
+	// Takes no more than fits, the rest stays in SDL's queue for the next
+	// pump rather than being lost.
+	SDL_Event aEvents[PumpBatch];
+	for (;;) {
+		int Space = static_cast<int>(std::min<size_t>(m_Events.freeSpace(), PumpBatch));
+		if (Space == 0) {
+			if (SDL_PeepEvents(nullptr, 0, SDL_PEEKEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) > 0)
+				m_Deferred.fetch_add(1, std::memory_order_relaxed);
+			break;
+		}
+		int Count = SDL_PeepEvents(aEvents, Space, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+		if (Count <= 0)
+			break;
+		for (int i = 0; i < Count; i++)
+			m_Events.push(aEvents[i]);
+		if (Count < Space)
+			break;
+	}
+}
+
+void CInput::apply(InputSnapshot &Snapshot, const SDL_Event &Event, bool &Moved) {
+	switch (Event.type) {
+	case SDL_KEYDOWN:
+		if (!Event.key.repeat) {
+			Snapshot.m_KeysDown.set(Event.key.keysym.scancode);
+			Snapshot.m_KeysPressed.set(Event.key.keysym.scancode);
+		}
+		break;
+	case SDL_KEYUP:
+		Snapshot.m_KeysDown.reset(Event.key.keysym.scancode);
+		Snapshot.m_KeysReleased.set(Event.key.keysym.scancode);
+		break;
+	case SDL_MOUSEMOTION:
+		// Only where the mouse ended up and how far it went in total matter.
+		Snapshot.m_MousePosition = glm::vec2(Event.motion.x, Event.motion.y);
+		Snapshot.m_MouseDelta += glm::vec2(Event.motion.xrel, Event.motion.yrel);
+		m_Stats.m_MergedMotions += Moved;
+		Moved = true;
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+		Snapshot.m_MousePosition = glm::vec2(Event.button.x, Event.button.y);
+		Snapshot.m_ButtonsDown |= SDL_BUTTON(Event.button.button);
+		Snapshot.m_ButtonsPressed |= SDL_BUTTON(Event.button.button);
+		break;
+	case SDL_MOUSEBUTTONUP:
+		Snapshot.m_MousePosition = glm::vec2(Event.button.x, Event.button.y);
+		Snapshot.m_ButtonsDown &= ~SDL_BUTTON(Event.button.button);
+		Snapshot.m_ButtonsReleased |= SDL_BUTTON(Event.button.button);
+		break;
+	case SDL_MOUSEWHEEL: {
+		glm::vec2 Wheel(Event.wheel.x, Event.wheel.y);
+		Snapshot.m_Wheel += Event.wheel.direction == SDL_MOUSEWHEEL_FLIPPED ? -Wheel : Wheel;
+		break;
+	}
+	case SDL_TEXTINPUT:
+		Snapshot.m_Text += Event.text.text;
+		break;
+	case SDL_WINDOWEVENT:
+		if (Event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
+			Snapshot.m_Focused = true;
+		} else if (Event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+			// The releases go to whichever window has the focus now.
+			Snapshot.m_Focused = false;
+			Snapshot.m_KeysReleased |= Snapshot.m_KeysDown;
+			Snapshot.m_KeysDown.reset();
+			Snapshot.m_ButtonsReleased |= Snapshot.m_ButtonsDown;
+			Snapshot.m_ButtonsDown = 0;
+		}
+		break;
+	case SDL_QUIT:
+		Snapshot.m_QuitRequested = true;
+		break;
+	default:
+		break;
+	}
+}
+
+InputSnapshot &CInput::beginSnapshot(bool KeepEdges) {
+	const InputSnapshot &Previous = m_aSnapshots[m_Current];
+	InputSnapshot &Next = m_aSnapshots[m_Current ^ 1];
+
+	// What is held carries over, what happened only until an update saw it.
+	Next.m_Sequence = Previous.m_Sequence + 1;
+	Next.m_KeysDown = Previous.m_KeysDown;
+	Next.m_MousePosition = Previous.m_MousePosition;
+	Next.m_ButtonsDown = Previous.m_ButtonsDown;
+	Next.m_Focused = Previous.m_Focused;
+	Next.m_QuitRequested = Previous.m_QuitRequested;
+	if (KeepEdges) {
+		Next.m_KeysPressed = Previous.m_KeysPressed;
+		Next.m_KeysReleased = Previous.m_KeysReleased;
+		Next.m_MouseDelta = Previous.m_MouseDelta;
+		Next.m_Wheel = Previous.m_Wheel;
+		Next.m_ButtonsPressed = Previous.m_ButtonsPressed;
+		Next.m_ButtonsReleased = Previous.m_ButtonsReleased;
+		Next.m_Text = Previous.m_Text;
+	} else {
+		Next.m_KeysPressed.reset();
+		Next.m_KeysReleased.reset();
+		Next.m_MouseDelta = glm::vec2(0.0f);
+		Next.m_Wheel = glm::vec2(0.0f);
+		Next.m_ButtonsPressed = 0;
+		Next.m_ButtonsReleased = 0;
+		Next.m_Text.clear();
+	}
+	return Next;
+}
+
+void CInput::update() {
+	SPS_PROFILE_SCOPE("CInput::update");
+	InputSnapshot &Next = beginSnapshot(true);
+
+	SDL_Event Event;
+	bool Moved = false;
+	uint32_t Now = SDL_GetTicks();
+	uint32_t OldestAge = 0;
+	while (m_Events.pop(Event)) {
+		OldestAge = std::max(OldestAge, Now - Event.common.timestamp);
+		apply(Next, Event, Moved);
+		m_Stats.m_Events++;
+	}
+
+	Next.m_Time = std::chrono::steady_clock::now();
+	Next.m_OldestEvent = OldestAge / 1000.0;
+	m_Stats.m_MaxEventAge = std::max(m_Stats.m_MaxEventAge, Next.m_OldestEvent);
+	m_Stats.m_Deferred = m_Deferred.load(std::memory_order_relaxed);
+	m_Current ^= 1;
+}
+
+void CInput::consume() {
+	const InputSnapshot &Previous = m_aSnapshots[m_Current];
+	InputSnapshot &Next = beginSnapshot(false);
+	Next.m_Time = Previous.m_Time;
+	Next.m_OldestEvent = 0.0;
+	m_Current ^= 1;
+}
+
+} // namespace sps
@@ -0,0 +1,286 @@
+#include <SuperSDL/job_system.hpp>
+#include <SuperSDL/profiler.hpp>
+#include <string>
+
+namespace sps {
+
+static thread_local CJobSystem *t_pSystem = nullptr;
+static thread_local void *t_pWorker = nullptr;
+
+/*
+ * Chase-Lev deque with the C11 orderings from "Correct and Efficient
+ * Work-Stealing for Weak Memory Models" (Lê et al.). Fixed capacity, push
+ * fails instead of growing.
+ */
+CJobSystem::CDeque::CDeque() : m_Top(0), m_Bottom(0) {
+	m_pJobs = std::make_unique<std::atomic<Job *>[]>(QueueCapacity);
+}
+
+bool CJobSystem::CDeque::push(Job *pJob) {
+	int64_t Bottom = m_Bottom.load(std::memory_order_relaxed);
+	int64_t Top = m_Top.load(std::memory_order_acquire);
+	if (Bottom - Top >= int64_t(QueueCapacity))
+		return false;
+
+	m_pJobs[Bottom % QueueCapacity].store(pJob, std::memory_order_relaxed);
+	// Publishes the job to thieves, same as the paper's release fence.
+	m_Bottom.store(Bottom + 1, std::memory_order_release);
+	return true;
+}
+
+Job *CJobSystem::CDeque::pop() {
+	int64_t Bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+	m_Bottom.store(Bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t Top = m_Top.load(std::memory_order_relaxed);
+
+	if (Top > Bottom) {
+		// Empty.
+		m_Bottom.store(Bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job *pJob = m_pJobs[Bottom % QueueCapacity].load(std::memory_order_relaxed);
+	if (Top == Bottom) {
+		// Last one, race the thieves for it.
+		if (!m_Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			pJob = nullptr;
+		m_Bottom.store(Bottom + 1, std::memory_order_relaxed);
+	}
+	return pJob;
+}
+
+Job *CJobSystem::CDeque::steal() {
+	int64_t Top = m_Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t Bottom = m_Bottom.load(std::memory_order_acquire);
+
+	if (Top >= Bottom)
+		return nullptr;
+
+	Job *pJob = m_pJobs[Top % QueueCapacity].load(std::memory_order_relaxed);
+	if (!m_Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return pJob;
+}
+
+CJobSystem::CJobSystem() : CLoggable("jobs"), m_Stop(false), m_Queued(0), m_Sleeping(0) {
+}
+
+CJobSystem::~CJobSystem() {
+	quit();
+}
+
+void CJobSystem::init(uint32_t WorkerThreads) {
+	if (WorkerThreads == AutoWorkers)
+		WorkerThreads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+	m_Stop = false;
+	m_Workers.resize(WorkerThreads + 1);
+	for (uint32_t i = 0; i <= WorkerThreads; i++) {
+		m_Workers[i] = std::make_unique<Worker>();
+		m_Workers[i]->m_pJobs = std::make_unique<Job[]>(JobsPerThread);
+		m_Workers[i]->m_Index = i;
+		m_Workers[i]->m_Random = 0x9E3779B97F4A7C15ull * (i + 1);
+	}
+
+	t_pSystem = this;
+	t_pWorker = m_Workers[0].get();
+
+	for (uint32_t i = 1; i <= WorkerThreads; i++)
+		m_Workers[i]->m_Thread = std::thread(&CJobSystem::workerLoop, this, m_Workers[i].get());
+
+	Log()->info("Job system started with {} worker threads", WorkerThreads);
+}
+
+void CJobSystem::quit() {
+	if (m_Workers.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> Lock(m_WakeMutex);
+		m_Stop = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (auto &pWorker : m_Workers) {
+		if (pWorker->m_Thread.joinable())
+			pWorker->m_Thread.join();
+	}
+
+	if (t_pSystem == this) {
+		t_pSystem = nullptr;
+		t_pWorker = nullptr;
+	}
+	m_Workers.clear();
+}
+
+CJobSystem::Worker *CJobSystem::currentWorker() const {
+	return t_pSystem == this ? static_cast<Worker *>(t_pWorker) : nullptr;
+}
+
+uint32_t CJobSystem::getThreadIndex() const {
+	Worker *pWorker = currentWorker();
+	return pWorker ? pWorker->m_Index : UINT32_MAX;
+}
+
+Job *CJobSystem::allocateJob(Worker &Worker) {
+	while (true) {
+		// Skip slots whose job is still queued or running, a running one may
+		// be further up our own stack.
+		for (uint32_t i = 0; i < JobsPerThread; i++) {
+			Job *pJob = &Worker.m_pJobs[Worker.m_NextJob];
+			Worker.m_NextJob = (Worker.m_NextJob + 1) % JobsPerThread;
+			if (!pJob->m_Busy.load(std::memory_order_acquire)) {
+				pJob->m_Busy.store(true, std::memory_order_relaxed);
+				return pJob;
+			}
+		}
+
+		// Every slot is taken, help out until one frees up.
+		if (Job *pOther = findJob(Worker))
+			execute(pOther);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void CJobSystem::submit(Job *pJob, const CJobCounter *pDependency) {
+	if (pDependency) {
+		const CJobCounter &Dependency = *pDependency;
+		std::lock_guard<std::mutex> Lock(Dependency.m_Mutex);
+		// Checked under the lock, the last job of the dependency takes it
+		// before it releases the waiting jobs.
+		if (!Dependency.isDone()) {
+			pJob->m_pNext = Dependency.m_pDependents;
+			Dependency.m_pDependents = pJob;
+			return;
+		}
+	}
+
+	push(*currentWorker(), pJob);
+}
+
+void CJobSystem::push(Worker &Worker, Job *pJob) {
+	if (!Worker.m_Queue.push(pJob)) {
+		// Our queue is full, running it now is as good as anything.
+		execute(pJob);
+		return;
+	}
+
+	m_Queued.fetch_add(1, std::memory_order_seq_cst);
+	if (m_Sleeping.load(std::memory_order_seq_cst) > 0) {
+		// Taking the lock makes sure a worker about to sleep sees the job.
+		{ std::lock_guard<std::mutex> Lock(m_WakeMutex); }
+		m_WakeCondition.notify_one();
+	}
+}
+
+Job *CJobSystem::findJob(Worker &Worker) {
+	Job *pJob = Worker.m_Queue.pop();
+
+	if (!pJob) {
+		uint32_t Count = static_cast<uint32_t>(m_Workers.size());
+		// xorshift, picks where to start looking for a victim.
+		Worker.m_Random ^= Worker.m_Random << 13;
+		Worker.m_Random ^= Worker.m_Random >> 7;
+		Worker.m_Random ^= Worker.m_Random << 17;
+		uint32_t Start = static_cast<uint32_t>(Worker.m_Random % Count);
+
+		for (uint32_t i = 0; i < Count && !pJob; i++) {
+			uint32_t Victim = (Start + i) % Count;
+			if (Victim != Worker.m_Index)
+				pJob = m_Workers[Victim]->m_Queue.steal();
+		}
+	}
+
+	if (pJob)
+		m_Queued.fetch_sub(1, std::memory_order_relaxed);
+	return pJob;
+}
+
+void CJobSystem::execute(Job *pJob) {
+	pJob->m_pRun(pJob->m_aStorage);
+
+	CJobCounter *pCounter = pJob->m_pCounter;
+	pJob->m_Busy.store(false, std::memory_order_release);
+
+	if (!pCounter)
+		return;
+
+	// Not the last job, the counter can't be released by this.
+	uint32_t Pending = pCounter->m_Pending.load(std::memory_order_relaxed);
+	while (Pending > 1) {
+		if (pCounter->m_Pending.compare_exchange_weak(Pending, Pending - 1, std::memory_order_acq_rel))
+			return;
+	}
+
+	// The counter may be destroyed as soon as a waiter sees zero, wait() takes
+	// the lock before returning so we are done with it by then.
+	Job *pDependents = nullptr;
+	{
+		std::lock_guard<std::mutex> Lock(pCounter->m_Mutex);
+		if (pCounter->m_Pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			pDependents = pCounter->m_pDependents;
+			pCounter->m_pDependents = nullptr;
+		}
+	}
+
+	Worker *pWorker = currentWorker();
+	while (pDependents) {
+		Job *pNext = pDependents->m_pNext;
+		push(*pWorker, pDependents);
+		pDependents = pNext;
+	}
+}
+
+void CJobSystem::wait(const CJobCounter &Counter) {
+	Worker *pWorker = currentWorker();
+
+	while (!Counter.isDone()) {
+		Job *pJob = pWorker ? findJob(*pWorker) : nullptr;
+		if (pJob)
+			execute(pJob);
+		else
+			std::this_thread::yield();
+	}
+
+	// Synchronizes with the thread that released the counter.
+	std::lock_guard<std::mutex> Lock(Counter.m_Mutex);
+}
+
+void CJobSystem::workerLoop(Worker *pWorker) {
+	t_pSystem = this;
+	t_pWorker = pWorker;
+
+	std::string Name = "worker " + std::to_string(pWorker->m_Index);
+	SPS_PROFILE_THREAD(Name.c_str());
+	(void)Name;
+
+	// Spin for a short while before sleeping, jobs tend to come in bursts.
+	constexpr uint32_t SpinCount = 256;
+	uint32_t Idle = 0;
+
+	while (!m_Stop.load(std::memory_order_relaxed)) {
+		if (Job *pJob = findJob(*pWorker)) {
+			execute(pJob);
+			Idle = 0;
+			continue;
+		}
+
+		if (++Idle < SpinCount) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> Lock(m_WakeMutex);
+		m_Sleeping.fetch_add(1, std::memory_order_seq_cst);
+		m_WakeCondition.wait(Lock, [this]() {
+			return m_Stop.load(std::memory_order_relaxed) || m_Queued.load(std::memory_order_seq_cst) > 0;
+		});
+		m_Sleeping.fetch_sub(1, std::memory_order_relaxed);
+		Idle = 0;
+	}
+}
+
+} // namespace sps
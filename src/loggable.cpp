@@ -1,14 +1,235 @@
 #include <SuperSDL/loggable.hpp>
-#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <spdlog/sinks/sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <thread>
 
 namespace sps {
 
+/*
+ * The sink shared by all loggers. In async mode messages go through a bounded
+ * multi-producer ring (Vyukov's queue): each slot carries a sequence number
+ * telling producers and the writer thread whether it is free or filled, so a
+ * producer only needs one CAS on the tail to claim a slot.
+ */
+class CLogSink : public spdlog::sinks::sink {
+  private:
+	static constexpr uint32_t Capacity = 4096;
+	static constexpr size_t MaxName = 24;
+	static constexpr size_t MaxPayload = 232;
+
+	struct Slot {
+		std::atomic<uint64_t> m_Sequence;
+		spdlog::level::level_enum m_Level;
+		spdlog::log_clock::time_point m_Time;
+		size_t m_ThreadId;
+		uint8_t m_NameSize;
+		uint8_t m_PayloadSize;
+		char m_aName[MaxName];
+		char m_aPayload[MaxPayload];
+	};
+
+	std::shared_ptr<spdlog::sinks::sink> m_pTarget;
+	std::unique_ptr<Slot[]> m_pSlots;
+
+	alignas(64) std::atomic<uint64_t> m_Tail;
+	alignas(64) std::atomic<uint64_t> m_Head;
+	std::atomic<uint64_t> m_Dropped;
+	uint64_t m_ReportedDropped;
+
+	std::atomic<bool> m_Async;
+	std::atomic<bool> m_Running;
+	std::thread m_Writer;
+	std::mutex m_ControlMutex;
+
+	void enqueue(const spdlog::details::log_msg &Msg) {
+		uint64_t Pos = m_Tail.load(std::memory_order_relaxed);
+		Slot *pSlot;
+		while (true) {
+			pSlot = &m_pSlots[Pos % Capacity];
+			uint64_t Seq = pSlot->m_Sequence.load(std::memory_order_acquire);
+			int64_t Diff = int64_t(Seq) - int64_t(Pos);
+			if (Diff == 0) {
+				if (m_Tail.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (Diff < 0) {
+				// Full, the writer hasn't caught up.
+				m_Dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			} else {
+				Pos = m_Tail.load(std::memory_order_relaxed);
+			}
+		}
+
+		pSlot->m_Level = Msg.level;
+		pSlot->m_Time = Msg.time;
+		pSlot->m_ThreadId = Msg.thread_id;
+		pSlot->m_NameSize = std::min(Msg.logger_name.size(), MaxName);
+		std::memcpy(pSlot->m_aName, Msg.logger_name.data(), pSlot->m_NameSize);
+		// Longer messages are cut, they are rare and shouldn't be on a hot path.
+		pSlot->m_PayloadSize = std::min(Msg.payload.size(), MaxPayload);
+		std::memcpy(pSlot->m_aPayload, Msg.payload.data(), pSlot->m_PayloadSize);
+
+		pSlot->m_Sequence.store(Pos + 1, std::memory_order_release);
+	}
+
+	// Only called by one thread at a time. Returns the number of messages written.
+	uint32_t drain() {
+		uint32_t Count = 0;
+		uint64_t Head = m_Head.load(std::memory_order_relaxed);
+
+		while (true) {
+			Slot &Current = m_pSlots[Head % Capacity];
+			if (Current.m_Sequence.load(std::memory_order_acquire) != Head + 1)
+				break;
+
+			spdlog::details::log_msg Msg(
+				Current.m_Time, spdlog::source_loc(),
+				spdlog::string_view_t(Current.m_aName, Current.m_NameSize), Current.m_Level,
+				spdlog::string_view_t(Current.m_aPayload, Current.m_PayloadSize));
+			Msg.thread_id = Current.m_ThreadId;
+			m_pTarget->log(Msg);
+
+			Current.m_Sequence.store(Head + Capacity, std::memory_order_release);
+			m_Head.store(++Head, std::memory_order_release);
+			Count++;
+		}
+
+		uint64_t Dropped = m_Dropped.load(std::memory_order_relaxed);
+		if (Dropped != m_ReportedDropped) {
+			std::string Text = fmt::format("Log buffer full, dropped {} messages", Dropped - m_ReportedDropped);
+			m_pTarget->log(spdlog::details::log_msg("log", spdlog::level::warn, Text));
+			m_ReportedDropped = Dropped;
+		}
+
+		if (Count > 0)
+			m_pTarget->flush();
+		return Count;
+	}
+
+	void writerLoop() {
+		while (m_Running.load(std::memory_order_acquire)) {
+			if (drain() == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+  public:
+	CLogSink() {
+		m_pTarget = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+		m_pSlots = std::make_unique<Slot[]>(Capacity);
+		for (uint32_t i = 0; i < Capacity; i++)
+			m_pSlots[i].m_Sequence.store(i, std::memory_order_relaxed);
+		m_Tail = 0;
+		m_Head = 0;
+		m_Dropped = 0;
+		m_ReportedDropped = 0;
+		m_Async = false;
+		m_Running = false;
+	}
+
+	~CLogSink() { setAsync(false); }
+
+	void log(const spdlog::details::log_msg &Msg) override {
+		if (m_Async.load(std::memory_order_relaxed))
+			enqueue(Msg);
+		else
+			m_pTarget->log(Msg);
+	}
+
+	void flush() override {
+		if (!m_Async.load(std::memory_order_relaxed)) {
+			m_pTarget->flush();
+			return;
+		}
+
+		uint64_t Tail = m_Tail.load(std::memory_order_acquire);
+		while (m_Head.load(std::memory_order_acquire) < Tail && m_Running.load(std::memory_order_acquire))
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+
+	void set_pattern(const std::string &Pattern) override { m_pTarget->set_pattern(Pattern); }
+	void set_formatter(std::unique_ptr<spdlog::formatter> pFormatter) override { m_pTarget->set_formatter(std::move(pFormatter)); }
+
+	void setAsync(bool Async) {
+		std::lock_guard<std::mutex> Lock(m_ControlMutex);
+		if (Async == m_Async.load())
+			return;
+
+		if (Async) {
+			m_Running.store(true, std::memory_order_release);
+			m_Writer = std::thread(&CLogSink::writerLoop, this);
+			m_Async.store(true, std::memory_order_release);
+		} else {
+			m_Async.store(false, std::memory_order_release);
+			m_Running.store(false, std::memory_order_release);
+			m_Writer.join();
+			drain();
+		}
+	}
+
+	void setTarget(spdlog::sink_ptr pTarget) {
+		std::lock_guard<std::mutex> Lock(m_ControlMutex);
+		m_pTarget->flush();
+		m_pTarget = pTarget ? std::move(pTarget) : std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+	}
+
+	bool isAsync() const { return m_Async.load(std::memory_order_relaxed); }
+	uint64_t getDropped() const { return m_Dropped.load(std::memory_order_relaxed); }
+};
+
+// Loggers share ownership, so the sink outlives loggers in static objects.
+static const std::shared_ptr<CLogSink> &logSink() {
+	static auto s_pSink = std::make_shared<CLogSink>();
+	return s_pSink;
+}
+
 CLoggable::CLoggable(const char *pName) {
-	m_Logger = spdlog::stdout_color_mt(pName);
+	// Not registered with spdlog, so several instances may share a name.
+	m_Logger = std::make_shared<spdlog::logger>(pName, logSink());
 #ifndef NDEBUG
 	m_Logger->set_level(spdlog::level::debug);
 #endif
 }
 
+void CLoggable::setAsyncLogging(bool Async) {
+	logSink()->setAsync(Async);
+}
+
+bool CLoggable::isAsyncLogging() {
+	return logSink()->isAsync();
+}
+
+void CLoggable::flushLogs() {
+	logSink()->flush();
+}
+
+uint64_t CLoggable::getDroppedLogs() {
+	return logSink()->getDropped();
+}
+
+void CLoggable::setLogTarget(spdlog::sink_ptr pTarget) {
+	logSink()->setTarget(std::move(pTarget));
+}
+
+CLogRateLimit::CLogRateLimit(double Seconds) : m_Interval(int64_t(Seconds * 1e9)), m_Next(0), m_Suppressed(0) {
+}
+
+bool CLogRateLimit::allow(uint32_t &Suppressed) {
+	int64_t Now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	int64_t Next = m_Next.load(std::memory_order_relaxed);
+
+	if (Now < Next || !m_Next.compare_exchange_strong(Next, Now + m_Interval, std::memory_order_relaxed)) {
+		m_Suppressed.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	Suppressed = m_Suppressed.exchange(0, std::memory_order_relaxed);
+	return true;
+}
+
 } // namespace sps
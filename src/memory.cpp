@@ -0,0 +1,332 @@
+#include <SuperSDL/job_system.hpp>
+#include <SuperSDL/memory.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace sps {
+
+namespace {
+
+// Counters are spread over a few cache lines so threads allocating at the
+// same time don't fight over one.
+constexpr uint32_t CounterShards = 16;
+
+struct alignas(64) CounterShard {
+	std::atomic<uint64_t> m_Allocations{0};
+	std::atomic<uint64_t> m_Bytes{0};
+};
+
+CounterShard s_aShards[CounterShards];
+
+uintptr_t alignUp(uintptr_t Value, size_t Alignment) {
+	return (Value + Alignment - 1) & ~uintptr_t(Alignment - 1);
+}
+
+} // namespace
+
+#ifdef SUPERSDL_TRACK_ALLOCATIONS
+static std::atomic<uint32_t> s_NextShard{0};
+static thread_local uint32_t t_Shard = UINT32_MAX;
+
+static void countAllocation(size_t Bytes) {
+	if (t_Shard == UINT32_MAX)
+		t_Shard = s_NextShard.fetch_add(1, std::memory_order_relaxed) % CounterShards;
+	CounterShard &Shard = s_aShards[t_Shard];
+	Shard.m_Allocations.fetch_add(1, std::memory_order_relaxed);
+	Shard.m_Bytes.fetch_add(Bytes, std::memory_order_relaxed);
+}
+#endif
+
+bool isTrackingHeap() {
+#ifdef SUPERSDL_TRACK_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+HeapCounters getHeapCounters() {
+	HeapCounters Counters;
+	for (const CounterShard &Shard : s_aShards) {
+		Counters.m_Allocations += Shard.m_Allocations.load(std::memory_order_relaxed);
+		Counters.m_Bytes += Shard.m_Bytes.load(std::memory_order_relaxed);
+	}
+	return Counters;
+}
+
+CLinearArena::CLinearArena(size_t Capacity) {
+	m_pBlock = Capacity > 0 ? static_cast<unsigned char *>(::operator new(Capacity)) : nullptr;
+	m_Capacity = Capacity;
+	m_Used = 0;
+	m_pOverflow = nullptr;
+	m_pOverflowHead = nullptr;
+	m_OverflowLeft = 0;
+	m_OverflowUsed = 0;
+	m_Peak = 0;
+	m_Overflows = 0;
+}
+
+CLinearArena::~CLinearArena() {
+	while (m_pOverflow) {
+		OverflowBlock *pNext = m_pOverflow->m_pNext;
+		::operator delete(m_pOverflow);
+		m_pOverflow = pNext;
+	}
+	::operator delete(m_pBlock);
+}
+
+void *CLinearArena::do_allocate(size_t Bytes, size_t Alignment) {
+	uintptr_t Base = reinterpret_cast<uintptr_t>(m_pBlock);
+	size_t Offset = alignUp(Base + m_Used, Alignment) - Base;
+	if (m_pBlock && Offset + Bytes <= m_Capacity) {
+		m_Used = Offset + Bytes;
+		return m_pBlock + Offset;
+	}
+	return allocateOverflow(Bytes, Alignment);
+}
+
+void *CLinearArena::allocateOverflow(size_t Bytes, size_t Alignment) {
+	uintptr_t Head = reinterpret_cast<uintptr_t>(m_pOverflowHead);
+	size_t Padding = alignUp(Head, Alignment) - Head;
+	if (!m_pOverflowHead || Padding + Bytes > m_OverflowLeft) {
+		size_t Size = std::max({MinOverflowBlock, m_Capacity, sizeof(OverflowBlock) + Alignment + Bytes});
+		OverflowBlock *pBlock = static_cast<OverflowBlock *>(::operator new(Size));
+		pBlock->m_pNext = m_pOverflow;
+		pBlock->m_Size = Size;
+		m_pOverflow = pBlock;
+		m_pOverflowHead = reinterpret_cast<unsigned char *>(pBlock + 1);
+		m_OverflowLeft = Size - sizeof(OverflowBlock);
+		m_Overflows++;
+
+		Head = reinterpret_cast<uintptr_t>(m_pOverflowHead);
+		Padding = alignUp(Head, Alignment) - Head;
+	}
+
+	unsigned char *pData = m_pOverflowHead + Padding;
+	m_pOverflowHead = pData + Bytes;
+	m_OverflowLeft -= Padding + Bytes;
+	m_OverflowUsed += Padding + Bytes;
+	return pData;
+}
+
+void CLinearArena::do_deallocate(void *pData, size_t Bytes, size_t Alignment) {
+	// Freed all at once by reset().
+	(void)pData;
+	(void)Bytes;
+	(void)Alignment;
+}
+
+void CLinearArena::reset() {
+	size_t Used = getUsed();
+	m_Peak = std::max(m_Peak, Used);
+
+	if (m_pOverflow) {
+		while (m_pOverflow) {
+			OverflowBlock *pNext = m_pOverflow->m_pNext;
+			::operator delete(m_pOverflow);
+			m_pOverflow = pNext;
+		}
+		// Everything of this round fits next time, with room for padding
+		// and some growth.
+		size_t Capacity = std::max(m_Capacity * 2, Used + Used / 2);
+		::operator delete(m_pBlock);
+		m_pBlock = static_cast<unsigned char *>(::operator new(Capacity));
+		m_Capacity = Capacity;
+	}
+
+	m_Used = 0;
+	m_pOverflowHead = nullptr;
+	m_OverflowLeft = 0;
+	m_OverflowUsed = 0;
+}
+
+CFrameMemory::CFrameMemory() : CLoggable("memory") {
+	m_pJobs = nullptr;
+}
+
+void CFrameMemory::init(CJobSystem *pJobs) {
+	m_pJobs = pJobs;
+	m_Arenas.clear();
+	for (uint32_t i = 0; i < std::max(1u, pJobs->getThreadCount()); i++)
+		m_Arenas.push_back(std::make_unique<CLinearArena>(ArenaSize));
+
+	m_Stats = MemoryStats();
+	m_FrameStart = getHeapCounters();
+	if (!isTrackingHeap())
+		Log()->debug("Built without SUPERSDL_TRACK_ALLOCATIONS, heap allocations aren't counted");
+}
+
+void CFrameMemory::quit() {
+	m_Arenas.clear();
+	m_pJobs = nullptr;
+}
+
+CLinearArena &CFrameMemory::arena() {
+	uint32_t Thread = m_pJobs ? m_pJobs->getThreadIndex() : UINT32_MAX;
+	if (Thread >= m_Arenas.size())
+		throw std::runtime_error("Frame memory can only be used by job system threads");
+	return *m_Arenas[Thread];
+}
+
+void CFrameMemory::endFrame() {
+	// Taken before the resets, an arena growing counts for the next frame.
+	HeapCounters Now = getHeapCounters();
+	m_Stats.m_Frames++;
+	m_Stats.m_FrameAllocations = Now.m_Allocations - m_FrameStart.m_Allocations;
+	m_Stats.m_FrameBytes = Now.m_Bytes - m_FrameStart.m_Bytes;
+	m_Stats.m_MaxFrameAllocations = std::max(m_Stats.m_MaxFrameAllocations, m_Stats.m_FrameAllocations);
+	m_Stats.m_QuietFrames = m_Stats.m_FrameAllocations == 0 ? m_Stats.m_QuietFrames + 1 : 0;
+	m_FrameStart = Now;
+
+	m_Stats.m_ArenaUsed = 0;
+	m_Stats.m_ArenaPeak = 0;
+	m_Stats.m_ArenaCapacity = 0;
+	m_Stats.m_ArenaOverflows = 0;
+	for (auto &pArena : m_Arenas) {
+		m_Stats.m_ArenaUsed += pArena->getUsed();
+		pArena->reset();
+		m_Stats.m_ArenaPeak += pArena->getPeak();
+		m_Stats.m_ArenaCapacity += pArena->getCapacity();
+		m_Stats.m_ArenaOverflows += pArena->getOverflows();
+	}
+}
+
+} // namespace sps
+
+/*
+ * Replaces the global operator new and delete of the process, so allocations
+ * made through them are counted whichever module makes them. Memory that C
+ * code such as SDL or the Vulkan driver gets from malloc() isn't. Windows
+ * DLLs can't replace them for the executable, so it's off there.
+ */
+#ifdef SUPERSDL_TRACK_ALLOCATIONS
+
+static void *countedAllocate(size_t Bytes) {
+	sps::countAllocation(Bytes);
+	if (Bytes == 0)
+		Bytes = 1;
+	while (true) {
+		if (void *pData = std::malloc(Bytes))
+			return pData;
+		std::new_handler Handler = std::get_new_handler();
+		if (!Handler)
+			throw std::bad_alloc();
+		Handler();
+	}
+}
+
+static void *countedAllocate(size_t Bytes, std::align_val_t Alignment) {
+	sps::countAllocation(Bytes);
+	size_t Align = std::max(static_cast<size_t>(Alignment), sizeof(void *));
+	if (Bytes == 0)
+		Bytes = 1;
+	while (true) {
+		void *pData = nullptr;
+		if (posix_memalign(&pData, Align, Bytes) == 0)
+			return pData;
+		std::new_handler Handler = std::get_new_handler();
+		if (!Handler)
+			throw std::bad_alloc();
+		Handler();
+	}
+}
+
+void *operator new(size_t Bytes) {
+	return countedAllocate(Bytes);
+}
+
+void *operator new[](size_t Bytes) {
+	return countedAllocate(Bytes);
+}
+
+void *operator new(size_t Bytes, const std::nothrow_t &) noexcept {
+	try {
+		return countedAllocate(Bytes);
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void *operator new[](size_t Bytes, const std::nothrow_t &) noexcept {
+	try {
+		return countedAllocate(Bytes);
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void *operator new(size_t Bytes, std::align_val_t Alignment) {
+	return countedAllocate(Bytes, Alignment);
+}
+
+void *operator new[](size_t Bytes, std::align_val_t Alignment) {
+	return countedAllocate(Bytes, Alignment);
+}
+
+void *operator new(size_t Bytes, std::align_val_t Alignment, const std::nothrow_t &) noexcept {
+	try {
+		return countedAllocate(Bytes, Alignment);
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void *operator new[](size_t Bytes, std::align_val_t Alignment, const std::nothrow_t &) noexcept {
+	try {
+		return countedAllocate(Bytes, Alignment);
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void operator delete(void *pData) noexcept {
+	std::free(pData);
+}
+
+void operator delete[](void *pData) noexcept {
+	std::free(pData);
+}
+
+void operator delete(void *pData, size_t) noexcept {
+	std::free(pData);
+}
+
+void operator delete[](void *pData, size_t) noexcept {
+	std::free(pData);
+}
+
+void operator delete(void *pData, const std::nothrow_t &) noexcept {
+	std::free(pData);
+}
+
+void operator delete[](void *pData, const std::nothrow_t &) noexcept {
+	std::free(pData);
+}
+
+void operator delete(void *pData, std::align_val_t) noexcept {
+	std::free(pData);
+}
+
+void operator delete[](void *pData, std::align_val_t) noexcept {
+	std::free(pData);
+}
+
+void operator delete(void *pData, size_t, std::align_val_t) noexcept {
+	std::free(pData);
+}
+
+void operator delete[](void *pData, size_t, std::align_val_t) noexcept {
+	std::free(pData);
+}
+
+void operator delete(void *pData, std::align_val_t, const std::nothrow_t &) noexcept {
+	std::free(pData);
+}
+
+void operator delete[](void *pData, std::align_val_t, const std::nothrow_t &) noexcept {
+	std::free(pData);
+}
+
+#endif
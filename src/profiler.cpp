@@ -0,0 +1,88 @@
+#include <SuperSDL/profiler.hpp>
+#include <algorithm>
+#include <cstdio>
+
+namespace sps {
+
+static thread_local CProfiler::Track *t_pTrack = nullptr;
+
+CProfiler::CProfiler() : m_Enabled(false), m_Epoch(std::chrono::steady_clock::now()) {
+}
+
+CProfiler &CProfiler::get() {
+	static CProfiler s_Profiler;
+	return s_Profiler;
+}
+
+CProfiler::Track *CProfiler::createTrack(std::string Name) {
+	std::lock_guard<std::mutex> Lock(m_TracksMutex);
+
+	auto pTrack = std::make_unique<Track>();
+	pTrack->m_Id = m_Tracks.size() + 1;
+	pTrack->m_Name = Name.empty() ? "thread " + std::to_string(pTrack->m_Id) : std::move(Name);
+	pTrack->m_pEvents = std::make_unique<Event[]>(Track::Capacity);
+	pTrack->m_Head = 0;
+
+	m_Tracks.push_back(std::move(pTrack));
+	return m_Tracks.back().get();
+}
+
+CProfiler::Track &CProfiler::threadTrack() {
+	if (!t_pTrack)
+		t_pTrack = createTrack("");
+	return *t_pTrack;
+}
+
+void CProfiler::setThreadName(const char *pName) {
+	Track &Track = threadTrack();
+	std::lock_guard<std::mutex> Lock(m_TracksMutex);
+	Track.m_Name = pName;
+}
+
+CProfiler::Track *CProfiler::addTrack(const char *pName) {
+	return createTrack(pName);
+}
+
+static void writeEscaped(FILE *pFile, const char *pStr) {
+	for (; *pStr; pStr++) {
+		if (*pStr == '"' || *pStr == '\\')
+			std::fputc('\\', pFile);
+		std::fputc(*pStr, pFile);
+	}
+}
+
+bool CProfiler::exportChromeTrace(const std::string &Path) {
+	FILE *pFile = std::fopen(Path.c_str(), "w");
+	if (!pFile)
+		return false;
+
+	std::lock_guard<std::mutex> Lock(m_TracksMutex);
+
+	std::fputs("{\"traceEvents\":[\n", pFile);
+	bool First = true;
+
+	for (const auto &pTrack : m_Tracks) {
+		std::fprintf(pFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+					 First ? "" : ",\n", pTrack->m_Id);
+		writeEscaped(pFile, pTrack->m_Name.c_str());
+		std::fputs("\"}}", pFile);
+		First = false;
+
+		// Only the last Capacity events are still in the ring.
+		uint64_t Head = pTrack->m_Head.load(std::memory_order_acquire);
+		uint64_t Begin = Head > Track::Capacity ? Head - Track::Capacity : 0;
+
+		for (uint64_t i = Begin; i < Head; i++) {
+			const Event &E = pTrack->m_pEvents[i % Track::Capacity];
+			std::fputs(",\n{\"name\":\"", pFile);
+			writeEscaped(pFile, E.m_pName);
+			std::fprintf(pFile, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+						 pTrack->m_Id, E.m_Start / 1000.0, E.m_Duration / 1000.0);
+		}
+	}
+
+	std::fputs("\n]}\n", pFile);
+	return std::fclose(pFile) == 0;
+}
+
+} // namespace sps
@@ -0,0 +1,384 @@
+#include <SuperSDL/spatial.hpp>
+#include <cmath>
+
+namespace sps {
+
+namespace {
+
+// Empty cell ranges, for linking and unlinking without skipping any cell.
+const glm::ivec2 NoSkipMin(1, 1);
+const glm::ivec2 NoSkipMax(0, 0);
+
+// Marks proxies that are in use, the free list ends with NullProxy.
+constexpr uint32_t ProxyUsed = NullProxy - 1;
+
+} // namespace
+
+CSpatialGrid::CSpatialGrid(float CellSize) {
+	m_CellSize = CellSize;
+	m_InvCellSize = 1.0f / CellSize;
+	m_FreeList = NullProxy;
+	m_ProxyCount = 0;
+	m_Slots.assign(64, {0, UINT32_MAX});
+	m_SlotMask = 63;
+}
+
+glm::ivec2 CSpatialGrid::cellOf(glm::vec2 Point) const {
+	// Clamped so far away or non finite boxes can't overflow.
+	constexpr float Limit = float(1 << 30);
+	glm::vec2 Cell = glm::clamp(glm::floor(Point * m_InvCellSize), glm::vec2(-Limit), glm::vec2(Limit));
+	return glm::ivec2(Cell);
+}
+
+const CSpatialGrid::Cell *CSpatialGrid::findCell(int32_t X, int32_t Y) const {
+	uint64_t Key = cellKey(X, Y);
+	for (uint32_t i = hashKey(Key) & m_SlotMask;; i = (i + 1) & m_SlotMask) {
+		const Slot &S = m_Slots[i];
+		if (S.m_Cell == UINT32_MAX)
+			return nullptr;
+		if (S.m_Key == Key)
+			return &m_Cells[S.m_Cell];
+	}
+}
+
+CSpatialGrid::Cell &CSpatialGrid::getCell(int32_t X, int32_t Y) {
+	uint64_t Key = cellKey(X, Y);
+	uint32_t i = hashKey(Key) & m_SlotMask;
+	for (;; i = (i + 1) & m_SlotMask) {
+		const Slot &S = m_Slots[i];
+		if (S.m_Cell == UINT32_MAX)
+			break;
+		if (S.m_Key == Key)
+			return m_Cells[S.m_Cell];
+	}
+
+	m_Slots[i] = {Key, static_cast<uint32_t>(m_Cells.size())};
+	m_Cells.push_back({glm::ivec2(X, Y), {}});
+	// At most half full.
+	if (m_Cells.size() * 2 > m_Slots.size())
+		grow();
+	return m_Cells.back();
+}
+
+void CSpatialGrid::grow() {
+	m_Slots.assign(m_Slots.size() * 2, {0, UINT32_MAX});
+	m_SlotMask = static_cast<uint32_t>(m_Slots.size() - 1);
+	for (uint32_t c = 0; c < m_Cells.size(); c++) {
+		uint64_t Key = cellKey(m_Cells[c].m_Coord.x, m_Cells[c].m_Coord.y);
+		uint32_t i = hashKey(Key) & m_SlotMask;
+		while (m_Slots[i].m_Cell != UINT32_MAX)
+			i = (i + 1) & m_SlotMask;
+		m_Slots[i] = {Key, c};
+	}
+}
+
+void CSpatialGrid::link(uint32_t Index, glm::ivec2 Min, glm::ivec2 Max, glm::ivec2 SkipMin, glm::ivec2 SkipMax) {
+	for (int32_t y = Min.y; y <= Max.y; y++) {
+		for (int32_t x = Min.x; x <= Max.x; x++) {
+			if (x >= SkipMin.x && x <= SkipMax.x && y >= SkipMin.y && y <= SkipMax.y)
+				continue;
+			getCell(x, y).m_Proxies.push_back(Index);
+		}
+	}
+}
+
+void CSpatialGrid::unlink(uint32_t Index, glm::ivec2 Min, glm::ivec2 Max, glm::ivec2 SkipMin, glm::ivec2 SkipMax) {
+	for (int32_t y = Min.y; y <= Max.y; y++) {
+		for (int32_t x = Min.x; x <= Max.x; x++) {
+			if (x >= SkipMin.x && x <= SkipMax.x && y >= SkipMin.y && y <= SkipMax.y)
+				continue;
+			std::vector<uint32_t> &Proxies = getCell(x, y).m_Proxies;
+			auto It = std::find(Proxies.begin(), Proxies.end(), Index);
+			*It = Proxies.back();
+			Proxies.pop_back();
+		}
+	}
+}
+
+void CSpatialGrid::setCellSize(float CellSize) {
+	m_CellSize = CellSize;
+	m_InvCellSize = 1.0f / CellSize;
+
+	m_Cells.clear();
+	m_Slots.assign(64, {0, UINT32_MAX});
+	m_SlotMask = 63;
+
+	for (uint32_t i = 0; i < m_Proxies.size(); i++) {
+		Proxy &P = m_Proxies[i];
+		if (P.m_NextFree != ProxyUsed)
+			continue;
+		P.m_CellMin = cellOf(P.m_Bounds.m_Min);
+		P.m_CellMax = cellOf(P.m_Bounds.m_Max);
+		link(i, P.m_CellMin, P.m_CellMax, NoSkipMin, NoSkipMax);
+	}
+}
+
+uint32_t CSpatialGrid::insert(const Aabb &Bounds, uint32_t UserData) {
+	uint32_t Index;
+	if (m_FreeList != NullProxy) {
+		Index = m_FreeList;
+		m_FreeList = m_Proxies[Index].m_NextFree;
+	} else {
+		Index = static_cast<uint32_t>(m_Proxies.size());
+		m_Proxies.emplace_back();
+	}
+
+	Proxy &P = m_Proxies[Index];
+	P.m_Bounds = Bounds;
+	P.m_CellMin = cellOf(Bounds.m_Min);
+	P.m_CellMax = cellOf(Bounds.m_Max);
+	P.m_UserData = UserData;
+	P.m_NextFree = ProxyUsed;
+	link(Index, P.m_CellMin, P.m_CellMax, NoSkipMin, NoSkipMax);
+	m_ProxyCount++;
+	return Index;
+}
+
+void CSpatialGrid::remove(uint32_t Index) {
+	Proxy &P = m_Proxies[Index];
+	unlink(Index, P.m_CellMin, P.m_CellMax, NoSkipMin, NoSkipMax);
+	P.m_NextFree = m_FreeList;
+	m_FreeList = Index;
+	m_ProxyCount--;
+}
+
+void CSpatialGrid::update(uint32_t Index, const Aabb &Bounds) {
+	Proxy &P = m_Proxies[Index];
+	P.m_Bounds = Bounds;
+
+	glm::ivec2 Min = cellOf(Bounds.m_Min);
+	glm::ivec2 Max = cellOf(Bounds.m_Max);
+	if (Min == P.m_CellMin && Max == P.m_CellMax)
+		return;
+
+	unlink(Index, P.m_CellMin, P.m_CellMax, Min, Max);
+	link(Index, Min, Max, P.m_CellMin, P.m_CellMax);
+	P.m_CellMin = Min;
+	P.m_CellMax = Max;
+}
+
+void CSpatialGrid::clear() {
+	m_Proxies.clear();
+	m_FreeList = NullProxy;
+	m_ProxyCount = 0;
+	// Keeps the cells and their storage around for the next fill.
+	for (Cell &C : m_Cells)
+		C.m_Proxies.clear();
+}
+
+CAabbTree::CAabbTree(float Margin) {
+	m_Root = NullProxy;
+	m_FreeList = NullProxy;
+	m_LeafCount = 0;
+	m_Margin = Margin;
+}
+
+uint32_t CAabbTree::allocateNode() {
+	uint32_t Index;
+	if (m_FreeList != NullProxy) {
+		Index = m_FreeList;
+		m_FreeList = m_Nodes[Index].m_Parent;
+	} else {
+		Index = static_cast<uint32_t>(m_Nodes.size());
+		m_Nodes.emplace_back();
+	}
+
+	Node &N = m_Nodes[Index];
+	N.m_Parent = NullProxy;
+	N.m_aChild[0] = NullProxy;
+	N.m_aChild[1] = NullProxy;
+	N.m_Height = 0;
+	N.m_UserData = 0;
+	return Index;
+}
+
+void CAabbTree::freeNode(uint32_t Index) {
+	m_Nodes[Index].m_Parent = m_FreeList;
+	m_Nodes[Index].m_Height = -1;
+	m_FreeList = Index;
+}
+
+void CAabbTree::refit(uint32_t Index) {
+	while (Index != NullProxy) {
+		Index = balance(Index);
+
+		Node &N = m_Nodes[Index];
+		const Node &A = m_Nodes[N.m_aChild[0]];
+		const Node &B = m_Nodes[N.m_aChild[1]];
+		N.m_Height = 1 + std::max(A.m_Height, B.m_Height);
+		N.m_Bounds = A.m_Bounds.merged(B.m_Bounds);
+		Index = N.m_Parent;
+	}
+}
+
+void CAabbTree::insertLeaf(uint32_t Leaf) {
+	if (m_Root == NullProxy) {
+		m_Root = Leaf;
+		m_Nodes[Leaf].m_Parent = NullProxy;
+		return;
+	}
+
+	// Walks down to the sibling that grows the total perimeter the least,
+	// see "Fast, Effective BVH Updates for Animated Scenes".
+	const Aabb Bounds = m_Nodes[Leaf].m_Bounds;
+	uint32_t Index = m_Root;
+	while (!m_Nodes[Index].isLeaf()) {
+		const Node &N = m_Nodes[Index];
+		float Perimeter = N.m_Bounds.perimeter();
+		float Combined = N.m_Bounds.merged(Bounds).perimeter();
+
+		// Making a new parent for this node and the leaf.
+		float Cost = 2.0f * Combined;
+		// Every ancestor below this one grows by at least this much.
+		float InheritedCost = 2.0f * (Combined - Perimeter);
+
+		float aChildCost[2];
+		for (int i = 0; i < 2; i++) {
+			const Node &Child = m_Nodes[N.m_aChild[i]];
+			float Merged = Child.m_Bounds.merged(Bounds).perimeter();
+			aChildCost[i] = (Child.isLeaf() ? Merged : Merged - Child.m_Bounds.perimeter()) + InheritedCost;
+		}
+
+		if (Cost < aChildCost[0] && Cost < aChildCost[1])
+			break;
+		Index = N.m_aChild[aChildCost[0] < aChildCost[1] ? 0 : 1];
+	}
+
+	uint32_t Sibling = Index;
+	uint32_t OldParent = m_Nodes[Sibling].m_Parent;
+	uint32_t NewParent = allocateNode();
+
+	Node &P = m_Nodes[NewParent];
+	P.m_Parent = OldParent;
+	P.m_Bounds = Bounds.merged(m_Nodes[Sibling].m_Bounds);
+	P.m_Height = m_Nodes[Sibling].m_Height + 1;
+	P.m_aChild[0] = Sibling;
+	P.m_aChild[1] = Leaf;
+	m_Nodes[Sibling].m_Parent = NewParent;
+	m_Nodes[Leaf].m_Parent = NewParent;
+
+	if (OldParent != NullProxy) {
+		Node &Old = m_Nodes[OldParent];
+		Old.m_aChild[Old.m_aChild[0] == Sibling ? 0 : 1] = NewParent;
+	} else {
+		m_Root = NewParent;
+	}
+
+	refit(OldParent);
+}
+
+void CAabbTree::removeLeaf(uint32_t Leaf) {
+	if (Leaf == m_Root) {
+		m_Root = NullProxy;
+		return;
+	}
+
+	uint32_t Parent = m_Nodes[Leaf].m_Parent;
+	uint32_t GrandParent = m_Nodes[Parent].m_Parent;
+	const Node &P = m_Nodes[Parent];
+	uint32_t Sibling = P.m_aChild[P.m_aChild[0] == Leaf ? 1 : 0];
+
+	// The sibling takes the parent's place.
+	m_Nodes[Sibling].m_Parent = GrandParent;
+	if (GrandParent != NullProxy) {
+		Node &G = m_Nodes[GrandParent];
+		G.m_aChild[G.m_aChild[0] == Parent ? 0 : 1] = Sibling;
+	} else {
+		m_Root = Sibling;
+	}
+	freeNode(Parent);
+
+	refit(GrandParent);
+}
+
+uint32_t CAabbTree::balance(uint32_t IndexA) {
+	Node &A = m_Nodes[IndexA];
+	if (A.isLeaf() || A.m_Height < 2)
+		return IndexA;
+
+	uint32_t IndexB = A.m_aChild[0];
+	uint32_t IndexC = A.m_aChild[1];
+	Node &B = m_Nodes[IndexB];
+	Node &C = m_Nodes[IndexC];
+	int32_t Balance = C.m_Height - B.m_Height;
+
+	// Rotates the taller child up, the shorter of its children goes to A.
+	auto Rotate = [&](uint32_t IndexUp, Node &Up, int UpSide, Node &Other) {
+		uint32_t IndexF = Up.m_aChild[0];
+		uint32_t IndexG = Up.m_aChild[1];
+		Node &F = m_Nodes[IndexF];
+		Node &G = m_Nodes[IndexG];
+
+		Up.m_aChild[0] = IndexA;
+		Up.m_Parent = A.m_Parent;
+		A.m_Parent = IndexUp;
+		if (Up.m_Parent != NullProxy) {
+			Node &Parent = m_Nodes[Up.m_Parent];
+			Parent.m_aChild[Parent.m_aChild[0] == IndexA ? 0 : 1] = IndexUp;
+		} else {
+			m_Root = IndexUp;
+		}
+
+		bool KeepF = F.m_Height > G.m_Height;
+		uint32_t IndexKeep = KeepF ? IndexF : IndexG;
+		uint32_t IndexMove = KeepF ? IndexG : IndexF;
+		Node &Keep = KeepF ? F : G;
+		Node &Move = KeepF ? G : F;
+
+		Up.m_aChild[1] = IndexKeep;
+		A.m_aChild[UpSide] = IndexMove;
+		Move.m_Parent = IndexA;
+		A.m_Bounds = Other.m_Bounds.merged(Move.m_Bounds);
+		Up.m_Bounds = A.m_Bounds.merged(Keep.m_Bounds);
+		A.m_Height = 1 + std::max(Other.m_Height, Move.m_Height);
+		Up.m_Height = 1 + std::max(A.m_Height, Keep.m_Height);
+	};
+
+	if (Balance > 1) {
+		Rotate(IndexC, C, 1, B);
+		return IndexC;
+	}
+	if (Balance < -1) {
+		Rotate(IndexB, B, 0, C);
+		return IndexB;
+	}
+	return IndexA;
+}
+
+uint32_t CAabbTree::insert(const Aabb &Bounds, uint32_t UserData) {
+	uint32_t Leaf = allocateNode();
+	Node &N = m_Nodes[Leaf];
+	N.m_Bounds = Bounds.expanded(m_Margin);
+	N.m_Tight = Bounds;
+	N.m_UserData = UserData;
+	insertLeaf(Leaf);
+	m_LeafCount++;
+	return Leaf;
+}
+
+void CAabbTree::remove(uint32_t Proxy) {
+	removeLeaf(Proxy);
+	freeNode(Proxy);
+	m_LeafCount--;
+}
+
+bool CAabbTree::update(uint32_t Proxy, const Aabb &Bounds) {
+	Node &N = m_Nodes[Proxy];
+	N.m_Tight = Bounds;
+	if (N.m_Bounds.contains(Bounds))
+		return false;
+
+	removeLeaf(Proxy);
+	m_Nodes[Proxy].m_Bounds = Bounds.expanded(m_Margin);
+	insertLeaf(Proxy);
+	return true;
+}
+
+void CAabbTree::clear() {
+	m_Nodes.clear();
+	m_Root = NullProxy;
+	m_FreeList = NullProxy;
+	m_LeafCount = 0;
+}
+
+} // namespace sps
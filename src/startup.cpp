@@ -0,0 +1,60 @@
+#include <SuperSDL/startup.hpp>
+#include <algorithm>
+
+namespace sps {
+
+CStartup::CStartup() : CLoggable("startup") {
+	m_Begin = clock_t::now();
+	m_MainThread = std::this_thread::get_id();
+	m_Parallel = true;
+	m_Finished = false;
+}
+
+void CStartup::begin() {
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+	m_Begin = clock_t::now();
+	m_MainThread = std::this_thread::get_id();
+	m_Finished = false;
+	m_Stats = StartupStats();
+}
+
+void CStartup::record(const char *pName, clock_t::time_point Start) {
+	clock_t::time_point End = clock_t::now();
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+	StartupStep Step;
+	Step.m_pName = pName;
+	Step.m_Start = std::chrono::duration<double>(Start - m_Begin).count();
+	Step.m_Duration = std::chrono::duration<double>(End - Start).count();
+	Step.m_Background = std::this_thread::get_id() != m_MainThread;
+	m_Stats.m_Steps.push_back(Step);
+	if (Step.m_Background)
+		m_Stats.m_BackgroundTime += Step.m_Duration;
+}
+
+void CStartup::finish() {
+	if (m_Finished)
+		return;
+
+	StartupStats Stats;
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		m_Stats.m_TimeToFirstFrame = std::chrono::duration<double>(clock_t::now() - m_Begin).count();
+		m_Finished = true;
+		Stats = m_Stats;
+	}
+
+	Log()->info("First frame after {:.2f}ms, {:.2f}ms of work ran in the background{}", Stats.m_TimeToFirstFrame * 1e3,
+				Stats.m_BackgroundTime * 1e3, m_Parallel ? "" : " (parallel startup is off)");
+
+	// Listed by when they started, which reads like a timeline.
+	std::sort(Stats.m_Steps.begin(), Stats.m_Steps.end(), [](const StartupStep &A, const StartupStep &B) { return A.m_Start < B.m_Start; });
+	for (const StartupStep &Step : Stats.m_Steps)
+		Log()->info("  {:<24} {:8.2f}ms at {:8.2f}ms{}", Step.m_pName, Step.m_Duration * 1e3, Step.m_Start * 1e3, Step.m_Background ? " (background)" : "");
+}
+
+StartupStats CStartup::getStats() const {
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+	return m_Stats;
+}
+
+} // namespace sps
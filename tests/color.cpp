@@ -0,0 +1,161 @@
+#include "test.hpp"
+#include <SuperSDL/color.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace test {
+
+namespace {
+
+struct Planes {
+	std::vector<float> m_R, m_G, m_B, m_A;
+
+	explicit Planes(size_t Count) : m_R(Count), m_G(Count), m_B(Count), m_A(Count) {}
+
+	sps::ColorPlanes get() { return {m_R.data(), m_G.data(), m_B.data(), m_A.data()}; }
+
+	// Bit for bit, so NaNs compare equal as well.
+	bool operator==(const Planes &Other) const {
+		auto Same = [](const std::vector<float> &A, const std::vector<float> &B) {
+			return A.size() == B.size() && std::memcmp(A.data(), B.data(), A.size() * sizeof(float)) == 0;
+		};
+		return Same(m_R, Other.m_R) && Same(m_G, Other.m_G) && Same(m_B, Other.m_B) && Same(m_A, Other.m_A);
+	}
+};
+
+double linearToSrgb(double v) {
+	return v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+}
+
+uint32_t levelError(uint32_t A, uint32_t B) { return A > B ? A - B : B - A; }
+
+// Every implementation the CPU supports gives the scalar results bit for
+// bit. The count isn't a multiple of any vector width so the tails run too.
+void colorKernelParity() {
+	constexpr size_t Count = 4099;
+
+	std::vector<uint32_t> Source(Count);
+	for (size_t i = 0; i < Count; i++)
+		Source[i] = uint32_t(i * 2654435761u);
+	Planes Background(Count);
+	for (size_t i = 0; i < Count; i++) {
+		Background.m_R[i] = float(i % 7) / 6.0f;
+		Background.m_G[i] = float(i % 11) / 10.0f;
+		Background.m_B[i] = float(i % 13) / 12.0f;
+		Background.m_A[i] = float(i % 5) / 4.0f;
+	}
+	// Out of range and NaN are clamped the same way by every kernel.
+	Background.m_R[1] = -0.5f;
+	Background.m_G[2] = 1.5f;
+	Background.m_B[3] = std::nanf("");
+	Background.m_A[4] = 2.0f;
+
+	sps::EColorKernels Best = sps::getColorKernels();
+	Planes Reference(Count);
+	std::vector<uint32_t> ReferencePacked(Count);
+	for (int k = sps::COLOR_KERNELS_SCALAR; k <= Best; k++) {
+		sps::EColorKernels Kernels = sps::setColorKernels(sps::EColorKernels(k));
+		Planes Colors(Count);
+		Planes Target = Background;
+		std::vector<uint32_t> Packed(Count);
+
+		sps::unpackSrgb(Source.data(), Colors.get(), Count);
+		sps::premultiply(Colors.get(), Count);
+		sps::blendOver(Target.get(), Colors.get(), Count);
+		sps::packSrgb(Target.get(), Packed.data(), Count);
+
+		if (Kernels == sps::COLOR_KERNELS_SCALAR) {
+			Reference = Target;
+			ReferencePacked = Packed;
+		} else {
+			std::printf("    %s against scalar\n", sps::getColorKernelsName(Kernels));
+			SPS_CHECK(Target == Reference);
+			SPS_CHECK(Packed == ReferencePacked);
+		}
+	}
+	sps::setColorKernels(Best);
+}
+
+// Every level decodes and encodes back to itself, and the table encoding
+// stays within one level of the exact conversion.
+void srgbRoundTrip() {
+	std::vector<uint32_t> Levels(256);
+	for (uint32_t i = 0; i < 256; i++)
+		Levels[i] = sps::packRGBA(uint8_t(i), uint8_t(255 - i), uint8_t(i * 7), uint8_t(i));
+
+	sps::EColorKernels Best = sps::getColorKernels();
+	for (int k = sps::COLOR_KERNELS_SCALAR; k <= Best; k++) {
+		sps::setColorKernels(sps::EColorKernels(k));
+		Planes Linear(256);
+		std::vector<uint32_t> Packed(256);
+		sps::unpackSrgb(Levels.data(), Linear.get(), 256);
+		sps::packSrgb(Linear.get(), Packed.data(), 256);
+		SPS_CHECK(Packed == Levels);
+
+		// Level 0 and 255 are exact, alpha is only normalized.
+		SPS_CHECK(Linear.m_R[0] == 0.0f && Linear.m_R[255] == 1.0f);
+		SPS_CHECK(Linear.m_A[255] == 1.0f && std::fabs(Linear.m_A[51] - 0.2f) < 1e-6f);
+	}
+	sps::setColorKernels(Best);
+
+	constexpr size_t Count = 1 << 16;
+	Planes Sweep(Count);
+	for (size_t i = 0; i < Count; i++) {
+		// Denser towards 0 where the curve is steepest.
+		float t = float(i) / float(Count - 1);
+		Sweep.m_R[i] = t;
+		Sweep.m_G[i] = t * t;
+		Sweep.m_B[i] = t * t * t * t;
+		Sweep.m_A[i] = t;
+	}
+	std::vector<uint32_t> Packed(Count);
+	sps::packSrgb(Sweep.get(), Packed.data(), Count);
+
+	uint32_t MaxError = 0;
+	for (size_t i = 0; i < Count; i++) {
+		auto Exact = [](float v) { return uint32_t(std::lround(linearToSrgb(v) * 255.0)); };
+		MaxError = std::max(MaxError, levelError(Exact(Sweep.m_R[i]), Packed[i] & 0xFF));
+		MaxError = std::max(MaxError, levelError(Exact(Sweep.m_G[i]), (Packed[i] >> 8) & 0xFF));
+		MaxError = std::max(MaxError, levelError(Exact(Sweep.m_B[i]), (Packed[i] >> 16) & 0xFF));
+		MaxError = std::max(MaxError, levelError(uint32_t(std::lround(Sweep.m_A[i] * 255.0)), Packed[i] >> 24));
+	}
+	SPS_CHECK(MaxError <= 1);
+}
+
+void colorConversions() {
+	SPS_CHECK(sps::CColor(255, 0, 51).r == 1.0f);
+	SPS_CHECK(sps::CColor(255, 0, 51).b == 0.2f);
+	SPS_CHECK(sps::CColor(255, 0, 51).a == 1.0f);
+	SPS_CHECK(sps::COLOR_GRAY.a == sps::COLOR_GRAY.r);
+
+	sps::CColor Hex = sps::CColor::from_hex(0x80FF01);
+	SPS_CHECK(sps::packColor(Hex) == sps::packRGBA(0x80, 0xFF, 0x01));
+
+	// Every level survives packing, unpacking and packing again.
+	bool RoundTrips = true;
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t Packed = sps::packRGBA(uint8_t(i), uint8_t(255 - i), uint8_t(i / 2), uint8_t(i));
+		RoundTrips &= sps::packColor(sps::unpackColor(Packed)) == Packed;
+	}
+	SPS_CHECK(RoundTrips);
+
+	// Out of range channels saturate when packed.
+	sps::CColor Over = sps::COLOR_WHITE + sps::COLOR_RED;
+	SPS_CHECK(Over.r == 2.0f);
+	SPS_CHECK(sps::packColor(Over) == 0xFFFFFFFFu);
+	SPS_CHECK(sps::packColor(sps::COLOR_BLACK - sps::COLOR_WHITE) == 0u);
+	SPS_CHECK(sps::packColor(sps::COLOR_YELLOW * sps::COLOR_CYAN) == sps::packColor(sps::COLOR_LIME));
+
+	static_assert(sps::packColor(sps::COLOR_MAGENTA) == sps::packRGBA(255, 0, 255), "packColor must stay constexpr");
+}
+
+RegisterTest s_ColorKernelParity("color_kernel_parity", colorKernelParity);
+RegisterTest s_SrgbRoundTrip("srgb_round_trip", srgbRoundTrip);
+RegisterTest s_ColorConversions("color_conversions", colorConversions);
+
+} // namespace
+
+} // namespace test
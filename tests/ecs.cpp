@@ -0,0 +1,214 @@
+#include "test.hpp"
+#include <SuperSDL/ecs.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace test {
+
+namespace {
+
+struct Position {
+	float m_X, m_Y;
+};
+
+struct Velocity {
+	float m_X, m_Y;
+};
+
+// Counts its live instances, to find leaked or doubly destroyed components
+// and command captures.
+struct Tracked {
+	static int s_Alive;
+	// Assigning one throws while set.
+	static bool s_Throw;
+	int m_Value;
+
+	explicit Tracked(int Value = 0) : m_Value(Value) { s_Alive++; }
+	Tracked(const Tracked &Other) : m_Value(Other.m_Value) { s_Alive++; }
+	Tracked(Tracked &&Other) : m_Value(Other.m_Value) { s_Alive++; }
+	~Tracked() { s_Alive--; }
+	Tracked &operator=(const Tracked &Other) {
+		if (s_Throw)
+			throw std::runtime_error("assignment failed");
+		m_Value = Other.m_Value;
+		return *this;
+	}
+};
+
+int Tracked::s_Alive = 0;
+bool Tracked::s_Throw = false;
+
+void ecsSpawnDestroy() {
+	{
+		sps::CWorld World;
+		World.init(nullptr);
+
+		sps::Entity A = World.create(Position{1.0f, 2.0f});
+		sps::Entity B = World.create(Position{3.0f, 4.0f}, Velocity{1.0f, 0.0f});
+		sps::Entity C = World.create(Tracked(7));
+		SPS_CHECK(A && B && C);
+		SPS_CHECK(A != B);
+		SPS_CHECK(World.getEntityCount() == 3);
+		SPS_CHECK(World.has<Position>(B) && World.has<Velocity>(B) && !World.has<Velocity>(A));
+		SPS_CHECK(World.get<Position>(A) && World.get<Position>(A)->m_Y == 2.0f);
+		SPS_CHECK(World.get<Velocity>(A) == nullptr);
+		SPS_CHECK(Tracked::s_Alive == 1);
+
+		// Removing A moves the last entity of its archetype into its row.
+		World.destroy(A);
+		SPS_CHECK(!World.isAlive(A));
+		SPS_CHECK(World.isAlive(B) && World.get<Position>(B)->m_X == 3.0f);
+		SPS_CHECK(World.getEntityCount() == 2);
+		World.destroy(A);
+		SPS_CHECK(World.getEntityCount() == 2);
+
+		// The index is reused with another generation, the old handle stays dead.
+		sps::Entity D = World.create(Position{5.0f, 6.0f});
+		SPS_CHECK(!World.isAlive(A) && World.isAlive(D));
+		SPS_CHECK(World.get<Position>(A) == nullptr);
+
+		World.add(B, Tracked(1));
+		World.remove<Velocity>(B);
+		SPS_CHECK(World.has<Tracked>(B) && !World.has<Velocity>(B));
+		SPS_CHECK(World.get<Position>(B)->m_Y == 4.0f);
+		SPS_CHECK(Tracked::s_Alive == 2);
+
+		World.destroy(C);
+		SPS_CHECK(Tracked::s_Alive == 1);
+	}
+	// quit() destroys what's left.
+	SPS_CHECK(Tracked::s_Alive == 0);
+}
+
+void ecsQuery() {
+	sps::CWorld World;
+	World.init(nullptr);
+
+	constexpr int Count = 3000;
+	for (int i = 0; i < Count; i++) {
+		if (i % 3 == 0)
+			World.create(Position{float(i), 0.0f});
+		else
+			World.create(Position{float(i), 0.0f}, Velocity{1.0f, 2.0f});
+	}
+
+	int Moved = 0;
+	World.each<Position, const Velocity>([&Moved](Position &P, const Velocity &V) {
+		P.m_X += V.m_X;
+		P.m_Y += V.m_Y;
+		Moved++;
+	});
+	SPS_CHECK(Moved == Count - Count / 3);
+
+	double Sum = 0.0;
+	int Seen = 0;
+	bool Alive = true;
+	World.each<Position>([&](sps::Entity E, const Position &P) {
+		Sum += P.m_X;
+		Alive &= World.isAlive(E);
+		Seen++;
+	});
+	SPS_CHECK(Seen == Count);
+	SPS_CHECK(Alive);
+	SPS_CHECK(Sum == double(Count) * (Count - 1) / 2 + Moved);
+
+	// Chunks cover every matching entity once.
+	uint32_t Columns = 0;
+	World.eachChunk<Velocity>([&Columns](uint32_t ChunkCount, const sps::Entity *pEntities, Velocity *pVelocities) {
+		(void)pEntities;
+		for (uint32_t i = 0; i < ChunkCount; i++)
+			Columns += pVelocities[i].m_Y == 2.0f;
+	});
+	SPS_CHECK(Columns == uint32_t(Moved));
+
+	// Structural changes while iterating throw.
+	bool Threw = false;
+	World.each<Position>([&](sps::Entity E, Position &) {
+		if (Threw)
+			return;
+		try {
+			World.destroy(E);
+		} catch (const std::exception &) {
+			Threw = true;
+		}
+	});
+	SPS_CHECK(Threw);
+	SPS_CHECK(World.getEntityCount() == Count);
+}
+
+void ecsCommands() {
+	{
+		sps::CWorld World;
+		World.init(nullptr);
+
+		std::vector<sps::Entity> Entities;
+		for (int i = 0; i < 10; i++)
+			Entities.push_back(World.create(Position{float(i), 0.0f}));
+
+		// Recorded while iterating, applied in order by flush().
+		World.each<Position>([&World](sps::Entity E, const Position &P) {
+			int i = int(P.m_X);
+			if (i % 2 == 0)
+				World.commands().destroy(E);
+			else
+				World.commands().add(E, Tracked(i));
+			if (i == 9)
+				World.commands().create(Position{100.0f, 0.0f}, Tracked(100));
+		});
+		SPS_CHECK(World.commands().size() == 11);
+		SPS_CHECK(World.getEntityCount() == 10);
+		SPS_CHECK(!World.has<Tracked>(Entities[1]));
+
+		// The destroyed entity's add below is dropped.
+		World.commands().add(Entities[0], Tracked(-1));
+		World.flush();
+		SPS_CHECK(World.commands().size() == 0);
+		SPS_CHECK(World.getEntityCount() == 6);
+		SPS_CHECK(!World.isAlive(Entities[0]) && World.isAlive(Entities[1]));
+		SPS_CHECK(World.get<Tracked>(Entities[3]) && World.get<Tracked>(Entities[3])->m_Value == 3);
+		SPS_CHECK(Tracked::s_Alive == 6);
+
+		int Created = 0;
+		World.each<Position, Tracked>([&Created](const Position &P, const Tracked &T) { Created += P.m_X == 100.0f && T.m_Value == 100; });
+		SPS_CHECK(Created == 1);
+
+		// Cleared commands never run, their captures are still destroyed.
+		World.commands().create(Tracked(5));
+		World.commands().clear();
+		World.flush();
+		SPS_CHECK(World.getEntityCount() == 6);
+		SPS_CHECK(Tracked::s_Alive == 6);
+
+		// A command that throws stops the flush, the ones after it are
+		// destroyed without running.
+		World.commands().add(Entities[1], Tracked(11));
+		World.commands().add(Entities[3], Tracked(13));
+		World.commands().create(Tracked(20));
+		Tracked::s_Throw = true;
+		bool Threw = false;
+		try {
+			World.flush();
+		} catch (const std::runtime_error &) {
+			Threw = true;
+		}
+		Tracked::s_Throw = false;
+		SPS_CHECK(Threw);
+		SPS_CHECK(World.commands().size() == 0);
+		SPS_CHECK(World.getEntityCount() == 6);
+		SPS_CHECK(Tracked::s_Alive == 6);
+
+		// The buffer is still usable afterwards.
+		World.commands().add(Entities[1], Tracked(11));
+		World.flush();
+		SPS_CHECK(World.get<Tracked>(Entities[1])->m_Value == 11);
+	}
+	SPS_CHECK(Tracked::s_Alive == 0);
+}
+
+RegisterTest s_EcsSpawnDestroy("ecs_spawn_destroy", ecsSpawnDestroy);
+RegisterTest s_EcsQuery("ecs_query", ecsQuery);
+RegisterTest s_EcsCommands("ecs_commands", ecsCommands);
+
+} // namespace
+
+} // namespace test
@@ -0,0 +1,50 @@
+#include "test.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace test {
+
+namespace {
+
+uint32_t s_Failures = 0;
+
+} // namespace
+
+std::vector<TestCase> &testCases() {
+	static std::vector<TestCase> s_TestCases;
+	return s_TestCases;
+}
+
+void fail(const char *pFile, int Line, const char *pCheck) {
+	std::printf("    %s:%d: failed %s\n", pFile, Line, pCheck);
+	s_Failures++;
+}
+
+} // namespace test
+
+// Runs the tests named on the command line, or all of them.
+int main(int argc, char **argv) {
+	uint32_t Ran = 0;
+	for (const test::TestCase &Case : test::testCases()) {
+		bool Selected = argc < 2;
+		for (int i = 1; i < argc && !Selected; i++)
+			Selected = std::strcmp(argv[i], Case.m_pName) == 0;
+		if (!Selected)
+			continue;
+
+		std::printf("== %s\n", Case.m_pName);
+		Case.m_pRun();
+		Ran++;
+	}
+
+	if (Ran == 0) {
+		std::printf("no test matches\n");
+		return 1;
+	}
+	if (test::s_Failures != 0) {
+		std::printf("%u checks failed\n", test::s_Failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef SUPERSDL_TESTS_TEST_HPP
+#define SUPERSDL_TESTS_TEST_HPP
+
+#include <vector>
+
+namespace test {
+
+// A group of checks, run by name so CTest can list each on its own.
+struct TestCase {
+	const char *m_pName;
+	void (*m_pRun)();
+};
+
+std::vector<TestCase> &testCases();
+
+// Prints the failed check, the test exits with 1 once it's done.
+void fail(const char *pFile, int Line, const char *pCheck);
+
+struct RegisterTest {
+	RegisterTest(const char *pName, void (*pRun)()) { testCases().push_back({pName, pRun}); }
+};
+
+} // namespace test
+
+// Keeps going after a failure so one run reports every broken check.
+#define SPS_CHECK(Check) ((Check) ? (void)0 : test::fail(__FILE__, __LINE__, #Check))
+
+#endif
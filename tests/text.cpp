@@ -0,0 +1,49 @@
+#include "test.hpp"
+#include <SuperSDL/font_atlas.hpp>
+#include <string_view>
+#include <vector>
+
+namespace test {
+
+namespace {
+
+std::vector<uint32_t> decode(std::string_view Text) {
+	std::vector<uint32_t> CodePoints;
+	for (size_t i = 0; i < Text.size();)
+		CodePoints.push_back(sps::decodeUtf8(Text, i));
+	return CodePoints;
+}
+
+using CodePoints = std::vector<uint32_t>;
+
+void utf8Decode() {
+	// One of each length, and the ends of the valid range.
+	SPS_CHECK(decode("a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80") == (CodePoints{'a', 0xE9, 0x20AC, 0x1F600}));
+	SPS_CHECK(decode("\xC2\x80\xE0\xA0\x80\xF0\x90\x80\x80") == (CodePoints{0x80, 0x800, 0x10000}));
+	SPS_CHECK(decode("\xDF\xBF\xEF\xBF\xBF\xF4\x8F\xBF\xBF") == (CodePoints{0x7FF, 0xFFFF, 0x10FFFF}));
+	SPS_CHECK(decode("\xED\x9F\xBF\xEE\x80\x80") == (CodePoints{0xD7FF, 0xE000}));
+
+	// Overlong forms of '/' and U+07FF, U+FFFF.
+	SPS_CHECK(decode("\xC0\xAF") == (CodePoints{0xFFFD, 0xFFFD}));
+	SPS_CHECK(decode("\xC1\xBF") == (CodePoints{0xFFFD, 0xFFFD}));
+	SPS_CHECK(decode("\xE0\x9F\xBF") == (CodePoints{0xFFFD, 0xFFFD, 0xFFFD}));
+	SPS_CHECK(decode("\xF0\x8F\xBF\xBF") == (CodePoints{0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD}));
+
+	// Surrogates and code points past U+10FFFF.
+	SPS_CHECK(decode("\xED\xA0\x80") == (CodePoints{0xFFFD, 0xFFFD, 0xFFFD}));
+	SPS_CHECK(decode("\xED\xBF\xBF") == (CodePoints{0xFFFD, 0xFFFD, 0xFFFD}));
+	SPS_CHECK(decode("\xF4\x90\x80\x80") == (CodePoints{0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD}));
+	SPS_CHECK(decode("\xF5\x80\x80\x80") == (CodePoints{0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD}));
+
+	// A cut off sequence gives one U+FFFD and the next character survives.
+	SPS_CHECK(decode("\xE2\x82" "a") == (CodePoints{0xFFFD, 'a'}));
+	SPS_CHECK(decode("\xF0\x9F\x98") == (CodePoints{0xFFFD}));
+	SPS_CHECK(decode("\x80\xBF") == (CodePoints{0xFFFD, 0xFFFD}));
+	SPS_CHECK(decode("\xFF" "b") == (CodePoints{0xFFFD, 'b'}));
+}
+
+RegisterTest s_Utf8Decode("utf8_decode", utf8Decode);
+
+} // namespace
+
+} // namespace test